@@ -0,0 +1,148 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Batch Executor Benchmark
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_batch_benchmark.c
+//
+// Description:
+//   Measures how the batch executor scales with the number of threads. The same batch of machines is run with 1, 2, 4, ...
+//   threads up to the number of cores, and the throughput, speedup and parallel efficiency of each run are printed.
+//
+//   Build: cc -O2 -pthread -I../Source mos6502_batch_benchmark.c ../Source/mos6502_batch.c ../Source/mos6502_emulator.c
+//          ../Source/mos6502_block_cache.c ../Source/mos6502_jit.c ../Source/mos6502_memory_bus.c ../Source/mos6502_debugger.c
+//          -o mos6502_batch_benchmark
+//   Usage: mos6502_batch_benchmark [job count] [instructions per job] [max threads]
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Local
+#include "mos6502_batch.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defaults for the command line arguments
+#define DEFAULT_JOB_COUNT 256
+#define DEFAULT_INSTRUCTIONS_PER_JOB 1000000
+
+// Where the test program is loaded
+#define PROGRAM_ADDRESS 0x0200
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Everything owned by a single machine
+typedef struct t_struct_machine {
+    unsigned char memory[MOS_6502_MEM_SIZE];
+    t_memory_bus bus;
+    t_registers registers;
+} t_machine;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Adds one to every byte of page 3 forever
+static const unsigned char test_program[] = {
+    0xA2, 0x00,         // start: LDX #$00
+    0xBD, 0x00, 0x03,   // loop:  LDA $0300,X
+    0x18,               //        CLC
+    0x69, 0x01,         //        ADC #$01
+    0x9D, 0x00, 0x03,   //        STA $0300,X
+    0xE8,               //        INX
+    0xD0, 0xF4,         //        BNE loop
+    0xE6, 0x10,         //        INC $10
+    0x4C, 0x00, 0x02    //        JMP start
+};
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts every machine back at the start of the test program
+static void reset_machines(t_machine *, t_batch_job *, unsigned int, unsigned long long);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    unsigned int job_count = (argc > 1) ? (unsigned int) strtoul(argv[1], NULL, 0) : DEFAULT_JOB_COUNT;
+    unsigned long long instructions_per_job = (argc > 2) ? strtoull(argv[2], NULL, 0) : DEFAULT_INSTRUCTIONS_PER_JOB;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int max_threads = (argc > 3) ? (unsigned int) strtoul(argv[3], NULL, 0) : (unsigned int) ((cores > 0) ? cores : 1);
+    double single_thread_rate = 0;
+
+    t_machine *machines = calloc(job_count, sizeof(t_machine));
+    t_batch_job *jobs = calloc(job_count, sizeof(t_batch_job));
+    if (machines == NULL || jobs == NULL) {
+        printf("Error: Could not allocate %u machines!!\n", job_count);
+        return 1;
+    }
+
+    printf("%u jobs, %llu instructions per job\n", job_count, instructions_per_job);
+    printf("%8s %14s %10s %10s\n", "Threads", "MIPS", "Speedup", "Efficiency");
+
+    for (unsigned int threads = 1; ; threads *= 2) {
+        t_batch_result result;
+
+        if (threads > max_threads) {
+            threads = max_threads;
+        }
+
+        reset_machines(machines, jobs, job_count, instructions_per_job);
+        run_batch_mos6502(jobs, job_count, threads, &result);
+
+        // Every job should have run its whole budget
+        for (unsigned int i = 0; i < job_count; i++) {
+            if (jobs[i].status != RUN_BUDGET_EXHAUSTED) {
+                printf("Error: Job %u stopped early with status %d!!\n", i, jobs[i].status);
+                return 1;
+            }
+        }
+
+        if (threads == 1) {
+            single_thread_rate = result.instructions_per_second;
+        }
+        double speedup = (single_thread_rate > 0) ? result.instructions_per_second / single_thread_rate : 0;
+        printf("%8u %14.1f %9.2fx %9.1f%%\n", result.thread_count, result.instructions_per_second / 1e6, speedup,
+               100.0 * speedup / result.thread_count);
+
+        if (threads == max_threads) {
+            break;
+        }
+    }
+
+    free(jobs);
+    free(machines);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts every machine back at the start of the test program with a fresh budget
+//   Inputs: Machines, Jobs, Job Count, Instructions Per Job
+// -------------------------------------------------------------------------------------------------------------------------------
+static void reset_machines(t_machine *machines, t_batch_job *jobs, unsigned int job_count, unsigned long long instructions_per_job) {
+    for (unsigned int i = 0; i < job_count; i++) {
+        t_machine *machine = &machines[i];
+
+        init_memory_bus_mos6502(&machine->bus);
+        map_memory_mos6502(&machine->bus, 0, MEMORY_PAGE_COUNT, machine->memory, 0);
+        memcpy(&machine->memory[PROGRAM_ADDRESS], test_program, sizeof(test_program));
+        reset_mos6502(&machine->bus, &machine->registers);
+        machine->registers.program_counter = PROGRAM_ADDRESS;
+
+        memset(&jobs[i], 0, sizeof(t_batch_job));
+        jobs[i].bus = &machine->bus;
+        jobs[i].registers = &machine->registers;
+        jobs[i].budget.instruction_limit = instructions_per_job;
+    }
+}
@@ -0,0 +1,221 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Block Cache Benchmark
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_block_cache_benchmark.c
+//
+// Description:
+//   Compares running from the block cache, with and without the JIT, with the interpreter. Each test program is run on all
+//   three and the memory, registers and cycles are checked to match. The second program rewrites one of its own instructions
+//   on every pass of its loop, so the cache has to throw the block away and decode it again each time.
+//
+//   Build: cc -O2 -I../Source mos6502_block_cache_benchmark.c ../Source/mos6502_block_cache.c ../Source/mos6502_jit.c
+//          ../Source/mos6502_emulator.c ../Source/mos6502_memory_bus.c ../Source/mos6502_debugger.c
+//          -o mos6502_block_cache_benchmark
+//   Usage: mos6502_block_cache_benchmark [instructions]
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Local
+#include "mos6502_block_cache.h"
+#include "mos6502_jit.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defaults for the command line arguments
+#define DEFAULT_INSTRUCTIONS 100000000
+
+// Where the test programs are loaded
+#define PROGRAM_ADDRESS 0x0200
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Everything owned by a single machine
+typedef struct t_struct_machine {
+    unsigned char memory[MOS_6502_MEM_SIZE];
+    t_memory_bus bus;
+    t_registers registers;
+} t_machine;
+
+// Test program
+typedef struct t_struct_test_program {
+    const char *name;
+    const unsigned char *code;
+    unsigned int length;
+} t_test_program;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Adds one to every byte of page 3 forever, the same program the batch benchmark uses
+static const unsigned char loop_program[] = {
+    0xA2, 0x00,         // start: LDX #$00
+    0xBD, 0x00, 0x03,   // loop:  LDA $0300,X
+    0x18,               //        CLC
+    0x69, 0x01,         //        ADC #$01
+    0x9D, 0x00, 0x03,   //        STA $0300,X
+    0xE8,               //        INX
+    0xD0, 0xF4,         //        BNE loop
+    0xE6, 0x10,         //        INC $10
+    0x4C, 0x00, 0x02    //        JMP start
+};
+
+// Stores a counter across page 3, bumping the operand of its own LDA on every pass
+static const unsigned char self_modifying_program[] = {
+    0xA2, 0x00,         // start: LDX #$00
+    0xEE, 0x06, 0x02,   // loop:  INC value
+    0xA9, 0x00,         //        LDA #value
+    0x9D, 0x00, 0x03,   //        STA $0300,X
+    0xE8,               //        INX
+    0xD0, 0xF5,         //        BNE loop
+    0x4C, 0x00, 0x02    //        JMP start
+};
+
+static const t_test_program test_programs[] = {
+    { "Loop", loop_program, sizeof(loop_program) },
+    { "Self-modifying", self_modifying_program, sizeof(self_modifying_program) }
+};
+
+// Machines run by the interpreter, from the cache and by the JIT
+static t_machine interpreted_machine;
+static t_machine cached_machine;
+static t_machine jit_machine;
+
+// Block cache, too big for the stack
+static t_block_cache cache;
+
+// JIT, only used when it could be started on this host
+static t_jit jit;
+static int jit_available;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts a machine at the start of a test program
+static void reset_machine(t_machine *, const t_test_program *);
+
+// Checks that a machine ended up in the same state as the interpreted one
+static int matches_interpreter(t_machine *);
+
+// Seconds since an arbitrary point
+static double now_seconds(void);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    unsigned long long instruction_count = (argc > 1) ? strtoull(argv[1], NULL, 0) : DEFAULT_INSTRUCTIONS;
+
+    jit_available = (init_jit_mos6502(&jit) == 0);
+
+    printf("%llu instructions per program\n", instruction_count);
+    printf("%-16s %12s %12s %9s %12s %9s %12s %12s %12s\n", "Program", "Interp MIPS", "Cached MIPS", "Speedup", "JIT MIPS",
+           "Speedup", "Hits", "Misses", "Invalidated");
+
+    for (unsigned int p = 0; p < sizeof(test_programs) / sizeof(test_programs[0]); p++) {
+        const t_test_program *program = &test_programs[p];
+        t_run_budget budget;
+
+        // Interpreter
+        reset_machine(&interpreted_machine, program);
+        memset(&budget, 0, sizeof(budget));
+        budget.instruction_limit = instruction_count;
+        double start_time = now_seconds();
+        run_mos6502(&interpreted_machine.bus, &interpreted_machine.registers, &budget);
+        double interpreted_seconds = now_seconds() - start_time;
+
+        // Block cache
+        reset_machine(&cached_machine, program);
+        init_block_cache_mos6502(&cache);
+        memset(&budget, 0, sizeof(budget));
+        budget.instruction_limit = instruction_count;
+        start_time = now_seconds();
+        run_cached_mos6502(&cache, &cached_machine.bus, &cached_machine.registers, &budget);
+        double cached_seconds = now_seconds() - start_time;
+
+        // Block cache with the JIT, skipped when the host has no JIT
+        double jit_seconds = 0;
+        if (jit_available) {
+            reset_machine(&jit_machine, program);
+            init_block_cache_mos6502(&cache);
+            cache.jit = &jit;
+            memset(&budget, 0, sizeof(budget));
+            budget.instruction_limit = instruction_count;
+            start_time = now_seconds();
+            run_cached_mos6502(&cache, &jit_machine.bus, &jit_machine.registers, &budget);
+            jit_seconds = now_seconds() - start_time;
+        }
+
+        // Every run must leave the machine in the same state
+        if (!matches_interpreter(&cached_machine) || (jit_available && !matches_interpreter(&jit_machine))) {
+            printf("Error: %s program does not match the interpreter!!\n", program->name);
+            return 1;
+        }
+
+        double interpreted_rate = (interpreted_seconds > 0) ? instruction_count / interpreted_seconds : 0;
+        double cached_rate = (cached_seconds > 0) ? instruction_count / cached_seconds : 0;
+        double jit_rate = (jit_seconds > 0) ? instruction_count / jit_seconds : 0;
+        printf("%-16s %12.1f %12.1f %8.2fx %12.1f %8.2fx %12llu %12llu %12llu\n", program->name, interpreted_rate / 1e6,
+               cached_rate / 1e6, (interpreted_rate > 0) ? cached_rate / interpreted_rate : 0, jit_rate / 1e6,
+               (interpreted_rate > 0) ? jit_rate / interpreted_rate : 0, cache.hits, cache.misses, cache.invalidations);
+    }
+
+    if (jit_available) {
+        printf("JIT: %llu blocks compiled, %llu native runs, %llu left early\n", jit.blocks_compiled, jit.native_runs,
+               jit.side_exits);
+        free_jit_mos6502(&jit);
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts a machine at the start of a test program, loaded into RAM so that it can rewrite itself
+//   Inputs: Machine, Test Program
+// -------------------------------------------------------------------------------------------------------------------------------
+static void reset_machine(t_machine *machine, const t_test_program *program) {
+    memset(machine->memory, 0, MOS_6502_MEM_SIZE);
+    memcpy(&machine->memory[PROGRAM_ADDRESS], program->code, program->length);
+    init_memory_bus_mos6502(&machine->bus);
+    map_memory_mos6502(&machine->bus, 0, MEMORY_PAGE_COUNT, machine->memory, 0);
+    reset_mos6502(&machine->bus, &machine->registers);
+    machine->registers.program_counter = PROGRAM_ADDRESS;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks that a machine ended up in the same state as the interpreted one
+//   Inputs: Machine
+//   Output: 1 if the memory and registers match, 0 otherwise
+// -------------------------------------------------------------------------------------------------------------------------------
+static int matches_interpreter(t_machine *machine) {
+    t_registers *registers = &machine->registers;
+    t_registers *expected = &interpreted_machine.registers;
+
+    // Registers are compared field by field, as the padding between the fields is never written
+    return memcmp(machine->memory, interpreted_machine.memory, MOS_6502_MEM_SIZE) == 0 &&
+           registers->program_counter == expected->program_counter && registers->stack_pointer == expected->stack_pointer &&
+           registers->accumulator == expected->accumulator && registers->register_x == expected->register_x &&
+           registers->register_y == expected->register_y && registers->processor_status == expected->processor_status &&
+           registers->cycles == expected->cycles;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Seconds since an arbitrary point
+// -------------------------------------------------------------------------------------------------------------------------------
+static double now_seconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
@@ -0,0 +1,409 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Instruction Mix Benchmark
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_instruction_mix_benchmark.c
+//
+// Description:
+//   Measures the interpreter, the block cache and the JIT on test programs that each lean on a different kind of work: every
+//   LDA addressing mode, arithmetic and flags, branches, the stack and subroutines, and copying and filling memory. Every
+//   program is run once to warm up and then a number of times, and the median run gives the instructions per second, the
+//   emulated cycles per second and the nanoseconds per instruction. The results can also be written out as JSON so that
+//   runs can be compared over time.
+//
+//   Build: cc -O2 -I../Source mos6502_instruction_mix_benchmark.c ../Source/mos6502_block_cache.c ../Source/mos6502_jit.c
+//          ../Source/mos6502_emulator.c ../Source/mos6502_memory_bus.c ../Source/mos6502_debugger.c
+//          -o mos6502_instruction_mix_benchmark
+//   Usage: mos6502_instruction_mix_benchmark [instructions] [repetitions] [json_file]
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Local
+#include "mos6502_block_cache.h"
+#include "mos6502_jit.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defaults for the command line arguments
+#define DEFAULT_INSTRUCTIONS 50000000
+#define DEFAULT_REPETITIONS 5
+#define MAX_REPETITIONS 101
+
+// Fraction of the instructions run to warm up before timing
+#define WARM_UP_DIVISOR 10
+
+// Where the test programs are loaded
+#define PROGRAM_ADDRESS 0x0200
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Everything owned by a single machine
+typedef struct t_struct_machine {
+    unsigned char memory[MOS_6502_MEM_SIZE];
+    t_memory_bus bus;
+    t_registers registers;
+} t_machine;
+
+// Test program
+typedef struct t_struct_test_program {
+    const char *name;
+    const unsigned char *code;
+    unsigned int length;
+} t_test_program;
+
+// Ways of running a program
+typedef enum {
+    ENGINE_INTERPRETER,
+    ENGINE_BLOCK_CACHE,
+    ENGINE_JIT,
+    ENGINE_COUNT
+} t_engine;
+
+// Timing of one program on one engine
+typedef struct t_struct_result {
+    double median_seconds;
+    double best_seconds;
+    double worst_seconds;
+    unsigned long long instructions;
+    unsigned long long cycles;
+} t_result;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Loads through all eight LDA addressing modes on every pass
+static const unsigned char load_program[] = {
+    0xA2, 0x00,         // start: LDX #$00
+    0xA0, 0x00,         //        LDY #$00
+    0xA9, 0x01,         // loop:  LDA #$01
+    0xA5, 0x10,         //        LDA $10
+    0xB5, 0x10,         //        LDA $10,X
+    0xAD, 0x00, 0x03,   //        LDA $0300
+    0xBD, 0x00, 0x03,   //        LDA $0300,X
+    0xB9, 0x80, 0x03,   //        LDA $0380,Y
+    0xA1, 0x10,         //        LDA ($10,X)
+    0xB1, 0x20,         //        LDA ($20),Y
+    0xC8,               //        INY
+    0xE8,               //        INX
+    0xD0, 0xE9,         //        BNE loop
+    0x4C, 0x00, 0x02    //        JMP start
+};
+
+// Sixteen bit addition, subtraction, logic, shifts, compares and flag changes
+static const unsigned char arithmetic_program[] = {
+    0xD8,               //        CLD
+    0x18,               // loop:  CLC
+    0xA5, 0x10,         //        LDA $10
+    0x69, 0x37,         //        ADC #$37
+    0x85, 0x10,         //        STA $10
+    0xA5, 0x11,         //        LDA $11
+    0x69, 0x00,         //        ADC #$00
+    0x85, 0x11,         //        STA $11
+    0x38,               //        SEC
+    0xE5, 0x12,         //        SBC $12
+    0x49, 0x5A,         //        EOR #$5A
+    0x29, 0xF7,         //        AND #$F7
+    0x09, 0x21,         //        ORA #$21
+    0x0A,               //        ASL A
+    0x2A,               //        ROL A
+    0x4A,               //        LSR A
+    0x6A,               //        ROR A
+    0xC9, 0x80,         //        CMP #$80
+    0x24, 0x10,         //        BIT $10
+    0x85, 0x12,         //        STA $12
+    0xE6, 0x13,         //        INC $13
+    0xB8,               //        CLV
+    0x4C, 0x01, 0x02    //        JMP loop
+};
+
+// Tests bits of a counter, taking and skipping branches in changing patterns
+static const unsigned char branch_program[] = {
+    0xA2, 0x00,         // start: LDX #$00
+    0x8A,               // loop:  TXA
+    0x29, 0x01,         //        AND #$01
+    0xF0, 0x02,         //        BEQ even
+    0xE6, 0x10,         //        INC $10
+    0x8A,               // even:  TXA
+    0x29, 0x02,         //        AND #$02
+    0xD0, 0x02,         //        BNE skip
+    0xC6, 0x11,         //        DEC $11
+    0xE0, 0x80,         // skip:  CPX #$80
+    0x90, 0x02,         //        BCC low
+    0xE6, 0x12,         //        INC $12
+    0xA5, 0x10,         // low:   LDA $10
+    0x10, 0x02,         //        BPL pos
+    0xE6, 0x13,         //        INC $13
+    0xE8,               // pos:   INX
+    0xD0, 0xE3,         //        BNE loop
+    0xF0, 0xDF          //        BEQ start
+};
+
+// Nested subroutine calls with registers and flags saved on the stack
+static const unsigned char stack_program[] = {
+    0x20, 0x0C, 0x02,   // loop:  JSR sub
+    0x48,               //        PHA
+    0x08,               //        PHP
+    0x28,               //        PLP
+    0x68,               //        PLA
+    0xE8,               //        INX
+    0x4C, 0x00, 0x02,   //        JMP loop
+    0xEA,               //        NOP
+    0x48,               // sub:   PHA
+    0x8A,               //        TXA
+    0x48,               //        PHA
+    0x20, 0x17, 0x02,   //        JSR leaf
+    0x68,               //        PLA
+    0xAA,               //        TAX
+    0x68,               //        PLA
+    0x60,               //        RTS
+    0xEA,               //        NOP
+    0xE6, 0x10,         // leaf:  INC $10
+    0x60                //        RTS
+};
+
+// Copies four pages from $1000 to $2000 through zero page pointers, then fills the page at $3000
+static const unsigned char memory_program[] = {
+    0xA9, 0x00,         // start: LDA #$00
+    0x85, 0x20,         //        STA $20
+    0x85, 0x22,         //        STA $22
+    0xA9, 0x10,         //        LDA #$10
+    0x85, 0x21,         //        STA $21
+    0xA9, 0x20,         //        LDA #$20
+    0x85, 0x23,         //        STA $23
+    0xA2, 0x04,         //        LDX #$04
+    0xA0, 0x00,         // page:  LDY #$00
+    0xB1, 0x20,         // copy:  LDA ($20),Y
+    0x91, 0x22,         //        STA ($22),Y
+    0xC8,               //        INY
+    0xD0, 0xF9,         //        BNE copy
+    0xE6, 0x21,         //        INC $21
+    0xE6, 0x23,         //        INC $23
+    0xCA,               //        DEX
+    0xD0, 0xF0,         //        BNE page
+    0xA9, 0x55,         //        LDA #$55
+    0xA0, 0x00,         //        LDY #$00
+    0x99, 0x00, 0x30,   // fill:  STA $3000,Y
+    0xC8,               //        INY
+    0xD0, 0xFA,         //        BNE fill
+    0x4C, 0x00, 0x02    //        JMP start
+};
+
+static const t_test_program test_programs[] = {
+    { "Load", load_program, sizeof(load_program) },
+    { "Arithmetic", arithmetic_program, sizeof(arithmetic_program) },
+    { "Branch", branch_program, sizeof(branch_program) },
+    { "Stack", stack_program, sizeof(stack_program) },
+    { "Memory", memory_program, sizeof(memory_program) }
+};
+
+#define TEST_PROGRAM_COUNT (sizeof(test_programs) / sizeof(test_programs[0]))
+
+static const char *const engine_names[ENGINE_COUNT] = { "Interpreter", "Block cache", "JIT" };
+
+// Machines run by the interpreter and by the engine being measured
+static t_machine interpreted_machine;
+static t_machine machine;
+
+// Block cache, too big for the stack
+static t_block_cache cache;
+
+// JIT, only used when it could be started on this host
+static t_jit jit;
+static int jit_available;
+
+// Results of every program on every engine
+static t_result results[TEST_PROGRAM_COUNT][ENGINE_COUNT];
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs a program on an engine
+static double run_program(t_machine *, const t_test_program *, t_engine, unsigned long long, t_run_budget *);
+static void reset_machine(t_machine *, const t_test_program *);
+
+// Saves the results
+static int write_json(const char *, unsigned long long, unsigned int);
+
+// Helpers
+static int compare_seconds(const void *, const void *);
+static double now_seconds(void);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    unsigned long long instruction_count = (argc > 1) ? strtoull(argv[1], NULL, 0) : DEFAULT_INSTRUCTIONS;
+    unsigned int repetitions = (argc > 2) ? (unsigned int) strtoul(argv[2], NULL, 0) : DEFAULT_REPETITIONS;
+    double seconds[MAX_REPETITIONS];
+
+    if (repetitions < 1 || repetitions > MAX_REPETITIONS) {
+        printf("Error: Repetitions must be between 1 and %d!!\n", MAX_REPETITIONS);
+        return 1;
+    }
+
+    jit_available = (init_jit_mos6502(&jit) == 0);
+
+    printf("%llu instructions per run, median of %u runs\n", instruction_count, repetitions);
+    printf("%-12s %-12s %10s %14s %10s %9s\n", "Program", "Engine", "MIPS", "Cycles/s", "ns/instr", "Spread");
+
+    for (unsigned int p = 0; p < TEST_PROGRAM_COUNT; p++) {
+        const t_test_program *program = &test_programs[p];
+
+        for (t_engine engine = ENGINE_INTERPRETER; engine < ENGINE_COUNT; engine++) {
+            t_machine *target = (engine == ENGINE_INTERPRETER) ? &interpreted_machine : &machine;
+            t_result *result = &results[p][engine];
+            t_run_budget budget;
+
+            if (engine == ENGINE_JIT && !jit_available) {
+                continue;
+            }
+
+            // Warm up the host caches and branch predictors, then time every repetition from the same start
+            run_program(target, program, engine, instruction_count / WARM_UP_DIVISOR + 1, &budget);
+            for (unsigned int r = 0; r < repetitions; r++) {
+                seconds[r] = run_program(target, program, engine, instruction_count, &budget);
+            }
+            qsort(seconds, repetitions, sizeof(double), compare_seconds);
+            result->median_seconds = seconds[repetitions / 2];
+            result->best_seconds = seconds[0];
+            result->worst_seconds = seconds[repetitions - 1];
+            result->instructions = budget.instructions_executed;
+            result->cycles = budget.cycles_executed;
+
+            // Faster engines must leave the machine just like the interpreter does
+            if (engine != ENGINE_INTERPRETER &&
+                (memcmp(machine.memory, interpreted_machine.memory, MOS_6502_MEM_SIZE) != 0 ||
+                 memcmp(&machine.registers, &interpreted_machine.registers, sizeof(t_registers)) != 0)) {
+                printf("Error: %s program on the %s does not match the interpreter!!\n", program->name, engine_names[engine]);
+                return 1;
+            }
+
+            double median = (result->median_seconds > 0) ? result->median_seconds : 1e-9;
+            printf("%-12s %-12s %10.1f %14.0f %10.2f %8.1f%%\n", program->name, engine_names[engine],
+                   result->instructions / median / 1e6, result->cycles / median, median * 1e9 / result->instructions,
+                   100.0 * (result->worst_seconds - result->best_seconds) / median);
+        }
+    }
+
+    if (jit_available) {
+        free_jit_mos6502(&jit);
+    }
+    if (argc > 3) {
+        return (write_json(argv[3], instruction_count, repetitions) == 0) ? 0 : 1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs a program from its start on an engine
+//   Inputs: Machine, Test Program, Engine, Instructions To Run, Budget (filled in)
+//   Output: Seconds taken
+// -------------------------------------------------------------------------------------------------------------------------------
+static double run_program(t_machine *target, const t_test_program *program, t_engine engine, unsigned long long instruction_count,
+                          t_run_budget *budget) {
+    reset_machine(target, program);
+    memset(budget, 0, sizeof(t_run_budget));
+    budget->instruction_limit = instruction_count;
+
+    // A fresh cache each run, so the time includes decoding and compiling the blocks
+    if (engine != ENGINE_INTERPRETER) {
+        init_block_cache_mos6502(&cache);
+        cache.jit = (engine == ENGINE_JIT) ? &jit : NULL;
+    }
+
+    double start_time = now_seconds();
+    if (engine == ENGINE_INTERPRETER) {
+        run_mos6502(&target->bus, &target->registers, budget);
+    } else {
+        run_cached_mos6502(&cache, &target->bus, &target->registers, budget);
+    }
+    return now_seconds() - start_time;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts a machine at the start of a test program, loaded into RAM
+//   Inputs: Machine, Test Program
+// -------------------------------------------------------------------------------------------------------------------------------
+static void reset_machine(t_machine *target, const t_test_program *program) {
+    memset(target->memory, 0, MOS_6502_MEM_SIZE);
+    memcpy(&target->memory[PROGRAM_ADDRESS], program->code, program->length);
+    init_memory_bus_mos6502(&target->bus);
+    map_memory_mos6502(&target->bus, 0, MEMORY_PAGE_COUNT, target->memory, 0);
+    reset_mos6502(&target->bus, &target->registers);
+    target->registers.program_counter = PROGRAM_ADDRESS;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes the results as JSON, one record per program and engine
+//   Inputs: File Path, Instructions Per Run, Repetitions
+//   Output: 0 on success, -1 if the file could not be written
+// -------------------------------------------------------------------------------------------------------------------------------
+static int write_json(const char *path, unsigned long long instruction_count, unsigned int repetitions) {
+    int first = 1;
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Error: Could not create %s!!\n", path);
+        return -1;
+    }
+
+    fprintf(file, "{\n  \"instructions\": %llu,\n  \"repetitions\": %u,\n", instruction_count, repetitions);
+    fprintf(file, "  \"cycle_counting\": %d,\n  \"computed_goto\": %d,\n  \"jit\": %d,\n  \"results\": [", MOS_6502_CYCLE_COUNTING,
+            MOS_6502_COMPUTED_GOTO, jit_available);
+    for (unsigned int p = 0; p < TEST_PROGRAM_COUNT; p++) {
+        for (t_engine engine = ENGINE_INTERPRETER; engine < ENGINE_COUNT; engine++) {
+            t_result *result = &results[p][engine];
+            if (result->instructions == 0) {
+                continue;
+            }
+            double median = (result->median_seconds > 0) ? result->median_seconds : 1e-9;
+            fprintf(file, "%s\n    { \"program\": \"%s\", \"engine\": \"%s\", \"instructions_per_second\": %.0f, ", first ? "" : ",",
+                    test_programs[p].name, engine_names[engine], result->instructions / median);
+            fprintf(file, "\"cycles_per_second\": %.0f, \"ns_per_instruction\": %.3f, ", result->cycles / median,
+                    median * 1e9 / result->instructions);
+            fprintf(file, "\"median_seconds\": %.6f, \"best_seconds\": %.6f, \"worst_seconds\": %.6f }", result->median_seconds,
+                    result->best_seconds, result->worst_seconds);
+            first = 0;
+        }
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    if (fclose(file) != 0) {
+        printf("Error: Could not write %s!!\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Orders times shortest first for qsort()
+//   Inputs: Times To Compare
+//   Output: Negative, zero or positive like qsort() wants
+// -------------------------------------------------------------------------------------------------------------------------------
+static int compare_seconds(const void *left, const void *right) {
+    double a = *(const double *) left;
+    double b = *(const double *) right;
+    return (a > b) - (a < b);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Seconds since an arbitrary point
+// -------------------------------------------------------------------------------------------------------------------------------
+static double now_seconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
@@ -0,0 +1,168 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 SIMD Lockstep Engine Benchmark
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_simd_benchmark.c
+//
+// Description:
+//   Compares the lockstep engine with running the same machines one after another on the scalar core. Every machine runs
+//   the same program from a shared ROM page over its own data, first on the scalar core and then on the engine with 8, 16
+//   and 32 lanes, and the memory of every machine is checked against the scalar run.
+//
+//   Build: cc -O2 -I../Source mos6502_simd_benchmark.c ../Source/mos6502_simd.c ../Source/mos6502_emulator.c
+//          ../Source/mos6502_block_cache.c ../Source/mos6502_jit.c ../Source/mos6502_memory_bus.c ../Source/mos6502_debugger.c
+//          -o mos6502_simd_benchmark
+//   Usage: mos6502_simd_benchmark [instructions per machine]
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Local
+#include "mos6502_simd.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defaults for the command line arguments
+#define DEFAULT_INSTRUCTIONS_PER_MACHINE 2000000
+
+// Where the test program is loaded
+#define PROGRAM_ADDRESS 0x0200
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Everything owned by a single machine
+typedef struct t_struct_machine {
+    unsigned char memory[MOS_6502_MEM_SIZE];
+    t_memory_bus bus;
+    t_registers registers;
+} t_machine;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Adds one to every byte of page 3 forever, the same program the batch benchmark uses
+static const unsigned char test_program[] = {
+    0xA2, 0x00,         // start: LDX #$00
+    0xBD, 0x00, 0x03,   // loop:  LDA $0300,X
+    0x18,               //        CLC
+    0x69, 0x01,         //        ADC #$01
+    0x9D, 0x00, 0x03,   //        STA $0300,X
+    0xE8,               //        INX
+    0xD0, 0xF4,         //        BNE loop
+    0xE6, 0x10,         //        INC $10
+    0x4C, 0x00, 0x02    //        JMP start
+};
+
+// Page of ROM holding the test program, mapped into every machine
+static unsigned char program_rom[MEMORY_PAGE_SIZE];
+
+// Machines run by the scalar core and by the engine
+static t_machine scalar_machines[SIMD_MAX_LANES];
+static t_machine simd_machines[SIMD_MAX_LANES];
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts a machine at the start of the test program with its own data
+static void reset_machine(t_machine *, unsigned int);
+
+// Seconds since an arbitrary point
+static double now_seconds(void);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    unsigned long long instructions_per_machine = (argc > 1) ? strtoull(argv[1], NULL, 0) : DEFAULT_INSTRUCTIONS_PER_MACHINE;
+    static const unsigned int lane_counts[] = { 8, 16, 32 };
+
+    memcpy(program_rom, test_program, sizeof(test_program));
+
+    printf("%llu instructions per machine, vector instruction set %s\n", instructions_per_machine, simd_instruction_set_mos6502());
+    printf("%8s %14s %14s %10s %10s\n", "Lanes", "Scalar MIPS", "SIMD MIPS", "Speedup", "Vector %");
+
+    for (unsigned int c = 0; c < sizeof(lane_counts) / sizeof(lane_counts[0]); c++) {
+        unsigned int lane_count = lane_counts[c];
+        t_simd_engine engine;
+        t_run_budget budget;
+
+        // Scalar core, one machine after another
+        double start_time = now_seconds();
+        for (unsigned int i = 0; i < lane_count; i++) {
+            reset_machine(&scalar_machines[i], i);
+            memset(&budget, 0, sizeof(budget));
+            budget.instruction_limit = instructions_per_machine;
+            run_mos6502(&scalar_machines[i].bus, &scalar_machines[i].registers, &budget);
+        }
+        double scalar_seconds = now_seconds() - start_time;
+
+        // Engine, every machine in its own lane
+        start_time = now_seconds();
+        init_simd_mos6502(&engine, lane_count);
+        for (unsigned int i = 0; i < lane_count; i++) {
+            reset_machine(&simd_machines[i], i);
+            load_lane_simd_mos6502(&engine, i, &simd_machines[i].bus, &simd_machines[i].registers);
+        }
+        memset(&budget, 0, sizeof(budget));
+        budget.instruction_limit = instructions_per_machine;
+        run_simd_mos6502(&engine, &budget);
+        double simd_seconds = now_seconds() - start_time;
+
+        // Both runs must leave every machine in the same state
+        for (unsigned int i = 0; i < lane_count; i++) {
+            store_lane_simd_mos6502(&engine, i, &simd_machines[i].registers);
+            if (memcmp(simd_machines[i].memory, scalar_machines[i].memory, MOS_6502_MEM_SIZE) != 0 ||
+                simd_machines[i].registers.program_counter != scalar_machines[i].registers.program_counter ||
+                simd_machines[i].registers.cycles != scalar_machines[i].registers.cycles) {
+                printf("Error: Lane %u does not match the scalar core!!\n", i);
+                return 1;
+            }
+        }
+
+        double total = (double) instructions_per_machine * lane_count;
+        double scalar_rate = (scalar_seconds > 0) ? total / scalar_seconds : 0;
+        double simd_rate = (simd_seconds > 0) ? total / simd_seconds : 0;
+        printf("%8u %14.1f %14.1f %9.2fx %9.1f%%\n", lane_count, scalar_rate / 1e6, simd_rate / 1e6,
+               (scalar_rate > 0) ? simd_rate / scalar_rate : 0,
+               100.0 * engine.vector_instructions / (engine.vector_instructions + engine.scalar_instructions));
+    }
+
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts a machine at the start of the test program. Page 3 is filled with data that differs between machines.
+//   Inputs: Machine, Machine Number
+// -------------------------------------------------------------------------------------------------------------------------------
+static void reset_machine(t_machine *machine, unsigned int machine_number) {
+    memset(machine->memory, 0, MOS_6502_MEM_SIZE);
+    init_memory_bus_mos6502(&machine->bus);
+    map_memory_mos6502(&machine->bus, 0, MEMORY_PAGE_COUNT, machine->memory, 0);
+    map_memory_mos6502(&machine->bus, PROGRAM_ADDRESS >> 8, 1, program_rom, PAGE_WRITE_PROTECT);
+    for (unsigned int i = 0; i < MEMORY_PAGE_SIZE; i++) {
+        machine->memory[0x0300 + i] = (unsigned char) (i * (machine_number + 1));
+    }
+    reset_mos6502(&machine->bus, &machine->registers);
+    machine->registers.program_counter = PROGRAM_ADDRESS;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Seconds since an arbitrary point
+// -------------------------------------------------------------------------------------------------------------------------------
+static double now_seconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
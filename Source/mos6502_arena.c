@@ -0,0 +1,440 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Context Arena
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_arena.c
+//
+// Description:
+//   Hands out contexts and 256 byte pages from blocks allocated up front. Free contexts and pages are kept on stacks so
+//   taking or giving one back is constant time, and ROM pages are found by a hash of their contents so identical pages are
+//   only stored once.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local
+#include "mos6502_arena.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Lazily allocated RAM callbacks
+static unsigned char read_unwritten_ram(void *, unsigned short);
+static void write_unwritten_ram(void *, unsigned short, unsigned char);
+
+// Takes a page for a context from the pool and maps it in as RAM
+static unsigned char *allocate_ram_page(t_context *, unsigned int);
+
+// Lets go of the pool page mapped into a page of a context
+static void release_context_page(t_context *, unsigned int);
+
+// Takes a page from the pool, and drops a reference to one, with the lock held
+static unsigned int take_page(t_context_arena *);
+static void release_page(t_context_arena *, unsigned int);
+
+// Hashes the contents of a page
+static unsigned int hash_page(const unsigned char *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize an arena, allocating every context and pool page it will hand out
+//   Inputs: Context Arena, Number Of Contexts, Number Of Pool Pages
+//   Output: 0 on success, -1 if the memory could not be allocated
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int init_context_arena_mos6502(t_context_arena *arena, unsigned int context_capacity, unsigned int page_capacity) {
+    unsigned int bucket_count = 1;
+
+    memset(arena, 0, sizeof(t_context_arena));
+    pthread_mutex_init(&arena->lock, NULL);
+    while (bucket_count < page_capacity) {
+        bucket_count <<= 1;
+    }
+    arena->context_capacity = context_capacity;
+    arena->page_capacity = page_capacity;
+    arena->bucket_mask = bucket_count - 1;
+    arena->contexts = malloc((size_t) context_capacity * sizeof(t_context));
+    arena->free_contexts = malloc((size_t) context_capacity * sizeof(unsigned int));
+    arena->page_data = malloc((size_t) page_capacity * MEMORY_PAGE_SIZE);
+    arena->page_references = calloc(page_capacity, sizeof(unsigned int));
+    arena->free_pages = malloc((size_t) page_capacity * sizeof(unsigned int));
+    arena->page_hashes = malloc((size_t) page_capacity * sizeof(unsigned int));
+    arena->next_in_bucket = malloc((size_t) page_capacity * sizeof(unsigned int));
+    arena->buckets = malloc((size_t) bucket_count * sizeof(unsigned int));
+    arena->rom_pages = calloc(page_capacity, 1);
+    if (arena->contexts == NULL || arena->free_contexts == NULL || arena->page_data == NULL ||
+        arena->page_references == NULL || arena->free_pages == NULL || arena->page_hashes == NULL ||
+        arena->next_in_bucket == NULL || arena->buckets == NULL || arena->rom_pages == NULL) {
+        printf("Error: Could not allocate an arena of %u contexts and %u pages!!\n", context_capacity, page_capacity);
+        free_context_arena_mos6502(arena);
+        return -1;
+    }
+
+    // Stacks are popped from the end, so the lowest numbers are handed out first
+    for (unsigned int i = 0; i < context_capacity; i++) {
+        arena->contexts[i].in_use = 0;
+        arena->free_contexts[i] = context_capacity - 1 - i;
+    }
+    arena->free_context_count = context_capacity;
+    for (unsigned int i = 0; i < page_capacity; i++) {
+        arena->free_pages[i] = page_capacity - 1 - i;
+    }
+    arena->free_page_count = page_capacity;
+    for (unsigned int i = 0; i < bucket_count; i++) {
+        arena->buckets[i] = ARENA_NO_PAGE;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Free the memory of an arena, which must have been initialized. Every context it handed out goes with it.
+//   Inputs: Context Arena
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void free_context_arena_mos6502(t_context_arena *arena) {
+    pthread_mutex_destroy(&arena->lock);
+    free(arena->contexts);
+    free(arena->free_contexts);
+    free(arena->page_data);
+    free(arena->page_references);
+    free(arena->free_pages);
+    free(arena->page_hashes);
+    free(arena->next_in_bucket);
+    free(arena->buckets);
+    free(arena->rom_pages);
+    memset(arena, 0, sizeof(t_context_arena));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Add a ROM image to an arena. The image is split into pages, the last one padded with zeros, and each page identical to a
+// ROM page already in the arena is shared instead of copied. The image does not need to be kept once it is added.
+//   Inputs: Context Arena, Image, Image Size
+//   Output: ROM number on success, -1 if the image is too large or the arena is out of ROMs or pages
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int add_rom_mos6502(t_context_arena *arena, const unsigned char *image, unsigned int size) {
+    unsigned char page[MEMORY_PAGE_SIZE];
+    int rom_number = -1;
+
+    if (size == 0 || size > MOS_6502_MEM_SIZE) {
+        printf("Error: A ROM image must be from 1 to %d bytes!!\n", MOS_6502_MEM_SIZE);
+        return -1;
+    }
+
+    pthread_mutex_lock(&arena->lock);
+    for (int i = 0; i < ARENA_MAX_ROMS; i++) {
+        if (!arena->roms[i].in_use) {
+            rom_number = i;
+            break;
+        }
+    }
+    if (rom_number < 0) {
+        pthread_mutex_unlock(&arena->lock);
+        printf("Error: An arena holds at most %d ROMs!!\n", ARENA_MAX_ROMS);
+        return -1;
+    }
+
+    t_arena_rom *rom = &arena->roms[rom_number];
+    rom->page_count = 0;
+    for (unsigned int offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+        unsigned int length = (size - offset < MEMORY_PAGE_SIZE) ? size - offset : MEMORY_PAGE_SIZE;
+        memset(page, 0, MEMORY_PAGE_SIZE);
+        memcpy(page, image + offset, length);
+
+        unsigned int hash = hash_page(page);
+        unsigned int pool_page = arena->buckets[hash & arena->bucket_mask];
+        while (pool_page != ARENA_NO_PAGE && (arena->page_hashes[pool_page] != hash ||
+               memcmp(&arena->page_data[(size_t) pool_page * MEMORY_PAGE_SIZE], page, MEMORY_PAGE_SIZE) != 0)) {
+            pool_page = arena->next_in_bucket[pool_page];
+        }
+
+        if (pool_page != ARENA_NO_PAGE) {
+            arena->page_references[pool_page]++;
+            arena->shared_rom_pages++;
+        } else {
+            pool_page = take_page(arena);
+            if (pool_page == ARENA_NO_PAGE) {
+                for (unsigned int i = 0; i < rom->page_count; i++) {
+                    release_page(arena, rom->pool_pages[i]);
+                }
+                pthread_mutex_unlock(&arena->lock);
+                printf("Error: Arena has no free pages for a ROM of %u bytes!!\n", size);
+                return -1;
+            }
+            memcpy(&arena->page_data[(size_t) pool_page * MEMORY_PAGE_SIZE], page, MEMORY_PAGE_SIZE);
+            arena->page_hashes[pool_page] = hash;
+            arena->next_in_bucket[pool_page] = arena->buckets[hash & arena->bucket_mask];
+            arena->buckets[hash & arena->bucket_mask] = pool_page;
+            arena->rom_pages[pool_page] = 1;
+        }
+        rom->pool_pages[rom->page_count++] = pool_page;
+    }
+    rom->in_use = 1;
+    pthread_mutex_unlock(&arena->lock);
+    return rom_number;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Remove a ROM image from an arena. Contexts it is mapped into keep their pages until they are destroyed or mapped over.
+//   Inputs: Context Arena, ROM Number
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void remove_rom_mos6502(t_context_arena *arena, int rom_number) {
+    if (rom_number < 0 || rom_number >= ARENA_MAX_ROMS) {
+        return;
+    }
+
+    pthread_mutex_lock(&arena->lock);
+    t_arena_rom *rom = &arena->roms[rom_number];
+    if (rom->in_use) {
+        for (unsigned int i = 0; i < rom->page_count; i++) {
+            release_page(arena, rom->pool_pages[i]);
+        }
+        rom->in_use = 0;
+    }
+    pthread_mutex_unlock(&arena->lock);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Create a context with nothing mapped and its registers cleared
+//   Inputs: Context Arena
+//   Output: Context, or NULL if every context is in use
+// -------------------------------------------------------------------------------------------------------------------------------
+extern t_context *create_context_mos6502(t_context_arena *arena) {
+    pthread_mutex_lock(&arena->lock);
+    if (arena->free_context_count == 0) {
+        pthread_mutex_unlock(&arena->lock);
+        printf("Error: All %u contexts of the arena are in use!!\n", arena->context_capacity);
+        return NULL;
+    }
+    t_context *context = &arena->contexts[arena->free_contexts[--arena->free_context_count]];
+    context->in_use = 1;
+    pthread_mutex_unlock(&arena->lock);
+
+    memset(&context->registers, 0, sizeof(t_registers));
+    init_memory_bus_mos6502(&context->bus);
+    context->arena = arena;
+    for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+        context->pool_pages[i] = ARENA_NO_PAGE;
+    }
+    return context;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Destroy a context, giving back every page it holds
+//   Inputs: Context
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void destroy_context_mos6502(t_context *context) {
+    t_context_arena *arena = context->arena;
+
+    pthread_mutex_lock(&arena->lock);
+    for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+        if (context->pool_pages[i] != ARENA_NO_PAGE) {
+            release_page(arena, context->pool_pages[i]);
+            context->pool_pages[i] = ARENA_NO_PAGE;
+        }
+    }
+    context->in_use = 0;
+    arena->free_contexts[arena->free_context_count++] = (unsigned int) (context - arena->contexts);
+    pthread_mutex_unlock(&arena->lock);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Map RAM into a range of pages of a context. Each page reads as zeros until it is first written, which takes a page from
+// the pool. Pages held before are given back.
+//   Inputs: Context, First Page, Page Count
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void map_context_ram_mos6502(t_context *context, unsigned char first_page, unsigned int page_count) {
+    for (unsigned int i = first_page; i < MEMORY_PAGE_COUNT && i < first_page + page_count; i++) {
+        release_context_page(context, i);
+    }
+    map_device_mos6502(&context->bus, first_page, page_count, read_unwritten_ram, write_unwritten_ram, context);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Map a ROM added to the arena into a context, write protected. The pages are shared with every other context the ROM is
+// mapped into, and pages held before are given back.
+//   Inputs: Context, ROM Number, Address (must be at the start of a page)
+//   Output: 0 on success, -1 if there is no such ROM or it does not fit at the address
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int map_context_rom_mos6502(t_context *context, int rom_number, unsigned short address) {
+    t_context_arena *arena = context->arena;
+
+    if (rom_number < 0 || rom_number >= ARENA_MAX_ROMS || !arena->roms[rom_number].in_use) {
+        printf("Error: Arena has no ROM %d!!\n", rom_number);
+        return -1;
+    }
+    t_arena_rom *rom = &arena->roms[rom_number];
+    if ((address & 0x00FF) != 0 || (address >> 8) + rom->page_count > MEMORY_PAGE_COUNT) {
+        printf("Error: ROM %d can not be mapped at $%04X!!\n", rom_number, address);
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < rom->page_count; i++) {
+        unsigned int page_number = (address >> 8) + i;
+        unsigned int pool_page = rom->pool_pages[i];
+
+        release_context_page(context, page_number);
+        pthread_mutex_lock(&arena->lock);
+        arena->page_references[pool_page]++;
+        pthread_mutex_unlock(&arena->lock);
+        context->pool_pages[page_number] = pool_page;
+        map_memory_mos6502(&context->bus, page_number, 1, &arena->page_data[(size_t) pool_page * MEMORY_PAGE_SIZE],
+                           PAGE_WRITE_PROTECT);
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Write bytes into the RAM of a context, the way the host loads a program. RAM pages not written yet are allocated, tracked
+// pages written are marked dirty and code decoded from them is thrown away. Shared ROM pages can not be written, as every
+// context mapping them would see the change.
+//   Inputs: Context, Address, Bytes, Number Of Bytes
+//   Output: 0 on success, -1 if the bytes run into memory that is not RAM or the arena is out of pages
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int poke_context_mos6502(t_context *context, unsigned short address, const unsigned char *bytes, unsigned int length) {
+    unsigned int next = address;
+
+    if (address + length > MOS_6502_MEM_SIZE) {
+        printf("Error: $%04X bytes at $%04X run past the end of memory!!\n", length, address);
+        return -1;
+    }
+
+    while (length != 0) {
+        unsigned int page_number = next >> 8;
+        unsigned int offset = next & 0x00FF;
+        unsigned int chunk = (MEMORY_PAGE_SIZE - offset < length) ? MEMORY_PAGE_SIZE - offset : length;
+        t_memory_page *page = &context->bus.pages[page_number];
+        unsigned char *data = page->data;
+
+        if (data == NULL && page->read_handler == read_unwritten_ram && page->device == context) {
+            data = allocate_ram_page(context, page_number);
+            if (data == NULL) {
+                return -1;
+            }
+        } else if (data == NULL || (page->flags & PAGE_WRITE_PROTECT)) {
+            printf("Error: No RAM is mapped at $%04X!!\n", next);
+            return -1;
+        }
+        memcpy(&data[offset], bytes, chunk);
+        mark_page_dirty_mos6502(&context->bus, (unsigned char) page_number);
+        invalidate_code_page_mos6502(&context->bus, (unsigned char) page_number);
+        next += chunk;
+        bytes += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads RAM that has not been written yet
+//   Inputs: Context, Address
+//   Output: 0
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned char read_unwritten_ram(void *device, unsigned short address) {
+    (void) device;
+    (void) address;
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// First write to a RAM page, which maps a page from the pool in and writes to it. The write is dropped if the pool is empty.
+//   Inputs: Context, Address, Value
+// -------------------------------------------------------------------------------------------------------------------------------
+static void write_unwritten_ram(void *device, unsigned short address, unsigned char value) {
+    unsigned char *data = allocate_ram_page((t_context *) device, address >> 8);
+    if (data != NULL) {
+        data[address & 0x00FF] = value;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Takes a page for a context from the pool, clears it and maps it in as RAM
+//   Inputs: Context, Page Number
+//   Output: Host memory of the page, or NULL if the pool is empty
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned char *allocate_ram_page(t_context *context, unsigned int page_number) {
+    t_context_arena *arena = context->arena;
+
+    pthread_mutex_lock(&arena->lock);
+    unsigned int pool_page = take_page(arena);
+    if (pool_page == ARENA_NO_PAGE) {
+        // Only the first failure is reported, a program writing all over memory would otherwise flood the output
+        if (arena->allocation_failures++ == 0) {
+            printf("Error: Arena has no free pages for RAM at $%02X00!!\n", page_number);
+        }
+        pthread_mutex_unlock(&arena->lock);
+        return NULL;
+    }
+    pthread_mutex_unlock(&arena->lock);
+
+    unsigned char *data = &arena->page_data[(size_t) pool_page * MEMORY_PAGE_SIZE];
+    memset(data, 0, MEMORY_PAGE_SIZE);
+    context->pool_pages[page_number] = pool_page;
+    map_memory_mos6502(&context->bus, (unsigned char) page_number, 1, data, 0);
+    return data;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Lets go of the pool page mapped into a page of a context, if there is one
+//   Inputs: Context, Page Number
+// -------------------------------------------------------------------------------------------------------------------------------
+static void release_context_page(t_context *context, unsigned int page_number) {
+    if (context->pool_pages[page_number] != ARENA_NO_PAGE) {
+        pthread_mutex_lock(&context->arena->lock);
+        release_page(context->arena, context->pool_pages[page_number]);
+        pthread_mutex_unlock(&context->arena->lock);
+        context->pool_pages[page_number] = ARENA_NO_PAGE;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Takes a page from the pool with one reference, with the lock held
+//   Inputs: Context Arena
+//   Output: Pool page number, or ARENA_NO_PAGE if the pool is empty
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int take_page(t_context_arena *arena) {
+    if (arena->free_page_count == 0) {
+        return ARENA_NO_PAGE;
+    }
+    unsigned int pool_page = arena->free_pages[--arena->free_page_count];
+    arena->page_references[pool_page] = 1;
+    return pool_page;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Drops a reference to a pool page, with the lock held. The last one gives the page back to the pool, taking it out of the
+// hash table if it is a ROM page.
+//   Inputs: Context Arena, Pool Page Number
+// -------------------------------------------------------------------------------------------------------------------------------
+static void release_page(t_context_arena *arena, unsigned int pool_page) {
+    if (--arena->page_references[pool_page] != 0) {
+        return;
+    }
+    if (arena->rom_pages[pool_page]) {
+        unsigned int *link = &arena->buckets[arena->page_hashes[pool_page] & arena->bucket_mask];
+        while (*link != pool_page) {
+            link = &arena->next_in_bucket[*link];
+        }
+        *link = arena->next_in_bucket[pool_page];
+        arena->rom_pages[pool_page] = 0;
+    }
+    arena->free_pages[arena->free_page_count++] = pool_page;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Hashes the contents of a page with FNV-1a
+//   Inputs: Page
+//   Output: Hash
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int hash_page(const unsigned char *page) {
+    unsigned int hash = 2166136261u;
+    for (unsigned int i = 0; i < MEMORY_PAGE_SIZE; i++) {
+        hash = (hash ^ page[i]) * 16777619u;
+    }
+    return hash;
+}
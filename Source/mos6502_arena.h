@@ -0,0 +1,121 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Context Arena Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_arena.h
+//
+// Description:
+//   Contains the data types and function prototypes for the context arena, which packs many machines into one block of host
+//   memory. A context is the registers and memory bus of a single machine, taken from a fixed array. Its RAM and ROM come
+//   from a pool of 256 byte pages, so a machine only holds the pages it uses rather than a whole 64 kB.
+//
+//   RAM pages are not allocated when they are mapped. Until a page is first written it reads as zeros through the slow path,
+//   and the first write takes a page from the pool and maps it in. ROM images are added to the arena once and split into
+//   pages, with pages identical to ones already in the arena shared rather than copied. Every pool page keeps a count of the
+//   ROMs and contexts holding it, and goes back to the pool when the last one lets go.
+//
+//   All memory is allocated when the arena is initialized, so creating and destroying contexts and touching new RAM pages
+//   never call malloc(). A lock guards the pool, so contexts of the same arena can be run on several threads at once. Pages
+//   allocated after a snapshot is taken of a context are tracked but were not in the snapshot, so a restore leaves them as
+//   they are, and a context should have its RAM poked in before a snapshot is taken of it.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_ARENA_H
+#define MOS_6502_ARENA_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <pthread.h>
+
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most ROM images added to an arena at once
+#define ARENA_MAX_ROMS 64
+
+// Pool page number of a page of the address space that holds no pool page
+#define ARENA_NO_PAGE 0xFFFFFFFF
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+struct t_struct_context_arena;
+
+// Single machine
+typedef struct t_struct_context {
+    t_registers registers;
+    t_memory_bus bus;
+    struct t_struct_context_arena *arena;
+    // Pool page mapped into each page of the address space, ARENA_NO_PAGE for pages that are unmapped, devices or RAM not
+    // written yet
+    unsigned int pool_pages[MEMORY_PAGE_COUNT];
+    int in_use;
+} t_context;
+
+// ROM image split into pool pages
+typedef struct t_struct_arena_rom {
+    int in_use;
+    unsigned int page_count;
+    unsigned int pool_pages[MEMORY_PAGE_COUNT];
+} t_arena_rom;
+
+// Context arena
+typedef struct t_struct_context_arena {
+    // Contexts, and the numbers of the ones not in use
+    t_context *contexts;
+    unsigned int context_capacity;
+    unsigned int *free_contexts;
+    unsigned int free_context_count;
+    // Pool pages, how many ROMs and contexts hold each one, and the numbers of the ones not in use
+    unsigned char *page_data;
+    unsigned int page_capacity;
+    unsigned int *page_references;
+    unsigned int *free_pages;
+    unsigned int free_page_count;
+    // Hash table of the ROM pages, chained through the pages, for finding a page identical to a new one
+    unsigned int *page_hashes;
+    unsigned int *next_in_bucket;
+    unsigned int *buckets;
+    unsigned int bucket_mask;
+    unsigned char *rom_pages;
+    t_arena_rom roms[ARENA_MAX_ROMS];
+    // Guards the pool and the contexts
+    pthread_mutex_t lock;
+    // Counters
+    unsigned long long shared_rom_pages;
+    unsigned long long allocation_failures;
+} t_context_arena;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize An Arena With A Fixed Number Of Contexts And Pool Pages
+extern int init_context_arena_mos6502(t_context_arena *, unsigned int, unsigned int);
+
+// Free The Memory Of An Arena
+extern void free_context_arena_mos6502(t_context_arena *);
+
+// Add A ROM Image To An Arena, Sharing Pages With The ROMs Already In It
+extern int add_rom_mos6502(t_context_arena *, const unsigned char *, unsigned int);
+extern void remove_rom_mos6502(t_context_arena *, int);
+
+// Create And Destroy Contexts
+extern t_context *create_context_mos6502(t_context_arena *);
+extern void destroy_context_mos6502(t_context *);
+
+// Map RAM That Is Allocated When First Written, And ROM Added To The Arena
+extern void map_context_ram_mos6502(t_context *, unsigned char, unsigned int);
+extern int map_context_rom_mos6502(t_context *, int, unsigned short);
+
+// Write Bytes Into The RAM Of A Context Without Going Through The Bus
+extern int poke_context_mos6502(t_context *, unsigned short, const unsigned char *, unsigned int);
+
+#endif // MOS_6502_ARENA_H
@@ -0,0 +1,307 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Batch Executor
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_batch.c
+//
+// Description:
+//   Runs a batch of independent 6502 machines on a work stealing pool of threads, one thread pinned to each core. Every
+//   thread starts with an equal share of the jobs and, once its own share is done, steals half of the remaining share of
+//   another thread. Jobs never share state, so the only contended memory is the job range of each thread.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Needed for CPU affinity on Linux
+#define _GNU_SOURCE
+
+// Standard
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+// Local
+#include "mos6502_batch.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Size of a host cache line, worker contexts are aligned to it so threads never write to the same line
+#define BATCH_CACHE_LINE_SIZE 64
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+struct t_struct_batch_pool;
+
+// Context owned by a single worker thread
+typedef struct t_struct_batch_worker {
+    // Jobs still to run, next job in the low 32 bits and end of the range in the high 32 bits. The owner takes jobs from
+    // the front and thieves take them from the back, both with a compare and swap.
+    _Alignas(BATCH_CACHE_LINE_SIZE) atomic_ullong range;
+    struct t_struct_batch_pool *pool;
+    pthread_t thread;
+    unsigned int index;
+    int started;
+    // Totals for the jobs this worker ran
+    unsigned long long instructions_executed;
+    unsigned long long cycles_executed;
+} t_batch_worker;
+
+// State shared by every worker of a batch
+typedef struct t_struct_batch_pool {
+    t_batch_job *jobs;
+    unsigned int worker_count;
+    t_batch_worker workers[BATCH_MAX_THREADS];
+} t_batch_pool;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Worker thread
+static void *worker_main(void *);
+static void run_worker(t_batch_worker *);
+
+// Takes a job from the worker's own range
+static int take_job(t_batch_worker *, unsigned int *);
+
+// Moves half of another worker's range into the worker's own range
+static int steal_jobs(t_batch_worker *);
+
+// Pins the calling thread to a core
+static void pin_thread(unsigned int);
+
+// Packs and unpacks a job range
+static unsigned long long pack_range(unsigned int, unsigned int);
+static unsigned int range_begin(unsigned long long);
+static unsigned int range_end(unsigned long long);
+
+// Number of cores available to this process
+static unsigned int online_cores(void);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Run a batch of jobs. The calling thread takes part as the first worker, so a batch still completes when fewer threads
+// could be started than were asked for. The status and budget of every job are filled in on return.
+//   Inputs: Jobs, Job Count, Thread Count (0 for one per core), Result
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void run_batch_mos6502(t_batch_job *jobs, unsigned int job_count, unsigned int thread_count, t_batch_result *result) {
+    // Each batch gets its own pool so batches can be run from several host threads at once
+    t_batch_pool local_pool;
+    t_batch_pool *pool = &local_pool;
+    struct timespec start_time;
+    struct timespec end_time;
+
+    if (thread_count == 0) {
+        thread_count = online_cores();
+    }
+    if (thread_count > BATCH_MAX_THREADS) {
+        thread_count = BATCH_MAX_THREADS;
+    }
+    if (thread_count > job_count && job_count > 0) {
+        thread_count = job_count;
+    }
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+
+    pool->jobs = jobs;
+    pool->worker_count = thread_count;
+
+    // Split the jobs evenly between the workers
+    for (unsigned int i = 0; i < thread_count; i++) {
+        t_batch_worker *worker = &pool->workers[i];
+        unsigned int begin = (unsigned int) (((unsigned long long) job_count * i) / thread_count);
+        unsigned int end = (unsigned int) (((unsigned long long) job_count * (i + 1)) / thread_count);
+        atomic_init(&worker->range, pack_range(begin, end));
+        worker->pool = pool;
+        worker->index = i;
+        worker->started = 0;
+        worker->instructions_executed = 0;
+        worker->cycles_executed = 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    // Start the other workers, any that fail to start simply have their jobs stolen
+    for (unsigned int i = 1; i < thread_count; i++) {
+        t_batch_worker *worker = &pool->workers[i];
+        worker->started = (pthread_create(&worker->thread, NULL, worker_main, worker) == 0);
+    }
+
+    // The calling thread is worker 0. Its affinity is put back afterwards.
+#if defined(__linux__)
+    cpu_set_t saved_affinity;
+    int restore_affinity = (pthread_getaffinity_np(pthread_self(), sizeof(saved_affinity), &saved_affinity) == 0);
+    pin_thread(0);
+#endif
+    run_worker(&pool->workers[0]);
+#if defined(__linux__)
+    if (restore_affinity) {
+        pthread_setaffinity_np(pthread_self(), sizeof(saved_affinity), &saved_affinity);
+    }
+#endif
+
+    for (unsigned int i = 1; i < thread_count; i++) {
+        if (pool->workers[i].started) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+    // Add up the totals
+    result->thread_count = thread_count;
+    result->instructions_executed = 0;
+    result->cycles_executed = 0;
+    for (unsigned int i = 0; i < thread_count; i++) {
+        result->instructions_executed += pool->workers[i].instructions_executed;
+        result->cycles_executed += pool->workers[i].cycles_executed;
+    }
+    result->elapsed_seconds = (double) (end_time.tv_sec - start_time.tv_sec) + (double) (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+    result->instructions_per_second = (result->elapsed_seconds > 0) ? (double) result->instructions_executed / result->elapsed_seconds : 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Entry point of the worker threads
+//   Inputs: Worker
+// -------------------------------------------------------------------------------------------------------------------------------
+static void *worker_main(void *argument) {
+    t_batch_worker *worker = (t_batch_worker *) argument;
+
+    pin_thread(worker->index);
+    run_worker(worker);
+    return NULL;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs jobs until there are none left to take or steal
+//   Inputs: Worker
+// -------------------------------------------------------------------------------------------------------------------------------
+static void run_worker(t_batch_worker *worker) {
+    unsigned int job_index;
+
+    for (;;) {
+        if (!take_job(worker, &job_index) && (!steal_jobs(worker) || !take_job(worker, &job_index))) {
+            return;
+        }
+
+        t_batch_job *job = &worker->pool->jobs[job_index];
+        job->status = run_mos6502(job->bus, job->registers, &job->budget);
+        worker->instructions_executed += job->budget.instructions_executed;
+        worker->cycles_executed += job->budget.cycles_executed;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Takes the next job from the front of the worker's own range
+//   Inputs: Worker, Job Index
+//   Output: 1 if a job was taken, 0 if the range is empty
+// -------------------------------------------------------------------------------------------------------------------------------
+static int take_job(t_batch_worker *worker, unsigned int *job_index) {
+    unsigned long long range = atomic_load_explicit(&worker->range, memory_order_acquire);
+
+    while (range_begin(range) < range_end(range)) {
+        unsigned long long taken = pack_range(range_begin(range) + 1, range_end(range));
+        if (atomic_compare_exchange_weak_explicit(&worker->range, &range, taken, memory_order_acq_rel, memory_order_acquire)) {
+            *job_index = range_begin(range);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Steals the back half of the first other worker found with jobs left. The worker's own range is empty when this is called,
+// so nobody else will touch it while the stolen jobs are moved into it.
+//   Inputs: Worker
+//   Output: 1 if jobs were stolen, 0 if every other range is empty
+// -------------------------------------------------------------------------------------------------------------------------------
+static int steal_jobs(t_batch_worker *worker) {
+    t_batch_pool *pool = worker->pool;
+
+    for (unsigned int i = 1; i < pool->worker_count; i++) {
+        t_batch_worker *victim = &pool->workers[(worker->index + i) % pool->worker_count];
+        unsigned long long range = atomic_load_explicit(&victim->range, memory_order_acquire);
+
+        while (range_begin(range) < range_end(range)) {
+            unsigned int begin = range_begin(range);
+            unsigned int end = range_end(range);
+            unsigned int split = end - (end - begin + 1) / 2;
+            if (atomic_compare_exchange_weak_explicit(&victim->range, &range, pack_range(begin, split),
+                                                      memory_order_acq_rel, memory_order_acquire)) {
+                atomic_store_explicit(&worker->range, pack_range(split, end), memory_order_release);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Pins the calling thread to a core, worker n runs on the n-th core this process may use
+//   Inputs: Worker Index
+// -------------------------------------------------------------------------------------------------------------------------------
+static void pin_thread(unsigned int worker_index) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    cpu_set_t pinned;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
+    }
+
+    // Find the n-th allowed core, wrapping around when there are more workers than cores
+    unsigned int wanted = worker_index % (unsigned int) CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            if (wanted == 0) {
+                CPU_ZERO(&pinned);
+                CPU_SET(cpu, &pinned);
+                pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+                return;
+            }
+            wanted--;
+        }
+    }
+#else
+    (void) worker_index;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Packs a job range into a single word
+//   Inputs: First Job, End Of Range
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned long long pack_range(unsigned int begin, unsigned int end) {
+    return ((unsigned long long) end << 32) | begin;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// First job of a packed range
+//   Inputs: Packed Range
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int range_begin(unsigned long long range) {
+    return (unsigned int) (range & 0xFFFFFFFFULL);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// End of a packed range
+//   Inputs: Packed Range
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int range_end(unsigned long long range) {
+    return (unsigned int) (range >> 32);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Number of cores available to this process
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int online_cores(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cores > 0) ? (unsigned int) cores : 1;
+}
@@ -0,0 +1,58 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Batch Executor Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_batch.h
+//
+// Description:
+//   Contains the data types and function prototypes needed to run a large batch of independent 6502 machines across all of
+//   the cores of the host
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_BATCH_H
+#define MOS_6502_BATCH_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most worker threads a batch will start
+#define BATCH_MAX_THREADS 256
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// A single machine to run. The memory bus and registers are owned by the caller and must not be shared between jobs.
+typedef struct t_struct_batch_job {
+    t_memory_bus *bus;
+    t_registers *registers;
+    // Budget for this job, the amount used is written back when the job finishes
+    t_run_budget budget;
+    // Reason the job stopped
+    t_run_status status;
+} t_batch_job;
+
+// Totals for a whole batch
+typedef struct t_struct_batch_result {
+    unsigned int thread_count;
+    unsigned long long instructions_executed;
+    unsigned long long cycles_executed;
+    double elapsed_seconds;
+    double instructions_per_second;
+} t_batch_result;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Run A Batch Of Jobs
+extern void run_batch_mos6502(t_batch_job *, unsigned int, unsigned int, t_batch_result *);
+
+#endif // MOS_6502_BATCH_H
@@ -0,0 +1,337 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Block Cache
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_block_cache.c
+//
+// Description:
+//   Decodes basic blocks, keeps them in a hash table by start address and throws them away when their code changes. The
+//   blocks are run by run_cached_mos6502() in mos6502_emulator.c, which shares the instruction handlers with run_mos6502().
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stddef.h>
+
+// Local
+#include "mos6502_opcode.h"
+#include "mos6502_block_cache.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Handlers that can be part of an idle loop, as they leave memory and the stack alone. The shifts and rotates only can in
+// accumulator mode.
+#define IDLE_LOOP_adc 1
+#define IDLE_LOOP_and 1
+#define IDLE_LOOP_asl 0
+#define IDLE_LOOP_bcc 1
+#define IDLE_LOOP_bcs 1
+#define IDLE_LOOP_beq 1
+#define IDLE_LOOP_bit 1
+#define IDLE_LOOP_bmi 1
+#define IDLE_LOOP_bne 1
+#define IDLE_LOOP_bpl 1
+#define IDLE_LOOP_brk 0
+#define IDLE_LOOP_bvc 1
+#define IDLE_LOOP_bvs 1
+#define IDLE_LOOP_clc 1
+#define IDLE_LOOP_cld 1
+#define IDLE_LOOP_cli 1
+#define IDLE_LOOP_clv 1
+#define IDLE_LOOP_cmp 1
+#define IDLE_LOOP_cpx 1
+#define IDLE_LOOP_cpy 1
+#define IDLE_LOOP_dec 0
+#define IDLE_LOOP_dex 1
+#define IDLE_LOOP_dey 1
+#define IDLE_LOOP_eor 1
+#define IDLE_LOOP_inc 0
+#define IDLE_LOOP_inx 1
+#define IDLE_LOOP_iny 1
+#define IDLE_LOOP_jmp 0
+#define IDLE_LOOP_jsr 0
+#define IDLE_LOOP_lda 1
+#define IDLE_LOOP_ldx 1
+#define IDLE_LOOP_ldy 1
+#define IDLE_LOOP_lsr 0
+#define IDLE_LOOP_nop 1
+#define IDLE_LOOP_ora 1
+#define IDLE_LOOP_pha 0
+#define IDLE_LOOP_php 0
+#define IDLE_LOOP_pla 0
+#define IDLE_LOOP_plp 0
+#define IDLE_LOOP_rol 0
+#define IDLE_LOOP_ror 0
+#define IDLE_LOOP_rti 0
+#define IDLE_LOOP_rts 0
+#define IDLE_LOOP_sbc 1
+#define IDLE_LOOP_sec 1
+#define IDLE_LOOP_sed 1
+#define IDLE_LOOP_sei 1
+#define IDLE_LOOP_sta 0
+#define IDLE_LOOP_stx 0
+#define IDLE_LOOP_sty 0
+#define IDLE_LOOP_tax 1
+#define IDLE_LOOP_tay 1
+#define IDLE_LOOP_tsx 1
+#define IDLE_LOOP_txa 1
+#define IDLE_LOOP_txs 1
+#define IDLE_LOOP_tya 1
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Whether each opcode can be part of an idle loop
+#define IDLE_LOOP_ENTRY(code, mnemonic, handler, mode, length, base_cycles) [code] = IDLE_LOOP_##handler || mode == ACCUMULATOR,
+static const unsigned char idle_loop_opcodes[OPCODE_TABLE_SIZE] = {
+    MOS_6502_OPCODE_TABLE(IDLE_LOOP_ENTRY)
+};
+#undef IDLE_LOOP_ENTRY
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Decodes the block starting at an address
+static t_cached_block *decode_block(t_block_cache *, t_memory_bus *, unsigned short);
+
+// Checks whether an instruction can move the program counter anywhere but the next instruction
+static int ends_block(unsigned char);
+
+// Checks whether a block could be an idle loop
+static int is_idle_loop(t_cached_block *);
+
+// Hash table bucket for an address
+static unsigned int hash_address(unsigned short);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize an empty cache with its counters cleared
+//   Inputs: Block Cache
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void init_block_cache_mos6502(t_block_cache *cache) {
+    cache->bus = NULL;
+    cache->jit = NULL;
+    cache->hits = 0;
+    cache->chained = 0;
+    cache->misses = 0;
+    cache->invalidations = 0;
+    cache->flushes = 0;
+    cache->skip_idle_loops = 1;
+    cache->idle_loops_skipped = 0;
+    cache->idle_cycles_skipped = 0;
+    flush_block_cache_mos6502(cache);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Throw away every block. Pointers to blocks handed out before are no longer valid.
+//   Inputs: Block Cache
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void flush_block_cache_mos6502(t_block_cache *cache) {
+    for (unsigned int i = 0; i < BLOCK_HASH_SIZE; i++) {
+        cache->hash_table[i] = NULL;
+    }
+    cache->block_count = 0;
+    cache->instruction_count = 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Find the block starting at an address, decoding it if it is not in the cache. Stale blocks met in the hash table are
+// unlinked on the way. The block found is linked to the previous block so the next exit to the same address skips the hash
+// table, unless the cache had to be flushed to make room.
+//   Inputs: Block Cache, Memory Bus, Block Just Run (NULL if none), Address
+//   Output: Block starting at the address, NULL if the code there can not be cached
+// -------------------------------------------------------------------------------------------------------------------------------
+extern t_cached_block *find_block_mos6502(t_block_cache *cache, t_memory_bus *bus, t_cached_block *previous, unsigned short address) {
+    t_cached_block **link = &cache->hash_table[hash_address(address)];
+    t_cached_block *block = NULL;
+    unsigned long long flushes = cache->flushes;
+
+    // Generations are per bus, so blocks decoded through another bus mean nothing here
+    if (cache->bus != bus) {
+        flush_block_cache_mos6502(cache);
+        cache->bus = bus;
+        previous = NULL;
+    }
+
+    while (*link != NULL) {
+        if (!block_is_current_mos6502(bus, *link)) {
+            *link = (*link)->hash_next;
+            cache->invalidations++;
+            continue;
+        }
+        if ((*link)->start_address == address) {
+            block = *link;
+            break;
+        }
+        link = &(*link)->hash_next;
+    }
+
+    if (block != NULL) {
+        cache->hits++;
+    } else {
+        block = decode_block(cache, bus, address);
+        if (block == NULL) {
+            return NULL;
+        }
+        cache->misses++;
+    }
+
+    if (previous != NULL && cache->flushes == flushes) {
+        if (address == previous->end_address) {
+            previous->fallthrough = block;
+        } else {
+            previous->taken = block;
+        }
+    }
+    return block;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Decodes the block starting at an address. Decoding stops after an instruction that ends the block, before an unsupported
+// opcode, before an instruction with a byte outside RAM or ROM or in a third page, and after BLOCK_MAX_INSTRUCTIONS. The
+// pages decoded from are then watched through the bus.
+//   Inputs: Block Cache, Memory Bus, Address
+//   Output: New block, NULL if not even the first instruction could be decoded
+// -------------------------------------------------------------------------------------------------------------------------------
+static t_cached_block *decode_block(t_block_cache *cache, t_memory_bus *bus, unsigned short address) {
+    unsigned char first_page = address >> 8;
+    unsigned char last_page = first_page;
+    unsigned short program_counter = address;
+    unsigned int count = 0;
+
+    if (cache->block_count == BLOCK_CACHE_SIZE || cache->instruction_count + BLOCK_MAX_INSTRUCTIONS > BLOCK_CACHE_INSTRUCTIONS) {
+        flush_block_cache_mos6502(cache);
+        cache->flushes++;
+    }
+
+    t_cached_block *block = &cache->blocks[cache->block_count];
+    t_decoded_instruction *instructions = &cache->instructions[cache->instruction_count];
+
+    while (count < BLOCK_MAX_INSTRUCTIONS) {
+        unsigned char page = program_counter >> 8;
+        if (bus->read_pages[page] == NULL) {
+            break;
+        }
+
+        unsigned char opcode = read_bus_mos6502(bus, program_counter);
+        const t_opcode_descriptor *descriptor = &mos6502_opcode_table[opcode];
+        if (descriptor->mnemonic == NULL) {
+            break;
+        }
+
+        // Every byte of the instruction has to be in the first page of the block or the one after it
+        unsigned short last_byte = program_counter + descriptor->length - 1;
+        unsigned char end_page = last_byte >> 8;
+        if ((end_page != first_page && end_page != (unsigned char) (first_page + 1)) || bus->read_pages[end_page] == NULL) {
+            break;
+        }
+        if (end_page != first_page) {
+            last_page = end_page;
+        }
+
+        t_decoded_instruction *instruction = &instructions[count];
+        instruction->opcode = opcode;
+        instruction->length = descriptor->length;
+        instruction->cycles = descriptor->cycles;
+        instruction->operand = 0;
+        if (descriptor->length >= 2) {
+            instruction->operand = read_bus_mos6502(bus, program_counter + 1);
+        }
+        if (descriptor->length == 3) {
+            instruction->operand |= read_bus_mos6502(bus, program_counter + 2) << 8;
+        }
+
+        count++;
+        program_counter += descriptor->length;
+        if (ends_block(opcode)) {
+            break;
+        }
+    }
+
+    if (count == 0) {
+        return NULL;
+    }
+
+    watch_code_page_mos6502(bus, first_page);
+    watch_code_page_mos6502(bus, last_page);
+
+    block->start_address = address;
+    block->end_address = program_counter;
+    block->instruction_count = count;
+    block->first_page = first_page;
+    block->last_page = last_page;
+    block->first_generation = bus->code_generation[first_page];
+    block->last_generation = bus->code_generation[last_page];
+    block->instructions = instructions;
+    block->fallthrough = NULL;
+    block->taken = NULL;
+    block->execution_count = 0;
+    block->native = NULL;
+    block->native_generation = 0;
+    block->native_max_cycles = 0;
+    block->idle_loop = is_idle_loop(block);
+
+    unsigned int bucket = hash_address(address);
+    block->hash_next = cache->hash_table[bucket];
+    cache->hash_table[bucket] = block;
+
+    cache->block_count++;
+    cache->instruction_count += count;
+    return block;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether an instruction can move the program counter anywhere but the next instruction
+//   Inputs: Opcode
+//   Output: 1 for branches, jumps, calls, returns and BRK, 0 otherwise
+// -------------------------------------------------------------------------------------------------------------------------------
+static int ends_block(unsigned char opcode) {
+    switch (opcode) {
+        case JMP_ABSOLUTE:
+        case JMP_INDIRECT:
+        case JSR_ABSOLUTE:
+        case RTS_IMPLIED:
+        case RTI_IMPLIED:
+        case BRK_IMPLIED:
+            return 1;
+        default:
+            return mos6502_opcode_table[opcode].addressing_mode == RELATIVE;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether a block only reads memory, through addressing modes that read the same address each time the registers
+// are the same, and ends in a branch back to its own start
+//   Inputs: Block
+//   Output: 1 if the block could be an idle loop, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int is_idle_loop(t_cached_block *block) {
+    const t_decoded_instruction *branch = &block->instructions[block->instruction_count - 1];
+    if (mos6502_opcode_table[branch->opcode].addressing_mode != RELATIVE ||
+        (unsigned short) (block->end_address + (signed char) branch->operand) != block->start_address) {
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < block->instruction_count; i++) {
+        unsigned char opcode = block->instructions[i].opcode;
+        t_memory_access mode = mos6502_opcode_table[opcode].addressing_mode;
+        if (!idle_loop_opcodes[opcode] || mode == INDEXED_INDIRECT || mode == INDIRECT_INDEXED) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Hash table bucket for an address. Blocks start all over a page, so the low bits are kept as they are.
+//   Inputs: Address
+//   Output: Bucket number
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int hash_address(unsigned short address) {
+    return (address ^ (address >> 12)) & (BLOCK_HASH_SIZE - 1);
+}
@@ -0,0 +1,193 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Block Cache Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_block_cache.h
+//
+// Description:
+//   Contains the data types and function prototypes for the basic block cache. A block is a straight run of instructions
+//   ending at a branch, jump, call, return or BRK, decoded once into records holding the opcode, operand, length and cycles
+//   so that running it again skips fetching and decoding. Blocks are found by their start address and linked to the blocks
+//   they exit to. The pages a block was decoded from are watched through the memory bus, and a write into one of them throws
+//   the block away so self-modifying code keeps working.
+//
+//   A block that only reads memory and branches back to its own start is marked as a possible idle loop, like a program
+//   polling a flag with LDA $xx / BEQ back. Nothing but the processor writes memory while run_cached_mos6502() runs, events
+//   and devices only get to run between calls, so when such a block comes back to its start with every register and flag
+//   as they were the time before, it will keep doing so until the budget runs out. The loop is then skipped forward by as
+//   many whole passes as fit in the budget, which keeps the cycle and instruction counts exactly what running it would
+//   have given. Loops reading device pages are never skipped, as reading a device can change it.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_BLOCK_CACHE_H
+#define MOS_6502_BLOCK_CACHE_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most blocks and decoded instructions a cache holds, the whole cache is flushed when either runs out
+#define BLOCK_CACHE_SIZE         4096
+#define BLOCK_CACHE_INSTRUCTIONS 32768
+
+// Most instructions in a single block. At 3 bytes each a block never covers more than two pages.
+#define BLOCK_MAX_INSTRUCTIONS 64
+
+// Number of hash table buckets, a power of two
+#define BLOCK_HASH_SIZE 4096
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Pre-decoded instruction. The opcode picks the handler, the operand is the byte or word that followed it in memory.
+typedef struct t_struct_decoded_instruction {
+    unsigned short operand;
+    unsigned char opcode;
+    unsigned char length;
+    unsigned char cycles;
+} t_decoded_instruction;
+
+// Decoded basic block
+typedef struct t_struct_cached_block {
+    // Address of the first instruction and of the byte after the last one
+    unsigned short start_address;
+    unsigned short end_address;
+    unsigned short instruction_count;
+    // Pages the block was decoded from and their code generations at the time, the block is stale once either changes
+    unsigned char first_page;
+    unsigned char last_page;
+    unsigned int first_generation;
+    unsigned int last_generation;
+    t_decoded_instruction *instructions;
+    // Next block in the same hash bucket
+    struct t_struct_cached_block *hash_next;
+    // Blocks this one last exited to, by falling through its last instruction or by taking its branch or jump
+    struct t_struct_cached_block *fallthrough;
+    struct t_struct_cached_block *taken;
+    // Times the block was entered while the JIT is on, it is compiled when this reaches the JIT's hot threshold
+    unsigned int execution_count;
+    // Native code compiled by the JIT (NULL if none), the generation of the JIT it was compiled in and the most cycles
+    // running it can take
+    void *native;
+    unsigned int native_generation;
+    unsigned int native_max_cycles;
+    // Set when the block only reads memory and its branch goes back to its own start
+    unsigned char idle_loop;
+} t_cached_block;
+
+// Block Cache. Belongs to a single memory bus, using it with another bus flushes it.
+typedef struct t_struct_block_cache {
+    t_memory_bus *bus;
+    // JIT that compiles the hot blocks of this cache, NULL to only run the decoded records
+    struct t_struct_jit *jit;
+    t_cached_block *hash_table[BLOCK_HASH_SIZE];
+    t_cached_block blocks[BLOCK_CACHE_SIZE];
+    t_decoded_instruction instructions[BLOCK_CACHE_INSTRUCTIONS];
+    unsigned int block_count;
+    unsigned int instruction_count;
+    // Blocks found already decoded, and how many of those were found by following a link
+    unsigned long long hits;
+    unsigned long long chained;
+    // Blocks that had to be decoded
+    unsigned long long misses;
+    // Blocks thrown away because the code they were decoded from was written or remapped
+    unsigned long long invalidations;
+    // Times the cache filled up and was emptied
+    unsigned long long flushes;
+    // Set to skip idle loops when built in, cleared to always run them
+    int skip_idle_loops;
+    // Idle loops skipped and the cycles skipped over
+    unsigned long long idle_loops_skipped;
+    unsigned long long idle_cycles_skipped;
+} t_block_cache;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize Empty Cache
+extern void init_block_cache_mos6502(t_block_cache *);
+
+// Throw Away Every Block
+extern void flush_block_cache_mos6502(t_block_cache *);
+
+// Find Or Decode The Block Starting At An Address
+extern t_cached_block *find_block_mos6502(t_block_cache *, t_memory_bus *, t_cached_block *, unsigned short);
+
+// Run Instructions From The Cache Until The Budget Is Used Up (in mos6502_emulator.c, next to run_mos6502())
+extern t_run_status run_cached_mos6502(t_block_cache *, t_memory_bus *, t_registers *, t_run_budget *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Inline Functions
+// -------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks that the code a block was decoded from has not changed since
+//   Inputs: Memory Bus, Block
+//   Output: 1 if the block can still be run, 0 if it is stale
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline int block_is_current_mos6502(t_memory_bus *bus, t_cached_block *block) {
+    return bus->code_generation[block->first_page] == block->first_generation &&
+           bus->code_generation[block->last_page] == block->last_generation;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Finds the block to run after another one. The blocks linked to the previous block are tried first, which skips the hash
+// table for most branches and jumps.
+//   Inputs: Block Cache, Memory Bus, Block Just Run (NULL if none), Address
+//   Output: Block starting at the address, NULL if the code there can not be cached
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline t_cached_block *next_block_mos6502(t_block_cache *cache, t_memory_bus *bus, t_cached_block *previous, unsigned short address) {
+    if (previous != NULL) {
+        t_cached_block *next = (address == previous->end_address) ? previous->fallthrough : previous->taken;
+        if (next != NULL && next->start_address == address && block_is_current_mos6502(bus, next)) {
+            cache->hits++;
+            cache->chained++;
+            return next;
+        }
+    }
+    return find_block_mos6502(cache, bus, previous, address);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks that every memory operand of a block is in a RAM or ROM page, which reads the same value each time
+//   Inputs: Memory Bus, Block
+//   Output: 1 if the block reads no device or unmapped pages, 0 if it might
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline int reads_plain_memory_mos6502(t_memory_bus *bus, t_cached_block *block) {
+    for (unsigned int i = 0; i < block->instruction_count; i++) {
+        const t_decoded_instruction *instruction = &block->instructions[i];
+        unsigned short address = instruction->operand;
+
+        switch (mos6502_opcode_table[instruction->opcode].addressing_mode) {
+            case ZERO_PAGE:
+            case ZERO_PAGE_X:
+            case ZERO_PAGE_Y:
+                address = 0;
+                break;
+            case ABSOLUTE:
+                break;
+            case ABSOLUTE_X:
+            case ABSOLUTE_Y:
+                // Any index reaches at most the page after
+                if (bus->read_pages[(unsigned char) ((address >> 8) + 1)] == NULL) {
+                    return 0;
+                }
+                break;
+            default:
+                continue;
+        }
+        if (bus->read_pages[address >> 8] == NULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#endif // MOS_6502_BLOCK_CACHE_H
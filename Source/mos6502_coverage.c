@@ -0,0 +1,106 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Edge Coverage
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_coverage.c
+//
+// Description:
+//   Starts and finishes the runs of edge coverage. Hit counts are put into buckets the way AFL does, so a loop running a few
+//   more times does not count as new, and only the edges a run hit are looked at.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <string.h>
+
+// Local
+#include "mos6502_coverage.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts a hit count into its bucket
+static unsigned char hit_count_bucket(unsigned char);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize coverage with nothing seen. The map is cleared, it can be shared with a fuzzer and must hold COVERAGE_MAP_SIZE
+// bytes.
+//   Inputs: Coverage, Map (NULL for the coverage's own)
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void init_coverage_mos6502(t_coverage *coverage, unsigned char *map) {
+    memset(coverage, 0, sizeof(t_coverage));
+    coverage->map = (map != NULL) ? map : coverage->own_map;
+    memset(coverage->map, 0, COVERAGE_MAP_SIZE);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Clear the edges hit by the last run, ready for the next input
+//   Inputs: Coverage
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void start_coverage_run_mos6502(t_coverage *coverage) {
+    for (unsigned int i = 0; i < coverage->touched_count; i++) {
+        coverage->map[coverage->touched[i]] = 0;
+    }
+    coverage->touched_count = 0;
+    coverage->previous_location = 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Merge the edges hit by a run into the ones seen before. The map is left as the run made it, for the fuzzer to read.
+//   Inputs: Coverage
+//   Output: COVERAGE_NEW_EDGES when the run hit an edge never hit before, COVERAGE_NEW_HIT_COUNTS when it hit a known edge
+//           a number of times that falls in a new bucket, otherwise COVERAGE_NOTHING_NEW
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int finish_coverage_run_mos6502(t_coverage *coverage) {
+    int found = COVERAGE_NOTHING_NEW;
+
+    for (unsigned int i = 0; i < coverage->touched_count; i++) {
+        unsigned short edge = coverage->touched[i];
+        unsigned char bucket = hit_count_bucket(coverage->map[edge]);
+        if (coverage->seen[edge] & bucket) {
+            continue;
+        }
+        if (coverage->seen[edge] == 0) {
+            coverage->edges_seen++;
+            found = COVERAGE_NEW_EDGES;
+        } else if (found == COVERAGE_NOTHING_NEW) {
+            found = COVERAGE_NEW_HIT_COUNTS;
+        }
+        coverage->seen[edge] |= bucket;
+    }
+
+    coverage->runs++;
+    if (found != COVERAGE_NOTHING_NEW) {
+        coverage->new_runs++;
+    }
+    return found;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts a hit count into its bucket: 1, 2, 3, 4 to 7, 8 to 15, 16 to 31, 32 to 127 and 128 or more
+//   Inputs: Hit Count (not 0)
+//   Output: Bit of the bucket
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned char hit_count_bucket(unsigned char count) {
+    if (count <= 3) {
+        return (unsigned char) (1 << (count - 1));
+    }
+    if (count <= 7) {
+        return 0x08;
+    }
+    if (count <= 15) {
+        return 0x10;
+    }
+    if (count <= 31) {
+        return 0x20;
+    }
+    if (count <= 127) {
+        return 0x40;
+    }
+    return 0x80;
+}
@@ -0,0 +1,95 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Edge Coverage Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_coverage.h
+//
+// Description:
+//   Contains the data types and function prototypes for edge coverage, the feedback a coverage guided fuzzer needs. While
+//   coverage is compiled in (MOS_6502_COVERAGE) run_mos6502() and run_cached_mos6502() record an edge into the coverage of
+//   their budget after every branch, jump, call, return and BRK. The edge is made from a hash of the address control went to
+//   and the hash of the one before it, the same way AFL does it, and counts into a 64 KB map of hit counts that can be the
+//   shared memory of a fuzzer.
+//
+//   Each input is run between start_coverage_run_mos6502() and finish_coverage_run_mos6502(). Edges are listed the first
+//   time they are hit in a run, so finishing a run only looks at the edges it hit to tell whether it found a new edge or a
+//   new bucket of hit counts, and starting the next one only clears those.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_COVERAGE_H
+#define MOS_6502_COVERAGE_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Number of edges in the map, one byte each
+#define COVERAGE_MAP_SIZE 65536
+
+// What a finished run found
+#define COVERAGE_NOTHING_NEW    0
+#define COVERAGE_NEW_HIT_COUNTS 1
+#define COVERAGE_NEW_EDGES      2
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Edge coverage of the current run and of every run before it
+typedef struct t_struct_coverage {
+    // Hit count of every edge in this run, stopping at 255. Points at own_map unless a map was given.
+    unsigned char *map;
+    unsigned char own_map[COVERAGE_MAP_SIZE];
+    // Hash of the address control last went to, shifted so that going from A to B and from B to A are different edges
+    unsigned short previous_location;
+    // Edges hit in this run, in the order they were first hit
+    unsigned short touched[COVERAGE_MAP_SIZE];
+    unsigned int touched_count;
+    // Buckets of hit counts seen on every edge over all runs, a bit for each bucket
+    unsigned char seen[COVERAGE_MAP_SIZE];
+    // Counters
+    unsigned long long runs;
+    unsigned long long new_runs;
+    unsigned int edges_seen;
+} t_coverage;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize Coverage With Nothing Seen, Counting Into A Shared Map Or Its Own
+extern void init_coverage_mos6502(t_coverage *, unsigned char *);
+
+// Clear The Edges Hit By The Last Run
+extern void start_coverage_run_mos6502(t_coverage *);
+
+// Merge The Edges Hit By A Run Into The Ones Seen Before
+extern int finish_coverage_run_mos6502(t_coverage *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Inline Functions
+// -------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------
+// Record the edge from the last control transfer to this one. The count stops at 255 rather than wrapping to 0, so an edge
+// is only listed once per run.
+//   Inputs: Coverage, Address Control Went To
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void record_edge_mos6502(t_coverage *coverage, unsigned short address) {
+    unsigned short location = (unsigned short) ((address * 0x9E3779B1U) >> 16);
+    unsigned short edge = location ^ coverage->previous_location;
+    unsigned char count = coverage->map[edge];
+
+    coverage->previous_location = location >> 1;
+    if (count == 0) {
+        coverage->touched[coverage->touched_count++] = edge;
+    }
+    coverage->map[edge] = (unsigned char) (count + (count != 0xFF));
+}
+
+#endif // MOS_6502_COVERAGE_H
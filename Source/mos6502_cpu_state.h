@@ -0,0 +1,46 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Processor State Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_cpu_state.h
+//
+// Description:
+//   Contains the processor state used while running. It is private to the emulator and the JIT, which works on the same
+//   state from native code, hosts use t_registers instead.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_CPU_STATE_H
+#define MOS_6502_CPU_STATE_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Processor state used while running. The negative and zero flags are not kept in the status byte, instead they are worked
+// out when needed from the last result that set them. The zero flag is set when the low byte of the result is 0 and the
+// negative flag when bit 7 or bit 8 is set, so bit 8 lets both flags be set at once (BIT, PLP and RTI need this).
+typedef struct t_struct_cpu_state {
+    unsigned short program_counter;
+    unsigned char stack_pointer;
+    unsigned char accumulator;
+    unsigned char register_x;
+    unsigned char register_y;
+    unsigned char processor_status;
+    unsigned short nz_result;
+    unsigned long long cycles;
+#if MOS_6502_PROFILE
+    // Page crossings since the run started, added to the profile when it returns
+    unsigned long long page_crossings;
+    unsigned long long branch_page_crossings;
+#endif
+} t_cpu_state;
+
+#endif // MOS_6502_CPU_STATE_H
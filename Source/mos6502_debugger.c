@@ -0,0 +1,330 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Debugger
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_debugger.c
+//
+// Description:
+//   Sets and clears breakpoints and watchpoints, checks them while stepping the processor and reports what stopped a run
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <string.h>
+
+// Local
+#include "mos6502_debugger.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks the breakpoints of an address
+static int check_breakpoints(t_debugger *, unsigned char, unsigned short, unsigned char);
+static int condition_holds(t_debugger *, t_breakpoint *, unsigned char);
+
+// Catches watched reads and writes from the memory bus
+static void watch_access(void *, unsigned short, unsigned char, int);
+
+// Rebuilds the bitmaps of an address and the watching of its page
+static void update_address(t_debugger *, unsigned short);
+
+// Tests a bit of an address bitmap
+static int address_is_set(const unsigned long long *, unsigned short);
+
+// Reads memory without going through the bus
+static unsigned char peek(t_memory_bus *, unsigned short);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize a debugger with no breakpoints, and have the bus pass it the accesses of watched pages
+//   Inputs: Debugger, Memory Bus
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void init_debugger_mos6502(t_debugger *debugger, t_memory_bus *bus) {
+    memset(debugger, 0, sizeof(t_debugger));
+    debugger->bus = bus;
+    debugger->hit = -1;
+    set_access_watcher_mos6502(bus, watch_access, debugger);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Set a breakpoint on an address, with no condition
+//   Inputs: Debugger, Address, Kinds (BREAK_ON_EXECUTE, BREAK_ON_READ and BREAK_ON_WRITE or'ed together)
+//   Output: Breakpoint number, -1 if every breakpoint is in use
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int add_breakpoint_mos6502(t_debugger *debugger, unsigned short address, unsigned char kinds) {
+    for (int i = 0; i < DEBUGGER_MAX_BREAKPOINTS; i++) {
+        t_breakpoint *breakpoint = &debugger->breakpoints[i];
+        if (!breakpoint->in_use) {
+            memset(breakpoint, 0, sizeof(t_breakpoint));
+            breakpoint->in_use = 1;
+            breakpoint->address = address;
+            breakpoint->kinds = kinds & (BREAK_ON_EXECUTE | BREAK_ON_READ | BREAK_ON_WRITE);
+            breakpoint->operand = CONDITION_NONE;
+            debugger->armed++;
+            update_address(debugger, address);
+            return i;
+        }
+    }
+    printf("Error: More than %d breakpoints set!!\n", DEBUGGER_MAX_BREAKPOINTS);
+    return -1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Give a breakpoint a condition and a number of hits to let pass. A hit is only counted while the condition holds.
+//   Inputs: Debugger, Breakpoint Number, What To Compare (CONDITION_NONE for no condition), How To Compare, Value To Compare
+//           With, Hits To Let Pass
+//   Output: 0 on success, -1 if the breakpoint is not set
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int set_breakpoint_condition_mos6502(t_debugger *debugger, int number, t_condition_operand operand,
+                                            t_condition_comparison comparison, unsigned char value, unsigned long long ignore_count) {
+    if (number < 0 || number >= DEBUGGER_MAX_BREAKPOINTS || !debugger->breakpoints[number].in_use) {
+        printf("Error: Breakpoint %d is not set!!\n", number);
+        return -1;
+    }
+
+    t_breakpoint *breakpoint = &debugger->breakpoints[number];
+    breakpoint->operand = operand;
+    breakpoint->comparison = comparison;
+    breakpoint->value = value;
+    breakpoint->ignore_count = ignore_count;
+    breakpoint->hits = 0;
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Clear a breakpoint. Once the last one is cleared runs stop checking for them.
+//   Inputs: Debugger, Breakpoint Number
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void remove_breakpoint_mos6502(t_debugger *debugger, int number) {
+    if (number < 0 || number >= DEBUGGER_MAX_BREAKPOINTS || !debugger->breakpoints[number].in_use) {
+        return;
+    }
+    debugger->breakpoints[number].in_use = 0;
+    debugger->armed--;
+    update_address(debugger, debugger->breakpoints[number].address);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Print the breakpoint that stopped the last run
+//   Inputs: Debugger, Output File
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void print_breakpoint_hit_mos6502(t_debugger *debugger, FILE *output) {
+    if (debugger->hit < 0) {
+        fprintf(output, "No breakpoint hit\n");
+        return;
+    }
+
+    t_breakpoint *breakpoint = &debugger->breakpoints[debugger->hit];
+    const char *kind = (debugger->hit_kind == BREAK_ON_EXECUTE) ? "Execute" : (debugger->hit_kind == BREAK_ON_READ) ? "Read" : "Write";
+    fprintf(output, "%s breakpoint %d at $%04X, value $%02X, hit %llu times\n", kind, debugger->hit, debugger->hit_address,
+            debugger->hit_value, breakpoint->hits);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs instructions one at a time through run_mos6502() until a breakpoint is hit or the budget is used up. The execute
+// bitmap is checked before each instruction, and watched accesses are checked by the bus while it runs.
+//   Inputs: Memory Bus, Registers, Budget (with its debugger)
+//   Output: Reason for returning, RUN_BREAKPOINT when a breakpoint stopped the run
+// -------------------------------------------------------------------------------------------------------------------------------
+extern t_run_status run_debugged_mos6502(t_memory_bus *bus, t_registers *registers, t_run_budget *budget) {
+    t_debugger *debugger = budget->debugger;
+    t_run_status status = RUN_BUDGET_EXHAUSTED;
+    unsigned long long start_cycles = registers->cycles;
+    unsigned long long instructions = 0;
+    t_run_budget step = { .instruction_limit = 1 };
+
+    step.trace = budget->trace;
+    step.profile = budget->profile;
+    step.coverage = budget->coverage;
+    debugger->hit = -1;
+
+    for (;;) {
+        if (budget->stop_requested) {
+            status = RUN_STOPPED;
+            break;
+        }
+        if ((budget->instruction_limit != 0 && instructions >= budget->instruction_limit) ||
+            (MOS_6502_CYCLE_COUNTING && budget->cycle_limit != 0 && registers->cycles - start_cycles >= budget->cycle_limit)) {
+            break;
+        }
+
+        unsigned short address = registers->program_counter;
+        unsigned char opcode = peek(bus, address);
+        int resuming = debugger->resuming && debugger->resume_address == address;
+        debugger->resuming = 0;
+        debugger->registers = registers;
+        debugger->instruction_address = address;
+        debugger->instruction_length = (mos6502_opcode_table[opcode].mnemonic != NULL) ? mos6502_opcode_table[opcode].length : 1;
+        if (!resuming && address_is_set(debugger->execute_addresses, address) &&
+            check_breakpoints(debugger, BREAK_ON_EXECUTE, address, opcode)) {
+            debugger->registers = NULL;
+            debugger->resuming = 1;
+            debugger->resume_address = address;
+            status = RUN_BREAKPOINT;
+            break;
+        }
+
+        status = run_mos6502(bus, registers, &step);
+        debugger->registers = NULL;
+        instructions += step.instructions_executed;
+        if (debugger->hit >= 0) {
+            status = RUN_BREAKPOINT;
+            break;
+        }
+        if (status != RUN_BUDGET_EXHAUSTED) {
+            break;
+        }
+    }
+
+    budget->instructions_executed = instructions;
+    budget->cycles_executed = MOS_6502_CYCLE_COUNTING ? registers->cycles - start_cycles : 0;
+    return status;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Counts a hit on every breakpoint of a kind on an address whose condition holds, and records the first one to stop the run
+//   Inputs: Debugger, Kind, Address, Value Read, Written Or Executed
+//   Output: 1 if a breakpoint stops the run, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int check_breakpoints(t_debugger *debugger, unsigned char kind, unsigned short address, unsigned char value) {
+    int stop = 0;
+
+    for (int i = 0; i < DEBUGGER_MAX_BREAKPOINTS; i++) {
+        t_breakpoint *breakpoint = &debugger->breakpoints[i];
+        if (!breakpoint->in_use || breakpoint->address != address || !(breakpoint->kinds & kind) ||
+            !condition_holds(debugger, breakpoint, value)) {
+            continue;
+        }
+        breakpoint->hits++;
+        if (breakpoint->hits > breakpoint->ignore_count && !stop) {
+            debugger->hit = i;
+            debugger->hit_kind = kind;
+            debugger->hit_address = address;
+            debugger->hit_value = value;
+            stop = 1;
+        }
+    }
+    return stop;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks the condition of a breakpoint
+//   Inputs: Debugger, Breakpoint, Value Read, Written Or Executed
+//   Output: 1 if the condition holds or there is none, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int condition_holds(t_debugger *debugger, t_breakpoint *breakpoint, unsigned char value) {
+    t_registers *registers = debugger->registers;
+    unsigned char operand;
+
+    switch (breakpoint->operand) {
+        case CONDITION_ACCUMULATOR:
+            operand = registers->accumulator;
+            break;
+        case CONDITION_REGISTER_X:
+            operand = registers->register_x;
+            break;
+        case CONDITION_REGISTER_Y:
+            operand = registers->register_y;
+            break;
+        case CONDITION_STACK_POINTER:
+            operand = registers->stack_pointer;
+            break;
+        case CONDITION_PROCESSOR_STATUS:
+            operand = registers->processor_status;
+            break;
+        case CONDITION_VALUE:
+            operand = value;
+            break;
+        default:
+            return 1;
+    }
+
+    switch (breakpoint->comparison) {
+        case COMPARE_EQUAL:
+            return operand == breakpoint->value;
+        case COMPARE_NOT_EQUAL:
+            return operand != breakpoint->value;
+        case COMPARE_LESS:
+            return operand < breakpoint->value;
+        case COMPARE_GREATER:
+            return operand > breakpoint->value;
+        case COMPARE_ANY_BITS:
+            return (operand & breakpoint->value) != 0;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks a watched access passed on by the memory bus. Accesses made while the debugger is not stepping, and the fetch of
+// the instruction itself, are let through.
+//   Inputs: Debugger, Address, Value Read Or Written, Whether It Was A Write
+// -------------------------------------------------------------------------------------------------------------------------------
+static void watch_access(void *watcher, unsigned short address, unsigned char value, int write) {
+    t_debugger *debugger = watcher;
+
+    if (debugger->registers == NULL || debugger->hit >= 0) {
+        return;
+    }
+    if (write) {
+        if (address_is_set(debugger->write_addresses, address)) {
+            check_breakpoints(debugger, BREAK_ON_WRITE, address, value);
+        }
+        return;
+    }
+    if ((unsigned short) (address - debugger->instruction_address) < debugger->instruction_length) {
+        return;
+    }
+    if (address_is_set(debugger->read_addresses, address)) {
+        check_breakpoints(debugger, BREAK_ON_READ, address, value);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Sets the bits of an address from the breakpoints left on it, and watches the reads and writes of its page while any
+// address in the page has a read or write breakpoint
+//   Inputs: Debugger, Address
+// -------------------------------------------------------------------------------------------------------------------------------
+static void update_address(t_debugger *debugger, unsigned short address) {
+    unsigned char kinds = 0;
+    unsigned char page_kinds = 0;
+
+    for (int i = 0; i < DEBUGGER_MAX_BREAKPOINTS; i++) {
+        t_breakpoint *breakpoint = &debugger->breakpoints[i];
+        if (breakpoint->in_use && (breakpoint->address >> 8) == (address >> 8)) {
+            page_kinds |= breakpoint->kinds;
+            if (breakpoint->address == address) {
+                kinds |= breakpoint->kinds;
+            }
+        }
+    }
+
+    unsigned long long bit = 1ULL << (address % 64);
+    unsigned long long *bitmaps[3] = { debugger->execute_addresses, debugger->read_addresses, debugger->write_addresses };
+    for (unsigned int i = 0; i < 3; i++) {
+        bitmaps[i][address / 64] = (kinds & (1 << i)) ? (bitmaps[i][address / 64] | bit) : (bitmaps[i][address / 64] & ~bit);
+    }
+    watch_page_accesses_mos6502(debugger->bus, address >> 8, (page_kinds & BREAK_ON_READ) != 0, (page_kinds & BREAK_ON_WRITE) != 0);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Tests the bit of an address in a bitmap
+//   Inputs: Address Bitmap, Address
+//   Output: 1 if the bit is set, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int address_is_set(const unsigned long long *bitmap, unsigned short address) {
+    return (bitmap[address / 64] >> (address % 64)) & 1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads memory without going through the bus, so devices and watchpoints do not see it
+//   Inputs: Memory Bus, Address
+//   Output: Byte at the address, OPEN_BUS_VALUE for device and unmapped pages
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned char peek(t_memory_bus *bus, unsigned short address) {
+    unsigned char *data = bus->pages[address >> 8].data;
+    return (data != NULL) ? data[address & 0x00FF] : OPEN_BUS_VALUE;
+}
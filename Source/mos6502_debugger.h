@@ -0,0 +1,132 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Debugger Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_debugger.h
+//
+// Description:
+//   Contains the data types and function prototypes for breakpoints and watchpoints. Each kind has a bitmap with a bit for
+//   every address, so finding out whether an address has any breakpoint is a single bit test. A breakpoint can have a
+//   condition on a register or on the value read or written, and a number of hits to let pass before it stops the run.
+//
+//   A run whose budget has a debugger with breakpoints set steps the processor one instruction at a time, checking the
+//   execute bitmap before each one. Watched reads and writes are caught by the memory bus, which only sends the pages that
+//   hold a watchpoint down its slow path. Until the first breakpoint is set runs do not check anything, so building the
+//   debugger in costs nothing.
+//
+//   Execute breakpoints stop the run before the instruction, with the registers as they are then, and running again from
+//   the same place lets the instruction run. Watchpoints stop the run after the instruction that made the access, and
+//   their register conditions see the registers as they were before it. Instruction fetches are not reads.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_DEBUGGER_H
+#define MOS_6502_DEBUGGER_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most breakpoints set at once
+#define DEBUGGER_MAX_BREAKPOINTS 64
+
+// Number of words in a bitmap with one bit per address
+#define ADDRESS_BITMAP_WORDS (MOS_6502_MEM_SIZE / 64)
+
+// Kinds of breakpoint, a breakpoint can be several at once
+#define BREAK_ON_EXECUTE 0x01
+#define BREAK_ON_READ    0x02
+#define BREAK_ON_WRITE   0x04
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// What a condition looks at
+typedef enum {
+    CONDITION_NONE,
+    CONDITION_ACCUMULATOR,
+    CONDITION_REGISTER_X,
+    CONDITION_REGISTER_Y,
+    CONDITION_STACK_POINTER,
+    CONDITION_PROCESSOR_STATUS,
+    // Value read or written, execute breakpoints see the opcode
+    CONDITION_VALUE
+} t_condition_operand;
+
+// How a condition compares
+typedef enum {
+    COMPARE_EQUAL,
+    COMPARE_NOT_EQUAL,
+    COMPARE_LESS,
+    COMPARE_GREATER,
+    // Any of the bits of the value are set, for testing flags
+    COMPARE_ANY_BITS
+} t_condition_comparison;
+
+// Single breakpoint
+typedef struct t_struct_breakpoint {
+    int in_use;
+    unsigned short address;
+    unsigned char kinds;
+    // Condition that has to hold for a hit, none by default
+    t_condition_operand operand;
+    t_condition_comparison comparison;
+    unsigned char value;
+    // Hits let pass before the run is stopped, and hits so far
+    unsigned long long ignore_count;
+    unsigned long long hits;
+} t_breakpoint;
+
+// Debugger for a single machine
+typedef struct t_struct_debugger {
+    t_memory_bus *bus;
+    // Addresses with a breakpoint of each kind, bit n of word n / 64 is address n
+    unsigned long long execute_addresses[ADDRESS_BITMAP_WORDS];
+    unsigned long long read_addresses[ADDRESS_BITMAP_WORDS];
+    unsigned long long write_addresses[ADDRESS_BITMAP_WORDS];
+    t_breakpoint breakpoints[DEBUGGER_MAX_BREAKPOINTS];
+    // Number of breakpoints set, runs only check for them while this is not 0
+    unsigned int armed;
+    // Registers, address and length of the instruction being stepped, NULL while not stepping
+    t_registers *registers;
+    unsigned short instruction_address;
+    unsigned char instruction_length;
+    // Breakpoint that stopped the last run (-1 if none), the kind of hit and the address and value it hit on
+    int hit;
+    unsigned char hit_kind;
+    unsigned short hit_address;
+    unsigned char hit_value;
+    // Set after an execute breakpoint stops a run, so running again from the same address runs the instruction
+    int resuming;
+    unsigned short resume_address;
+} t_debugger;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize A Debugger With No Breakpoints For A Bus
+extern void init_debugger_mos6502(t_debugger *, t_memory_bus *);
+
+// Set And Clear Breakpoints
+extern int add_breakpoint_mos6502(t_debugger *, unsigned short, unsigned char);
+extern int set_breakpoint_condition_mos6502(t_debugger *, int, t_condition_operand, t_condition_comparison, unsigned char,
+                                            unsigned long long);
+extern void remove_breakpoint_mos6502(t_debugger *, int);
+
+// Print What Stopped The Last Run
+extern void print_breakpoint_hit_mos6502(t_debugger *, FILE *);
+
+// Run Instructions One At A Time, Checking Breakpoints (called by run_mos6502() and run_cached_mos6502())
+extern t_run_status run_debugged_mos6502(t_memory_bus *, t_registers *, t_run_budget *);
+
+#endif // MOS_6502_DEBUGGER_H
@@ -20,45 +20,169 @@
 // Local
 #include "mos6502_opcode.h"
 #include "mos6502_emulator.h"
+#include "mos6502_cpu_state.h"
+#include "mos6502_block_cache.h"
+#include "mos6502_jit.h"
+#include "mos6502_trace.h"
+#include "mos6502_profile.h"
+#include "mos6502_debugger.h"
+#include "mos6502_coverage.h"
 
 // -------------------------------------------------------------------------------------------------------------------------------
-// Types
+// Macros
 // -------------------------------------------------------------------------------------------------------------------------------
-// Enumerated type for zero page access type
-typedef enum {
-    ZERO_PAGE, 
-    ZERO_PAGE_X, 
-    ZERO_PAGE_Y,
-    ABSOLUTE,
-    ABSOLUTE_X,
-    ABSOLUTE_Y,
-    INDIRECT,
-    INDEXED_INDIRECT,
-    INDIRECT_INDEXED
-} t_memory_access;
+// Instruction handlers and the helpers that take an addressing mode. Every opcode block passes its mode and length as
+// constants, and forcing these inline into the blocks lets the compiler fold the switches on them away, so each opcode
+// gets its own straight line code the way a template per mode would.
+#if MOS_6502_SPECIALIZE_HANDLERS && defined(__GNUC__)
+#define SPECIALIZED static inline __attribute__((always_inline))
+#else
+#define SPECIALIZED static inline
+#endif
+
+// Adds clock cycles to the cycle counter, or nothing at all when cycle counting is compiled out
+#if MOS_6502_CYCLE_COUNTING
+#define ADD_CYCLES(cpu, count) ((cpu)->cycles += (count))
+#else
+#define ADD_CYCLES(cpu, count) ((void) 0)
+#endif
+
+// Stores a trace record with the state before the instruction runs, or nothing at all when tracing is compiled out. Needs the
+// budget's ring in a local called trace.
+#if MOS_6502_TRACE
+#define TRACING() (trace != NULL)
+#define TRACE_INSTRUCTION(address, code, operand) \
+    if (trace != NULL) { \
+        record_trace_mos6502(trace, address, code, operand, cpu.accumulator, cpu.register_x, cpu.register_y, \
+                             cpu.stack_pointer, pack_status(&cpu), cpu.cycles); \
+    }
+#else
+#define TRACING() 0
+#define TRACE_INSTRUCTION(address, code, operand) ((void) 0)
+#endif
+
+// Counts an instruction into the budget's profile, or nothing at all when profiling is compiled out. Needs the profile and
+// the address and cycles the instruction started at in locals. PROFILE_START() goes before the cycles are added and
+// PROFILE_END() after the handler.
+#if MOS_6502_PROFILE
+#define PROFILING() (profile != NULL)
+#if MOS_6502_CYCLE_COUNTING
+#define PROFILE_START(address) (profile_address = (address), profile_cycles = cpu.cycles)
+#define PROFILE_END(code, base_cycles) \
+    if (profile != NULL) { \
+        profile->address_hits[profile_address]++; \
+        profile->opcode_executions[code]++; \
+        profile->opcode_cycles[code] += cpu.cycles - profile_cycles; \
+    }
+#else
+// Without cycle counting the cycles are the base cycles of the opcode, so the cycles it started at are not needed
+#define PROFILE_START(address) (profile_address = (address))
+#define PROFILE_END(code, base_cycles) \
+    if (profile != NULL) { \
+        profile->address_hits[profile_address]++; \
+        profile->opcode_executions[code]++; \
+        profile->opcode_cycles[code] += (base_cycles); \
+    }
+#endif
+#define COUNT_PAGE_CROSSINGS(cpu, field, count) ((cpu)->field += (count))
+#else
+#define PROFILING() 0
+#define PROFILE_START(address) ((void) 0)
+#define PROFILE_END(code, base_cycles) ((void) 0)
+#define COUNT_PAGE_CROSSINGS(cpu, field, count) ((void) 0)
+#endif
+
+// Records the edge to the program counter after a branch, jump, call, return or BRK into the budget's coverage, or nothing at
+// all when coverage is compiled out. Needs the coverage in a local called coverage. The opcode and mode are constants, so
+// every other instruction has no check at all.
+#if MOS_6502_COVERAGE
+#define COVERING() (coverage != NULL)
+#define COVER_EDGE(code, mode) \
+    if (((mode) == RELATIVE || (code) == JMP_ABSOLUTE || (code) == JMP_INDIRECT || (code) == JSR_ABSOLUTE || \
+         (code) == RTS_IMPLIED || (code) == RTI_IMPLIED || (code) == BRK_IMPLIED) && coverage != NULL) { \
+        record_edge_mos6502(coverage, cpu.program_counter); \
+    }
+#else
+#define COVERING() 0
+#define COVER_EDGE(code, mode) ((void) 0)
+#endif
 
 // -------------------------------------------------------------------------------------------------------------------------------
 // Function Prototypes
 // -------------------------------------------------------------------------------------------------------------------------------
 // Fetches an instruction
-static unsigned char fetch(unsigned char *, t_registers *);
+static inline unsigned char fetch(t_memory_bus *, t_cpu_state *);
+SPECIALIZED unsigned short fetch_word(t_memory_bus *, t_cpu_state *);
+SPECIALIZED unsigned short fetch_operand(t_memory_bus *, t_cpu_state *, unsigned char);
+
+// Reads and writes memory using an addressing mode
+SPECIALIZED unsigned short operand_address(t_memory_bus *, t_cpu_state *, t_memory_access, unsigned short, int);
+SPECIALIZED unsigned char read_memory(t_memory_bus *, t_cpu_state *, t_memory_access, unsigned short);
+SPECIALIZED void write_memory(t_memory_bus *, t_cpu_state *, t_memory_access, unsigned short, unsigned char);
+
+// Pushes and pulls values on the stack
+static inline void push(t_memory_bus *, t_cpu_state *, unsigned char);
+static inline unsigned char pull(t_memory_bus *, t_cpu_state *);
+
+// Reads and sets the processor status flags
+static inline void set_nz_flags(t_cpu_state *, unsigned short);
+static inline int zero_flag(t_cpu_state *);
+static inline int negative_flag(t_cpu_state *);
+static inline void set_carry_flag(t_cpu_state *, unsigned short);
 
-// Reads the zero page in memory
-static unsigned char read_memory(unsigned char *, t_registers *, unsigned short, t_memory_access);
+// Converts the processor status between the lazy form used while running and the packed byte
+static inline unsigned char pack_status(t_cpu_state *);
+static inline void unpack_status(t_cpu_state *, unsigned char);
 
-// Sets the processor status flags
-static void set_zero_page(t_registers *, unsigned char);
-static void set_negative_flag(t_registers *, unsigned char);
-static void set_carry_flag(t_registers *, short);
+// Copies the registers in and out of the state used while running
+static inline void load_cpu_state(t_cpu_state *, t_registers *);
+static inline void store_cpu_state(t_cpu_state *, t_registers *);
+
+// Instruction handlers
+#define DECLARE_HANDLER(code, mnemonic, handler, mode, length, base_cycles) \
+    SPECIALIZED void execute_##handler(t_memory_bus *, t_cpu_state *, t_memory_access, unsigned short);
+MOS_6502_OPCODE_TABLE(DECLARE_HANDLER)
+#undef DECLARE_HANDLER
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Negative and zero flag bits for every possible result byte
+static const unsigned char nz_flag_table[256] = {
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+
+// Opcode descriptor table, generated from the opcode list in mos6502_opcode.h
+#define DESCRIPTOR_ENTRY(code, mnemonic, handler, mode, length, base_cycles) \
+    [code] = { mnemonic, mode, length, base_cycles, execute_##handler },
+const t_opcode_descriptor mos6502_opcode_table[OPCODE_TABLE_SIZE] = {
+    MOS_6502_OPCODE_TABLE(DESCRIPTOR_ENTRY)
+};
+#undef DESCRIPTOR_ENTRY
 
 // -------------------------------------------------------------------------------------------------------------------------------
 // Reset MOS 6502
-//   Inputs: Memory, Registers
+//   Inputs: Memory Bus, Registers
 // -------------------------------------------------------------------------------------------------------------------------------
-extern void reset_mos6502(unsigned char *memory, t_registers *registers) {
+extern void reset_mos6502(t_memory_bus *bus, t_registers *registers) {
 
-    // Set program counter to the power on reset location
-    registers->program_counter = RESET_LOCATION_1;
+    // Start at the address held in the reset vector
+    registers->program_counter = (read_bus_mos6502(bus, RESET_LOCATION_2) << 8) | read_bus_mos6502(bus, RESET_LOCATION_1);
     
     // Clear all other registers
     registers->register_x = 0;
@@ -67,22 +191,19 @@ extern void reset_mos6502(unsigned char *memory, t_registers *registers) {
     registers->stack_pointer = 0;
 
     // Clear processor status bits
-    registers->processor_status.carry_flag = 0;
-    registers->processor_status.zero_flag = 0;
-    registers->processor_status.interrupt_disable = 0;
-    registers->processor_status.decimal_mode = 0;
-    registers->processor_status.break_command = 0;
-    registers->processor_status.overflow_flag = 0;
-    registers->processor_status.negative_flag = 0;
+    registers->processor_status = 0;
+
+    // Restart the cycle counter
+    registers->cycles = 0;
 
     // Clear the zero page in memory
     for (int i = 0; i < ZERO_PAGE_SIZE; i++) {
-        memory[i] = 0;
+        write_bus_mos6502(bus, i, 0);
     }
 
     // Clear the stack
     for (int i = 0; i < STACK_SIZE; i++) {
-        memory[STACK_BASE_ADDR + i] = 0;
+        write_bus_mos6502(bus, STACK_BASE_ADDR + i, 0);
     }
 }
 
@@ -97,228 +218,1225 @@ extern void print_registers_mos6502(t_registers *registers) {
     printf("\tRegister Y:        %d\n", registers->register_y);
     printf("\tAccumulator:       %d\n", registers->accumulator);
     printf("\tStack Pointer:     %d\n", registers->stack_pointer);
-    printf("\tCarry Flag:        %d\n", registers->processor_status.carry_flag);
-    printf("\tZero Flag:         %d\n", registers->processor_status.zero_flag);
-    printf("\tInterrupt Disable: %d\n", registers->processor_status.interrupt_disable);
-    printf("\tDecimal Mode:      %d\n", registers->processor_status.decimal_mode);
-    printf("\tBreak Command:     %d\n", registers->processor_status.break_command);
-    printf("\tOverflow Flag:     %d\n", registers->processor_status.overflow_flag);
-    printf("\tNegative Flag:     %d\n", registers->processor_status.negative_flag);
-}
-
-// -------------------------------------------------------------------------------------------------------------------------------
-// Executes instructions
-//   Inputs: Memory, Registers
-// -------------------------------------------------------------------------------------------------------------------------------
-extern void execute_mos6502(unsigned char *memory, t_registers *registers) {
-
-    // Fetch instruction
-    unsigned char instruction = fetch(memory, registers);
-
-    // Execute
-    switch (instruction) {
-
-        case ADC_IMMEDIATE: {
-            // Grab immediate value to be added
-            signed char value = fetch(memory, registers);
-            short sum = (short) (value + (signed char) registers->accumulator + (signed char) registers->processor_status.carry_flag);
-
-        } break;
-
-        case LDA_IMMEDIATE: {
-            // Grab value to be stored
-            unsigned char value = fetch(memory, registers);
-            registers->accumulator = value;
-            // Set processor status register bits
-            set_negative_flag(registers, value);
-            set_zero_flag(registers, value);
-        } break;
-
-        case LDA_ZERO_PAGE: {
-            // Grab zero page address
-            unsigned short address = (unsigned short) fetch(memory, registers);
-            unsigned char value = read_memory(memory, registers, address, ZERO_PAGE);
-            registers->accumulator = value;
-            // Set processor status register bits
-            set_negative_flag(registers, value);
-            set_zero_flag(registers, value);
-        } break;
-
-        case LDA_ZERO_PAGE_X: {
-            // Grab zero page address
-            unsigned short address = (unsigned short) fetch(memory, registers);
-            unsigned char value = read_memory(memory, registers, address, ZERO_PAGE_X);
-            registers->accumulator = value;
-            // Set processor status register bits
-            set_negative_flag(registers, value);
-            set_zero_flag(registers, value);
-        } break;
-
-        case LDA_ABSOLUTE: {
-            // Calculate memory address
-            unsigned short address_msb = (unsigned short) fetch(memory, registers);
-            unsigned short address_lsb = (unsigned short) fetch(memory, registers);
-            unsigned short address = (address_msb << 8) + address_lsb;
-            // Read memory
-            unsigned char value = read_memory(memory, registers, address, ABSOLUTE);
-            registers->accumulator = value;
-            // Set process status register bits
-            set_negative_flag(registers, value);
-            set_zero_flag(registers, value);
-        } break;
-
-        case LDA_ABSOLUTE_X: {
-            // Calculate memory address
-            unsigned short address_msb = (unsigned short) fetch(memory, registers);
-            unsigned short address_lsb = (unsigned short) fetch(memory, registers);
-            unsigned short address = (address_msb << 8) + address_lsb;
-            // Read memory
-            unsigned char value = read_memory(memory, registers, address, ABSOLUTE_X);
-            registers->accumulator = value;
-            // Set process status register bits
-            set_negative_flag(registers, value);
-            set_zero_flag(registers, value);
-        } break;
-
-        case LDA_ABSOLUTE_Y: {  
-            // Calculate memory address
-            unsigned short address_msb = (unsigned short) fetch(memory, registers);
-            unsigned short address_lsb = (unsigned short) fetch(memory, registers);
-            unsigned short address = (address_msb << 8) + address_lsb;
-            // Read memory
-            unsigned char value = read_memory(memory, registers, address, ABSOLUTE_Y);
-            registers->accumulator = value;
-            // Set process status register bits
-            set_negative_flag(registers, value);
-            set_zero_flag(registers, value);
-        } break;
-        
-        case LDA_INDIRECT_X: {
-            // Read memory
-            unsigned short address = (unsigned short) fetch(memory, registers);
-            unsigned char value = read_memory(memory, registers, address, INDEXED_INDIRECT);
-            registers->accumulator = value;
-            // Set process status register bits
-            set_negative_flag(registers, value);
-            set_zero_flag(registers, value);
-        } break;
-
-        case LDA_INDIRECT_Y: {
-            // Read memory
-            unsigned short address = (unsigned short) fetch(memory, registers);
-            unsigned char value = read_memory(memory, registers, address, INDIRECT_INDEXED);
-            registers->accumulator = value;
-            // Set process status register bits
-            set_negative_flag(registers, value);
-            set_zero_flag(registers, value);
-        } break;
-
-        default:
-            printf("Error: Instruction, %02hhX, not supported!!\n", (unsigned char) instruction);
+    printf("\tCarry Flag:        %d\n", (registers->processor_status & STATUS_CARRY) != 0);
+    printf("\tZero Flag:         %d\n", (registers->processor_status & STATUS_ZERO) != 0);
+    printf("\tInterrupt Disable: %d\n", (registers->processor_status & STATUS_INTERRUPT_DISABLE) != 0);
+    printf("\tDecimal Mode:      %d\n", (registers->processor_status & STATUS_DECIMAL_MODE) != 0);
+    printf("\tBreak Command:     %d\n", (registers->processor_status & STATUS_BREAK_COMMAND) != 0);
+    printf("\tOverflow Flag:     %d\n", (registers->processor_status & STATUS_OVERFLOW) != 0);
+    printf("\tNegative Flag:     %d\n", (registers->processor_status & STATUS_NEGATIVE) != 0);
+    printf("\tCycles:            %llu\n", registers->cycles);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Executes a single instruction
+//   Inputs: Memory Bus, Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void execute_mos6502(t_memory_bus *bus, t_registers *registers) {
+    t_run_budget budget = { .instruction_limit = 1 };
+
+    if (run_mos6502(bus, registers, &budget) == RUN_UNSUPPORTED_OPCODE) {
+        printf("Error: Instruction, %02hhX, not supported!!\n", read_bus_mos6502(bus, registers->program_counter));
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Enters an interrupt handler between instructions. The return address and the status, with the break bit clear, are
+// pushed, further interrupt requests are disabled and the program counter is loaded from the vector. A non maskable
+// interrupt is always taken, an interrupt request only while interrupts are enabled.
+//   Inputs: Memory Bus, Registers, Non Maskable
+//   Output: 1 if the interrupt was taken, 0 if it is masked
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int interrupt_mos6502(t_memory_bus *bus, t_registers *registers, int non_maskable) {
+    t_cpu_state cpu;
+
+    if (!non_maskable && (registers->processor_status & STATUS_INTERRUPT_DISABLE)) {
+        return 0;
+    }
+
+    load_cpu_state(&cpu, registers);
+    push(bus, &cpu, cpu.program_counter >> 8);
+    push(bus, &cpu, cpu.program_counter & 0xFF);
+    push(bus, &cpu, (pack_status(&cpu) & ~STATUS_BREAK_COMMAND) | STATUS_UNUSED);
+    cpu.processor_status |= STATUS_INTERRUPT_DISABLE;
+    if (non_maskable) {
+        cpu.program_counter = (read_bus_mos6502(bus, INTERRUPT_HANDLER_2) << 8) | read_bus_mos6502(bus, INTERRUPT_HANDLER_1);
+    } else {
+        cpu.program_counter = (read_bus_mos6502(bus, INTERRUPT_REQUEST_2) << 8) | read_bus_mos6502(bus, INTERRUPT_REQUEST_1);
+    }
+    ADD_CYCLES(&cpu, INTERRUPT_CYCLES);
+    store_cpu_state(&cpu, registers);
+    return 1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs instructions until the instruction or cycle budget is used up, a BRK or unsupported opcode is hit or the host sets the
+// stop flag. The registers are kept in a local copy for the whole run and only written back on return. A BRK is executed
+// (pushes the return address and status and jumps through the interrupt request vector) before returning.
+//
+// Each opcode is expanded from the opcode table into its own block of code which calls its handler with a constant addressing
+// mode. Where the compiler supports it every block jumps straight to the next opcode's block through a table of label
+// addresses, which gives each opcode its own indirect branch to predict. Otherwise a single switch is used.
+//   Inputs: Memory Bus, Registers, Budget
+//   Output: Reason for returning
+// -------------------------------------------------------------------------------------------------------------------------------
+extern t_run_status run_mos6502(t_memory_bus *bus, t_registers *registers, t_run_budget *budget) {
+    t_cpu_state cpu;
+    t_run_status status = RUN_BUDGET_EXHAUSTED;
+    unsigned long long instructions = 0;
+    unsigned long long slice = 0;
+    unsigned long long remaining = 0;
+    unsigned char opcode;
+#if MOS_6502_TRACE
+    t_trace_ring *trace = budget->trace;
+#endif
+#if MOS_6502_PROFILE
+    t_profile *profile = budget->profile;
+    unsigned short profile_address = 0;
+#if MOS_6502_CYCLE_COUNTING
+    unsigned long long profile_cycles = 0;
+#endif
+#endif
+#if MOS_6502_COVERAGE
+    t_coverage *coverage = budget->coverage;
+#endif
+
+    // Breakpoints are checked by stepping one instruction at a time, so the loops below never look for them
+    if (budget->debugger != NULL && budget->debugger->armed != 0) {
+        return run_debugged_mos6502(bus, registers, budget);
+    }
+
+    load_cpu_state(&cpu, registers);
+#if MOS_6502_PROFILE
+    cpu.page_crossings = 0;
+    cpu.branch_page_crossings = 0;
+#endif
+
+#if MOS_6502_CYCLE_COUNTING
+    // Cycle count at which the cycle budget runs out
+    unsigned long long start_cycles = cpu.cycles;
+    unsigned long long cycle_limit = (budget->cycle_limit != 0) ? start_cycles + budget->cycle_limit : ~0ULL;
+#define CYCLE_BUDGET_USED() (cpu.cycles >= cycle_limit)
+#else
+#define CYCLE_BUDGET_USED() 0
+#endif
+
+#if MOS_6502_COMPUTED_GOTO
+    // Label address for every opcode, unsupported opcodes fall through to the error label
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+#define LABEL_ENTRY(code, mnemonic, handler, mode, length, base_cycles) [code] = &&opcode_##code,
+    static void *const dispatch_table[OPCODE_TABLE_SIZE] = {
+        [0 ... OPCODE_TABLE_SIZE - 1] = &&unsupported_opcode,
+        MOS_6502_OPCODE_TABLE(LABEL_ENTRY)
+    };
+#undef LABEL_ENTRY
+#pragma GCC diagnostic pop
+#endif
+
+    for (;;) {
+
+        // Work out how many instructions to run before looking at the stop flag again
+        slice = RUN_SLICE_SIZE;
+        if (budget->instruction_limit != 0) {
+            if (instructions >= budget->instruction_limit) {
+                goto done;
+            }
+            if (budget->instruction_limit - instructions < slice) {
+                slice = budget->instruction_limit - instructions;
+            }
+        }
+        if (budget->stop_requested) {
+            status = RUN_STOPPED;
+            goto done;
+        }
+        remaining = slice;
+
+#if MOS_6502_COMPUTED_GOTO
+
+// Checks the budget, then fetches the next opcode and jumps straight to its code
+#define DISPATCH() \
+        if (remaining == 0 || CYCLE_BUDGET_USED()) { \
+            goto slice_done; \
+        } \
+        remaining--; \
+        opcode = fetch(bus, &cpu); \
+        goto *dispatch_table[opcode]
+
+// Code for a single opcode, a BRK ends the run once it has been executed
+#define OPCODE_BLOCK(code, mnemonic, handler, mode, length, base_cycles) \
+    opcode_##code: { \
+        unsigned short operand = fetch_operand(bus, &cpu, length); \
+        PROFILE_START(cpu.program_counter - length); \
+        TRACE_INSTRUCTION(cpu.program_counter - length, code, operand); \
+        ADD_CYCLES(&cpu, base_cycles); \
+        execute_##handler(bus, &cpu, mode, operand); \
+        PROFILE_END(code, base_cycles); \
+        COVER_EDGE(code, mode); \
+        if (code == BRK_IMPLIED) { \
+            status = RUN_BREAK; \
+            goto slice_done; \
+        } \
+        DISPATCH(); \
+    }
+
+        DISPATCH();
+        MOS_6502_OPCODE_TABLE(OPCODE_BLOCK)
+
+#undef OPCODE_BLOCK
+#undef DISPATCH
+
+#else
+
+// Code for a single opcode, a BRK ends the run once it has been executed
+#define OPCODE_CASE(code, mnemonic, handler, mode, length, base_cycles) \
+            case code: { \
+                unsigned short operand = fetch_operand(bus, &cpu, length); \
+                PROFILE_START(cpu.program_counter - length); \
+                TRACE_INSTRUCTION(cpu.program_counter - length, code, operand); \
+                ADD_CYCLES(&cpu, base_cycles); \
+                execute_##handler(bus, &cpu, mode, operand); \
+                PROFILE_END(code, base_cycles); \
+                COVER_EDGE(code, mode); \
+                if (code == BRK_IMPLIED) { \
+                    status = RUN_BREAK; \
+                    goto slice_done; \
+                } \
+            } break;
+
+        while (remaining != 0 && !CYCLE_BUDGET_USED()) {
+            remaining--;
+            opcode = fetch(bus, &cpu);
+            switch (opcode) {
+                MOS_6502_OPCODE_TABLE(OPCODE_CASE)
+                default:
+                    goto unsupported_opcode;
+            }
+        }
+        goto slice_done;
+
+#undef OPCODE_CASE
+
+#endif
+
+    unsupported_opcode:
+        // Leave the program counter on the unsupported opcode so the host can inspect it
+        cpu.program_counter--;
+        remaining++;
+        status = RUN_UNSUPPORTED_OPCODE;
+
+    slice_done:
+        instructions += slice - remaining;
+        if (status != RUN_BUDGET_EXHAUSTED || remaining != 0) {
+            goto done;
+        }
     }
+
+done:
+    store_cpu_state(&cpu, registers);
+    budget->instructions_executed = instructions;
+#if MOS_6502_PROFILE
+    if (profile != NULL) {
+        profile->page_crossings += cpu.page_crossings;
+        profile->branch_page_crossings += cpu.branch_page_crossings;
+    }
+#endif
+#if MOS_6502_CYCLE_COUNTING
+    budget->cycles_executed = cpu.cycles - start_cycles;
+#else
+    budget->cycles_executed = 0;
+#endif
+#undef CYCLE_BUDGET_USED
+    return status;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs instructions from a block cache. Gives the same results as run_mos6502() with the same budget, but each block is
+// fetched and decoded only the first time it is reached and then run from its decoded records, going from block to block
+// through the links the cache keeps. Code the cache can not hold (device pages and unsupported opcodes) is stepped through
+// run_mos6502() one instruction at a time.
+//
+// A write into a page holding cached code, or a page being remapped, bumps the code changes counter of the bus. It is
+// checked after every instruction, and the block is left when its own code was changed so the next instruction is decoded
+// again from memory.
+//   Inputs: Block Cache, Memory Bus, Registers, Budget
+//   Output: Reason for returning
+// -------------------------------------------------------------------------------------------------------------------------------
+extern t_run_status run_cached_mos6502(t_block_cache *cache, t_memory_bus *bus, t_registers *registers, t_run_budget *budget) {
+    t_cpu_state cpu;
+    t_run_status status = RUN_BUDGET_EXHAUSTED;
+    unsigned long long instructions = 0;
+    unsigned long long slice = 0;
+    unsigned long long remaining = 0;
+    // Block being run, the next record to run in it and the end of its records
+    t_cached_block *block = NULL;
+    const t_decoded_instruction *instruction = NULL;
+    const t_decoded_instruction *last = NULL;
+    unsigned int code_changes = 0;
+#if MOS_6502_TRACE
+    t_trace_ring *trace = budget->trace;
+#endif
+#if MOS_6502_PROFILE
+    t_profile *profile = budget->profile;
+    unsigned short profile_address = 0;
+#if MOS_6502_CYCLE_COUNTING
+    unsigned long long profile_cycles = 0;
+#endif
+#endif
+#if MOS_6502_COVERAGE
+    t_coverage *coverage = budget->coverage;
+#endif
+#if MOS_6502_SKIP_IDLE_LOOPS && MOS_6502_CYCLE_COUNTING
+    // Idle loop entered last, and the processor state it was entered with
+    t_cached_block *idle_block = NULL;
+    t_cpu_state idle_state = { 0 };
+#endif
+
+    // Breakpoints are checked by stepping one instruction at a time, so the loops below never look for them
+    if (budget->debugger != NULL && budget->debugger->armed != 0) {
+        return run_debugged_mos6502(bus, registers, budget);
+    }
+
+    load_cpu_state(&cpu, registers);
+#if MOS_6502_PROFILE
+    cpu.page_crossings = 0;
+    cpu.branch_page_crossings = 0;
+#endif
+
+#if MOS_6502_CYCLE_COUNTING
+    unsigned long long start_cycles = cpu.cycles;
+    unsigned long long cycle_limit = (budget->cycle_limit != 0) ? start_cycles + budget->cycle_limit : ~0ULL;
+#define CYCLE_BUDGET_USED() (cpu.cycles >= cycle_limit)
+#else
+#define CYCLE_BUDGET_USED() 0
+#endif
+
+// Leaves the block when its own code has changed, the program counter is already on the next instruction
+#define CHECK_CODE_CHANGES() \
+        if (bus->code_changes != code_changes) { \
+            code_changes = bus->code_changes; \
+            if (!block_is_current_mos6502(bus, block)) { \
+                last = instruction; \
+            } \
+        }
+
+#if MOS_6502_COMPUTED_GOTO
+    // Label address for every opcode, decoded records only hold supported opcodes
+#define LABEL_ENTRY(code, mnemonic, handler, mode, length, base_cycles) [code] = &&cached_opcode_##code,
+    static void *const dispatch_table[OPCODE_TABLE_SIZE] = {
+        MOS_6502_OPCODE_TABLE(LABEL_ENTRY)
+    };
+#undef LABEL_ENTRY
+#endif
+
+    for (;;) {
+
+        // Work out how many instructions to run before looking at the stop flag again
+        slice = RUN_SLICE_SIZE;
+        if (budget->instruction_limit != 0) {
+            if (instructions >= budget->instruction_limit) {
+                goto done;
+            }
+            if (budget->instruction_limit - instructions < slice) {
+                slice = budget->instruction_limit - instructions;
+            }
+        }
+        if (budget->stop_requested) {
+            status = RUN_STOPPED;
+            goto done;
+        }
+        remaining = slice;
+
+        while (remaining != 0 && !CYCLE_BUDGET_USED()) {
+
+            // Move on to the next block once the records of this one have all been run
+            if (instruction == last) {
+                block = next_block_mos6502(cache, bus, block, cpu.program_counter);
+                if (block == NULL) {
+                    t_run_budget step = { .instruction_limit = 1 };
+                    step.trace = budget->trace;
+                    step.profile = budget->profile;
+                    step.coverage = budget->coverage;
+                    store_cpu_state(&cpu, registers);
+                    status = run_mos6502(bus, registers, &step);
+                    load_cpu_state(&cpu, registers);
+                    remaining -= step.instructions_executed;
+                    instruction = last = NULL;
+#if MOS_6502_SKIP_IDLE_LOOPS && MOS_6502_CYCLE_COUNTING
+                    idle_block = NULL;
+#endif
+                    if (status != RUN_BUDGET_EXHAUSTED) {
+                        goto slice_done;
+                    }
+                    continue;
+                }
+                instruction = block->instructions;
+                last = instruction + block->instruction_count;
+                code_changes = bus->code_changes;
+
+#if MOS_6502_SKIP_IDLE_LOOPS && MOS_6502_CYCLE_COUNTING
+                // An idle loop back at its start with the same state as the pass before will only ever make the same pass
+                // again, so as many passes as fit in the budget are skipped at once. The rest of the budget is run as usual.
+                if (block->idle_loop && cache->skip_idle_loops && !TRACING() && !PROFILING() && !COVERING()) {
+                    if (block == idle_block && cycle_limit != ~0ULL && cpu.accumulator == idle_state.accumulator &&
+                        cpu.register_x == idle_state.register_x && cpu.register_y == idle_state.register_y &&
+                        cpu.stack_pointer == idle_state.stack_pointer && cpu.processor_status == idle_state.processor_status &&
+                        cpu.nz_result == idle_state.nz_result && reads_plain_memory_mos6502(bus, block)) {
+                        unsigned long long pass_cycles = cpu.cycles - idle_state.cycles;
+                        unsigned long long passes = (cycle_limit - cpu.cycles) / pass_cycles;
+                        if (budget->instruction_limit != 0) {
+                            // The instructions of this slice are counted when it ends, so they are left out here
+                            unsigned long long instructions_left = budget->instruction_limit - instructions - slice;
+                            if (instructions_left / block->instruction_count < passes) {
+                                passes = instructions_left / block->instruction_count;
+                            }
+                        }
+                        if (passes != 0) {
+                            cpu.cycles += passes * pass_cycles;
+                            instructions += passes * block->instruction_count;
+                            cache->idle_loops_skipped++;
+                            cache->idle_cycles_skipped += passes * pass_cycles;
+                        }
+                    }
+                    idle_block = block;
+                    idle_state = cpu;
+                } else {
+                    idle_block = NULL;
+                }
+#endif
+
+#if MOS_6502_JIT
+                // Run hot blocks natively when the whole block fits in the budget, whatever the native code left undone
+                // is finished from the records. Traced, profiled and covered runs stay on the records so that every
+                // instruction is recorded and counted.
+                if (cache->jit != NULL && cache->jit->enabled && !TRACING() && !PROFILING() && !COVERING()) {
+                    // Native code from before the arena was last emptied is gone, the block is compiled again once hot
+                    if (block->native != NULL && block->native_generation != cache->jit->generation) {
+                        block->native = NULL;
+                        block->execution_count = 0;
+                    }
+                    if (block->native == NULL && ++block->execution_count == cache->jit->hot_threshold) {
+                        compile_block_jit_mos6502(cache->jit, block);
+                    }
+#if MOS_6502_CYCLE_COUNTING
+                    if (block->native != NULL && remaining >= block->instruction_count && cpu.cycles + block->native_max_cycles <= cycle_limit) {
+#else
+                    if (block->native != NULL && remaining >= block->instruction_count) {
+#endif
+                        unsigned int executed = run_native_jit_mos6502(cache->jit, &cpu, bus, block);
+                        remaining -= executed;
+                        instruction += executed;
+                        continue;
+                    }
+                }
+#endif
+            }
+
+#if MOS_6502_COMPUTED_GOTO
+
+// Runs the next record of the block straight away while the block and the budget last
+#define DISPATCH() \
+            if (instruction == last || remaining == 0 || CYCLE_BUDGET_USED()) { \
+                continue; \
+            } \
+            remaining--; \
+            goto *dispatch_table[instruction->opcode]
+
+// Code for a single opcode, with the operand taken from the decoded record
+#define OPCODE_BLOCK(code, mnemonic, handler, mode, length, base_cycles) \
+        cached_opcode_##code: \
+            PROFILE_START(cpu.program_counter); \
+            TRACE_INSTRUCTION(cpu.program_counter, code, instruction->operand); \
+            cpu.program_counter += length; \
+            ADD_CYCLES(&cpu, base_cycles); \
+            execute_##handler(bus, &cpu, mode, instruction->operand); \
+            PROFILE_END(code, base_cycles); \
+            COVER_EDGE(code, mode); \
+            instruction++; \
+            if (code == BRK_IMPLIED) { \
+                status = RUN_BREAK; \
+                goto slice_done; \
+            } \
+            CHECK_CODE_CHANGES(); \
+            DISPATCH();
+
+            DISPATCH();
+            MOS_6502_OPCODE_TABLE(OPCODE_BLOCK)
+
+#undef OPCODE_BLOCK
+#undef DISPATCH
+
+#else
+
+// Code for a single opcode, with the operand taken from the decoded record
+#define OPCODE_CASE(code, mnemonic, handler, mode, length, base_cycles) \
+                case code: { \
+                    PROFILE_START(cpu.program_counter); \
+                    TRACE_INSTRUCTION(cpu.program_counter, code, instruction->operand); \
+                    cpu.program_counter += length; \
+                    ADD_CYCLES(&cpu, base_cycles); \
+                    execute_##handler(bus, &cpu, mode, instruction->operand); \
+                    PROFILE_END(code, base_cycles); \
+                    COVER_EDGE(code, mode); \
+                    instruction++; \
+                    if (code == BRK_IMPLIED) { \
+                        status = RUN_BREAK; \
+                        goto slice_done; \
+                    } \
+                    CHECK_CODE_CHANGES(); \
+                } break;
+
+            remaining--;
+            switch (instruction->opcode) {
+                MOS_6502_OPCODE_TABLE(OPCODE_CASE)
+            }
+
+#undef OPCODE_CASE
+
+#endif
+        }
+
+    slice_done:
+        instructions += slice - remaining;
+        if (status != RUN_BUDGET_EXHAUSTED || remaining != 0) {
+            goto done;
+        }
+    }
+
+done:
+    store_cpu_state(&cpu, registers);
+    budget->instructions_executed = instructions;
+#if MOS_6502_PROFILE
+    if (profile != NULL) {
+        profile->page_crossings += cpu.page_crossings;
+        profile->branch_page_crossings += cpu.branch_page_crossings;
+    }
+#endif
+#if MOS_6502_CYCLE_COUNTING
+    budget->cycles_executed = cpu.cycles - start_cycles;
+#else
+    budget->cycles_executed = 0;
+#endif
+#undef CHECK_CODE_CHANGES
+#undef CYCLE_BUDGET_USED
+    return status;
 }
 
 // -------------------------------------------------------------------------------------------------------------------------------
 // Fetch instruction and increment program counter
-//   Inputs: Memory, Registers
+//   Inputs: Memory Bus, Registers
 // -------------------------------------------------------------------------------------------------------------------------------
-static unsigned char fetch(unsigned char *memory, t_registers *registers) {
-    unsigned char instruction = memory[registers->program_counter];
-    registers->program_counter++;
+static inline unsigned char fetch(t_memory_bus *bus, t_cpu_state *cpu) {
+    unsigned char instruction = read_bus_mos6502(bus, cpu->program_counter);
+    cpu->program_counter++;
     return instruction;
 }
 
 // -------------------------------------------------------------------------------------------------------------------------------
-// Reads zero page in memory
-//   Inputs: Memory, Read Address
+// Fetch a little endian 16 bit operand and increment program counter
+//   Inputs: Memory Bus, Registers
 // -------------------------------------------------------------------------------------------------------------------------------
-static unsigned char read_memory(unsigned char *memory, t_registers *registers, unsigned short address, t_memory_access access_type) {
-        
+static inline unsigned short fetch_word(t_memory_bus *bus, t_cpu_state *cpu) {
+    unsigned short address_lsb = (unsigned short) fetch(bus, cpu);
+    unsigned short address_msb = (unsigned short) fetch(bus, cpu);
+    return (address_msb << 8) | address_lsb;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Fetch the operand bytes that follow an opcode, leaving the program counter on the next instruction
+//   Inputs: Memory Bus, Registers, Instruction Length
+//   Output: Operand, 0 for single byte instructions
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline unsigned short fetch_operand(t_memory_bus *bus, t_cpu_state *cpu, unsigned char length) {
+    if (length == 3) {
+        return fetch_word(bus, cpu);
+    }
+    if (length == 2) {
+        return fetch(bus, cpu);
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Calculates the memory address an operand points to. Reads through an indexed address take an extra cycle when indexing
+// crosses into the next page, stores and read-modify-write instructions always take it so it is already part of their base
+// cycles.
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand, Page Crossing Penalty
+//   Output: Effective address
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline unsigned short operand_address(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access access_type, unsigned short operand, int page_penalty) {
+
     switch (access_type) {
 
-        case ABSOLUTE:
         case ZERO_PAGE: {
-            return memory[address];
-        } break;
+            return operand;
+        }
 
         case ZERO_PAGE_X: {
-            address += (unsigned short) registers->register_x;
-            if (address > 255) {
-                // Need to wrap around if address ends up being greater than 255 so that we stay in the zero page
-                address -= 255;
-            }
-            return memory[address];
-        } break;
+            // Wrap around so that we stay in the zero page
+            return (unsigned char) (operand + cpu->register_x);
+        }
+
+        case ZERO_PAGE_Y: {
+            // Wrap around so that we stay in the zero page
+            return (unsigned char) (operand + cpu->register_y);
+        }
+
+        case ABSOLUTE: {
+            return operand;
+        }
 
         case ABSOLUTE_X: {
-            address += (unsigned short) registers->register_x;
-            return memory[address];
-        } break;
+            if (page_penalty) {
+                // Carry out of the low byte means the page was crossed
+                ADD_CYCLES(cpu, ((operand & 0x00FF) + cpu->register_x) >> 8);
+                COUNT_PAGE_CROSSINGS(cpu, page_crossings, ((operand & 0x00FF) + cpu->register_x) >> 8);
+            }
+            return (unsigned short) (operand + cpu->register_x);
+        }
 
         case ABSOLUTE_Y: {
-            address += (unsigned short) registers->register_y;
-            return memory[address];
-        } break;
+            if (page_penalty) {
+                ADD_CYCLES(cpu, ((operand & 0x00FF) + cpu->register_y) >> 8);
+                COUNT_PAGE_CROSSINGS(cpu, page_crossings, ((operand & 0x00FF) + cpu->register_y) >> 8);
+            }
+            return (unsigned short) (operand + cpu->register_y);
+        }
+
+        case INDIRECT: {
+            // The high byte of the pointer is not carried into the page, just like the real processor
+            unsigned short pointer_next = (operand & 0xFF00) | ((operand + 1) & 0x00FF);
+            return (read_bus_mos6502(bus, pointer_next) << 8) | read_bus_mos6502(bus, operand);
+        }
 
         case INDEXED_INDIRECT: {
-            // Calculate address of pointer 
-            address += (unsigned short) registers->register_x;
-            if (address > 255) {
-                // Need to wrap around if address ends up being greater than 255 so that we stay in the zero page
-                address -= 255;
-            }
+            // Calculate address of pointer, wrapping around so that we stay in the zero page
+            unsigned char pointer = operand + cpu->register_x;
             // Grab pointer
-            unsigned short pointer = (memory[address] << 8) + memory[address + 1];
-            // Grab data
-            return memory[pointer]; 
-        } break;
+            return (read_bus_mos6502(bus, (unsigned char) (pointer + 1)) << 8) | read_bus_mos6502(bus, pointer);
+        }
 
         case INDIRECT_INDEXED: {
-            // Grab pointer
-            unsigned short pointer = (memory[address] << 8) + memory[address + 1];
-            // Grab data
-            return memory[pointer + registers->register_y];
-        } break;
+            // Grab pointer from the zero page
+            unsigned char pointer = operand;
+            unsigned short base = (read_bus_mos6502(bus, (unsigned char) (pointer + 1)) << 8) | read_bus_mos6502(bus, pointer);
+            if (page_penalty) {
+                ADD_CYCLES(cpu, ((base & 0x00FF) + cpu->register_y) >> 8);
+                COUNT_PAGE_CROSSINGS(cpu, page_crossings, ((base & 0x00FF) + cpu->register_y) >> 8);
+            }
+            return (unsigned short) (base + cpu->register_y);
+        }
 
         default: {
-            printf("ERROR: Memory access type, %d, does not exist!!", access_type);
+            printf("ERROR: Memory access type, %d, has no address!!", access_type);
+            return 0;
         }
     }
 }
 
 // -------------------------------------------------------------------------------------------------------------------------------
-// Sets the Zero Flag in the Processor Status Register
-//   Inputs Register, Value
+// Reads memory, an immediate operand is the value itself
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
 // -------------------------------------------------------------------------------------------------------------------------------
-static void set_zero_flag(t_registers *registers, unsigned char value) {
-    if (value == 0) {
-        registers->processor_status.zero_flag = 1;
-    } else {
-        registers->processor_status.zero_flag = 0;
+static inline unsigned char read_memory(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access access_type, unsigned short operand) {
+    if (access_type == IMMEDIATE) {
+        return (unsigned char) operand;
     }
+    return read_bus_mos6502(bus, operand_address(bus, cpu, access_type, operand, 1));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes memory
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand, Value
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void write_memory(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access access_type, unsigned short operand, unsigned char value) {
+    write_bus_mos6502(bus, operand_address(bus, cpu, access_type, operand, 0), value);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Pushes a value onto the stack
+//   Inputs: Memory Bus, Registers, Value
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void push(t_memory_bus *bus, t_cpu_state *cpu, unsigned char value) {
+    write_bus_mos6502(bus, STACK_BASE_ADDR + cpu->stack_pointer, value);
+    cpu->stack_pointer--;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Pulls a value from the stack
+//   Inputs: Memory Bus, Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline unsigned char pull(t_memory_bus *bus, t_cpu_state *cpu) {
+    cpu->stack_pointer++;
+    return read_bus_mos6502(bus, STACK_BASE_ADDR + cpu->stack_pointer);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Sets the Negative and Zero Flags in the Processor Status Register. Nothing is worked out here, the result is just kept
+// until a branch or a status push needs the flags.
+//   Inputs: Registers, Result
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void set_nz_flags(t_cpu_state *cpu, unsigned short value) {
+    cpu->nz_result = value;
 }
 
 // -------------------------------------------------------------------------------------------------------------------------------
-// Sets the Negative Flag in the Processor Status Register
-//   Inputs: Registers, Value
+// Reads the Zero Flag from the last result
+//   Inputs: Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline int zero_flag(t_cpu_state *cpu) {
+    return (cpu->nz_result & 0x00FF) == 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads the Negative Flag from the last result
+//   Inputs: Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline int negative_flag(t_cpu_state *cpu) {
+    return (cpu->nz_result & 0x0180) != 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Sets the Carry Flag in the Processor Status Register
+//   Inputs: Registers, 16 bit version of the unsigned arithmetic result
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void set_carry_flag(t_cpu_state *cpu, unsigned short value) {
+    // Bit 8 is set when the result does not fit in 8 bits
+    cpu->processor_status = (cpu->processor_status & ~STATUS_CARRY) | ((value >> 8) & STATUS_CARRY);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Packs the processor status into a single byte (NV-BDIZC)
+//   Inputs: Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline unsigned char pack_status(t_cpu_state *cpu) {
+    return (cpu->processor_status & ~(STATUS_NEGATIVE | STATUS_ZERO)) |
+           nz_flag_table[cpu->nz_result & 0x00FF] |
+           ((cpu->nz_result >> 1) & STATUS_NEGATIVE);
+}
+
 // -------------------------------------------------------------------------------------------------------------------------------
-static void set_negative_flag(t_registers *registers, unsigned char value) {
-    if ((value >> 7) == 1) {
-        registers->processor_status.negative_flag = 1;
+// Unpacks the processor status from a single byte
+//   Inputs: Registers, Status Byte
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void unpack_status(t_cpu_state *cpu, unsigned char value) {
+    cpu->processor_status = value & ~STATUS_UNUSED;
+    // Bit 8 carries the negative flag and the low byte is non zero only when the zero flag is clear
+    cpu->nz_result = ((value & STATUS_NEGATIVE) << 1) | (~value & STATUS_ZERO);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Copies the registers into the state used while running
+//   Inputs: Running State, Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void load_cpu_state(t_cpu_state *cpu, t_registers *registers) {
+    cpu->program_counter = registers->program_counter;
+    cpu->cycles = registers->cycles;
+    cpu->stack_pointer = registers->stack_pointer;
+    cpu->accumulator = registers->accumulator;
+    cpu->register_x = registers->register_x;
+    cpu->register_y = registers->register_y;
+    unpack_status(cpu, registers->processor_status);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Copies the state used while running back into the registers
+//   Inputs: Running State, Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void store_cpu_state(t_cpu_state *cpu, t_registers *registers) {
+    registers->program_counter = cpu->program_counter;
+    registers->cycles = cpu->cycles;
+    registers->stack_pointer = cpu->stack_pointer;
+    registers->accumulator = cpu->accumulator;
+    registers->register_x = cpu->register_x;
+    registers->register_y = cpu->register_y;
+    registers->processor_status = pack_status(cpu);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load and store instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load Accumulator
+static inline void execute_lda(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->accumulator = read_memory(bus, cpu, mode, operand);
+    set_nz_flags(cpu, cpu->accumulator);
+}
+
+// Load X Register
+static inline void execute_ldx(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_x = read_memory(bus, cpu, mode, operand);
+    set_nz_flags(cpu, cpu->register_x);
+}
+
+// Load Y Register
+static inline void execute_ldy(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_y = read_memory(bus, cpu, mode, operand);
+    set_nz_flags(cpu, cpu->register_y);
+}
+
+// Store Accumulator
+static inline void execute_sta(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    write_memory(bus, cpu, mode, operand, cpu->accumulator);
+}
+
+// Store X Register
+static inline void execute_stx(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    write_memory(bus, cpu, mode, operand, cpu->register_x);
+}
+
+// Store Y Register
+static inline void execute_sty(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    write_memory(bus, cpu, mode, operand, cpu->register_y);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Register transfer instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Transfer Accumulator To X
+static inline void execute_tax(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_x = cpu->accumulator;
+    set_nz_flags(cpu, cpu->register_x);
+}
+
+// Transfer Accumulator To Y
+static inline void execute_tay(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_y = cpu->accumulator;
+    set_nz_flags(cpu, cpu->register_y);
+}
+
+// Transfer X To Accumulator
+static inline void execute_txa(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->accumulator = cpu->register_x;
+    set_nz_flags(cpu, cpu->accumulator);
+}
+
+// Transfer Y To Accumulator
+static inline void execute_tya(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->accumulator = cpu->register_y;
+    set_nz_flags(cpu, cpu->accumulator);
+}
+
+// Transfer Stack Pointer To X
+static inline void execute_tsx(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_x = cpu->stack_pointer;
+    set_nz_flags(cpu, cpu->register_x);
+}
+
+// Transfer X To Stack Pointer, no flags are changed
+static inline void execute_txs(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->stack_pointer = cpu->register_x;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Stack instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Push Accumulator
+static inline void execute_pha(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    push(bus, cpu, cpu->accumulator);
+}
+
+// Push Processor Status, the break bit is always set in the pushed copy
+static inline void execute_php(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    push(bus, cpu, pack_status(cpu) | STATUS_BREAK_COMMAND | STATUS_UNUSED);
+}
+
+// Pull Accumulator
+static inline void execute_pla(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->accumulator = pull(bus, cpu);
+    set_nz_flags(cpu, cpu->accumulator);
+}
+
+// Pull Processor Status
+static inline void execute_plp(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unpack_status(cpu, pull(bus, cpu));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Logical instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Logical And
+static inline void execute_and(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->accumulator &= read_memory(bus, cpu, mode, operand);
+    set_nz_flags(cpu, cpu->accumulator);
+}
+
+// Exclusive Or
+static inline void execute_eor(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->accumulator ^= read_memory(bus, cpu, mode, operand);
+    set_nz_flags(cpu, cpu->accumulator);
+}
+
+// Logical Inclusive Or
+static inline void execute_ora(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->accumulator |= read_memory(bus, cpu, mode, operand);
+    set_nz_flags(cpu, cpu->accumulator);
+}
+
+// Bit Test, negative and overflow are copied from bits 7 and 6 of memory
+static inline void execute_bit(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unsigned char value = read_memory(bus, cpu, mode, operand);
+    cpu->processor_status = (cpu->processor_status & ~STATUS_OVERFLOW) | (value & STATUS_OVERFLOW);
+    // Bit 7 of memory goes in bit 8 so the zero flag only depends on the and
+    set_nz_flags(cpu, (cpu->accumulator & value) | ((value & STATUS_NEGATIVE) << 1));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Arithmetic instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Adds a value and the carry to the accumulator in binary
+static inline void add_with_carry(t_cpu_state *cpu, unsigned char value) {
+    unsigned short sum = cpu->accumulator + value + (cpu->processor_status & STATUS_CARRY);
+    // Overflow when both inputs have the same sign and the result has a different one
+    unsigned char overflow = (~(cpu->accumulator ^ value) & (cpu->accumulator ^ sum)) & 0x80;
+    cpu->processor_status = (cpu->processor_status & ~STATUS_OVERFLOW) | (overflow >> 1);
+    set_carry_flag(cpu, sum);
+    cpu->accumulator = (unsigned char) sum;
+    set_nz_flags(cpu, cpu->accumulator);
+}
+
+// Adds a value and the carry to the accumulator in decimal, as the NMOS 6502 does. Zero comes from the binary sum, negative
+// and overflow from the sum after the low digit is adjusted, and carry from the sum after both digits are. Invalid digits
+// give the same results as the real chip. Each adjust is a conditional move, so nothing here branches on the data.
+static inline void decimal_add_with_carry(t_cpu_state *cpu, unsigned char value) {
+    unsigned char accumulator = cpu->accumulator;
+    unsigned int carry = cpu->processor_status & STATUS_CARRY;
+    unsigned char binary = (unsigned char) (accumulator + value + carry);
+
+    unsigned int low = (accumulator & 0x0F) + (value & 0x0F) + carry;
+    low = (low >= 0x0A) ? ((low + 0x06) & 0x0F) + 0x10 : low;
+    unsigned int sum = (accumulator & 0xF0) + (value & 0xF0) + low;
+
+    unsigned char overflow = (~(accumulator ^ value) & (accumulator ^ sum)) & 0x80;
+    cpu->processor_status = (cpu->processor_status & ~STATUS_OVERFLOW) | (overflow >> 1);
+    // Negative goes in bit 8 and any non zero low byte clears zero, as unpack_status() does
+    cpu->nz_result = ((sum & 0x80) << 1) | ((binary != 0) << 1);
+
+    // The high digit can reach $1F before it is adjusted, so the carry is not just bit 8
+    sum = (sum >= 0xA0) ? sum + 0x60 : sum;
+    cpu->processor_status = (cpu->processor_status & ~STATUS_CARRY) | (sum > 0xFF);
+    cpu->accumulator = (unsigned char) sum;
+}
+
+// Subtracts a value and the borrow from the accumulator in decimal, as the NMOS 6502 does. The flags are the same as in
+// binary, only the accumulator is adjusted.
+static inline void decimal_subtract_with_borrow(t_cpu_state *cpu, unsigned char value) {
+    unsigned char accumulator = cpu->accumulator;
+    int borrow = (cpu->processor_status & STATUS_CARRY) ^ STATUS_CARRY;
+    add_with_carry(cpu, ~value);
+
+    int low = (accumulator & 0x0F) - (value & 0x0F) - borrow;
+    low = (low < 0) ? ((low - 0x06) & 0x0F) - 0x10 : low;
+    int difference = (accumulator & 0xF0) - (value & 0xF0) + low;
+    difference = (difference < 0) ? difference - 0x60 : difference;
+    cpu->accumulator = (unsigned char) difference;
+}
+
+// Add With Carry. The decimal flag rarely changes, so testing it costs a well predicted branch.
+static inline void execute_adc(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unsigned char value = read_memory(bus, cpu, mode, operand);
+    if (cpu->processor_status & STATUS_DECIMAL_MODE) {
+        decimal_add_with_carry(cpu, value);
+    } else {
+        add_with_carry(cpu, value);
+    }
+}
+
+// Subtract With Carry, which is an add of the inverted value in binary
+static inline void execute_sbc(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unsigned char value = read_memory(bus, cpu, mode, operand);
+    if (cpu->processor_status & STATUS_DECIMAL_MODE) {
+        decimal_subtract_with_borrow(cpu, value);
     } else {
-        registers->processor_status.negative_flag = 0;
+        add_with_carry(cpu, ~value);
     }
 }
 
+// Compares a register with a value
+static inline void compare(t_cpu_state *cpu, unsigned char reg, unsigned char value) {
+    // Carry is set when there is no borrow, which shows up in bit 8 of the difference
+    unsigned short difference = reg - value;
+    set_carry_flag(cpu, ~difference);
+    set_nz_flags(cpu, difference & 0xFF);
+}
+
+// Compare
+static inline void execute_cmp(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    compare(cpu, cpu->accumulator, read_memory(bus, cpu, mode, operand));
+}
+
+// Compare X Register
+static inline void execute_cpx(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    compare(cpu, cpu->register_x, read_memory(bus, cpu, mode, operand));
+}
+
+// Compare Y Register
+static inline void execute_cpy(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    compare(cpu, cpu->register_y, read_memory(bus, cpu, mode, operand));
+}
+
 // -------------------------------------------------------------------------------------------------------------------------------
-// Sets the Carry Flag in the Processor Status Register
-//   Inputs: Registers, 16 bit version of the arithmetic result
+// Increment and decrement instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Increment Memory
+static inline void execute_inc(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unsigned short address = operand_address(bus, cpu, mode, operand, 0);
+    unsigned char value = read_bus_mos6502(bus, address) + 1;
+    write_bus_mos6502(bus, address, value);
+    set_nz_flags(cpu, value);
+}
+
+// Increment X Register
+static inline void execute_inx(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_x++;
+    set_nz_flags(cpu, cpu->register_x);
+}
+
+// Increment Y Register
+static inline void execute_iny(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_y++;
+    set_nz_flags(cpu, cpu->register_y);
+}
+
+// Decrement Memory
+static inline void execute_dec(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unsigned short address = operand_address(bus, cpu, mode, operand, 0);
+    unsigned char value = read_bus_mos6502(bus, address) - 1;
+    write_bus_mos6502(bus, address, value);
+    set_nz_flags(cpu, value);
+}
+
+// Decrement X Register
+static inline void execute_dex(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_x--;
+    set_nz_flags(cpu, cpu->register_x);
+}
+
+// Decrement Y Register
+static inline void execute_dey(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->register_y--;
+    set_nz_flags(cpu, cpu->register_y);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Shift instructions, which work on either the accumulator or memory
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
 // -------------------------------------------------------------------------------------------------------------------------------
-static void set_carry_flag(t_registers *registers, short value) {
-    if (value > 127 || value < -128) {
-        // Outside range of signed 8 bit value. Therefore, carry flag needs to be set.
-        registers->processor_status.carry_flag = 1; 
+// Shifts a value left, bit 7 goes into the carry
+static inline unsigned char shift_left(t_cpu_state *cpu, unsigned char value) {
+    set_carry_flag(cpu, value << 1);
+    value <<= 1;
+    set_nz_flags(cpu, value);
+    return value;
+}
+
+// Shifts a value right, bit 0 goes into the carry
+static inline unsigned char shift_right(t_cpu_state *cpu, unsigned char value) {
+    set_carry_flag(cpu, value << 8);
+    value >>= 1;
+    set_nz_flags(cpu, value);
+    return value;
+}
+
+// Rotates a value left through the carry
+static inline unsigned char rotate_left(t_cpu_state *cpu, unsigned char value) {
+    unsigned char carry_in = cpu->processor_status & STATUS_CARRY;
+    set_carry_flag(cpu, value << 1);
+    value = (value << 1) | carry_in;
+    set_nz_flags(cpu, value);
+    return value;
+}
+
+// Rotates a value right through the carry
+static inline unsigned char rotate_right(t_cpu_state *cpu, unsigned char value) {
+    unsigned char carry_in = cpu->processor_status & STATUS_CARRY;
+    set_carry_flag(cpu, value << 8);
+    value = (value >> 1) | (carry_in << 7);
+    set_nz_flags(cpu, value);
+    return value;
+}
+
+// Arithmetic Shift Left
+static inline void execute_asl(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    if (mode == ACCUMULATOR) {
+        cpu->accumulator = shift_left(cpu, cpu->accumulator);
     } else {
-        registers->processor_status.carry_flag = 0;
+        unsigned short address = operand_address(bus, cpu, mode, operand, 0);
+        write_bus_mos6502(bus, address, shift_left(cpu, read_bus_mos6502(bus, address)));
     }
-}
\ No newline at end of file
+}
+
+// Logical Shift Right
+static inline void execute_lsr(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    if (mode == ACCUMULATOR) {
+        cpu->accumulator = shift_right(cpu, cpu->accumulator);
+    } else {
+        unsigned short address = operand_address(bus, cpu, mode, operand, 0);
+        write_bus_mos6502(bus, address, shift_right(cpu, read_bus_mos6502(bus, address)));
+    }
+}
+
+// Rotate Left
+static inline void execute_rol(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    if (mode == ACCUMULATOR) {
+        cpu->accumulator = rotate_left(cpu, cpu->accumulator);
+    } else {
+        unsigned short address = operand_address(bus, cpu, mode, operand, 0);
+        write_bus_mos6502(bus, address, rotate_left(cpu, read_bus_mos6502(bus, address)));
+    }
+}
+
+// Rotate Right
+static inline void execute_ror(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    if (mode == ACCUMULATOR) {
+        cpu->accumulator = rotate_right(cpu, cpu->accumulator);
+    } else {
+        unsigned short address = operand_address(bus, cpu, mode, operand, 0);
+        write_bus_mos6502(bus, address, rotate_right(cpu, read_bus_mos6502(bus, address)));
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Jump and call instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Jump
+static inline void execute_jmp(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->program_counter = operand_address(bus, cpu, mode, operand, 0);
+}
+
+// Jump To Subroutine, the address pushed is the last byte of the JSR instruction
+static inline void execute_jsr(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unsigned short return_address = cpu->program_counter - 1;
+    push(bus, cpu, return_address >> 8);
+    push(bus, cpu, return_address & 0xFF);
+    cpu->program_counter = operand;
+}
+
+// Return From Subroutine
+static inline void execute_rts(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unsigned short address_lsb = pull(bus, cpu);
+    unsigned short address_msb = pull(bus, cpu);
+    cpu->program_counter = ((address_msb << 8) | address_lsb) + 1;
+}
+
+// Force Interrupt, pushes the address after the padding byte and jumps through the interrupt request vector
+static inline void execute_brk(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unsigned short return_address = cpu->program_counter + 1;
+    push(bus, cpu, return_address >> 8);
+    push(bus, cpu, return_address & 0xFF);
+    push(bus, cpu, pack_status(cpu) | STATUS_BREAK_COMMAND | STATUS_UNUSED);
+    cpu->processor_status |= STATUS_INTERRUPT_DISABLE;
+    cpu->program_counter = (read_bus_mos6502(bus, INTERRUPT_REQUEST_2) << 8) | read_bus_mos6502(bus, INTERRUPT_REQUEST_1);
+}
+
+// Return From Interrupt
+static inline void execute_rti(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    unpack_status(cpu, pull(bus, cpu));
+    unsigned short address_lsb = pull(bus, cpu);
+    unsigned short address_msb = pull(bus, cpu);
+    cpu->program_counter = (address_msb << 8) | address_lsb;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Branch instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Adds the signed offset to the program counter when the condition is true. A taken branch costs one more cycle, and one
+// more again when the target is in a different page.
+static inline void branch(t_cpu_state *cpu, unsigned short operand, int condition) {
+    if (condition) {
+        unsigned short target = cpu->program_counter + (signed char) operand;
+        ADD_CYCLES(cpu, 1 + (((target ^ cpu->program_counter) >> 8) & 1));
+        COUNT_PAGE_CROSSINGS(cpu, branch_page_crossings, ((target ^ cpu->program_counter) >> 8) & 1);
+        cpu->program_counter = target;
+    }
+}
+
+// Branch If Carry Is Clear
+static inline void execute_bcc(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    branch(cpu, operand, !(cpu->processor_status & STATUS_CARRY));
+}
+
+// Branch If Carry Is Set
+static inline void execute_bcs(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    branch(cpu, operand, cpu->processor_status & STATUS_CARRY);
+}
+
+// Branch If Equal
+static inline void execute_beq(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    branch(cpu, operand, zero_flag(cpu));
+}
+
+// Branch If Not Equal
+static inline void execute_bne(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    branch(cpu, operand, !zero_flag(cpu));
+}
+
+// Branch If Minus
+static inline void execute_bmi(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    branch(cpu, operand, negative_flag(cpu));
+}
+
+// Branch If Positive
+static inline void execute_bpl(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    branch(cpu, operand, !negative_flag(cpu));
+}
+
+// Branch If Overflow Clear
+static inline void execute_bvc(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    branch(cpu, operand, !(cpu->processor_status & STATUS_OVERFLOW));
+}
+
+// Branch If Overflow Set
+static inline void execute_bvs(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    branch(cpu, operand, cpu->processor_status & STATUS_OVERFLOW);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Status flag instructions
+//   Inputs: Memory Bus, Registers, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+// Clear Carry Flag
+static inline void execute_clc(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->processor_status &= ~STATUS_CARRY;
+}
+
+// Clear Decimal Mode
+static inline void execute_cld(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->processor_status &= ~STATUS_DECIMAL_MODE;
+}
+
+// Clear Interrupt Disable
+static inline void execute_cli(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->processor_status &= ~STATUS_INTERRUPT_DISABLE;
+}
+
+// Clear Overflow Flag
+static inline void execute_clv(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->processor_status &= ~STATUS_OVERFLOW;
+}
+
+// Set Carry Flag
+static inline void execute_sec(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->processor_status |= STATUS_CARRY;
+}
+
+// Set Decimal Flag
+static inline void execute_sed(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->processor_status |= STATUS_DECIMAL_MODE;
+}
+
+// Set Interrupt Disable
+static inline void execute_sei(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+    cpu->processor_status |= STATUS_INTERRUPT_DISABLE;
+}
+
+// No Operation
+static inline void execute_nop(t_memory_bus *bus, t_cpu_state *cpu, t_memory_access mode, unsigned short operand) {
+}
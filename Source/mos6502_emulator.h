@@ -14,6 +14,12 @@
 #ifndef MOS_6502_EMULATOR_H
 #define MOS_6502_EMULATOR_H
 
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_memory_bus.h"
+
 // -------------------------------------------------------------------------------------------------------------------------------
 // Defines
 // -------------------------------------------------------------------------------------------------------------------------------
@@ -28,6 +34,9 @@
 #define INTERRUPT_REQUEST_1 0xFFFE
 #define INTERRUPT_REQUEST_2 0xFFFF
 
+// Clock cycles taken to enter an interrupt handler
+#define INTERRUPT_CYCLES 7
+
 // Stack Base Address
 #define STACK_BASE_ADDR 0x0100
 
@@ -37,19 +46,71 @@
 // Zero Page Memory Size
 #define ZERO_PAGE_SIZE 256
 
+// Processor Status Bits
+#define STATUS_CARRY             0x01
+#define STATUS_ZERO              0x02
+#define STATUS_INTERRUPT_DISABLE 0x04
+#define STATUS_DECIMAL_MODE      0x08
+#define STATUS_BREAK_COMMAND     0x10
+#define STATUS_UNUSED            0x20
+#define STATUS_OVERFLOW          0x40
+#define STATUS_NEGATIVE          0x80
+
+// Build every opcode's handler with its addressing mode folded in at compile time. Set to 0 to leave inlining to the
+// compiler, which gives smaller but slower code.
+#ifndef MOS_6502_SPECIALIZE_HANDLERS
+#define MOS_6502_SPECIALIZE_HANDLERS 1
+#endif
+
+// Count emulated clock cycles. Set to 0 for pure throughput runs, which also turns off the cycle budget of run_mos6502().
+#ifndef MOS_6502_CYCLE_COUNTING
+#define MOS_6502_CYCLE_COUNTING 1
+#endif
+
+// Let run_cached_mos6502() skip ahead through idle loops that wait for memory to change, straight to the end of the cycle
+// budget. Set to 0 to build it out, the block cache can also turn it off at run time. Needs cycle counting.
+#ifndef MOS_6502_SKIP_IDLE_LOOPS
+#define MOS_6502_SKIP_IDLE_LOOPS 1
+#endif
+
+// Store a trace record for every instruction into the trace ring of the budget. Set to 1 to build it in, when 0 the runners
+// do not even check for a ring.
+#ifndef MOS_6502_TRACE
+#define MOS_6502_TRACE 0
+#endif
+
+// Count every instruction into the profile of the budget. Set to 1 to build it in, when 0 the runners do not even check for a
+// profile.
+#ifndef MOS_6502_PROFILE
+#define MOS_6502_PROFILE 0
+#endif
+
+// Record an edge into the coverage of the budget after every control transfer. Set to 1 to build it in, when 0 the runners do
+// not even check for coverage.
+#ifndef MOS_6502_COVERAGE
+#define MOS_6502_COVERAGE 0
+#endif
+
+// Number of instructions run between checks of the stop flag in run_mos6502()
+#define RUN_SLICE_SIZE 4096
+
+// Number of entries in the opcode descriptor table
+#define OPCODE_TABLE_SIZE 256
+
+// Dispatch through a table of label addresses (computed goto) when the compiler supports it, otherwise use a switch
+#ifndef MOS_6502_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define MOS_6502_COMPUTED_GOTO 1
+#else
+#define MOS_6502_COMPUTED_GOTO 0
+#endif
+#endif
+
 // -------------------------------------------------------------------------------------------------------------------------------
 // Data Types
 // -------------------------------------------------------------------------------------------------------------------------------
-// Processor Status Bits
-typedef struct t_struct_processor_status {
-    unsigned char carry_flag : 1;
-    unsigned char zero_flag : 1;
-    unsigned char interrupt_disable : 1;
-    unsigned char decimal_mode : 1;
-    unsigned char break_command : 1;
-    unsigned char overflow_flag : 1;
-    unsigned char negative_flag : 1;
-} t_processor_status;
+// Processor Status Register, packed with the same bit layout as the real processor (NV-BDIZC)
+typedef unsigned char t_processor_status;
 
 // Registers Structure
 typedef struct t_struct_registers {
@@ -59,18 +120,94 @@ typedef struct t_struct_registers {
     unsigned char register_x;
     unsigned char register_y;
     t_processor_status processor_status;
+    // Clock cycles run since reset
+    unsigned long long cycles;
 } t_registers;
 
+// Addressing modes
+typedef enum {
+    ZERO_PAGE, 
+    ZERO_PAGE_X, 
+    ZERO_PAGE_Y,
+    ABSOLUTE,
+    ABSOLUTE_X,
+    ABSOLUTE_Y,
+    INDIRECT,
+    INDEXED_INDIRECT,
+    INDIRECT_INDEXED,
+    IMPLIED,
+    ACCUMULATOR,
+    IMMEDIATE,
+    RELATIVE
+} t_memory_access;
+
+// Executes one instruction whose opcode and operand bytes have already been fetched, with the program counter on the next
+// instruction. The operand is the byte or little endian word that follows the opcode. The processor state it works on is
+// private to the emulator.
+struct t_struct_cpu_state;
+typedef void (*t_opcode_handler)(t_memory_bus *, struct t_struct_cpu_state *, t_memory_access, unsigned short);
+
+// Description of a single opcode. Entries for opcodes that are not supported are all zero.
+typedef struct t_struct_opcode_descriptor {
+    const char *mnemonic;
+    t_memory_access addressing_mode;
+    unsigned char length;
+    unsigned char cycles;
+    t_opcode_handler handler;
+} t_opcode_descriptor;
+
+// Reasons for run_mos6502() returning to the host
+typedef enum {
+    RUN_BUDGET_EXHAUSTED,
+    RUN_BREAK,
+    RUN_UNSUPPORTED_OPCODE,
+    RUN_STOPPED,
+    RUN_BREAKPOINT
+} t_run_status;
+
+// Execution budget for run_mos6502(). A limit of 0 means that dimension is unlimited. The cycle limit is ignored when cycle
+// counting is compiled out.
+typedef struct t_struct_run_budget {
+    // Limits set by the host
+    unsigned long long instruction_limit;
+    unsigned long long cycle_limit;
+    // Set from another thread or a signal handler to make run_mos6502() return early
+    volatile int stop_requested;
+    // Amount of the budget used by the last call
+    unsigned long long instructions_executed;
+    unsigned long long cycles_executed;
+    // Ring to store a record of every instruction into when tracing is built in, NULL for none
+    struct t_struct_trace_ring *trace;
+    // Profile to count every instruction into when profiling is built in, NULL for none
+    struct t_struct_profile *profile;
+    // Debugger whose breakpoints stop the run, NULL for none. The run only checks for breakpoints while some are set.
+    struct t_struct_debugger *debugger;
+    // Edge coverage to record every control transfer into when coverage is built in, NULL for none
+    struct t_struct_coverage *coverage;
+} t_run_budget;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Opcode descriptor table, indexed by opcode
+extern const t_opcode_descriptor mos6502_opcode_table[OPCODE_TABLE_SIZE];
+
 // -------------------------------------------------------------------------------------------------------------------------------
 // Function Prototypes
 // -------------------------------------------------------------------------------------------------------------------------------
 // Reset MOS 6502
-extern void reset_mos6502(unsigned char *, t_registers *);
+extern void reset_mos6502(t_memory_bus *, t_registers *);
 
 // Print Registers
 extern void print_registers_mos6502(t_registers *);
 
 // Execute Instructions 
-extern void execute_mos6502(unsigned char *, t_registers *);
+extern void execute_mos6502(t_memory_bus *, t_registers *);
+
+// Run Instructions Until The Budget Is Used Up
+extern t_run_status run_mos6502(t_memory_bus *, t_registers *, t_run_budget *);
+
+// Enter The Interrupt Or Interrupt Request Handler
+extern int interrupt_mos6502(t_memory_bus *, t_registers *, int);
 
 #endif // MOS_6502_EMULATOR_H
\ No newline at end of file
@@ -0,0 +1,1184 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 JIT
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_jit.c
+//
+// Description:
+//   Compiles hot blocks of a block cache into x86-64 code. While native code runs RBX points at the processor state, RBP
+//   at the memory bus and R12 to R15 hold A, X, Y and the stack pointer, zero extended. The negative and zero flags are
+//   kept lazily in the processor state just like the interpreter does. Every memory access loads the fast path pointer of
+//   its page from the bus and leaves the native code when it is NULL, so no callbacks are ever made from native code.
+//   Leaving before an instruction stores its address as the program counter, adds the cycles of the instructions before it
+//   and returns how many of them ran.
+//
+//   The executable memory is only writable while a block is being compiled.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// Local
+#include "mos6502_opcode.h"
+#include "mos6502_cpu_state.h"
+#include "mos6502_jit.h"
+
+#if MOS_6502_JIT
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Host registers and what they hold while native code runs
+#define HOST_RAX 0
+#define HOST_RCX 1
+#define HOST_RDX 2
+#define HOST_RBX 3
+#define HOST_RSP 4
+#define HOST_RBP 5
+#define HOST_RSI 6
+#define HOST_RDI 7
+#define HOST_R12 12
+#define HOST_R13 13
+#define HOST_R14 14
+#define HOST_R15 15
+#define NO_INDEX -1
+
+#define REG_CPU     HOST_RBX
+#define REG_BUS     HOST_RBP
+#define REG_A       HOST_R12
+#define REG_X       HOST_R13
+#define REG_Y       HOST_R14
+#define REG_SP      HOST_R15
+#define REG_VALUE   HOST_RAX
+#define REG_ADDRESS HOST_RCX
+#define REG_PAGE    HOST_RDI
+#define REG_PENALTY HOST_RSI
+
+// Operand size of an emitted instruction
+#define EMIT_WIDE 0x01
+#define EMIT_WORD 0x02
+#define EMIT_BYTE 0x04
+
+// x86 opcodes, those above 0xFF are 0x0F escaped
+#define X86_ADD        0x01
+#define X86_OR_BYTE    0x08
+#define X86_OR         0x09
+#define X86_AND        0x21
+#define X86_SUB        0x29
+#define X86_XOR        0x31
+#define X86_TEST       0x85
+#define X86_STORE_BYTE 0x88
+#define X86_STORE      0x89
+#define X86_LOAD       0x8B
+#define X86_GROUP_1    0x81
+#define X86_GROUP_1_BYTE 0x80
+#define X86_GROUP_2    0xC1
+#define X86_GROUP_3    0xF7
+#define X86_GROUP_3_BYTE 0xF6
+#define X86_MOVE_IMMEDIATE 0xC7
+#define X86_MOVE_IMMEDIATE_BYTE 0xC6
+#define X86_ZERO_EXTEND_BYTE 0x0FB6
+#define X86_ZERO_EXTEND_WORD 0x0FB7
+#define X86_SET_CONDITION 0x0F90
+
+// ModRM digits of the immediate and shift groups
+#define DIGIT_ADD  0
+#define DIGIT_OR   1
+#define DIGIT_AND  4
+#define DIGIT_SUB  5
+#define DIGIT_XOR  6
+#define DIGIT_SHL  4
+#define DIGIT_SHR  5
+#define DIGIT_TEST 0
+#define DIGIT_NOT  2
+
+// Condition codes
+#define CONDITION_BELOW     0x2
+#define CONDITION_NOT_BELOW 0x3
+#define CONDITION_ZERO      0x4
+#define CONDITION_NOT_ZERO  0x5
+
+// Offsets of the processor state and bus fields used by native code
+#define CPU_FIELD(field) ((int) offsetof(t_cpu_state, field))
+#define BUS_FIELD(field) ((int) offsetof(t_memory_bus, field))
+
+// Most jumps to the exits in front of instructions in a single block
+#define JIT_MAX_EXIT_JUMPS (BLOCK_MAX_INSTRUCTIONS * 4)
+
+// Operation compiled for each instruction handler. Handlers mapped to JIT_INTERPRET end the native code and are run from
+// the decoded records.
+#define JIT_OPERATION_adc JIT_ADC
+#define JIT_OPERATION_and JIT_AND
+#define JIT_OPERATION_asl JIT_ASL
+#define JIT_OPERATION_bcc JIT_BRANCH
+#define JIT_OPERATION_bcs JIT_BRANCH
+#define JIT_OPERATION_beq JIT_BRANCH
+#define JIT_OPERATION_bit JIT_BIT
+#define JIT_OPERATION_bmi JIT_BRANCH
+#define JIT_OPERATION_bne JIT_BRANCH
+#define JIT_OPERATION_bpl JIT_BRANCH
+#define JIT_OPERATION_brk JIT_INTERPRET
+#define JIT_OPERATION_bvc JIT_BRANCH
+#define JIT_OPERATION_bvs JIT_BRANCH
+#define JIT_OPERATION_clc JIT_CLC
+#define JIT_OPERATION_cld JIT_CLD
+#define JIT_OPERATION_cli JIT_CLI
+#define JIT_OPERATION_clv JIT_CLV
+#define JIT_OPERATION_cmp JIT_CMP
+#define JIT_OPERATION_cpx JIT_CPX
+#define JIT_OPERATION_cpy JIT_CPY
+#define JIT_OPERATION_dec JIT_DEC
+#define JIT_OPERATION_dex JIT_DEX
+#define JIT_OPERATION_dey JIT_DEY
+#define JIT_OPERATION_eor JIT_EOR
+#define JIT_OPERATION_inc JIT_INC
+#define JIT_OPERATION_inx JIT_INX
+#define JIT_OPERATION_iny JIT_INY
+#define JIT_OPERATION_jmp JIT_JMP
+#define JIT_OPERATION_jsr JIT_JSR
+#define JIT_OPERATION_lda JIT_LDA
+#define JIT_OPERATION_ldx JIT_LDX
+#define JIT_OPERATION_ldy JIT_LDY
+#define JIT_OPERATION_lsr JIT_LSR
+#define JIT_OPERATION_nop JIT_NOP
+#define JIT_OPERATION_ora JIT_ORA
+#define JIT_OPERATION_pha JIT_PHA
+#define JIT_OPERATION_php JIT_PHP
+#define JIT_OPERATION_pla JIT_PLA
+#define JIT_OPERATION_plp JIT_PLP
+#define JIT_OPERATION_rol JIT_ROL
+#define JIT_OPERATION_ror JIT_ROR
+#define JIT_OPERATION_rti JIT_INTERPRET
+#define JIT_OPERATION_rts JIT_RTS
+#define JIT_OPERATION_sbc JIT_SBC
+#define JIT_OPERATION_sec JIT_SEC
+#define JIT_OPERATION_sed JIT_SED
+#define JIT_OPERATION_sei JIT_SEI
+#define JIT_OPERATION_sta JIT_STA
+#define JIT_OPERATION_stx JIT_STX
+#define JIT_OPERATION_sty JIT_STY
+#define JIT_OPERATION_tax JIT_TAX
+#define JIT_OPERATION_tay JIT_TAY
+#define JIT_OPERATION_tsx JIT_TSX
+#define JIT_OPERATION_txa JIT_TXA
+#define JIT_OPERATION_txs JIT_TXS
+#define JIT_OPERATION_tya JIT_TYA
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Operations native code is compiled for
+typedef enum {
+    JIT_INTERPRET = 0,
+    JIT_LDA, JIT_LDX, JIT_LDY,
+    JIT_STA, JIT_STX, JIT_STY,
+    JIT_ADC, JIT_SBC,
+    JIT_AND, JIT_ORA, JIT_EOR, JIT_BIT,
+    JIT_CMP, JIT_CPX, JIT_CPY,
+    JIT_INC, JIT_DEC, JIT_ASL, JIT_LSR, JIT_ROL, JIT_ROR,
+    JIT_INX, JIT_INY, JIT_DEX, JIT_DEY,
+    JIT_TAX, JIT_TAY, JIT_TXA, JIT_TYA, JIT_TSX, JIT_TXS,
+    JIT_CLC, JIT_SEC, JIT_CLD, JIT_SED, JIT_CLI, JIT_SEI, JIT_CLV,
+    JIT_PHA, JIT_PHP, JIT_PLA, JIT_PLP,
+    JIT_BRANCH, JIT_JMP, JIT_JSR, JIT_RTS,
+    JIT_NOP
+} t_jit_operation;
+
+// State of the compiler while it works through a block
+typedef struct t_struct_jit_compiler {
+    t_jit *jit;
+    unsigned char *position;
+    unsigned char *end;
+    int overflow;
+    // Instruction being compiled, with the address and the cycles before each instruction of the block
+    unsigned int index;
+    unsigned short addresses[BLOCK_MAX_INSTRUCTIONS + 1];
+    unsigned int cycles_before[BLOCK_MAX_INSTRUCTIONS + 1];
+    // Jumps to the exit in front of an instruction, patched once the exits have been emitted after the block
+    unsigned char *exit_jumps[JIT_MAX_EXIT_JUMPS];
+    unsigned char exit_instructions[JIT_MAX_EXIT_JUMPS];
+    unsigned int exit_jump_count;
+} t_jit_compiler;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Operation compiled for every opcode, unsupported opcodes never make it into a block
+#define OPERATION_ENTRY(code, mnemonic, handler, mode, length, base_cycles) [code] = JIT_OPERATION_##handler,
+static const unsigned char jit_operations[OPCODE_TABLE_SIZE] = {
+    MOS_6502_OPCODE_TABLE(OPERATION_ENTRY)
+};
+#undef OPERATION_ENTRY
+
+// Status flag tested by each group of branches, picked by the top two bits of the opcode
+static const unsigned char branch_flags[4] = { STATUS_NEGATIVE, STATUS_OVERFLOW, STATUS_CARRY, STATUS_ZERO };
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits the code shared by every block
+static void emit_entry_and_exit(t_jit_compiler *);
+
+// Compiles a single instruction
+static void compile_instruction(t_jit_compiler *, t_decoded_instruction *);
+static void compile_shift(t_jit_compiler *, t_jit_operation);
+
+// Checks whether an instruction always leaves the native code itself
+static int leaves_native_code(unsigned char);
+
+// Memory accesses
+static void emit_access(t_jit_compiler *, t_decoded_instruction *, t_memory_access, int, int, int);
+static void emit_page_pointer(t_jit_compiler *, int, int, int);
+static void emit_read_operand(t_jit_compiler *, t_decoded_instruction *, t_memory_access);
+static void emit_push(t_jit_compiler *, int);
+static void emit_pull(t_jit_compiler *, int);
+
+// Processor state updates
+static void emit_set_nz(t_jit_compiler *, int);
+static void emit_update_status(t_jit_compiler *, unsigned char, int);
+static void emit_pack_status(t_jit_compiler *);
+
+// Leaving native code
+static void emit_exit(t_jit_compiler *, int, unsigned int, unsigned int);
+static void emit_exit_jump(t_jit_compiler *, unsigned char);
+
+// Instruction encoding
+static void emit_byte(t_jit_compiler *, unsigned int);
+static void emit_u16(t_jit_compiler *, unsigned int);
+static void emit_u32(t_jit_compiler *, unsigned int);
+static void emit_opcode(t_jit_compiler *, int, unsigned int, int, int, int);
+static void emit_register(t_jit_compiler *, int, unsigned int, int, int);
+static void emit_memory(t_jit_compiler *, int, unsigned int, int, int, int, int, int);
+static void emit_push_register(t_jit_compiler *, int);
+static void emit_pop_register(t_jit_compiler *, int);
+static void emit_move(t_jit_compiler *, int, int);
+static void emit_alu(t_jit_compiler *, unsigned int, int, int);
+static void emit_alu_immediate(t_jit_compiler *, int, int, unsigned int);
+static void emit_shift(t_jit_compiler *, int, int, unsigned int);
+static void emit_zero_extend_byte(t_jit_compiler *, int, int);
+static void emit_zero_extend_word(t_jit_compiler *, int, int);
+static void emit_status_immediate(t_jit_compiler *, int, unsigned int);
+static void emit_load_immediate(t_jit_compiler *, int, unsigned int);
+static unsigned char *emit_jump_condition(t_jit_compiler *, unsigned char);
+static void patch_jump(t_jit_compiler *, unsigned char *, unsigned char *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize the JIT and map its executable memory. The JIT starts out enabled.
+//   Inputs: JIT
+//   Output: 0 on success, -1 if executable memory could not be mapped
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int init_jit_mos6502(t_jit *jit) {
+    t_jit_compiler compiler;
+
+    memset(jit, 0, sizeof(t_jit));
+    jit->hot_threshold = JIT_DEFAULT_HOT_THRESHOLD;
+
+    void *arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+        printf("Error: Could not map memory for the JIT!!\n");
+        return -1;
+    }
+    jit->arena = arena;
+
+    compiler.jit = jit;
+    compiler.position = jit->arena;
+    compiler.end = jit->arena + JIT_ARENA_SIZE;
+    compiler.overflow = 0;
+    emit_entry_and_exit(&compiler);
+    jit->block_code_start = (unsigned int) (compiler.position - jit->arena);
+    jit->arena_used = jit->block_code_start;
+
+    if (mprotect(jit->arena, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        printf("Error: Could not make the JIT memory executable!!\n");
+        free_jit_mos6502(jit);
+        return -1;
+    }
+    jit->enabled = 1;
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Unmap the executable memory. Blocks compiled by the JIT must not be run natively afterwards, so the JIT is detached from
+// its cache first.
+//   Inputs: JIT
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void free_jit_mos6502(t_jit *jit) {
+    if (jit->arena != NULL) {
+        munmap(jit->arena, JIT_ARENA_SIZE);
+    }
+    jit->arena = NULL;
+    jit->entry = NULL;
+    jit->enabled = 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Compile a block to native code. Compiling stops in front of the first instruction that is always interpreted, and a block
+// that starts with one is left without native code. When the arena is full it is emptied and the generation moves on,
+// which takes the native code away from every block compiled before.
+//   Inputs: JIT, Block
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void compile_block_jit_mos6502(t_jit *jit, t_cached_block *block) {
+    t_jit_compiler compiler;
+    unsigned int count = 0;
+    unsigned int max_cycles = 0;
+
+    if (jit->arena == NULL || jit_operations[block->instructions[0].opcode] == JIT_INTERPRET) {
+        return;
+    }
+
+    if (jit->arena_used + JIT_MAX_BLOCK_CODE > JIT_ARENA_SIZE) {
+        jit->arena_used = jit->block_code_start;
+        jit->generation++;
+        jit->arena_resets++;
+    }
+
+    // Addresses and cycles in front of every instruction, and how many of them can be compiled
+    compiler.addresses[0] = block->start_address;
+    compiler.cycles_before[0] = 0;
+    while (count < block->instruction_count && jit_operations[block->instructions[count].opcode] != JIT_INTERPRET) {
+        compiler.addresses[count + 1] = compiler.addresses[count] + block->instructions[count].length;
+        compiler.cycles_before[count + 1] = compiler.cycles_before[count] + block->instructions[count].cycles;
+        // Page crossings and taken branches add at most 2 cycles
+        max_cycles += block->instructions[count].cycles + 2;
+        count++;
+    }
+
+    if (mprotect(jit->arena, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        printf("Error: Could not make the JIT memory writable!!\n");
+        return;
+    }
+
+    compiler.jit = jit;
+    compiler.position = jit->arena + jit->arena_used;
+    compiler.end = compiler.position + JIT_MAX_BLOCK_CODE;
+    compiler.overflow = 0;
+    compiler.exit_jump_count = 0;
+    unsigned char *code = compiler.position;
+
+    for (compiler.index = 0; compiler.index < count; compiler.index++) {
+        compile_instruction(&compiler, &block->instructions[compiler.index]);
+    }
+
+    // Fall out of the end of the compiled instructions, unless the last one already left through a jump or branch
+    if (!leaves_native_code(block->instructions[count - 1].opcode)) {
+        emit_exit(&compiler, compiler.addresses[count], compiler.cycles_before[count], count);
+    }
+
+    // Exits in front of instructions, one per instruction that needs it
+    unsigned char *exits[BLOCK_MAX_INSTRUCTIONS] = { NULL };
+    for (unsigned int i = 0; i < compiler.exit_jump_count; i++) {
+        unsigned int index = compiler.exit_instructions[i];
+        if (exits[index] == NULL) {
+            exits[index] = compiler.position;
+            emit_exit(&compiler, compiler.addresses[index], compiler.cycles_before[index], index);
+        }
+        patch_jump(&compiler, compiler.exit_jumps[i], exits[index]);
+    }
+
+    if (!compiler.overflow) {
+        jit->arena_used += (unsigned int) (compiler.position - code);
+        block->native = code;
+        block->native_generation = jit->generation;
+        block->native_max_cycles = max_cycles;
+        jit->blocks_compiled++;
+    }
+
+    if (mprotect(jit->arena, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        printf("Error: Could not make the JIT memory executable!!\n");
+        block->native = NULL;
+        jit->enabled = 0;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits the entry code, which saves the host registers, loads the 6502 registers and jumps to the code of the block, and
+// the exit code every block jumps to with the number of instructions run in EAX
+//   Inputs: Compiler
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_entry_and_exit(t_jit_compiler *c) {
+    c->jit->entry = (t_jit_entry) (void *) c->position;
+    emit_push_register(c, HOST_RBX);
+    emit_push_register(c, HOST_RBP);
+    emit_push_register(c, HOST_R12);
+    emit_push_register(c, HOST_R13);
+    emit_push_register(c, HOST_R14);
+    emit_push_register(c, HOST_R15);
+    // Keep the stack aligned like the ABI wants, even though native code never calls out
+    emit_register(c, EMIT_WIDE, X86_GROUP_1, DIGIT_SUB, HOST_RSP);
+    emit_u32(c, 8);
+    emit_register(c, EMIT_WIDE, X86_STORE, HOST_RDI, REG_CPU);
+    emit_register(c, EMIT_WIDE, X86_STORE, HOST_RSI, REG_BUS);
+    emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_A, REG_CPU, NO_INDEX, 0, CPU_FIELD(accumulator));
+    emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_X, REG_CPU, NO_INDEX, 0, CPU_FIELD(register_x));
+    emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_Y, REG_CPU, NO_INDEX, 0, CPU_FIELD(register_y));
+    emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_SP, REG_CPU, NO_INDEX, 0, CPU_FIELD(stack_pointer));
+    emit_register(c, 0, 0xFF, 4, HOST_RDX);
+
+    c->jit->exit = c->position;
+    emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, REG_A, REG_CPU, NO_INDEX, 0, CPU_FIELD(accumulator));
+    emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, REG_X, REG_CPU, NO_INDEX, 0, CPU_FIELD(register_x));
+    emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, REG_Y, REG_CPU, NO_INDEX, 0, CPU_FIELD(register_y));
+    emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, REG_SP, REG_CPU, NO_INDEX, 0, CPU_FIELD(stack_pointer));
+    emit_register(c, EMIT_WIDE, X86_GROUP_1, DIGIT_ADD, HOST_RSP);
+    emit_u32(c, 8);
+    emit_pop_register(c, HOST_R15);
+    emit_pop_register(c, HOST_R14);
+    emit_pop_register(c, HOST_R13);
+    emit_pop_register(c, HOST_R12);
+    emit_pop_register(c, HOST_RBP);
+    emit_pop_register(c, HOST_RBX);
+    emit_byte(c, 0xC3);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Compiles a single instruction. Every check that can leave the native code comes before the first change to the processor
+// state or memory, so leaving always happens cleanly in front of the instruction.
+//   Inputs: Compiler, Decoded Instruction
+// -------------------------------------------------------------------------------------------------------------------------------
+static void compile_instruction(t_jit_compiler *c, t_decoded_instruction *instruction) {
+    t_jit_operation operation = (t_jit_operation) jit_operations[instruction->opcode];
+    t_memory_access mode = mos6502_opcode_table[instruction->opcode].addressing_mode;
+    unsigned short next_address = c->addresses[c->index + 1];
+    unsigned int next_cycles = c->cycles_before[c->index + 1];
+
+    switch (operation) {
+
+        case JIT_LDA:
+        case JIT_LDX:
+        case JIT_LDY: {
+            int target = (operation == JIT_LDA) ? REG_A : (operation == JIT_LDX) ? REG_X : REG_Y;
+            emit_read_operand(c, instruction, mode);
+            emit_move(c, target, REG_VALUE);
+            emit_set_nz(c, REG_VALUE);
+            break;
+        }
+
+        case JIT_STA:
+        case JIT_STX:
+        case JIT_STY: {
+            int source = (operation == JIT_STA) ? REG_A : (operation == JIT_STX) ? REG_X : REG_Y;
+            emit_access(c, instruction, mode, BUS_FIELD(write_pages), -1, 0);
+            emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, source, REG_PAGE, REG_ADDRESS, 0, 0);
+            break;
+        }
+
+        case JIT_AND:
+        case JIT_ORA:
+        case JIT_EOR: {
+            unsigned int opcode = (operation == JIT_AND) ? X86_AND : (operation == JIT_ORA) ? X86_OR : X86_XOR;
+            emit_read_operand(c, instruction, mode);
+            emit_alu(c, opcode, REG_A, REG_VALUE);
+            emit_set_nz(c, REG_A);
+            break;
+        }
+
+        case JIT_BIT: {
+            emit_read_operand(c, instruction, mode);
+            emit_move(c, HOST_RCX, REG_VALUE);
+            emit_alu_immediate(c, DIGIT_AND, HOST_RCX, STATUS_OVERFLOW);
+            emit_update_status(c, STATUS_OVERFLOW, HOST_RCX);
+            // Bit 7 of memory goes in bit 8 so the zero flag only depends on the and
+            emit_move(c, HOST_RCX, REG_VALUE);
+            emit_alu_immediate(c, DIGIT_AND, HOST_RCX, STATUS_NEGATIVE);
+            emit_shift(c, DIGIT_SHL, HOST_RCX, 1);
+            emit_alu(c, X86_AND, REG_VALUE, REG_A);
+            emit_alu(c, X86_OR, REG_VALUE, HOST_RCX);
+            emit_set_nz(c, REG_VALUE);
+            break;
+        }
+
+        case JIT_ADC:
+        case JIT_SBC: {
+            // Decimal mode is left to the interpreter
+            emit_memory(c, 0, X86_GROUP_3_BYTE, DIGIT_TEST, REG_CPU, NO_INDEX, 0, CPU_FIELD(processor_status));
+            emit_byte(c, STATUS_DECIMAL_MODE);
+            emit_exit_jump(c, CONDITION_NOT_ZERO);
+            emit_read_operand(c, instruction, mode);
+            if (operation == JIT_SBC) {
+                emit_alu_immediate(c, DIGIT_XOR, REG_VALUE, 0xFF);
+            }
+            // Sum in ECX
+            emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, HOST_RCX, REG_CPU, NO_INDEX, 0, CPU_FIELD(processor_status));
+            emit_alu_immediate(c, DIGIT_AND, HOST_RCX, STATUS_CARRY);
+            emit_alu(c, X86_ADD, HOST_RCX, REG_A);
+            emit_alu(c, X86_ADD, HOST_RCX, REG_VALUE);
+            // Overflow when both inputs have the same sign and the result has a different one
+            emit_move(c, HOST_RDX, REG_A);
+            emit_alu(c, X86_XOR, HOST_RDX, REG_VALUE);
+            emit_register(c, 0, X86_GROUP_3, DIGIT_NOT, HOST_RDX);
+            emit_move(c, HOST_RSI, REG_A);
+            emit_alu(c, X86_XOR, HOST_RSI, HOST_RCX);
+            emit_alu(c, X86_AND, HOST_RDX, HOST_RSI);
+            emit_alu_immediate(c, DIGIT_AND, HOST_RDX, 0x80);
+            emit_shift(c, DIGIT_SHR, HOST_RDX, 1);
+            // Carry out of bit 7
+            emit_move(c, REG_VALUE, HOST_RCX);
+            emit_shift(c, DIGIT_SHR, REG_VALUE, 8);
+            emit_alu(c, X86_OR, HOST_RDX, REG_VALUE);
+            emit_update_status(c, STATUS_OVERFLOW | STATUS_CARRY, HOST_RDX);
+            emit_zero_extend_byte(c, REG_A, HOST_RCX);
+            emit_set_nz(c, REG_A);
+            break;
+        }
+
+        case JIT_CMP:
+        case JIT_CPX:
+        case JIT_CPY: {
+            int source = (operation == JIT_CMP) ? REG_A : (operation == JIT_CPX) ? REG_X : REG_Y;
+            emit_read_operand(c, instruction, mode);
+            // Carry is set when there is no borrow
+            emit_load_immediate(c, HOST_RDX, 0);
+            emit_move(c, HOST_RCX, source);
+            emit_alu(c, X86_SUB, HOST_RCX, REG_VALUE);
+            emit_register(c, EMIT_BYTE, X86_SET_CONDITION + CONDITION_NOT_BELOW, 0, HOST_RDX);
+            emit_zero_extend_byte(c, HOST_RCX, HOST_RCX);
+            emit_set_nz(c, HOST_RCX);
+            emit_update_status(c, STATUS_CARRY, HOST_RDX);
+            break;
+        }
+
+        case JIT_INC:
+        case JIT_DEC: {
+            emit_access(c, instruction, mode, BUS_FIELD(read_pages), BUS_FIELD(write_pages), 0);
+            emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_VALUE, REG_PAGE, REG_ADDRESS, 0, 0);
+            emit_alu_immediate(c, (operation == JIT_INC) ? DIGIT_ADD : DIGIT_SUB, REG_VALUE, 1);
+            emit_zero_extend_byte(c, REG_VALUE, REG_VALUE);
+            emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, REG_VALUE, HOST_RDX, REG_ADDRESS, 0, 0);
+            emit_set_nz(c, REG_VALUE);
+            break;
+        }
+
+        case JIT_ASL:
+        case JIT_LSR:
+        case JIT_ROL:
+        case JIT_ROR: {
+            if (mode == ACCUMULATOR) {
+                emit_move(c, REG_VALUE, REG_A);
+                compile_shift(c, operation);
+                emit_move(c, REG_A, REG_VALUE);
+            } else {
+                emit_access(c, instruction, mode, BUS_FIELD(read_pages), BUS_FIELD(write_pages), 0);
+                emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_VALUE, REG_PAGE, REG_ADDRESS, 0, 0);
+                // The shift needs ECX, so the write address is worked out first
+                emit_register(c, EMIT_WIDE, X86_ADD, REG_ADDRESS, HOST_RDX);
+                compile_shift(c, operation);
+                emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, REG_VALUE, HOST_RDX, NO_INDEX, 0, 0);
+            }
+            break;
+        }
+
+        case JIT_INX:
+        case JIT_INY:
+        case JIT_DEX:
+        case JIT_DEY: {
+            int target = (operation == JIT_INX || operation == JIT_DEX) ? REG_X : REG_Y;
+            emit_alu_immediate(c, (operation == JIT_INX || operation == JIT_INY) ? DIGIT_ADD : DIGIT_SUB, target, 1);
+            emit_zero_extend_byte(c, target, target);
+            emit_set_nz(c, target);
+            break;
+        }
+
+        case JIT_TAX: emit_move(c, REG_X, REG_A); emit_set_nz(c, REG_X); break;
+        case JIT_TAY: emit_move(c, REG_Y, REG_A); emit_set_nz(c, REG_Y); break;
+        case JIT_TXA: emit_move(c, REG_A, REG_X); emit_set_nz(c, REG_A); break;
+        case JIT_TYA: emit_move(c, REG_A, REG_Y); emit_set_nz(c, REG_A); break;
+        case JIT_TSX: emit_move(c, REG_X, REG_SP); emit_set_nz(c, REG_X); break;
+        case JIT_TXS: emit_move(c, REG_SP, REG_X); break;
+
+        case JIT_CLC: emit_status_immediate(c, DIGIT_AND, (unsigned char) ~STATUS_CARRY); break;
+        case JIT_CLD: emit_status_immediate(c, DIGIT_AND, (unsigned char) ~STATUS_DECIMAL_MODE); break;
+        case JIT_CLI: emit_status_immediate(c, DIGIT_AND, (unsigned char) ~STATUS_INTERRUPT_DISABLE); break;
+        case JIT_CLV: emit_status_immediate(c, DIGIT_AND, (unsigned char) ~STATUS_OVERFLOW); break;
+        case JIT_SEC: emit_status_immediate(c, DIGIT_OR, STATUS_CARRY); break;
+        case JIT_SED: emit_status_immediate(c, DIGIT_OR, STATUS_DECIMAL_MODE); break;
+        case JIT_SEI: emit_status_immediate(c, DIGIT_OR, STATUS_INTERRUPT_DISABLE); break;
+
+        case JIT_PHA: {
+            emit_page_pointer(c, REG_PAGE, BUS_FIELD(write_pages), STACK_BASE_ADDR >> 8);
+            emit_push(c, REG_A);
+            break;
+        }
+
+        case JIT_PHP: {
+            // The break bit is always set in the pushed copy
+            emit_page_pointer(c, REG_PAGE, BUS_FIELD(write_pages), STACK_BASE_ADDR >> 8);
+            emit_pack_status(c);
+            emit_alu_immediate(c, DIGIT_OR, REG_VALUE, STATUS_BREAK_COMMAND | STATUS_UNUSED);
+            emit_push(c, REG_VALUE);
+            break;
+        }
+
+        case JIT_PLA: {
+            emit_page_pointer(c, REG_PAGE, BUS_FIELD(read_pages), STACK_BASE_ADDR >> 8);
+            emit_pull(c, REG_A);
+            emit_set_nz(c, REG_A);
+            break;
+        }
+
+        case JIT_PLP: {
+            emit_page_pointer(c, REG_PAGE, BUS_FIELD(read_pages), STACK_BASE_ADDR >> 8);
+            emit_pull(c, REG_VALUE);
+            emit_move(c, HOST_RCX, REG_VALUE);
+            emit_alu_immediate(c, DIGIT_AND, HOST_RCX, (unsigned char) ~STATUS_UNUSED);
+            emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, HOST_RCX, REG_CPU, NO_INDEX, 0, CPU_FIELD(processor_status));
+            // Same as unpack_status() in mos6502_emulator.c
+            emit_move(c, HOST_RDX, REG_VALUE);
+            emit_alu_immediate(c, DIGIT_AND, HOST_RDX, STATUS_NEGATIVE);
+            emit_shift(c, DIGIT_SHL, HOST_RDX, 1);
+            emit_register(c, 0, X86_GROUP_3, DIGIT_NOT, REG_VALUE);
+            emit_alu_immediate(c, DIGIT_AND, REG_VALUE, STATUS_ZERO);
+            emit_alu(c, X86_OR, HOST_RDX, REG_VALUE);
+            emit_set_nz(c, HOST_RDX);
+            break;
+        }
+
+        case JIT_JMP: {
+            if (mode == INDIRECT) {
+                // The high byte of the pointer is not carried into the page, just like the real processor
+                emit_page_pointer(c, REG_PAGE, BUS_FIELD(read_pages), instruction->operand >> 8);
+                emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, HOST_RCX, REG_PAGE, NO_INDEX, 0, instruction->operand & 0xFF);
+                emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_VALUE, REG_PAGE, NO_INDEX, 0, (instruction->operand + 1) & 0xFF);
+                emit_shift(c, DIGIT_SHL, REG_VALUE, 8);
+                emit_alu(c, X86_OR, HOST_RCX, REG_VALUE);
+                emit_memory(c, EMIT_WORD, X86_STORE, HOST_RCX, REG_CPU, NO_INDEX, 0, CPU_FIELD(program_counter));
+                emit_exit(c, -1, next_cycles, c->index + 1);
+            } else {
+                emit_exit(c, instruction->operand, next_cycles, c->index + 1);
+            }
+            break;
+        }
+
+        case JIT_JSR: {
+            // The address pushed is the last byte of the JSR instruction
+            unsigned short return_address = next_address - 1;
+            emit_page_pointer(c, REG_PAGE, BUS_FIELD(write_pages), STACK_BASE_ADDR >> 8);
+            emit_memory(c, 0, X86_MOVE_IMMEDIATE_BYTE, 0, REG_PAGE, REG_SP, 0, 0);
+            emit_byte(c, return_address >> 8);
+            emit_alu_immediate(c, DIGIT_SUB, REG_SP, 1);
+            emit_zero_extend_byte(c, REG_SP, REG_SP);
+            emit_memory(c, 0, X86_MOVE_IMMEDIATE_BYTE, 0, REG_PAGE, REG_SP, 0, 0);
+            emit_byte(c, return_address & 0xFF);
+            emit_alu_immediate(c, DIGIT_SUB, REG_SP, 1);
+            emit_zero_extend_byte(c, REG_SP, REG_SP);
+            emit_exit(c, instruction->operand, next_cycles, c->index + 1);
+            break;
+        }
+
+        case JIT_RTS: {
+            emit_page_pointer(c, REG_PAGE, BUS_FIELD(read_pages), STACK_BASE_ADDR >> 8);
+            emit_pull(c, HOST_RCX);
+            emit_pull(c, REG_VALUE);
+            emit_shift(c, DIGIT_SHL, REG_VALUE, 8);
+            emit_alu(c, X86_OR, HOST_RCX, REG_VALUE);
+            emit_alu_immediate(c, DIGIT_ADD, HOST_RCX, 1);
+            emit_memory(c, EMIT_WORD, X86_STORE, HOST_RCX, REG_CPU, NO_INDEX, 0, CPU_FIELD(program_counter));
+            emit_exit(c, -1, next_cycles, c->index + 1);
+            break;
+        }
+
+        case JIT_BRANCH: {
+            // The top two bits of the opcode pick the flag and bit 5 whether the branch is taken when it is set
+            unsigned char flag = branch_flags[instruction->opcode >> 6];
+            int taken_when_set = (instruction->opcode & 0x20) != 0;
+            unsigned short target = next_address + (signed char) instruction->operand;
+            unsigned int taken_cycles = next_cycles + 1 + (((target ^ next_address) >> 8) & 1);
+            unsigned char flag_clear;
+
+            if (flag == STATUS_ZERO) {
+                emit_memory(c, 0, X86_GROUP_3_BYTE, DIGIT_TEST, REG_CPU, NO_INDEX, 0, CPU_FIELD(nz_result));
+                emit_byte(c, 0xFF);
+                flag_clear = CONDITION_NOT_ZERO;
+            } else if (flag == STATUS_NEGATIVE) {
+                emit_memory(c, EMIT_WORD, X86_GROUP_3, DIGIT_TEST, REG_CPU, NO_INDEX, 0, CPU_FIELD(nz_result));
+                emit_u16(c, 0x0180);
+                flag_clear = CONDITION_ZERO;
+            } else {
+                emit_memory(c, 0, X86_GROUP_3_BYTE, DIGIT_TEST, REG_CPU, NO_INDEX, 0, CPU_FIELD(processor_status));
+                emit_byte(c, flag);
+                flag_clear = CONDITION_ZERO;
+            }
+
+            // Condition codes come in pairs, flipping the low bit negates one
+            unsigned char *not_taken = emit_jump_condition(c, taken_when_set ? flag_clear : (flag_clear ^ 1));
+            emit_exit(c, target, taken_cycles, c->index + 1);
+            patch_jump(c, not_taken, c->position);
+            emit_exit(c, next_address, next_cycles, c->index + 1);
+            break;
+        }
+
+        case JIT_NOP:
+        case JIT_INTERPRET:
+        default: {
+            break;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Compiles a shift or rotate of the value in EAX, leaving the result in EAX and updating the carry and last result
+//   Inputs: Compiler, Operation
+// -------------------------------------------------------------------------------------------------------------------------------
+static void compile_shift(t_jit_compiler *c, t_jit_operation operation) {
+    int left = (operation == JIT_ASL || operation == JIT_ROL);
+
+    // Carry in, in ESI
+    if (operation == JIT_ROL || operation == JIT_ROR) {
+        emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, HOST_RSI, REG_CPU, NO_INDEX, 0, CPU_FIELD(processor_status));
+        emit_alu_immediate(c, DIGIT_AND, HOST_RSI, STATUS_CARRY);
+        if (!left) {
+            emit_shift(c, DIGIT_SHL, HOST_RSI, 7);
+        }
+    }
+
+    // Carry out, in ECX
+    emit_move(c, HOST_RCX, REG_VALUE);
+    if (left) {
+        emit_shift(c, DIGIT_SHR, HOST_RCX, 7);
+        emit_shift(c, DIGIT_SHL, REG_VALUE, 1);
+    } else {
+        emit_alu_immediate(c, DIGIT_AND, HOST_RCX, STATUS_CARRY);
+        emit_shift(c, DIGIT_SHR, REG_VALUE, 1);
+    }
+
+    if (operation == JIT_ROL || operation == JIT_ROR) {
+        emit_alu(c, X86_OR, REG_VALUE, HOST_RSI);
+    }
+    emit_zero_extend_byte(c, REG_VALUE, REG_VALUE);
+    emit_update_status(c, STATUS_CARRY, HOST_RCX);
+    emit_set_nz(c, REG_VALUE);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether an instruction always leaves the native code itself
+//   Inputs: Opcode
+//   Output: 1 for branches, jumps, calls and returns, 0 otherwise
+// -------------------------------------------------------------------------------------------------------------------------------
+static int leaves_native_code(unsigned char opcode) {
+    switch (jit_operations[opcode]) {
+        case JIT_BRANCH:
+        case JIT_JMP:
+        case JIT_JSR:
+        case JIT_RTS:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits the work out of the page and offset of a memory operand. Addresses known when compiling use their page pointer
+// directly, others look it up from the bus. Leaves the native code when a page pointer is NULL.
+//   Inputs: Compiler, Decoded Instruction, Addressing Mode, Page Table (offset in the bus), Second Page Table Loaded Into RDX
+//           (-1 for none), Page Crossing Penalty
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_access(t_jit_compiler *c, t_decoded_instruction *instruction, t_memory_access mode, int table, int second_table, int page_penalty) {
+    unsigned short operand = instruction->operand;
+
+#if !MOS_6502_CYCLE_COUNTING
+    page_penalty = 0;
+#endif
+
+    switch (mode) {
+
+        case ZERO_PAGE:
+        case ABSOLUTE: {
+            emit_page_pointer(c, REG_PAGE, table, operand >> 8);
+            if (second_table >= 0) {
+                emit_page_pointer(c, HOST_RDX, second_table, operand >> 8);
+            }
+            emit_load_immediate(c, REG_ADDRESS, operand & 0xFF);
+            return;
+        }
+
+        case ZERO_PAGE_X:
+        case ZERO_PAGE_Y: {
+            // Wrap around so that we stay in the zero page
+            emit_page_pointer(c, REG_PAGE, table, 0);
+            if (second_table >= 0) {
+                emit_page_pointer(c, HOST_RDX, second_table, 0);
+            }
+            emit_move(c, REG_ADDRESS, (mode == ZERO_PAGE_X) ? REG_X : REG_Y);
+            emit_alu_immediate(c, DIGIT_ADD, REG_ADDRESS, operand & 0xFF);
+            emit_zero_extend_byte(c, REG_ADDRESS, REG_ADDRESS);
+            return;
+        }
+
+        case ABSOLUTE_X:
+        case ABSOLUTE_Y: {
+            emit_move(c, REG_ADDRESS, (mode == ABSOLUTE_X) ? REG_X : REG_Y);
+            emit_alu_immediate(c, DIGIT_ADD, REG_ADDRESS, operand);
+            if (page_penalty) {
+                // The page moved on when indexing carried out of the low byte
+                emit_move(c, REG_PENALTY, REG_ADDRESS);
+                emit_shift(c, DIGIT_SHR, REG_PENALTY, 8);
+                emit_alu_immediate(c, DIGIT_SUB, REG_PENALTY, operand >> 8);
+            }
+            emit_zero_extend_word(c, REG_ADDRESS, REG_ADDRESS);
+            break;
+        }
+
+        case INDEXED_INDIRECT: {
+            // Pointer in the zero page, wrapping around so that we stay in it. There is no page crossing penalty.
+            page_penalty = 0;
+            emit_page_pointer(c, REG_PAGE, BUS_FIELD(read_pages), 0);
+            emit_move(c, REG_VALUE, REG_X);
+            emit_alu_immediate(c, DIGIT_ADD, REG_VALUE, operand & 0xFF);
+            emit_zero_extend_byte(c, REG_VALUE, REG_VALUE);
+            emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_ADDRESS, REG_PAGE, REG_VALUE, 0, 0);
+            emit_alu_immediate(c, DIGIT_ADD, REG_VALUE, 1);
+            emit_zero_extend_byte(c, REG_VALUE, REG_VALUE);
+            emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_VALUE, REG_PAGE, REG_VALUE, 0, 0);
+            emit_shift(c, DIGIT_SHL, REG_VALUE, 8);
+            emit_alu(c, X86_OR, REG_ADDRESS, REG_VALUE);
+            break;
+        }
+
+        case INDIRECT_INDEXED: {
+            emit_page_pointer(c, REG_PAGE, BUS_FIELD(read_pages), 0);
+            emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_ADDRESS, REG_PAGE, NO_INDEX, 0, operand & 0xFF);
+            emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_VALUE, REG_PAGE, NO_INDEX, 0, (operand + 1) & 0xFF);
+            emit_shift(c, DIGIT_SHL, REG_VALUE, 8);
+            emit_alu(c, X86_OR, REG_ADDRESS, REG_VALUE);
+            if (page_penalty) {
+                emit_move(c, REG_PENALTY, REG_ADDRESS);
+                emit_alu_immediate(c, DIGIT_AND, REG_PENALTY, 0xFF);
+                emit_alu(c, X86_ADD, REG_PENALTY, REG_Y);
+                emit_shift(c, DIGIT_SHR, REG_PENALTY, 8);
+            }
+            emit_alu(c, X86_ADD, REG_ADDRESS, REG_Y);
+            emit_zero_extend_word(c, REG_ADDRESS, REG_ADDRESS);
+            break;
+        }
+
+        default: {
+            printf("Error: Memory access type, %d, can not be compiled!!\n", mode);
+            c->overflow = 1;
+            return;
+        }
+    }
+
+    // Page number in EAX
+    emit_move(c, REG_VALUE, REG_ADDRESS);
+    emit_shift(c, DIGIT_SHR, REG_VALUE, 8);
+    emit_page_pointer(c, REG_PAGE, table, -1);
+    if (second_table >= 0) {
+        emit_page_pointer(c, HOST_RDX, second_table, -1);
+    }
+    emit_zero_extend_byte(c, REG_ADDRESS, REG_ADDRESS);
+
+#if MOS_6502_CYCLE_COUNTING
+    if (page_penalty) {
+        emit_memory(c, EMIT_WIDE, X86_ADD, REG_PENALTY, REG_CPU, NO_INDEX, 0, CPU_FIELD(cycles));
+    }
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits the load of a page pointer from the bus, leaving the native code when it is NULL
+//   Inputs: Compiler, Register To Load, Page Table (offset in the bus), Page Number (-1 for the page number in EAX)
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_page_pointer(t_jit_compiler *c, int target, int table, int page) {
+    if (page < 0) {
+        emit_memory(c, EMIT_WIDE, X86_LOAD, target, REG_BUS, REG_VALUE, 3, table);
+    } else {
+        emit_memory(c, EMIT_WIDE, X86_LOAD, target, REG_BUS, NO_INDEX, 0, table + page * (int) sizeof(unsigned char *));
+    }
+    emit_register(c, EMIT_WIDE, X86_TEST, target, target);
+    emit_exit_jump(c, CONDITION_ZERO);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits the read of an operand into EAX, an immediate operand is the value itself. Reads through an indexed address add the
+// page crossing penalty.
+//   Inputs: Compiler, Decoded Instruction, Addressing Mode
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_read_operand(t_jit_compiler *c, t_decoded_instruction *instruction, t_memory_access mode) {
+    if (mode == IMMEDIATE) {
+        emit_load_immediate(c, REG_VALUE, instruction->operand & 0xFF);
+        return;
+    }
+    emit_access(c, instruction, mode, BUS_FIELD(read_pages), -1, 1);
+    emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_VALUE, REG_PAGE, REG_ADDRESS, 0, 0);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits a push onto the stack, with the stack page pointer already in RDI
+//   Inputs: Compiler, Register Holding The Value
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_push(t_jit_compiler *c, int source) {
+    emit_memory(c, EMIT_BYTE, X86_STORE_BYTE, source, REG_PAGE, REG_SP, 0, 0);
+    emit_alu_immediate(c, DIGIT_SUB, REG_SP, 1);
+    emit_zero_extend_byte(c, REG_SP, REG_SP);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits a pull from the stack, with the stack page pointer already in RDI
+//   Inputs: Compiler, Register To Load
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_pull(t_jit_compiler *c, int target) {
+    emit_alu_immediate(c, DIGIT_ADD, REG_SP, 1);
+    emit_zero_extend_byte(c, REG_SP, REG_SP);
+    emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, target, REG_PAGE, REG_SP, 0, 0);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits keeping a result for the negative and zero flags
+//   Inputs: Compiler, Register Holding The Result
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_set_nz(t_jit_compiler *c, int source) {
+    emit_memory(c, EMIT_WORD, X86_STORE, source, REG_CPU, NO_INDEX, 0, CPU_FIELD(nz_result));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits replacing some status bits with the bits of a register, which must be clear outside the mask
+//   Inputs: Compiler, Status Bits, Register Holding The New Bits
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_update_status(t_jit_compiler *c, unsigned char mask, int source) {
+    emit_status_immediate(c, DIGIT_AND, (unsigned char) ~mask);
+    emit_memory(c, EMIT_BYTE, X86_OR_BYTE, source, REG_CPU, NO_INDEX, 0, CPU_FIELD(processor_status));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits an and or or of the status byte with a constant
+//   Inputs: Compiler, Group Digit, Constant
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_status_immediate(t_jit_compiler *c, int digit, unsigned int value) {
+    emit_memory(c, 0, X86_GROUP_1_BYTE, digit, REG_CPU, NO_INDEX, 0, CPU_FIELD(processor_status));
+    emit_byte(c, value);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits building the full status byte in EAX, same as pack_status() in mos6502_emulator.c
+//   Inputs: Compiler
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_pack_status(t_jit_compiler *c) {
+    emit_memory(c, 0, X86_ZERO_EXTEND_BYTE, REG_VALUE, REG_CPU, NO_INDEX, 0, CPU_FIELD(processor_status));
+    emit_alu_immediate(c, DIGIT_AND, REG_VALUE, (unsigned char) ~(STATUS_NEGATIVE | STATUS_ZERO));
+    // Zero when the low byte of the last result is 0
+    emit_load_immediate(c, HOST_RDX, 0);
+    emit_memory(c, 0, X86_GROUP_3_BYTE, DIGIT_TEST, REG_CPU, NO_INDEX, 0, CPU_FIELD(nz_result));
+    emit_byte(c, 0xFF);
+    emit_register(c, EMIT_BYTE, X86_SET_CONDITION + CONDITION_ZERO, 0, HOST_RDX);
+    emit_shift(c, DIGIT_SHL, HOST_RDX, 1);
+    emit_alu(c, X86_OR, REG_VALUE, HOST_RDX);
+    // Negative when bit 7 or bit 8 is set
+    emit_memory(c, 0, X86_ZERO_EXTEND_WORD, HOST_RDX, REG_CPU, NO_INDEX, 0, CPU_FIELD(nz_result));
+    emit_move(c, HOST_RSI, HOST_RDX);
+    emit_shift(c, DIGIT_SHR, HOST_RSI, 1);
+    emit_alu(c, X86_OR, HOST_RDX, HOST_RSI);
+    emit_alu_immediate(c, DIGIT_AND, HOST_RDX, STATUS_NEGATIVE);
+    emit_alu(c, X86_OR, REG_VALUE, HOST_RDX);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits leaving the native code
+//   Inputs: Compiler, Program Counter (-1 when already stored), Cycles To Add, Instructions Run
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_exit(t_jit_compiler *c, int program_counter, unsigned int cycles, unsigned int executed) {
+    if (program_counter >= 0) {
+        emit_memory(c, EMIT_WORD, X86_MOVE_IMMEDIATE, 0, REG_CPU, NO_INDEX, 0, CPU_FIELD(program_counter));
+        emit_u16(c, program_counter);
+    }
+#if MOS_6502_CYCLE_COUNTING
+    if (cycles != 0) {
+        emit_memory(c, EMIT_WIDE, X86_GROUP_1, DIGIT_ADD, REG_CPU, NO_INDEX, 0, CPU_FIELD(cycles));
+        emit_u32(c, cycles);
+    }
+#endif
+    emit_load_immediate(c, REG_VALUE, executed);
+    emit_byte(c, 0xE9);
+    emit_u32(c, 0);
+    patch_jump(c, c->position - 4, c->jit->exit);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits a conditional jump to the exit in front of the instruction being compiled
+//   Inputs: Compiler, Condition Code
+// -------------------------------------------------------------------------------------------------------------------------------
+static void emit_exit_jump(t_jit_compiler *c, unsigned char condition) {
+    unsigned char *jump = emit_jump_condition(c, condition);
+    if (c->exit_jump_count == JIT_MAX_EXIT_JUMPS) {
+        c->overflow = 1;
+        return;
+    }
+    c->exit_jumps[c->exit_jump_count] = jump;
+    c->exit_instructions[c->exit_jump_count] = c->index;
+    c->exit_jump_count++;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Instruction encoding. Registers are host register numbers, operations are 32 bits wide unless flagged otherwise.
+// -------------------------------------------------------------------------------------------------------------------------------
+// Emits a byte, flagging an overflow instead of writing past the end of the code
+static void emit_byte(t_jit_compiler *c, unsigned int value) {
+    if (c->position >= c->end) {
+        c->overflow = 1;
+        return;
+    }
+    *c->position++ = (unsigned char) value;
+}
+
+// Emits a 16 bit little endian value
+static void emit_u16(t_jit_compiler *c, unsigned int value) {
+    emit_byte(c, value);
+    emit_byte(c, value >> 8);
+}
+
+// Emits a 32 bit little endian value
+static void emit_u32(t_jit_compiler *c, unsigned int value) {
+    emit_u16(c, value);
+    emit_u16(c, value >> 16);
+}
+
+// Emits the prefixes and opcode bytes, with a REX prefix whenever a register above 7 or a low byte register is used
+static void emit_opcode(t_jit_compiler *c, int flags, unsigned int opcode, int reg, int index, int base) {
+    unsigned int rex = 0;
+
+    if (flags & EMIT_WORD) {
+        emit_byte(c, 0x66);
+    }
+    if (flags & EMIT_WIDE) {
+        rex |= 0x08;
+    }
+    if (reg & 8) {
+        rex |= 0x04;
+    }
+    if (index != NO_INDEX && (index & 8)) {
+        rex |= 0x02;
+    }
+    if (base & 8) {
+        rex |= 0x01;
+    }
+    // SPL, BPL, SIL and DIL need a REX prefix to not be read as AH, CH, DH and BH
+    if (rex != 0 || ((flags & EMIT_BYTE) && ((reg >= 4 && reg <= 7) || (base >= 4 && base <= 7)))) {
+        emit_byte(c, 0x40 | rex);
+    }
+    if (opcode > 0xFF) {
+        emit_byte(c, opcode >> 8);
+    }
+    emit_byte(c, opcode);
+}
+
+// Emits an instruction working on two registers
+static void emit_register(t_jit_compiler *c, int flags, unsigned int opcode, int reg, int rm) {
+    emit_opcode(c, flags, opcode, reg, NO_INDEX, rm);
+    emit_byte(c, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// Emits an instruction working on a register and [base + index * 2^scale + displacement]
+static void emit_memory(t_jit_compiler *c, int flags, unsigned int opcode, int reg, int base, int index, int scale, int displacement) {
+    emit_opcode(c, flags, opcode, reg, index, base);
+    if (index == NO_INDEX && (base & 7) != HOST_RSP) {
+        emit_byte(c, 0x80 | ((reg & 7) << 3) | (base & 7));
+    } else {
+        emit_byte(c, 0x84 | ((reg & 7) << 3));
+        emit_byte(c, (scale << 6) | ((((index == NO_INDEX) ? HOST_RSP : index) & 7) << 3) | (base & 7));
+    }
+    emit_u32(c, (unsigned int) displacement);
+}
+
+// Emits a push of a 64 bit register
+static void emit_push_register(t_jit_compiler *c, int reg) {
+    if (reg & 8) {
+        emit_byte(c, 0x41);
+    }
+    emit_byte(c, 0x50 + (reg & 7));
+}
+
+// Emits a pop of a 64 bit register
+static void emit_pop_register(t_jit_compiler *c, int reg) {
+    if (reg & 8) {
+        emit_byte(c, 0x41);
+    }
+    emit_byte(c, 0x58 + (reg & 7));
+}
+
+// Emits target = source
+static void emit_move(t_jit_compiler *c, int target, int source) {
+    emit_register(c, 0, X86_STORE, source, target);
+}
+
+// Emits target = target (operation) source
+static void emit_alu(t_jit_compiler *c, unsigned int opcode, int target, int source) {
+    emit_register(c, 0, opcode, source, target);
+}
+
+// Emits target = target (operation) constant
+static void emit_alu_immediate(t_jit_compiler *c, int digit, int target, unsigned int value) {
+    emit_register(c, 0, X86_GROUP_1, digit, target);
+    emit_u32(c, value);
+}
+
+// Emits a shift of a register by a constant
+static void emit_shift(t_jit_compiler *c, int digit, int target, unsigned int count) {
+    emit_register(c, 0, X86_GROUP_2, digit, target);
+    emit_byte(c, count);
+}
+
+// Emits target = low byte of source
+static void emit_zero_extend_byte(t_jit_compiler *c, int target, int source) {
+    emit_register(c, EMIT_BYTE, X86_ZERO_EXTEND_BYTE, target, source);
+}
+
+// Emits target = low word of source
+static void emit_zero_extend_word(t_jit_compiler *c, int target, int source) {
+    emit_register(c, 0, X86_ZERO_EXTEND_WORD, target, source);
+}
+
+// Emits target = constant, without touching the host flags
+static void emit_load_immediate(t_jit_compiler *c, int target, unsigned int value) {
+    if (target & 8) {
+        emit_byte(c, 0x41);
+    }
+    emit_byte(c, 0xB8 + (target & 7));
+    emit_u32(c, value);
+}
+
+// Emits a conditional jump to be patched later
+//   Output: Where the jump distance goes, NULL if the code overflowed
+static unsigned char *emit_jump_condition(t_jit_compiler *c, unsigned char condition) {
+    emit_byte(c, 0x0F);
+    emit_byte(c, 0x80 + condition);
+    emit_u32(c, 0);
+    return c->overflow ? NULL : c->position - 4;
+}
+
+// Points a jump emitted before at its target
+static void patch_jump(t_jit_compiler *c, unsigned char *jump, unsigned char *target) {
+    if (c->overflow || jump == NULL) {
+        return;
+    }
+    int distance = (int) (target - (jump + 4));
+    memcpy(jump, &distance, sizeof(distance));
+}
+
+#else
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// The JIT is not built for this host, hosts fall back on the block cache when init_jit_mos6502() fails
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int init_jit_mos6502(t_jit *jit) {
+    memset(jit, 0, sizeof(t_jit));
+    printf("Error: The JIT is not supported on this host!!\n");
+    return -1;
+}
+
+extern void free_jit_mos6502(t_jit *jit) {
+    jit->enabled = 0;
+}
+
+extern void compile_block_jit_mos6502(t_jit *jit, t_cached_block *block) {
+}
+
+#endif // MOS_6502_JIT
@@ -0,0 +1,116 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 JIT Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_jit.h
+//
+// Description:
+//   Contains the data types and function prototypes for the JIT, which compiles hot blocks of a block cache into x86-64
+//   code. A block is compiled once run_cached_mos6502() has entered it hot_threshold times, and from then on is run natively
+//   whenever the whole block fits in the budget. A and X, Y and the stack pointer live in host registers for the whole block.
+//
+//   Native code only ever touches RAM and ROM through the fast path pointers of the bus. An instruction that would need the
+//   slow path (device pages, write protected, tracked and code pages) or decimal mode leaves the native code before it is
+//   executed, and run_cached_mos6502() carries on from the decoded records. Self-modifying writes therefore always go
+//   through the same invalidation as the block cache.
+//
+//   Several block caches can share a JIT. When its arena fills up it is emptied and its generation moves on, which takes the
+//   native code away from the blocks of every cache using it. The arena is made writable while a block is compiled, so a JIT
+//   and the caches using it must only be run on one thread at a time, and each thread needs a JIT of its own.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_JIT_H
+#define MOS_6502_JIT_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_block_cache.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Build the JIT on hosts it can generate code for, elsewhere init_jit_mos6502() fails and only the block cache is used
+#ifndef MOS_6502_JIT
+#if defined(__x86_64__) && defined(__linux__)
+#define MOS_6502_JIT 1
+#else
+#define MOS_6502_JIT 0
+#endif
+#endif
+
+// Size of the executable memory for native code, it is emptied when full
+#define JIT_ARENA_SIZE (1024 * 1024)
+
+// Most native code a single block can compile to
+#define JIT_MAX_BLOCK_CODE 16384
+
+// Default number of times a block is entered before it is compiled
+#define JIT_DEFAULT_HOT_THRESHOLD 32
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Enters native code, given the processor state, memory bus and code of a block. Returns the number of instructions run.
+struct t_struct_cpu_state;
+typedef unsigned int (*t_jit_entry)(struct t_struct_cpu_state *, t_memory_bus *, void *);
+
+// JIT
+typedef struct t_struct_jit {
+    // Cleared by the host to go back to the decoded records, checked every time a block is entered
+    volatile int enabled;
+    // Times a block is entered before it is compiled
+    unsigned int hot_threshold;
+    // Executable memory, the entry and exit code shared by every block sits at the start
+    unsigned char *arena;
+    unsigned int arena_used;
+    unsigned int block_code_start;
+    t_jit_entry entry;
+    unsigned char *exit;
+    // Moves on every time the arena is emptied, native code compiled in an older generation is gone
+    unsigned int generation;
+    // Blocks compiled, and instructions and block runs done in native code
+    unsigned long long blocks_compiled;
+    unsigned long long native_instructions;
+    unsigned long long native_runs;
+    // Native runs that left before the end of the block, for a slow path access or decimal mode
+    unsigned long long side_exits;
+    // Times the arena filled up and was emptied
+    unsigned long long arena_resets;
+} t_jit;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize JIT And Map Its Executable Memory
+extern int init_jit_mos6502(t_jit *);
+
+// Unmap The Executable Memory
+extern void free_jit_mos6502(t_jit *);
+
+// Compile A Block
+extern void compile_block_jit_mos6502(t_jit *, t_cached_block *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Inline Functions
+// -------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs the native code of a block, which must be of the current generation of the JIT
+//   Inputs: JIT, Processor State, Memory Bus, Block
+//   Output: Number of instructions run, less than the block holds when the native code left early
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline unsigned int run_native_jit_mos6502(t_jit *jit, struct t_struct_cpu_state *cpu, t_memory_bus *bus, t_cached_block *block) {
+    unsigned int executed = jit->entry(cpu, bus, block->native);
+    jit->native_runs++;
+    jit->native_instructions += executed;
+    if (executed < block->instruction_count) {
+        jit->side_exits++;
+    }
+    return executed;
+}
+
+#endif // MOS_6502_JIT_H
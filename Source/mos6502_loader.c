@@ -0,0 +1,476 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Loader
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_loader.c
+//
+// Description:
+//   Loads raw binaries, Intel HEX files and segment files into a machine, maps and patches ROM images straight from their
+//   files and sets the vectors
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Local
+#include "mos6502_loader.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Intel HEX record types
+#define HEX_DATA                    0x00
+#define HEX_END_OF_FILE             0x01
+#define HEX_EXTENDED_SEGMENT        0x02
+#define HEX_START_SEGMENT           0x03
+#define HEX_EXTENDED_LINEAR         0x04
+#define HEX_START_LINEAR            0x05
+
+// Marker a segment file may start with, and may repeat before any segment
+#define SEGMENT_MARKER 0xFFFF
+
+// Where a segment file may store its entry point, the run address of an Atari executable
+#define SEGMENT_RUN_ADDRESS 0x02E0
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Maps a whole file to read it
+static const unsigned char *map_file(const char *, unsigned long long *);
+
+// Reads the hexadecimal digits of an Intel HEX record
+static int hex_digit(unsigned char);
+static int hex_byte(const unsigned char *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load a program, working out the format from the contents of the file. A file starting with ':' is Intel HEX, one
+// starting with an $FFFF marker is a segment file and anything else is a raw binary loaded at the given address.
+//   Inputs: Memory Bus, File Path, Load Address For Raw Binaries, Entry Point (filled in, may be NULL), Load Flags
+//   Output: 0 on success, -1 if the file could not be loaded
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int load_program_mos6502(t_memory_bus *bus, const char *path, unsigned short address, unsigned int *entry, unsigned int flags) {
+    unsigned char first_bytes[2] = { 0, 0 };
+    unsigned int program_entry = LOAD_NO_ENTRY;
+    int result;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: Could not open program %s!!\n", path);
+        return -1;
+    }
+    size_t length = fread(first_bytes, 1, sizeof(first_bytes), file);
+    fclose(file);
+
+    if (length >= 1 && first_bytes[0] == ':') {
+        result = load_intel_hex_mos6502(bus, path, &program_entry);
+    } else if (length == 2 && (first_bytes[0] | (first_bytes[1] << 8)) == SEGMENT_MARKER) {
+        result = load_segments_mos6502(bus, path, &program_entry);
+    } else {
+        result = load_binary_mos6502(bus, path, address, &program_entry);
+    }
+    if (result != 0) {
+        return result;
+    }
+
+    if ((flags & LOAD_SET_RESET_VECTOR) && program_entry != LOAD_NO_ENTRY) {
+        unsigned char vector[2] = { program_entry & 0xFF, program_entry >> 8 };
+        if (poke_memory_mos6502(bus, RESET_LOCATION_1, vector, sizeof(vector)) != 0) {
+            return -1;
+        }
+    }
+    if (entry != NULL) {
+        *entry = program_entry;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load a raw binary, whose entry point is its load address
+//   Inputs: Memory Bus, File Path, Load Address, Entry Point (filled in, may be NULL)
+//   Output: 0 on success, -1 if the file could not be loaded
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int load_binary_mos6502(t_memory_bus *bus, const char *path, unsigned short address, unsigned int *entry) {
+    unsigned long long size;
+
+    const unsigned char *data = map_file(path, &size);
+    if (data == NULL) {
+        return -1;
+    }
+    if (address + size > MOS_6502_MEM_SIZE) {
+        printf("Error: %s does not fit at $%04X!!\n", path, address);
+        munmap((void *) data, size);
+        return -1;
+    }
+
+    int result = poke_memory_mos6502(bus, address, data, (unsigned int) size);
+    munmap((void *) data, size);
+    if (result == 0 && entry != NULL) {
+        *entry = address;
+    }
+    return result;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load an Intel HEX file. Extended address records must keep every byte inside the 64 kB address space, and a start
+// address record gives the entry point.
+//   Inputs: Memory Bus, File Path, Entry Point (filled in, may be NULL)
+//   Output: 0 on success, -1 if the file could not be loaded
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int load_intel_hex_mos6502(t_memory_bus *bus, const char *path, unsigned int *entry) {
+    unsigned long long size;
+    unsigned long long base = 0;
+    unsigned int program_entry = LOAD_NO_ENTRY;
+    unsigned char record[255];
+    unsigned int line = 0;
+
+    const unsigned char *data = map_file(path, &size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    const unsigned char *next = data;
+    const unsigned char *end = data + size;
+    while (next < end) {
+        // Skip line endings and anything else between records
+        if (*next != ':') {
+            line += (*next == '\n');
+            next++;
+            continue;
+        }
+
+        // Start code, then byte count, address, record type, data and checksum as pairs of hex digits
+        int count = (end - next >= 3) ? hex_byte(next + 1) : -1;
+        if (count < 0 || end - next < 11 + 2 * count) {
+            printf("Error: Record on line %u of %s is cut short!!\n", line + 1, path);
+            munmap((void *) data, size);
+            return -1;
+        }
+        unsigned char checksum = 0;
+        for (int i = 0; i < count + 5; i++) {
+            int value = hex_byte(next + 1 + 2 * i);
+            if (value < 0) {
+                printf("Error: Record on line %u of %s is not hexadecimal!!\n", line + 1, path);
+                munmap((void *) data, size);
+                return -1;
+            }
+            checksum += value;
+            if (i >= 4 && i < count + 4) {
+                record[i - 4] = (unsigned char) value;
+            }
+        }
+        if (checksum != 0) {
+            printf("Error: Record on line %u of %s has a bad checksum!!\n", line + 1, path);
+            munmap((void *) data, size);
+            return -1;
+        }
+        unsigned int address = (hex_byte(next + 3) << 8) | hex_byte(next + 5);
+        int type = hex_byte(next + 7);
+        next += 11 + 2 * count;
+
+        switch (type) {
+            case HEX_DATA:
+                if (base + address + count > MOS_6502_MEM_SIZE) {
+                    printf("Error: Record on line %u of %s is outside the address space!!\n", line + 1, path);
+                    munmap((void *) data, size);
+                    return -1;
+                }
+                if (poke_memory_mos6502(bus, (unsigned short) (base + address), record, count) != 0) {
+                    munmap((void *) data, size);
+                    return -1;
+                }
+                break;
+
+            case HEX_EXTENDED_SEGMENT:
+                base = (count == 2) ? ((record[0] << 8) | record[1]) * 16ULL : 0;
+                break;
+
+            case HEX_EXTENDED_LINEAR:
+                base = (count == 2) ? ((unsigned long long) ((record[0] << 8) | record[1])) << 16 : 0;
+                break;
+
+            case HEX_START_SEGMENT:
+            case HEX_START_LINEAR:
+                // Only the low 16 bits mean anything to the 6502, the code segment or upper half is dropped
+                if (count == 4) {
+                    program_entry = (record[2] << 8) | record[3];
+                }
+                break;
+
+            case HEX_END_OF_FILE:
+                next = end;
+                break;
+
+            default:
+                printf("Error: Record on line %u of %s has unknown type %02X!!\n", line + 1, path, type);
+                munmap((void *) data, size);
+                return -1;
+        }
+    }
+
+    munmap((void *) data, size);
+    if (entry != NULL) {
+        *entry = program_entry;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load a segment file: blocks of a little endian start and end address (inclusive) followed by the data, each optionally
+// after an $FFFF marker. The entry point is the start of the first segment, unless a segment writes a run address at
+// $02E0.
+//   Inputs: Memory Bus, File Path, Entry Point (filled in, may be NULL)
+//   Output: 0 on success, -1 if the file could not be loaded
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int load_segments_mos6502(t_memory_bus *bus, const char *path, unsigned int *entry) {
+    unsigned long long size;
+    unsigned int program_entry = LOAD_NO_ENTRY;
+
+    const unsigned char *data = map_file(path, &size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    unsigned long long offset = 0;
+    while (offset < size) {
+        if (size - offset < 4) {
+            printf("Error: Segment header at offset %llu of %s is cut short!!\n", offset, path);
+            munmap((void *) data, size);
+            return -1;
+        }
+        unsigned int start = data[offset] | (data[offset + 1] << 8);
+        if (start == SEGMENT_MARKER) {
+            offset += 2;
+            continue;
+        }
+        unsigned int last = data[offset + 2] | (data[offset + 3] << 8);
+        unsigned int length = last - start + 1;
+        offset += 4;
+        if (last < start || size - offset < length) {
+            printf("Error: Segment $%04X-$%04X of %s is cut short!!\n", start, last, path);
+            munmap((void *) data, size);
+            return -1;
+        }
+        if (poke_memory_mos6502(bus, (unsigned short) start, &data[offset], length) != 0) {
+            munmap((void *) data, size);
+            return -1;
+        }
+
+        if (program_entry == LOAD_NO_ENTRY) {
+            program_entry = start;
+        }
+        if (start <= SEGMENT_RUN_ADDRESS && last >= SEGMENT_RUN_ADDRESS + 1) {
+            const unsigned char *run_address = &data[offset + SEGMENT_RUN_ADDRESS - start];
+            program_entry = run_address[0] | (run_address[1] << 8);
+        }
+        offset += length;
+    }
+
+    munmap((void *) data, size);
+    if (entry != NULL) {
+        *entry = program_entry;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Map a ROM image file into memory. The mapping is private, so the file is never changed.
+//   Inputs: ROM Image, File Path
+//   Output: 0 on success, -1 if the file could not be mapped
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int open_rom_image_mos6502(t_rom_image *image, const char *path) {
+    struct stat file_status;
+
+    memset(image, 0, sizeof(t_rom_image));
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        printf("Error: Could not open ROM image %s!!\n", path);
+        return -1;
+    }
+    if (fstat(file, &file_status) != 0 || file_status.st_size == 0 || file_status.st_size > MOS_6502_MEM_SIZE) {
+        printf("Error: ROM image %s must be between 1 byte and 64 kB!!\n", path);
+        close(file);
+        return -1;
+    }
+
+    // Round up to whole host pages, the end of the last page reads as zeros
+    unsigned long long host_page_size = (unsigned long long) sysconf(_SC_PAGESIZE);
+    image->size = (unsigned int) file_status.st_size;
+    image->mapped_size = (image->size + host_page_size - 1) / host_page_size * host_page_size;
+
+    void *map = mmap(NULL, image->mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED) {
+        printf("Error: Could not map ROM image %s!!\n", path);
+        memset(image, 0, sizeof(t_rom_image));
+        return -1;
+    }
+    image->data = map;
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Map a ROM image into a bus as write protected pages, without copying it. The image must start on a page boundary, and
+// a last page the image only partly fills reads as zeros past its end.
+//   Inputs: Memory Bus, ROM Image, Address
+//   Output: 0 on success, -1 if the image can not be mapped there
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int map_rom_image_mos6502(t_memory_bus *bus, t_rom_image *image, unsigned short address) {
+    unsigned int page_count = (image->size + MEMORY_PAGE_SIZE - 1) / MEMORY_PAGE_SIZE;
+
+    if (image->data == NULL || (address & 0x00FF) != 0 || address + image->size > MOS_6502_MEM_SIZE) {
+        printf("Error: ROM image can not be mapped at $%04X!!\n", address);
+        return -1;
+    }
+    map_memory_mos6502(bus, address >> 8, page_count, image->data, PAGE_WRITE_PROTECT);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Write bytes into a ROM image. Buses do not see the change, so the image must be patched before it is mapped into any.
+//   Inputs: ROM Image, Offset Into The Image, Bytes, Number Of Bytes
+//   Output: 0 on success, -1 if the bytes run past the end of the image
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int patch_rom_image_mos6502(t_rom_image *image, unsigned int offset, const unsigned char *bytes, unsigned int length) {
+    if (image->data == NULL || offset > image->size || length > image->size - offset) {
+        printf("Error: $%04X bytes at offset $%04X run past the end of the ROM image!!\n", length, offset);
+        return -1;
+    }
+    memcpy(&image->data[offset], bytes, length);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Unmap a ROM image. Every bus it is mapped into must have been unmapped or be finished with first.
+//   Inputs: ROM Image
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void close_rom_image_mos6502(t_rom_image *image) {
+    if (image->data != NULL) {
+        munmap(image->data, image->mapped_size);
+    }
+    memset(image, 0, sizeof(t_rom_image));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Write bytes into the RAM mapped at an address, the way the host loads a program rather than the way the processor stores.
+// Tracked pages written are marked dirty and code decoded from them is thrown away. ROM can not be written, as a ROM image
+// may be mapped into other buses that would not see their code change, so it is patched with patch_rom_image_mos6502().
+//   Inputs: Memory Bus, Address, Bytes, Number Of Bytes
+//   Output: 0 on success, -1 if part of the range has no RAM behind it, in which case nothing is written
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int poke_memory_mos6502(t_memory_bus *bus, unsigned short address, const unsigned char *bytes, unsigned int length) {
+    unsigned int next = address;
+
+    if (address + length > MOS_6502_MEM_SIZE) {
+        printf("Error: $%04X bytes at $%04X run past the end of memory!!\n", length, address);
+        return -1;
+    }
+
+    // Every page is checked first, so a range running into ROM or a device writes nothing
+    for (unsigned int page_number = address >> 8; length != 0 && page_number <= (address + length - 1) >> 8; page_number++) {
+        t_memory_page *page = &bus->pages[page_number];
+        if (page->data == NULL || (page->flags & PAGE_WRITE_PROTECT)) {
+            printf("Error: No RAM is mapped at $%02X00!!\n", page_number);
+            return -1;
+        }
+    }
+
+    while (length != 0) {
+        unsigned int page_number = next >> 8;
+        unsigned int offset = next & 0x00FF;
+        unsigned int chunk = MEMORY_PAGE_SIZE - offset;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(&bus->pages[page_number].data[offset], bytes, chunk);
+        mark_page_dirty_mos6502(bus, (unsigned char) page_number);
+        invalidate_code_page_mos6502(bus, (unsigned char) page_number);
+        next += chunk;
+        bytes += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Set the non maskable interrupt, reset and interrupt request vectors at the top of memory. A ROM over the vectors has them
+// patched into its image instead.
+//   Inputs: Memory Bus, Interrupt Handler, Reset Location, Interrupt Request Handler
+//   Output: 0 on success, -1 if there is no RAM at the vectors
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int set_vectors_mos6502(t_memory_bus *bus, unsigned short interrupt, unsigned short reset, unsigned short request) {
+    unsigned char vectors[6] = {
+        interrupt & 0xFF, interrupt >> 8,
+        reset & 0xFF, reset >> 8,
+        request & 0xFF, request >> 8
+    };
+    return poke_memory_mos6502(bus, INTERRUPT_HANDLER_1, vectors, sizeof(vectors));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Maps a whole file read only
+//   Inputs: File Path, Size (filled in)
+//   Output: Contents of the file, NULL if it could not be mapped or is empty
+// -------------------------------------------------------------------------------------------------------------------------------
+static const unsigned char *map_file(const char *path, unsigned long long *size) {
+    struct stat file_status;
+
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        printf("Error: Could not open program %s!!\n", path);
+        return NULL;
+    }
+    if (fstat(file, &file_status) != 0 || file_status.st_size == 0) {
+        printf("Error: Program %s is empty!!\n", path);
+        close(file);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, file_status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED) {
+        printf("Error: Could not map program %s!!\n", path);
+        return NULL;
+    }
+    *size = file_status.st_size;
+    return map;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Value of a hexadecimal digit
+//   Inputs: Character
+//   Output: Value, -1 if it is not a hexadecimal digit
+// -------------------------------------------------------------------------------------------------------------------------------
+static int hex_digit(unsigned char character) {
+    if (character >= '0' && character <= '9') {
+        return character - '0';
+    }
+    if (character >= 'A' && character <= 'F') {
+        return character - 'A' + 10;
+    }
+    if (character >= 'a' && character <= 'f') {
+        return character - 'a' + 10;
+    }
+    return -1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Value of a pair of hexadecimal digits
+//   Inputs: First Character
+//   Output: Value, -1 if either is not a hexadecimal digit
+// -------------------------------------------------------------------------------------------------------------------------------
+static int hex_byte(const unsigned char *characters) {
+    int high = hex_digit(characters[0]);
+    int low = hex_digit(characters[1]);
+    return (high < 0 || low < 0) ? -1 : (high << 4) | low;
+}
@@ -0,0 +1,78 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Loader Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_loader.h
+//
+// Description:
+//   Contains the data types and function prototypes for loading programs into a machine. Raw binaries, Intel HEX files and
+//   segment files (a run of start address, end address and data blocks, optionally after an $FFFF marker, as used by Atari
+//   executables) are copied into whatever RAM the bus has mapped, marking tracked pages dirty. Each loader returns the
+//   entry point its file gives, and can set the reset vector to it when that is in RAM.
+//
+//   A ROM image is mapped straight from its file instead of being copied. The file is mapped once and the same pages are
+//   handed to every bus that maps the image, so starting a machine with a large ROM costs a few page table entries. Writing
+//   the ROM through one bus would change it under every other bus without their decoded code being thrown away, so the
+//   loaders refuse write protected pages. The host patches the image itself before mapping it instead, which only copies
+//   the host page that is written.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_LOADER_H
+#define MOS_6502_LOADER_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Entry point of a file that does not give one
+#define LOAD_NO_ENTRY 0x10000
+
+// Set the reset vector to the entry point of the file, when it has one. Loading fails if the vector is in ROM.
+#define LOAD_SET_RESET_VECTOR 0x01
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// ROM image mapped from a file, shared by every bus it is mapped into
+typedef struct t_struct_rom_image {
+    // Contents of the file, padded with zeros to a whole number of host pages
+    unsigned char *data;
+    // Length of the file and of the mapping
+    unsigned int size;
+    unsigned long long mapped_size;
+} t_rom_image;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load A Raw Binary, An Intel HEX File Or A Segment File, Picked From Its Contents
+extern int load_program_mos6502(t_memory_bus *, const char *, unsigned short, unsigned int *, unsigned int);
+
+// Load Each Format
+extern int load_binary_mos6502(t_memory_bus *, const char *, unsigned short, unsigned int *);
+extern int load_intel_hex_mos6502(t_memory_bus *, const char *, unsigned int *);
+extern int load_segments_mos6502(t_memory_bus *, const char *, unsigned int *);
+
+// Map A ROM Image From A File Without Copying It
+extern int open_rom_image_mos6502(t_rom_image *, const char *);
+extern int map_rom_image_mos6502(t_memory_bus *, t_rom_image *, unsigned short);
+extern void close_rom_image_mos6502(t_rom_image *);
+
+// Patch A ROM Image Before It Is Mapped
+extern int patch_rom_image_mos6502(t_rom_image *, unsigned int, const unsigned char *, unsigned int);
+
+// Write Bytes Into Mapped RAM Without Going Through The Bus
+extern int poke_memory_mos6502(t_memory_bus *, unsigned short, const unsigned char *, unsigned int);
+
+// Set The Interrupt, Reset And Interrupt Request Vectors
+extern int set_vectors_mos6502(t_memory_bus *, unsigned short, unsigned short, unsigned short);
+
+#endif // MOS_6502_LOADER_H
@@ -0,0 +1,287 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Lockstep Checker
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_lockstep.c
+//
+// Description:
+//   Runs a candidate engine side by side with run_mos6502() and stops at the first point where the two machines differ
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <string.h>
+
+// Local
+#include "mos6502_lockstep.h"
+#include "mos6502_block_cache.h"
+#include "mos6502_trace.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Memory hashes
+static void hash_all_pages(t_lockstep_machine *, void *);
+static void hash_dirty_pages(t_lockstep_machine *);
+static unsigned long long hash_page(t_memory_bus *, unsigned int);
+
+// Comparisons
+static int machines_match(t_lockstep *);
+static int registers_match(const t_registers *, const t_registers *);
+static void print_machine(FILE *, const char *, t_lockstep_machine *);
+
+// Reads a byte straight from RAM or ROM, so that devices never see the read
+static unsigned char peek(t_memory_bus *, unsigned short);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Start a lockstep run of two machines. Both must already be in the same state, and their dirty page tracking is taken
+// over for the memory hashes.
+//   Inputs: Lockstep Run, Reference Bus, Reference Registers, Candidate Bus, Candidate Registers, Candidate Runner,
+//           Candidate Context
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void init_lockstep_mos6502(t_lockstep *lockstep, t_memory_bus *reference_bus, t_registers *reference_registers,
+                                  t_memory_bus *candidate_bus, t_registers *candidate_registers, t_lockstep_runner runner,
+                                  void *context) {
+    memset(lockstep, 0, sizeof(t_lockstep));
+    lockstep->reference.bus = reference_bus;
+    lockstep->reference.registers = reference_registers;
+    lockstep->candidate.bus = candidate_bus;
+    lockstep->candidate.registers = candidate_registers;
+    lockstep->candidate_runner = runner;
+    lockstep->candidate_context = context;
+    lockstep->check_interval = 1;
+
+    hash_all_pages(&lockstep->reference, lockstep);
+    hash_all_pages(&lockstep->candidate, lockstep);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Run both machines for a number of instructions, checking them against each other every check interval. Stops early
+// when they stop matching, or when both hit an unsupported opcode or are stopped. A BRK is checked and run through like
+// any other instruction.
+//   Inputs: Lockstep Run, Instructions To Run
+//   Output: 0 if the machines still match, -1 if they stopped matching
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int run_lockstep_mos6502(t_lockstep *lockstep, unsigned long long instruction_count) {
+    t_lockstep_machine *reference = &lockstep->reference;
+    t_lockstep_machine *candidate = &lockstep->candidate;
+    unsigned long long target = lockstep->instructions_checked + instruction_count;
+
+    if (lockstep->diverged) {
+        return -1;
+    }
+
+    while (lockstep->instructions_checked < target) {
+        t_run_budget reference_budget = { 0 };
+        t_run_budget candidate_budget = { 0 };
+        unsigned long long step = target - lockstep->instructions_checked;
+        if (lockstep->check_interval != 0 && step > lockstep->check_interval) {
+            step = lockstep->check_interval;
+        }
+
+        // Remember where the interval started for the report, without disturbing any device
+        unsigned short program_counter = reference->registers->program_counter;
+        lockstep->diverged_from = *reference->registers;
+        for (unsigned int i = 0; i < sizeof(lockstep->diverged_bytes); i++) {
+            lockstep->diverged_bytes[i] = peek(reference->bus, (unsigned short) (program_counter + i));
+        }
+
+        reference_budget.instruction_limit = step;
+        candidate_budget.instruction_limit = step;
+        reference->status = run_mos6502(reference->bus, reference->registers, &reference_budget);
+        candidate->status = lockstep->candidate_runner(lockstep->candidate_context, candidate->bus, candidate->registers,
+                                                       &candidate_budget);
+        reference->instructions_executed = reference_budget.instructions_executed;
+        reference->cycles_executed = reference_budget.cycles_executed;
+        candidate->instructions_executed = candidate_budget.instructions_executed;
+        candidate->cycles_executed = candidate_budget.cycles_executed;
+        hash_dirty_pages(reference);
+        hash_dirty_pages(candidate);
+
+        if (!machines_match(lockstep)) {
+            lockstep->diverged = 1;
+            return -1;
+        }
+        lockstep->instructions_checked += reference->instructions_executed;
+
+        if (reference->status == RUN_UNSUPPORTED_OPCODE || reference->status == RUN_STOPPED) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Print where the machines stopped matching: the instruction the interval started at, both machines after it and the first
+// byte of RAM that differs
+//   Inputs: Lockstep Run, Output File
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void print_divergence_mos6502(t_lockstep *lockstep, FILE *output) {
+    t_memory_bus *reference_bus = lockstep->reference.bus;
+    t_memory_bus *candidate_bus = lockstep->candidate.bus;
+    t_trace_record record;
+    unsigned int differences = 0;
+    unsigned int first_difference = 0;
+
+    if (!lockstep->diverged) {
+        fprintf(output, "Machines match after %llu instructions\n", lockstep->instructions_checked);
+        return;
+    }
+
+    fprintf(output, "Machines differ within %llu instructions of instruction %llu, which started at:\n",
+            lockstep->check_interval, lockstep->instructions_checked);
+    memset(&record, 0, sizeof(record));
+    record.program_counter = lockstep->diverged_from.program_counter;
+    record.opcode = lockstep->diverged_bytes[0];
+    record.operand = lockstep->diverged_bytes[1] | (lockstep->diverged_bytes[2] << 8);
+    record.accumulator = lockstep->diverged_from.accumulator;
+    record.register_x = lockstep->diverged_from.register_x;
+    record.register_y = lockstep->diverged_from.register_y;
+    record.stack_pointer = lockstep->diverged_from.stack_pointer;
+    record.processor_status = lockstep->diverged_from.processor_status;
+    print_trace_record_mos6502(output, &record, lockstep->diverged_from.cycles);
+
+    print_machine(output, "Reference", &lockstep->reference);
+    print_machine(output, "Candidate", &lockstep->candidate);
+
+    // Compare the RAM byte by byte, only done once so speed does not matter
+    for (unsigned int page = 0; page < MEMORY_PAGE_COUNT; page++) {
+        const unsigned char *reference_data = reference_bus->pages[page].data;
+        const unsigned char *candidate_data = candidate_bus->pages[page].data;
+        if (reference_data == NULL || candidate_data == NULL) {
+            continue;
+        }
+        for (unsigned int offset = 0; offset < MEMORY_PAGE_SIZE; offset++) {
+            if (reference_data[offset] != candidate_data[offset]) {
+                if (differences++ == 0) {
+                    first_difference = page * MEMORY_PAGE_SIZE + offset;
+                }
+            }
+        }
+    }
+    if (differences != 0) {
+        fprintf(output, "Memory: %u bytes differ, first at $%04X (reference $%02X, candidate $%02X)\n", differences,
+                first_difference, peek(reference_bus, first_difference), peek(candidate_bus, first_difference));
+    } else {
+        fprintf(output, "Memory: matches\n");
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Candidate runner for the block cache, with or without its JIT. The JIT only runs a block natively when the rest of the
+// block fits in the budget, so it needs a check interval longer than its blocks to be checked at all.
+//   Inputs: Block Cache, Memory Bus, Registers, Budget
+//   Output: Reason for returning
+// -------------------------------------------------------------------------------------------------------------------------------
+extern t_run_status run_cached_lockstep_mos6502(void *cache, t_memory_bus *bus, t_registers *registers, t_run_budget *budget) {
+    return run_cached_mos6502((t_block_cache *) cache, bus, registers, budget);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Hash every page of a machine and start tracking which pages are written
+//   Inputs: Machine, Owner Of The Dirty Page Tracking
+// -------------------------------------------------------------------------------------------------------------------------------
+static void hash_all_pages(t_lockstep_machine *machine, void *tracker) {
+    machine->memory_hash = 0;
+    for (unsigned int page = 0; page < MEMORY_PAGE_COUNT; page++) {
+        machine->page_hashes[page] = hash_page(machine->bus, page);
+        machine->memory_hash ^= machine->page_hashes[page];
+    }
+    track_dirty_pages_mos6502(machine->bus, tracker);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Hash the pages written since the last check again and mark them clean
+//   Inputs: Machine
+// -------------------------------------------------------------------------------------------------------------------------------
+static void hash_dirty_pages(t_lockstep_machine *machine) {
+    t_memory_bus *bus = machine->bus;
+
+    for (unsigned int word = 0; word < PAGE_BITMAP_WORDS; word++) {
+        unsigned long long dirty = bus->dirty_pages[word];
+        while (dirty != 0) {
+            unsigned int page = word * 64 + __builtin_ctzll(dirty);
+            unsigned long long hash = hash_page(bus, page);
+            machine->memory_hash ^= machine->page_hashes[page] ^ hash;
+            machine->page_hashes[page] = hash;
+            clean_page_mos6502(bus, (unsigned char) page);
+            dirty &= dirty - 1;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Hash the contents of a page, mixed with its number so that equal pages in different places do not cancel out
+//   Inputs: Memory Bus, Page Number
+//   Output: Hash of the page, 0 if it has no RAM or ROM behind it
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned long long hash_page(t_memory_bus *bus, unsigned int page_number) {
+    const unsigned char *data = bus->pages[page_number].data;
+    unsigned long long hash = 0x9E3779B97F4A7C15ULL * (page_number + 1);
+
+    if (data == NULL) {
+        return 0;
+    }
+    for (unsigned int offset = 0; offset < MEMORY_PAGE_SIZE; offset += sizeof(unsigned long long)) {
+        unsigned long long word;
+        memcpy(&word, &data[offset], sizeof(word));
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks the two machines against each other after a run
+//   Inputs: Lockstep Run
+//   Output: 1 if they match, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int machines_match(t_lockstep *lockstep) {
+    t_lockstep_machine *reference = &lockstep->reference;
+    t_lockstep_machine *candidate = &lockstep->candidate;
+
+    return reference->status == candidate->status && reference->instructions_executed == candidate->instructions_executed &&
+           reference->cycles_executed == candidate->cycles_executed && reference->memory_hash == candidate->memory_hash &&
+           registers_match(reference->registers, candidate->registers);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks two sets of registers field by field, as the padding between the fields is never written
+//   Inputs: Registers, Other Registers
+//   Output: 1 if they match, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int registers_match(const t_registers *registers, const t_registers *other) {
+    return registers->program_counter == other->program_counter && registers->stack_pointer == other->stack_pointer &&
+           registers->accumulator == other->accumulator && registers->register_x == other->register_x &&
+           registers->register_y == other->register_y && registers->processor_status == other->processor_status &&
+           registers->cycles == other->cycles;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Print one machine after the run that went wrong
+//   Inputs: Output File, Name, Machine
+// -------------------------------------------------------------------------------------------------------------------------------
+static void print_machine(FILE *output, const char *name, t_lockstep_machine *machine) {
+    static const char *const status_names[] = { "budget exhausted", "break", "unsupported opcode", "stopped", "breakpoint" };
+    t_registers *registers = machine->registers;
+
+    fprintf(output, "%s: PC:%04X A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu, %s after %llu instructions and %llu cycles, "
+            "memory hash %016llX\n", name, registers->program_counter, registers->accumulator, registers->register_x,
+            registers->register_y, registers->processor_status, registers->stack_pointer, registers->cycles,
+            status_names[machine->status], machine->instructions_executed, machine->cycles_executed, machine->memory_hash);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads a byte straight from RAM or ROM, so that devices never see the read
+//   Inputs: Memory Bus, Address
+//   Output: Byte at the address, 0 for device and unmapped pages
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned char peek(t_memory_bus *bus, unsigned short address) {
+    const unsigned char *data = bus->pages[address >> 8].data;
+    return (data != NULL) ? data[address & 0x00FF] : 0;
+}
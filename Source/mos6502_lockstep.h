@@ -0,0 +1,84 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Lockstep Checker Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_lockstep.h
+//
+// Description:
+//   Contains the data types and function prototypes for running a candidate engine in lockstep with the interpreter. Both
+//   machines start from the same state and are run the same number of instructions between checks. At each check the
+//   registers, the reason for returning, the instructions and cycles run and a hash of the RAM of both machines are
+//   compared, and the run stops at the first difference.
+//
+//   The memory hash is kept per page and only the pages written since the last check are hashed again, which the bus finds
+//   through its dirty page tracking. The checker owns the tracking of both buses while it runs, so neither machine can have
+//   a snapshot taken at the same time.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_LOCKSTEP_H
+#define MOS_6502_LOCKSTEP_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs the candidate engine, the same contract as run_mos6502() with the engine's own state passed first
+typedef t_run_status (*t_lockstep_runner)(void *, t_memory_bus *, t_registers *, t_run_budget *);
+
+// One of the two machines being compared
+typedef struct t_struct_lockstep_machine {
+    t_memory_bus *bus;
+    t_registers *registers;
+    // Hash of every page as of the last check, zero for pages with no RAM or ROM behind them
+    unsigned long long page_hashes[MEMORY_PAGE_COUNT];
+    // Hashes of all pages combined
+    unsigned long long memory_hash;
+    // Result of the last run
+    t_run_status status;
+    unsigned long long instructions_executed;
+    unsigned long long cycles_executed;
+} t_lockstep_machine;
+
+// Lockstep run of the interpreter and a candidate engine
+typedef struct t_struct_lockstep {
+    t_lockstep_machine reference;
+    t_lockstep_machine candidate;
+    t_lockstep_runner candidate_runner;
+    void *candidate_context;
+    // Instructions run between checks, 1 checks after every instruction
+    unsigned long long check_interval;
+    // Instructions run by both machines and found to match
+    unsigned long long instructions_checked;
+    // Set once the machines stop matching, along with the reference state at the start of the interval that went wrong
+    int diverged;
+    t_registers diverged_from;
+    unsigned char diverged_bytes[3];
+} t_lockstep;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Start A Lockstep Run Of Two Machines In The Same State
+extern void init_lockstep_mos6502(t_lockstep *, t_memory_bus *, t_registers *, t_memory_bus *, t_registers *, t_lockstep_runner, void *);
+
+// Run Both Machines And Check Them Against Each Other
+extern int run_lockstep_mos6502(t_lockstep *, unsigned long long);
+
+// Print The State Of Both Machines Where They Stopped Matching
+extern void print_divergence_mos6502(t_lockstep *, FILE *);
+
+// Candidate Runner For The Block Cache, Whose Context Is The Cache
+extern t_run_status run_cached_lockstep_mos6502(void *, t_memory_bus *, t_registers *, t_run_budget *);
+
+#endif // MOS_6502_LOCKSTEP_H
@@ -0,0 +1,326 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Memory Bus
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_memory_bus.c
+//
+// Description:
+//   Maps host memory and device callbacks into the 6502 address space one page at a time
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stddef.h>
+
+// Local
+#include "mos6502_memory_bus.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Works out the fast path pointers of a page from its mapping
+static void update_fast_path(t_memory_bus *, unsigned int);
+
+// Limits a page range to the address space
+static unsigned int clamp_page_count(unsigned char, unsigned int);
+
+// Checks whether code has been decoded from a page since it last changed
+static int page_holds_code(t_memory_bus *, unsigned int);
+
+// Checks whether the reads or the writes of a page are watched
+static int page_is_watched(const unsigned long long *, unsigned int);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize memory bus with nothing mapped. Reads of unmapped pages return OPEN_BUS_VALUE and writes are dropped. Code
+// generations start again from 0, so a block cache used with the bus before must be flushed.
+//   Inputs: Memory Bus
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void init_memory_bus_mos6502(t_memory_bus *bus) {
+    for (unsigned int i = 0; i < PAGE_BITMAP_WORDS; i++) {
+        bus->dirty_pages[i] = 0;
+    }
+    bus->dirty_tracker = NULL;
+    for (unsigned int i = 0; i < PAGE_BITMAP_WORDS; i++) {
+        bus->code_pages[i] = 0;
+    }
+    for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+        bus->code_generation[i] = 0;
+    }
+    bus->code_changes = 0;
+    for (unsigned int i = 0; i < PAGE_BITMAP_WORDS; i++) {
+        bus->read_watched_pages[i] = 0;
+        bus->write_watched_pages[i] = 0;
+    }
+    bus->access_watcher = NULL;
+    bus->watcher = NULL;
+    unmap_memory_mos6502(bus, 0, MEMORY_PAGE_COUNT);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Map host memory into a range of pages. The host memory must hold page count * MEMORY_PAGE_SIZE bytes and stay valid while
+// it is mapped. Mapping another block over the same pages is how banks are switched. While dirty page tracking is on, RAM
+// mapped in is tracked and starts out dirty, as its contents may differ from what was there when tracking started.
+//   Inputs: Memory Bus, First Page, Page Count, Host Memory, Page Flags
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void map_memory_mos6502(t_memory_bus *bus, unsigned char first_page, unsigned int page_count, unsigned char *data, unsigned char flags) {
+    page_count = clamp_page_count(first_page, page_count);
+    if (bus->dirty_tracker != NULL && !(flags & PAGE_WRITE_PROTECT)) {
+        flags |= PAGE_TRACK_WRITES;
+    }
+
+    for (unsigned int i = 0; i < page_count; i++) {
+        t_memory_page *page = &bus->pages[first_page + i];
+        page->data = data + (i * MEMORY_PAGE_SIZE);
+        page->read_handler = NULL;
+        page->write_handler = NULL;
+        page->device = NULL;
+        page->flags = flags;
+        if (flags & PAGE_TRACK_WRITES) {
+            bus->dirty_pages[(first_page + i) / 64] |= 1ULL << ((first_page + i) % 64);
+        }
+        invalidate_code_page_mos6502(bus, first_page + i);
+        update_fast_path(bus, first_page + i);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Map device callbacks into a range of pages. Either callback may be NULL, in which case reads return OPEN_BUS_VALUE or
+// writes are dropped.
+//   Inputs: Memory Bus, First Page, Page Count, Read Callback, Write Callback, Device
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void map_device_mos6502(t_memory_bus *bus, unsigned char first_page, unsigned int page_count,
+                               t_bus_read_handler read_handler, t_bus_write_handler write_handler, void *device) {
+    page_count = clamp_page_count(first_page, page_count);
+
+    for (unsigned int i = 0; i < page_count; i++) {
+        t_memory_page *page = &bus->pages[first_page + i];
+        page->data = NULL;
+        page->read_handler = read_handler;
+        page->write_handler = write_handler;
+        page->device = device;
+        page->flags = 0;
+        invalidate_code_page_mos6502(bus, first_page + i);
+        update_fast_path(bus, first_page + i);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Unmap a range of pages
+//   Inputs: Memory Bus, First Page, Page Count
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void unmap_memory_mos6502(t_memory_bus *bus, unsigned char first_page, unsigned int page_count) {
+    page_count = clamp_page_count(first_page, page_count);
+
+    for (unsigned int i = 0; i < page_count; i++) {
+        t_memory_page *page = &bus->pages[first_page + i];
+        page->data = NULL;
+        page->read_handler = NULL;
+        page->write_handler = NULL;
+        page->device = NULL;
+        page->flags = 0;
+        invalidate_code_page_mos6502(bus, first_page + i);
+        update_fast_path(bus, first_page + i);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Turn on dirty page tracking for every RAM page that is mapped now and mark them all clean. Writes to a clean page take the
+// slow path once, which marks the page dirty and gives it back its fast path. RAM mapped later is tracked from the start.
+//   Inputs: Memory Bus, Tracker (recorded so the owner can tell whether the dirty pages are relative to it)
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void track_dirty_pages_mos6502(t_memory_bus *bus, const void *tracker) {
+    for (unsigned int i = 0; i < PAGE_BITMAP_WORDS; i++) {
+        bus->dirty_pages[i] = 0;
+    }
+    bus->dirty_tracker = tracker;
+
+    for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+        t_memory_page *page = &bus->pages[i];
+        if (page->data != NULL && !(page->flags & PAGE_WRITE_PROTECT)) {
+            page->flags |= PAGE_TRACK_WRITES;
+        }
+        update_fast_path(bus, i);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Mark a page clean again so that the next write to it is trapped
+//   Inputs: Memory Bus, Page Number
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void clean_page_mos6502(t_memory_bus *bus, unsigned char page_number) {
+    bus->dirty_pages[page_number / 64] &= ~(1ULL << (page_number % 64));
+    update_fast_path(bus, page_number);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Mark a tracked page dirty, for writes the host makes straight into its memory rather than through the bus
+//   Inputs: Memory Bus, Page Number
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void mark_page_dirty_mos6502(t_memory_bus *bus, unsigned char page_number) {
+    if (bus->dirty_tracker != NULL && (bus->pages[page_number].flags & PAGE_TRACK_WRITES) &&
+        !page_is_dirty_mos6502(bus, page_number)) {
+        bus->dirty_pages[page_number / 64] |= 1ULL << (page_number % 64);
+        update_fast_path(bus, page_number);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Check whether a page has been written since it was last marked clean
+//   Inputs: Memory Bus, Page Number
+//   Output: 1 if the page is dirty, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int page_is_dirty_mos6502(t_memory_bus *bus, unsigned char page_number) {
+    return (bus->dirty_pages[page_number / 64] >> (page_number % 64)) & 1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Start watching a page that code has been decoded from. Writes to the page are trapped until the next one, which
+// invalidates the page.
+//   Inputs: Memory Bus, Page Number
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void watch_code_page_mos6502(t_memory_bus *bus, unsigned char page_number) {
+    if (!page_holds_code(bus, page_number)) {
+        bus->code_pages[page_number / 64] |= 1ULL << (page_number % 64);
+        update_fast_path(bus, page_number);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Tell whoever decoded code from a page that it may have changed, and stop watching the page. Nothing happens for a page
+// that is not watched, as no code decoded from its current contents can exist. The host calls this after changing the
+// memory behind a page without going through the bus.
+//   Inputs: Memory Bus, Page Number
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void invalidate_code_page_mos6502(t_memory_bus *bus, unsigned char page_number) {
+    if (page_holds_code(bus, page_number)) {
+        bus->code_pages[page_number / 64] &= ~(1ULL << (page_number % 64));
+        bus->code_generation[page_number]++;
+        bus->code_changes++;
+        update_fast_path(bus, page_number);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Set the callback that watched pages pass their accesses to
+//   Inputs: Memory Bus, Access Watcher (NULL for none), Watcher
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void set_access_watcher_mos6502(t_memory_bus *bus, t_bus_access_watcher access_watcher, void *watcher) {
+    bus->access_watcher = access_watcher;
+    bus->watcher = watcher;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Start or stop passing the reads and writes of a page to the access watcher. Watched reads take the slow path, so code in
+// a page with watched reads is not cached.
+//   Inputs: Memory Bus, Page Number, Watch Reads, Watch Writes
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void watch_page_accesses_mos6502(t_memory_bus *bus, unsigned char page_number, int reads, int writes) {
+    unsigned long long bit = 1ULL << (page_number % 64);
+
+    bus->read_watched_pages[page_number / 64] = reads ? (bus->read_watched_pages[page_number / 64] | bit) :
+                                                        (bus->read_watched_pages[page_number / 64] & ~bit);
+    bus->write_watched_pages[page_number / 64] = writes ? (bus->write_watched_pages[page_number / 64] | bit) :
+                                                          (bus->write_watched_pages[page_number / 64] & ~bit);
+    update_fast_path(bus, page_number);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads a page that has no fast path
+//   Inputs: Memory Bus, Address
+// -------------------------------------------------------------------------------------------------------------------------------
+extern unsigned char read_bus_slow_mos6502(t_memory_bus *bus, unsigned short address) {
+    t_memory_page *page = &bus->pages[address >> 8];
+    unsigned char value = OPEN_BUS_VALUE;
+
+    if (page->data != NULL) {
+        value = page->data[address & 0x00FF];
+    } else if (page->read_handler != NULL) {
+        value = page->read_handler(page->device, address);
+    }
+    if (bus->access_watcher != NULL && page_is_watched(bus->read_watched_pages, address >> 8)) {
+        bus->access_watcher(bus->watcher, address, value, 0);
+    }
+    return value;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes a page that has no fast path
+//   Inputs: Memory Bus, Address, Value
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void write_bus_slow_mos6502(t_memory_bus *bus, unsigned short address, unsigned char value) {
+    t_memory_page *page = &bus->pages[address >> 8];
+
+    if (bus->access_watcher != NULL && page_is_watched(bus->write_watched_pages, address >> 8)) {
+        bus->access_watcher(bus->watcher, address, value, 1);
+    }
+    if (page->data != NULL) {
+        // Writes to ROM are dropped
+        if (page->flags & PAGE_WRITE_PROTECT) {
+            return;
+        }
+        // First write to a tracked page since it was marked clean, later writes take the fast path again
+        if ((page->flags & PAGE_TRACK_WRITES) && !page_is_dirty_mos6502(bus, address >> 8)) {
+            bus->dirty_pages[(address >> 8) / 64] |= 1ULL << ((address >> 8) % 64);
+            update_fast_path(bus, address >> 8);
+        }
+        // First write to a page holding decoded code
+        invalidate_code_page_mos6502(bus, address >> 8);
+        page->data[address & 0x00FF] = value;
+        return;
+    }
+    if (page->write_handler != NULL) {
+        page->write_handler(page->device, address, value);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Works out the fast path pointers of a page from its mapping
+//   Inputs: Memory Bus, Page Number
+// -------------------------------------------------------------------------------------------------------------------------------
+static void update_fast_path(t_memory_bus *bus, unsigned int page_number) {
+    t_memory_page *page = &bus->pages[page_number];
+
+    bus->read_pages[page_number] = page_is_watched(bus->read_watched_pages, page_number) ? NULL : page->data;
+    if ((page->flags & PAGE_WRITE_PROTECT) || ((page->flags & PAGE_TRACK_WRITES) && !page_is_dirty_mos6502(bus, page_number)) ||
+        page_holds_code(bus, page_number) || page_is_watched(bus->write_watched_pages, page_number)) {
+        bus->write_pages[page_number] = NULL;
+    } else {
+        bus->write_pages[page_number] = page->data;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Limits a page range to the end of the address space
+//   Inputs: First Page, Page Count
+//   Output: Number of pages that fit
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int clamp_page_count(unsigned char first_page, unsigned int page_count) {
+    unsigned int pages_left = MEMORY_PAGE_COUNT - first_page;
+    if (page_count > pages_left) {
+        return pages_left;
+    }
+    return page_count;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether code has been decoded from a page since it last changed
+//   Inputs: Memory Bus, Page Number
+//   Output: 1 if the page is watched, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int page_holds_code(t_memory_bus *bus, unsigned int page_number) {
+    return (bus->code_pages[page_number / 64] >> (page_number % 64)) & 1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether the reads or the writes of a page are watched
+//   Inputs: Watched Pages Bitmap, Page Number
+//   Output: 1 if the page is watched, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int page_is_watched(const unsigned long long *watched_pages, unsigned int page_number) {
+    return (watched_pages[page_number / 64] >> (page_number % 64)) & 1;
+}
@@ -0,0 +1,156 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Memory Bus Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_memory_bus.h
+//
+// Description:
+//   Contains the data types and function prototypes for the paged memory bus. The 64 kB address space is split into 256 pages
+//   of 256 bytes. Each page is either backed by host memory (RAM, or ROM when write protected) or by a pair of read/write
+//   callbacks for memory mapped devices. Bank switching is done by mapping a different block of host memory into a page.
+//   Writes to RAM can be tracked a page at a time, which is what lets a snapshot be restored by copying back only the pages
+//   that changed. Pages holding code decoded by the block cache are watched the same way, so that a write into them throws
+//   the decoded code away. A debugger can have the reads or writes of chosen pages passed to a callback, which costs nothing
+//   for every other page.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_MEMORY_BUS_H
+#define MOS_6502_MEMORY_BUS_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stddef.h>
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Memory Page Size
+#define MEMORY_PAGE_SIZE 256
+
+// Number of pages in the address space
+#define MEMORY_PAGE_COUNT 256
+
+// Memory Page Flags
+#define PAGE_WRITE_PROTECT 0x01
+// Set on RAM pages while dirty page tracking is on, the first write to the page is trapped to mark it dirty
+#define PAGE_TRACK_WRITES  0x02
+
+// Value read from a page with nothing mapped into it
+#define OPEN_BUS_VALUE 0x00
+
+// Number of words in a bitmap with one bit per page
+#define PAGE_BITMAP_WORDS (MEMORY_PAGE_COUNT / 64)
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Device callbacks, given the device pointer passed to map_device_mos6502() and the full 16 bit address
+typedef unsigned char (*t_bus_read_handler)(void *, unsigned short);
+typedef void (*t_bus_write_handler)(void *, unsigned short, unsigned char);
+
+// Access watcher callback, given the watcher pointer passed to set_access_watcher_mos6502(), the full 16 bit address, the
+// value read or written and whether it was a write
+typedef void (*t_bus_access_watcher)(void *, unsigned short, unsigned char, int);
+
+// What is mapped into a single page
+typedef struct t_struct_memory_page {
+    // Host memory for RAM and ROM pages, NULL for device pages
+    unsigned char *data;
+    // Callbacks and their context for device pages
+    t_bus_read_handler read_handler;
+    t_bus_write_handler write_handler;
+    void *device;
+    unsigned char flags;
+} t_memory_page;
+
+// Memory Bus
+typedef struct t_struct_memory_bus {
+    // Host memory for each page that can be read or written directly, NULL when the access needs the slow path
+    unsigned char *read_pages[MEMORY_PAGE_COUNT];
+    unsigned char *write_pages[MEMORY_PAGE_COUNT];
+    // Mapping of every page
+    t_memory_page pages[MEMORY_PAGE_COUNT];
+    // Pages written since dirty page tracking was last turned on, bit n of word n / 64 is page n
+    unsigned long long dirty_pages[PAGE_BITMAP_WORDS];
+    // Whoever turned dirty page tracking on, NULL while it is off
+    const void *dirty_tracker;
+    // Pages that code has been decoded from since they last changed, writes to them take the slow path
+    unsigned long long code_pages[PAGE_BITMAP_WORDS];
+    // Bumped each time the code in a watched page may have changed, by a write or by mapping something else into the page
+    unsigned int code_generation[MEMORY_PAGE_COUNT];
+    // Bumped along with any code generation, so code that is running can check for changes with a single compare
+    unsigned int code_changes;
+    // Pages whose reads and writes are passed to the access watcher, they take the slow path
+    unsigned long long read_watched_pages[PAGE_BITMAP_WORDS];
+    unsigned long long write_watched_pages[PAGE_BITMAP_WORDS];
+    t_bus_access_watcher access_watcher;
+    void *watcher;
+} t_memory_bus;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize Memory Bus With Nothing Mapped
+extern void init_memory_bus_mos6502(t_memory_bus *);
+
+// Map Host Memory Into Pages
+extern void map_memory_mos6502(t_memory_bus *, unsigned char, unsigned int, unsigned char *, unsigned char);
+
+// Map Device Callbacks Into Pages
+extern void map_device_mos6502(t_memory_bus *, unsigned char, unsigned int, t_bus_read_handler, t_bus_write_handler, void *);
+
+// Unmap Pages
+extern void unmap_memory_mos6502(t_memory_bus *, unsigned char, unsigned int);
+
+// Dirty Page Tracking
+extern void track_dirty_pages_mos6502(t_memory_bus *, const void *);
+extern void clean_page_mos6502(t_memory_bus *, unsigned char);
+extern void mark_page_dirty_mos6502(t_memory_bus *, unsigned char);
+extern int page_is_dirty_mos6502(t_memory_bus *, unsigned char);
+
+// Code Page Watching
+extern void watch_code_page_mos6502(t_memory_bus *, unsigned char);
+extern void invalidate_code_page_mos6502(t_memory_bus *, unsigned char);
+
+// Access Watching
+extern void set_access_watcher_mos6502(t_memory_bus *, t_bus_access_watcher, void *);
+extern void watch_page_accesses_mos6502(t_memory_bus *, unsigned char, int, int);
+
+// Slow Path Accesses For Device, Write Protected, Tracked, Code, Watched And Unmapped Pages
+extern unsigned char read_bus_slow_mos6502(t_memory_bus *, unsigned short);
+extern void write_bus_slow_mos6502(t_memory_bus *, unsigned short, unsigned char);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Inline Functions
+// -------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads a byte from the bus. RAM and ROM pages are a single pointer lookup and load.
+//   Inputs: Memory Bus, Address
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline unsigned char read_bus_mos6502(t_memory_bus *bus, unsigned short address) {
+    unsigned char *page = bus->read_pages[address >> 8];
+    if (page != NULL) {
+        return page[address & 0x00FF];
+    }
+    return read_bus_slow_mos6502(bus, address);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes a byte to the bus. RAM pages are a single pointer lookup and store.
+//   Inputs: Memory Bus, Address, Value
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void write_bus_mos6502(t_memory_bus *bus, unsigned short address, unsigned char value) {
+    unsigned char *page = bus->write_pages[address >> 8];
+    if (page != NULL) {
+        page[address & 0x00FF] = value;
+        return;
+    }
+    write_bus_slow_mos6502(bus, address, value);
+}
+
+#endif // MOS_6502_MEMORY_BUS_H
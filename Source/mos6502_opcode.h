@@ -38,7 +38,8 @@
 #define AND_INDIRECT_Y  0x31
 
 // Arithmetic Shift Left (ASL)
-#define ASL_IMMEDIATE   0x0A
+#define ASL_ACCUMULATOR 0x0A
+#define ASL_IMMEDIATE   ASL_ACCUMULATOR
 #define ASL_ZERO_PAGE   0x06
 #define ASL_ZERO_PAGE_X 0x16
 #define ASL_ABSOLUTE    0x0E
@@ -173,7 +174,8 @@
 #define LDY_ABSOLUTE_X  0xBC
 
 // Logical Shift Register (LSR)
-#define LSP_ACCUMULATOR 0x4A
+#define LSR_ACCUMULATOR 0x4A
+#define LSP_ACCUMULATOR LSR_ACCUMULATOR
 #define LSR_ZERO_PAGE   0x46
 #define LSR_ZERO_PAGE_X 0x56
 #define LSR_ABSOLUTE    0x4E
@@ -198,6 +200,9 @@
 // Push Processor Status (PHP)
 #define PHP_IMPLIED     0x08
 
+// Pull Accumulator (PLA)
+#define PLA_IMPLIED     0x68
+
 // Pull Processor Status (PLP)
 #define PLP_IMPLIED     0x28
 
@@ -277,4 +282,164 @@
 // Transfer Y to Accumulator (TYA)
 #define TYA_IMPLIED     0x98
 
+// -------------------------------------------------------------------------------------------------------------------------------
+// Opcode Table
+//   X(Opcode, Mnemonic, Handler, Addressing Mode, Length In Bytes, Base Cycles)
+//
+//   Every documented opcode is listed exactly once. The emulator expands this list into its opcode descriptor table and its
+//   dispatch code, so adding an instruction only needs a new define above and a new line here.
+// -------------------------------------------------------------------------------------------------------------------------------
+#define MOS_6502_OPCODE_TABLE(X) \
+    X(ADC_IMMEDIATE,   "ADC", adc, IMMEDIATE,        2, 2) \
+    X(ADC_ZERO_PAGE,   "ADC", adc, ZERO_PAGE,        2, 3) \
+    X(ADC_ZERO_PAGE_X, "ADC", adc, ZERO_PAGE_X,      2, 4) \
+    X(ADC_ABSOLUTE,    "ADC", adc, ABSOLUTE,         3, 4) \
+    X(ADC_ABSOLUTE_X,  "ADC", adc, ABSOLUTE_X,       3, 4) \
+    X(ADC_ABSOLUTE_Y,  "ADC", adc, ABSOLUTE_Y,       3, 4) \
+    X(ADC_INDIRECT_X,  "ADC", adc, INDEXED_INDIRECT, 2, 6) \
+    X(ADC_INDIRECT_Y,  "ADC", adc, INDIRECT_INDEXED, 2, 5) \
+    X(AND_IMMEDIATE,   "AND", and, IMMEDIATE,        2, 2) \
+    X(AND_ZERO_PAGE,   "AND", and, ZERO_PAGE,        2, 3) \
+    X(AND_ZERO_PAGE_X, "AND", and, ZERO_PAGE_X,      2, 4) \
+    X(AND_ABSOLUTE,    "AND", and, ABSOLUTE,         3, 4) \
+    X(AND_ABSOLUTE_X,  "AND", and, ABSOLUTE_X,       3, 4) \
+    X(AND_ABSOLUTE_Y,  "AND", and, ABSOLUTE_Y,       3, 4) \
+    X(AND_INDIRECT_X,  "AND", and, INDEXED_INDIRECT, 2, 6) \
+    X(AND_INDIRECT_Y,  "AND", and, INDIRECT_INDEXED, 2, 5) \
+    X(ASL_ACCUMULATOR, "ASL", asl, ACCUMULATOR,      1, 2) \
+    X(ASL_ZERO_PAGE,   "ASL", asl, ZERO_PAGE,        2, 5) \
+    X(ASL_ZERO_PAGE_X, "ASL", asl, ZERO_PAGE_X,      2, 6) \
+    X(ASL_ABSOLUTE,    "ASL", asl, ABSOLUTE,         3, 6) \
+    X(ASL_ABSOLUTE_X,  "ASL", asl, ABSOLUTE_X,       3, 7) \
+    X(BCC_RELATIVE,    "BCC", bcc, RELATIVE,         2, 2) \
+    X(BCS_RELATIVE,    "BCS", bcs, RELATIVE,         2, 2) \
+    X(BEQ_RELATIVE,    "BEQ", beq, RELATIVE,         2, 2) \
+    X(BIT_ZERO_PAGE,   "BIT", bit, ZERO_PAGE,        2, 3) \
+    X(BIT_ABSOLUTE,    "BIT", bit, ABSOLUTE,         3, 4) \
+    X(BMI_RELATIVE,    "BMI", bmi, RELATIVE,         2, 2) \
+    X(BNE_RELATIVE,    "BNE", bne, RELATIVE,         2, 2) \
+    X(BPL_RELATIVE,    "BPL", bpl, RELATIVE,         2, 2) \
+    X(BRK_IMPLIED,     "BRK", brk, IMPLIED,          1, 7) \
+    X(BVC_RELATIVE,    "BVC", bvc, RELATIVE,         2, 2) \
+    X(BVS_RELATIVE,    "BVS", bvs, RELATIVE,         2, 2) \
+    X(CLC_IMPLIED,     "CLC", clc, IMPLIED,          1, 2) \
+    X(CLD_IMPLIED,     "CLD", cld, IMPLIED,          1, 2) \
+    X(CLI_IMPLIED,     "CLI", cli, IMPLIED,          1, 2) \
+    X(CLV_IMPLIED,     "CLV", clv, IMPLIED,          1, 2) \
+    X(CMP_IMMEDIATE,   "CMP", cmp, IMMEDIATE,        2, 2) \
+    X(CMP_ZERO_PAGE,   "CMP", cmp, ZERO_PAGE,        2, 3) \
+    X(CMP_ZERO_PAGE_X, "CMP", cmp, ZERO_PAGE_X,      2, 4) \
+    X(CMP_ABSOLUTE,    "CMP", cmp, ABSOLUTE,         3, 4) \
+    X(CMP_ABSOLUTE_X,  "CMP", cmp, ABSOLUTE_X,       3, 4) \
+    X(CMP_ABSOLUTE_Y,  "CMP", cmp, ABSOLUTE_Y,       3, 4) \
+    X(CMP_INDIRECT_X,  "CMP", cmp, INDEXED_INDIRECT, 2, 6) \
+    X(CMP_INDIRECT_Y,  "CMP", cmp, INDIRECT_INDEXED, 2, 5) \
+    X(CPX_IMMEDIATE,   "CPX", cpx, IMMEDIATE,        2, 2) \
+    X(CPX_ZERO_PAGE,   "CPX", cpx, ZERO_PAGE,        2, 3) \
+    X(CPX_ABSOLUTE,    "CPX", cpx, ABSOLUTE,         3, 4) \
+    X(CPY_IMMEDIATE,   "CPY", cpy, IMMEDIATE,        2, 2) \
+    X(CPY_ZERO_PAGE,   "CPY", cpy, ZERO_PAGE,        2, 3) \
+    X(CPY_ABSOLUTE,    "CPY", cpy, ABSOLUTE,         3, 4) \
+    X(DEC_ZERO_PAGE,   "DEC", dec, ZERO_PAGE,        2, 5) \
+    X(DEC_ZERO_PAGE_X, "DEC", dec, ZERO_PAGE_X,      2, 6) \
+    X(DEC_ABSOLUTE,    "DEC", dec, ABSOLUTE,         3, 6) \
+    X(DEC_ABSOLUTE_X,  "DEC", dec, ABSOLUTE_X,       3, 7) \
+    X(DEX_IMPLIED,     "DEX", dex, IMPLIED,          1, 2) \
+    X(DEY_IMPLIED,     "DEY", dey, IMPLIED,          1, 2) \
+    X(EOR_IMMEDIATE,   "EOR", eor, IMMEDIATE,        2, 2) \
+    X(EOR_ZERO_PAGE,   "EOR", eor, ZERO_PAGE,        2, 3) \
+    X(EOR_ZERO_PAGE_X, "EOR", eor, ZERO_PAGE_X,      2, 4) \
+    X(EOR_ABSOLUTE,    "EOR", eor, ABSOLUTE,         3, 4) \
+    X(EOR_ABSOLUTE_X,  "EOR", eor, ABSOLUTE_X,       3, 4) \
+    X(EOR_ABSOLUTE_Y,  "EOR", eor, ABSOLUTE_Y,       3, 4) \
+    X(EOR_INDIRECT_X,  "EOR", eor, INDEXED_INDIRECT, 2, 6) \
+    X(EOR_INDIRECT_Y,  "EOR", eor, INDIRECT_INDEXED, 2, 5) \
+    X(INC_ZERO_PAGE,   "INC", inc, ZERO_PAGE,        2, 5) \
+    X(INC_ZERO_PAGE_X, "INC", inc, ZERO_PAGE_X,      2, 6) \
+    X(INC_ABSOLUTE,    "INC", inc, ABSOLUTE,         3, 6) \
+    X(INC_ABSOLUTE_X,  "INC", inc, ABSOLUTE_X,       3, 7) \
+    X(INX_IMPLIED,     "INX", inx, IMPLIED,          1, 2) \
+    X(INY_IMPLIED,     "INY", iny, IMPLIED,          1, 2) \
+    X(JMP_ABSOLUTE,    "JMP", jmp, ABSOLUTE,         3, 3) \
+    X(JMP_INDIRECT,    "JMP", jmp, INDIRECT,         3, 5) \
+    X(JSR_ABSOLUTE,    "JSR", jsr, ABSOLUTE,         3, 6) \
+    X(LDA_IMMEDIATE,   "LDA", lda, IMMEDIATE,        2, 2) \
+    X(LDA_ZERO_PAGE,   "LDA", lda, ZERO_PAGE,        2, 3) \
+    X(LDA_ZERO_PAGE_X, "LDA", lda, ZERO_PAGE_X,      2, 4) \
+    X(LDA_ABSOLUTE,    "LDA", lda, ABSOLUTE,         3, 4) \
+    X(LDA_ABSOLUTE_X,  "LDA", lda, ABSOLUTE_X,       3, 4) \
+    X(LDA_ABSOLUTE_Y,  "LDA", lda, ABSOLUTE_Y,       3, 4) \
+    X(LDA_INDIRECT_X,  "LDA", lda, INDEXED_INDIRECT, 2, 6) \
+    X(LDA_INDIRECT_Y,  "LDA", lda, INDIRECT_INDEXED, 2, 5) \
+    X(LDX_IMMEDIATE,   "LDX", ldx, IMMEDIATE,        2, 2) \
+    X(LDX_ZERO_PAGE,   "LDX", ldx, ZERO_PAGE,        2, 3) \
+    X(LDX_ZERO_PAGE_Y, "LDX", ldx, ZERO_PAGE_Y,      2, 4) \
+    X(LDX_ABSOLUTE,    "LDX", ldx, ABSOLUTE,         3, 4) \
+    X(LDX_ABSOLUTE_Y,  "LDX", ldx, ABSOLUTE_Y,       3, 4) \
+    X(LDY_IMMEDIATE,   "LDY", ldy, IMMEDIATE,        2, 2) \
+    X(LDY_ZERO_PAGE,   "LDY", ldy, ZERO_PAGE,        2, 3) \
+    X(LDY_ZERO_PAGE_X, "LDY", ldy, ZERO_PAGE_X,      2, 4) \
+    X(LDY_ABSOLUTE,    "LDY", ldy, ABSOLUTE,         3, 4) \
+    X(LDY_ABSOLUTE_X,  "LDY", ldy, ABSOLUTE_X,       3, 4) \
+    X(LSR_ACCUMULATOR, "LSR", lsr, ACCUMULATOR,      1, 2) \
+    X(LSR_ZERO_PAGE,   "LSR", lsr, ZERO_PAGE,        2, 5) \
+    X(LSR_ZERO_PAGE_X, "LSR", lsr, ZERO_PAGE_X,      2, 6) \
+    X(LSR_ABSOLUTE,    "LSR", lsr, ABSOLUTE,         3, 6) \
+    X(LSR_ABSOLUTE_X,  "LSR", lsr, ABSOLUTE_X,       3, 7) \
+    X(NOP_IMPLIED,     "NOP", nop, IMPLIED,          1, 2) \
+    X(ORA_IMMEDIATE,   "ORA", ora, IMMEDIATE,        2, 2) \
+    X(ORA_ZERO_PAGE,   "ORA", ora, ZERO_PAGE,        2, 3) \
+    X(ORA_ZERO_PAGE_X, "ORA", ora, ZERO_PAGE_X,      2, 4) \
+    X(ORA_ABSOLUTE,    "ORA", ora, ABSOLUTE,         3, 4) \
+    X(ORA_ABSOLUTE_X,  "ORA", ora, ABSOLUTE_X,       3, 4) \
+    X(ORA_ABSOLUTE_Y,  "ORA", ora, ABSOLUTE_Y,       3, 4) \
+    X(ORA_INDIRECT_X,  "ORA", ora, INDEXED_INDIRECT, 2, 6) \
+    X(ORA_INDIRECT_Y,  "ORA", ora, INDIRECT_INDEXED, 2, 5) \
+    X(PHA_IMPLIED,     "PHA", pha, IMPLIED,          1, 3) \
+    X(PHP_IMPLIED,     "PHP", php, IMPLIED,          1, 3) \
+    X(PLA_IMPLIED,     "PLA", pla, IMPLIED,          1, 4) \
+    X(PLP_IMPLIED,     "PLP", plp, IMPLIED,          1, 4) \
+    X(ROL_ACCUMULATOR, "ROL", rol, ACCUMULATOR,      1, 2) \
+    X(ROL_ZERO_PAGE,   "ROL", rol, ZERO_PAGE,        2, 5) \
+    X(ROL_ZERO_PAGE_X, "ROL", rol, ZERO_PAGE_X,      2, 6) \
+    X(ROL_ABSOLUTE,    "ROL", rol, ABSOLUTE,         3, 6) \
+    X(ROL_ABSOLUTE_X,  "ROL", rol, ABSOLUTE_X,       3, 7) \
+    X(ROR_ACCUMULATOR, "ROR", ror, ACCUMULATOR,      1, 2) \
+    X(ROR_ZERO_PAGE,   "ROR", ror, ZERO_PAGE,        2, 5) \
+    X(ROR_ZERO_PAGE_X, "ROR", ror, ZERO_PAGE_X,      2, 6) \
+    X(ROR_ABSOLUTE,    "ROR", ror, ABSOLUTE,         3, 6) \
+    X(ROR_ABSOLUTE_X,  "ROR", ror, ABSOLUTE_X,       3, 7) \
+    X(RTI_IMPLIED,     "RTI", rti, IMPLIED,          1, 6) \
+    X(RTS_IMPLIED,     "RTS", rts, IMPLIED,          1, 6) \
+    X(SBC_IMMEDIATE,   "SBC", sbc, IMMEDIATE,        2, 2) \
+    X(SBC_ZERO_PAGE,   "SBC", sbc, ZERO_PAGE,        2, 3) \
+    X(SBC_ZERO_PAGE_X, "SBC", sbc, ZERO_PAGE_X,      2, 4) \
+    X(SBC_ABSOLUTE,    "SBC", sbc, ABSOLUTE,         3, 4) \
+    X(SBC_ABSOLUTE_X,  "SBC", sbc, ABSOLUTE_X,       3, 4) \
+    X(SBC_ABSOLUTE_Y,  "SBC", sbc, ABSOLUTE_Y,       3, 4) \
+    X(SBC_INDIRECT_X,  "SBC", sbc, INDEXED_INDIRECT, 2, 6) \
+    X(SBC_INDIRECT_Y,  "SBC", sbc, INDIRECT_INDEXED, 2, 5) \
+    X(SEC_IMPLIED,     "SEC", sec, IMPLIED,          1, 2) \
+    X(SED_IMPLIED,     "SED", sed, IMPLIED,          1, 2) \
+    X(SEI_IMPLIED,     "SEI", sei, IMPLIED,          1, 2) \
+    X(STA_ZERO_PAGE,   "STA", sta, ZERO_PAGE,        2, 3) \
+    X(STA_ZERO_PAGE_X, "STA", sta, ZERO_PAGE_X,      2, 4) \
+    X(STA_ABSOLUTE,    "STA", sta, ABSOLUTE,         3, 4) \
+    X(STA_ABSOLUTE_X,  "STA", sta, ABSOLUTE_X,       3, 5) \
+    X(STA_ABSOLUTE_Y,  "STA", sta, ABSOLUTE_Y,       3, 5) \
+    X(STA_INDIRECT_X,  "STA", sta, INDEXED_INDIRECT, 2, 6) \
+    X(STA_INDIRECT_Y,  "STA", sta, INDIRECT_INDEXED, 2, 6) \
+    X(STX_ZERO_PAGE,   "STX", stx, ZERO_PAGE,        2, 3) \
+    X(STX_ZERO_PAGE_Y, "STX", stx, ZERO_PAGE_Y,      2, 4) \
+    X(STX_ABSOLUTE,    "STX", stx, ABSOLUTE,         3, 4) \
+    X(STY_ZERO_PAGE,   "STY", sty, ZERO_PAGE,        2, 3) \
+    X(STY_ZERO_PAGE_X, "STY", sty, ZERO_PAGE_X,      2, 4) \
+    X(STY_ABSOLUTE,    "STY", sty, ABSOLUTE,         3, 4) \
+    X(TAX_IMPLIED,     "TAX", tax, IMPLIED,          1, 2) \
+    X(TAY_IMPLIED,     "TAY", tay, IMPLIED,          1, 2) \
+    X(TSX_IMPLIED,     "TSX", tsx, IMPLIED,          1, 2) \
+    X(TXA_IMPLIED,     "TXA", txa, IMPLIED,          1, 2) \
+    X(TXS_IMPLIED,     "TXS", txs, IMPLIED,          1, 2) \
+    X(TYA_IMPLIED,     "TYA", tya, IMPLIED,          1, 2)
+
 #endif // MOS_6502_OPCODES_H
\ No newline at end of file
@@ -0,0 +1,226 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Profiler
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_profile.c
+//
+// Description:
+//   Resets, prints, saves and loads the counters filled by run_mos6502() and run_cached_mos6502() while profiling
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdlib.h>
+#include <string.h>
+
+// Local
+#include "mos6502_profile.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Counter and the index it was found at, sorted together so that the comparison needs nothing else
+typedef struct t_struct_counted_index {
+    unsigned long long count;
+    unsigned int index;
+} t_counted_index;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Name of each addressing mode, indexed by t_memory_access
+static const char *const addressing_mode_names[ADDRESSING_MODE_COUNT] = {
+    [ZERO_PAGE] = "Zero Page",
+    [ZERO_PAGE_X] = "Zero Page,X",
+    [ZERO_PAGE_Y] = "Zero Page,Y",
+    [ABSOLUTE] = "Absolute",
+    [ABSOLUTE_X] = "Absolute,X",
+    [ABSOLUTE_Y] = "Absolute,Y",
+    [INDIRECT] = "Indirect",
+    [INDEXED_INDIRECT] = "(Indirect,X)",
+    [INDIRECT_INDEXED] = "(Indirect),Y",
+    [IMPLIED] = "Implied",
+    [ACCUMULATOR] = "Accumulator",
+    [IMMEDIATE] = "Immediate",
+    [RELATIVE] = "Relative"
+};
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Sorts indices by their counter, highest first
+static unsigned int top_indices(const unsigned long long *, unsigned int, t_counted_index *, unsigned int);
+static int compare_counts(const void *, const void *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Clear every counter
+//   Inputs: Profile
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void reset_profile_mos6502(t_profile *profile) {
+    memset(profile, 0, sizeof(t_profile));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Work out the instructions run in each addressing mode from the opcode counts
+//   Inputs: Profile, Counts (ADDRESSING_MODE_COUNT entries, filled in)
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void count_addressing_modes_mos6502(t_profile *profile, unsigned long long *counts) {
+    for (unsigned int mode = 0; mode < ADDRESSING_MODE_COUNT; mode++) {
+        counts[mode] = 0;
+    }
+    for (unsigned int opcode = 0; opcode < OPCODE_TABLE_SIZE; opcode++) {
+        if (mos6502_opcode_table[opcode].mnemonic != NULL) {
+            counts[mos6502_opcode_table[opcode].addressing_mode] += profile->opcode_executions[opcode];
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Print the opcodes that took the most cycles, the addressing modes, the page crossings and the addresses run the most
+//   Inputs: Profile, Output File, Number Of Opcodes And Addresses To List
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void print_profile_mos6502(t_profile *profile, FILE *output, unsigned int top_count) {
+    unsigned long long mode_counts[ADDRESSING_MODE_COUNT];
+    unsigned long long instructions = 0;
+    unsigned long long cycles = 0;
+
+    for (unsigned int opcode = 0; opcode < OPCODE_TABLE_SIZE; opcode++) {
+        instructions += profile->opcode_executions[opcode];
+        cycles += profile->opcode_cycles[opcode];
+    }
+    fprintf(output, "Instructions: %llu\nCycles:       %llu\n", instructions, cycles);
+    if (instructions == 0) {
+        return;
+    }
+
+    // Opcodes
+    t_counted_index opcodes[OPCODE_TABLE_SIZE];
+    unsigned int opcode_count = top_indices(profile->opcode_cycles, OPCODE_TABLE_SIZE, opcodes, top_count);
+    fprintf(output, "\n%-6s %-4s %-13s %14s %7s %14s %7s %6s\n", "Opcode", "", "Mode", "Executions", "%", "Cycles", "%", "CPI");
+    for (unsigned int i = 0; i < opcode_count; i++) {
+        unsigned int opcode = opcodes[i].index;
+        const t_opcode_descriptor *descriptor = &mos6502_opcode_table[opcode];
+        unsigned long long executions = profile->opcode_executions[opcode];
+        fprintf(output, "$%02X    %-4s %-13s %14llu %6.2f%% %14llu %6.2f%% %6.2f\n", opcode,
+                (descriptor->mnemonic != NULL) ? descriptor->mnemonic : "???",
+                (descriptor->mnemonic != NULL) ? addressing_mode_names[descriptor->addressing_mode] : "", executions,
+                100.0 * executions / instructions, profile->opcode_cycles[opcode],
+                (cycles != 0) ? 100.0 * profile->opcode_cycles[opcode] / cycles : 0.0,
+                (executions != 0) ? (double) profile->opcode_cycles[opcode] / executions : 0.0);
+    }
+
+    // Addressing modes
+    count_addressing_modes_mos6502(profile, mode_counts);
+    fprintf(output, "\n%-13s %14s %7s\n", "Mode", "Executions", "%");
+    for (unsigned int mode = 0; mode < ADDRESSING_MODE_COUNT; mode++) {
+        fprintf(output, "%-13s %14llu %6.2f%%\n", addressing_mode_names[mode], mode_counts[mode],
+                100.0 * mode_counts[mode] / instructions);
+    }
+
+    // Page crossings
+    fprintf(output, "\nIndexed page crossings: %llu\nBranch page crossings:  %llu\n", profile->page_crossings,
+            profile->branch_page_crossings);
+
+    // Addresses
+    t_counted_index *addresses = malloc(MOS_6502_MEM_SIZE * sizeof(t_counted_index));
+    if (addresses == NULL) {
+        printf("Error: Could not allocate memory to sort the addresses!!\n");
+        return;
+    }
+    unsigned int address_count = top_indices(profile->address_hits, MOS_6502_MEM_SIZE, addresses, top_count);
+    fprintf(output, "\n%-7s %14s %7s\n", "Address", "Hits", "%");
+    for (unsigned int i = 0; i < address_count; i++) {
+        fprintf(output, "$%04X   %14llu %6.2f%%\n", addresses[i].index, addresses[i].count,
+                100.0 * addresses[i].count / instructions);
+    }
+    free(addresses);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Save a profile to a file
+//   Inputs: Profile, File Path
+//   Output: 0 on success, -1 if the file could not be written
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int save_profile_mos6502(t_profile *profile, const char *path) {
+    t_profile_file_header header;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Error: Could not create profile file %s!!\n", path);
+        return -1;
+    }
+
+    memcpy(header.magic, PROFILE_FILE_MAGIC, sizeof(header.magic));
+    header.version = PROFILE_FILE_VERSION;
+    header.profile_size = sizeof(t_profile);
+    int written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(profile, sizeof(t_profile), 1, file) == 1;
+    if (fclose(file) != 0 || !written) {
+        printf("Error: Could not write profile file %s!!\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load a profile saved by save_profile_mos6502()
+//   Inputs: Profile, File Path
+//   Output: 0 on success, -1 if the file could not be read or is not a profile
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int load_profile_mos6502(t_profile *profile, const char *path) {
+    t_profile_file_header header;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: Could not open profile file %s!!\n", path);
+        return -1;
+    }
+
+    int read = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, PROFILE_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+               header.version == PROFILE_FILE_VERSION && header.profile_size == sizeof(t_profile) &&
+               fread(profile, sizeof(t_profile), 1, file) == 1;
+    fclose(file);
+    if (!read) {
+        printf("Error: %s is not a profile this version can read!!\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Finds the indices with the highest non zero counters
+//   Inputs: Counters, Number Of Counters, Indices And Counters (filled in, room for one per counter), Most Indices Wanted
+//   Output: Number of indices found, highest counter first
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int top_indices(const unsigned long long *counts, unsigned int count, t_counted_index *indices, unsigned int wanted) {
+    unsigned int found = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        if (counts[i] != 0) {
+            indices[found].count = counts[i];
+            indices[found].index = i;
+            found++;
+        }
+    }
+    qsort(indices, found, sizeof(t_counted_index), compare_counts);
+    return (found < wanted) ? found : wanted;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Orders indices by their counter, highest first, ties by index
+//   Inputs: Indices With Their Counters To Compare
+//   Output: Negative, zero or positive like qsort() wants
+// -------------------------------------------------------------------------------------------------------------------------------
+static int compare_counts(const void *left, const void *right) {
+    const t_counted_index *a = left;
+    const t_counted_index *b = right;
+
+    if (a->count != b->count) {
+        return (a->count > b->count) ? -1 : 1;
+    }
+    return (a->index > b->index) - (a->index < b->index);
+}
@@ -0,0 +1,82 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Profiler Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_profile.h
+//
+// Description:
+//   Contains the data types and function prototypes for the profiler. While profiling is compiled in (MOS_6502_PROFILE)
+//   run_mos6502() and run_cached_mos6502() count every instruction into the profile of their budget: executions and cycles
+//   per opcode, hits per address and page crossings. Counts per addressing mode are worked out from the opcode counts when
+//   they are printed, which costs nothing while running.
+//
+//   A profile can be printed straight away or saved and looked at later with the profile report in Tools, which also groups
+//   the hot addresses into routines.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_PROFILE_H
+#define MOS_6502_PROFILE_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Profile file identification, the header is followed straight away by the profile
+#define PROFILE_FILE_MAGIC   "M6502PRF"
+#define PROFILE_FILE_VERSION 1
+
+// Number of addressing modes in t_memory_access
+#define ADDRESSING_MODE_COUNT (RELATIVE + 1)
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Profile counters, all cleared by reset_profile_mos6502()
+typedef struct t_struct_profile {
+    // Instructions run and cycles taken by each opcode. Without cycle counting the base cycles are counted instead.
+    unsigned long long opcode_executions[OPCODE_TABLE_SIZE];
+    unsigned long long opcode_cycles[OPCODE_TABLE_SIZE];
+    // Instructions run at each address
+    unsigned long long address_hits[MOS_6502_MEM_SIZE];
+    // Indexed reads that crossed into the next page, and taken branches that landed in another page
+    unsigned long long page_crossings;
+    unsigned long long branch_page_crossings;
+} t_profile;
+
+// Header at the start of a profile file
+typedef struct t_struct_profile_file_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int profile_size;
+} t_profile_file_header;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Clear Every Counter
+extern void reset_profile_mos6502(t_profile *);
+
+// Work Out The Instructions Run In Each Addressing Mode
+extern void count_addressing_modes_mos6502(t_profile *, unsigned long long *);
+
+// Print The Hottest Opcodes And Addresses, The Addressing Modes And Page Crossings
+extern void print_profile_mos6502(t_profile *, FILE *, unsigned int);
+
+// Save A Profile To A File
+extern int save_profile_mos6502(t_profile *, const char *);
+
+// Load A Profile From A File
+extern int load_profile_mos6502(t_profile *, const char *);
+
+#endif // MOS_6502_PROFILE_H
@@ -0,0 +1,827 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Static Recompiler
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_recompiler.c
+//
+// Description:
+//   Finds the code of a firmware image by following control flow from its entry points, splits it into basic blocks and
+//   writes each block out as C. Blocks jump straight to the blocks they go to when the target is known, and go back through
+//   a switch on the program counter when it is only known at run time.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local
+#include "mos6502_opcode.h"
+#include "mos6502_recompiler.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// What is known about each address
+#define ADDRESS_QUEUED      0x01
+#define ADDRESS_INSTRUCTION 0x02
+#define ADDRESS_BLOCK_START 0x04
+
+// Operation generated for each instruction handler
+#define RECOMPILE_OPERATION_adc RECOMPILE_ADC
+#define RECOMPILE_OPERATION_and RECOMPILE_AND
+#define RECOMPILE_OPERATION_asl RECOMPILE_ASL
+#define RECOMPILE_OPERATION_bcc RECOMPILE_BCC
+#define RECOMPILE_OPERATION_bcs RECOMPILE_BCS
+#define RECOMPILE_OPERATION_beq RECOMPILE_BEQ
+#define RECOMPILE_OPERATION_bit RECOMPILE_BIT
+#define RECOMPILE_OPERATION_bmi RECOMPILE_BMI
+#define RECOMPILE_OPERATION_bne RECOMPILE_BNE
+#define RECOMPILE_OPERATION_bpl RECOMPILE_BPL
+#define RECOMPILE_OPERATION_brk RECOMPILE_BRK
+#define RECOMPILE_OPERATION_bvc RECOMPILE_BVC
+#define RECOMPILE_OPERATION_bvs RECOMPILE_BVS
+#define RECOMPILE_OPERATION_clc RECOMPILE_CLC
+#define RECOMPILE_OPERATION_cld RECOMPILE_CLD
+#define RECOMPILE_OPERATION_cli RECOMPILE_CLI
+#define RECOMPILE_OPERATION_clv RECOMPILE_CLV
+#define RECOMPILE_OPERATION_cmp RECOMPILE_CMP
+#define RECOMPILE_OPERATION_cpx RECOMPILE_CPX
+#define RECOMPILE_OPERATION_cpy RECOMPILE_CPY
+#define RECOMPILE_OPERATION_dec RECOMPILE_DEC
+#define RECOMPILE_OPERATION_dex RECOMPILE_DEX
+#define RECOMPILE_OPERATION_dey RECOMPILE_DEY
+#define RECOMPILE_OPERATION_eor RECOMPILE_EOR
+#define RECOMPILE_OPERATION_inc RECOMPILE_INC
+#define RECOMPILE_OPERATION_inx RECOMPILE_INX
+#define RECOMPILE_OPERATION_iny RECOMPILE_INY
+#define RECOMPILE_OPERATION_jmp RECOMPILE_JMP
+#define RECOMPILE_OPERATION_jsr RECOMPILE_JSR
+#define RECOMPILE_OPERATION_lda RECOMPILE_LDA
+#define RECOMPILE_OPERATION_ldx RECOMPILE_LDX
+#define RECOMPILE_OPERATION_ldy RECOMPILE_LDY
+#define RECOMPILE_OPERATION_lsr RECOMPILE_LSR
+#define RECOMPILE_OPERATION_nop RECOMPILE_NOP
+#define RECOMPILE_OPERATION_ora RECOMPILE_ORA
+#define RECOMPILE_OPERATION_pha RECOMPILE_PHA
+#define RECOMPILE_OPERATION_php RECOMPILE_PHP
+#define RECOMPILE_OPERATION_pla RECOMPILE_PLA
+#define RECOMPILE_OPERATION_plp RECOMPILE_PLP
+#define RECOMPILE_OPERATION_rol RECOMPILE_ROL
+#define RECOMPILE_OPERATION_ror RECOMPILE_ROR
+#define RECOMPILE_OPERATION_rti RECOMPILE_RTI
+#define RECOMPILE_OPERATION_rts RECOMPILE_RTS
+#define RECOMPILE_OPERATION_sbc RECOMPILE_SBC
+#define RECOMPILE_OPERATION_sec RECOMPILE_SEC
+#define RECOMPILE_OPERATION_sed RECOMPILE_SED
+#define RECOMPILE_OPERATION_sei RECOMPILE_SEI
+#define RECOMPILE_OPERATION_sta RECOMPILE_STA
+#define RECOMPILE_OPERATION_stx RECOMPILE_STX
+#define RECOMPILE_OPERATION_sty RECOMPILE_STY
+#define RECOMPILE_OPERATION_tax RECOMPILE_TAX
+#define RECOMPILE_OPERATION_tay RECOMPILE_TAY
+#define RECOMPILE_OPERATION_tsx RECOMPILE_TSX
+#define RECOMPILE_OPERATION_txa RECOMPILE_TXA
+#define RECOMPILE_OPERATION_txs RECOMPILE_TXS
+#define RECOMPILE_OPERATION_tya RECOMPILE_TYA
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Operations the recompiler generates code for
+typedef enum {
+    RECOMPILE_ADC, RECOMPILE_AND, RECOMPILE_ASL, RECOMPILE_BCC, RECOMPILE_BCS, RECOMPILE_BEQ, RECOMPILE_BIT, RECOMPILE_BMI,
+    RECOMPILE_BNE, RECOMPILE_BPL, RECOMPILE_BRK, RECOMPILE_BVC, RECOMPILE_BVS, RECOMPILE_CLC, RECOMPILE_CLD, RECOMPILE_CLI,
+    RECOMPILE_CLV, RECOMPILE_CMP, RECOMPILE_CPX, RECOMPILE_CPY, RECOMPILE_DEC, RECOMPILE_DEX, RECOMPILE_DEY, RECOMPILE_EOR,
+    RECOMPILE_INC, RECOMPILE_INX, RECOMPILE_INY, RECOMPILE_JMP, RECOMPILE_JSR, RECOMPILE_LDA, RECOMPILE_LDX, RECOMPILE_LDY,
+    RECOMPILE_LSR, RECOMPILE_NOP, RECOMPILE_ORA, RECOMPILE_PHA, RECOMPILE_PHP, RECOMPILE_PLA, RECOMPILE_PLP, RECOMPILE_ROL,
+    RECOMPILE_ROR, RECOMPILE_RTI, RECOMPILE_RTS, RECOMPILE_SBC, RECOMPILE_SEC, RECOMPILE_SED, RECOMPILE_SEI, RECOMPILE_STA,
+    RECOMPILE_STX, RECOMPILE_STY, RECOMPILE_TAX, RECOMPILE_TAY, RECOMPILE_TSX, RECOMPILE_TXA, RECOMPILE_TXS, RECOMPILE_TYA
+} t_recompile_operation;
+
+// What the recompiler needs to know about an opcode, the mnemonic is NULL for unsupported opcodes
+typedef struct t_struct_recompile_opcode {
+    const char *mnemonic;
+    t_recompile_operation operation;
+    t_memory_access mode;
+    unsigned char length;
+    unsigned char cycles;
+} t_recompile_opcode;
+
+// Recompiler working on one image
+typedef struct t_struct_recompiler {
+    const unsigned char *image;
+    unsigned int size;
+    unsigned int base;
+    FILE *output;
+    t_recompiler_result *result;
+    unsigned char flags[MOS_6502_MEM_SIZE];
+    // Addresses still to be followed
+    unsigned short queue[MOS_6502_MEM_SIZE];
+    unsigned int queue_count;
+} t_recompiler;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+#define RECOMPILE_ENTRY(code, mnemonic, handler, mode, length, base_cycles) \
+    [code] = { mnemonic, RECOMPILE_OPERATION_##handler, mode, length, base_cycles },
+static const t_recompile_opcode recompile_opcodes[OPCODE_TABLE_SIZE] = {
+    MOS_6502_OPCODE_TABLE(RECOMPILE_ENTRY)
+};
+#undef RECOMPILE_ENTRY
+
+// Start of every generated module. The registers live in local variables, and the flags work the same way as in the
+// interpreter: negative and zero come from the last result, with bit 8 standing in for bit 7 when both are set.
+static const char module_preamble[] =
+    "#include \"mos6502_emulator.h\"\n"
+    "\n"
+    "#if MOS_6502_CYCLE_COUNTING\n"
+    "#define CYCLES(count) (cycles += (count))\n"
+    "#else\n"
+    "#define CYCLES(count) ((void) 0)\n"
+    "#endif\n"
+    "\n"
+    "#define READ(location) read_bus_mos6502(bus, (unsigned short) (location))\n"
+    "#define WRITE(location, byte) write_bus_mos6502(bus, (unsigned short) (location), (unsigned char) (byte))\n"
+    "#define PUSH(byte) (WRITE(STACK_BASE_ADDR + sp, byte), sp--)\n"
+    "#define PULL() (sp++, READ(STACK_BASE_ADDR + sp))\n"
+    "\n"
+    "#define PACK_STATUS() ((unsigned char) ((p & ~(STATUS_NEGATIVE | STATUS_ZERO)) | \\\n"
+    "                                        (((nz & 0xFF) == 0) ? STATUS_ZERO : 0) | ((nz & 0x180) ? STATUS_NEGATIVE : 0)))\n"
+    "#define UNPACK_STATUS(byte) (p = (unsigned char) ((byte) & ~STATUS_UNUSED), \\\n"
+    "                             nz = (((byte) & STATUS_NEGATIVE) << 1) | (~(byte) & STATUS_ZERO))\n"
+    "\n"
+    "#define LOAD_REGISTERS() (pc = registers->program_counter, a = registers->accumulator, x = registers->register_x, \\\n"
+    "                          y = registers->register_y, sp = registers->stack_pointer, cycles = registers->cycles, \\\n"
+    "                          UNPACK_STATUS(registers->processor_status))\n"
+    "#define STORE_REGISTERS() (registers->program_counter = pc, registers->accumulator = a, registers->register_x = x, \\\n"
+    "                           registers->register_y = y, registers->stack_pointer = sp, registers->cycles = cycles, \\\n"
+    "                           registers->processor_status = PACK_STATUS())\n"
+    "\n"
+    "#define SET_CARRY(bit) (p = (unsigned char) ((p & ~STATUS_CARRY) | ((bit) & STATUS_CARRY)))\n"
+    "#define COMPARE(reg, byte) (difference = (unsigned short) ((reg) - (byte)), SET_CARRY(~difference >> 8), \\\n"
+    "                            nz = difference & 0xFF)\n"
+    "#define SHIFT_LEFT(byte) (SET_CARRY((byte) >> 7), (byte) = (unsigned char) ((byte) << 1), nz = (byte))\n"
+    "#define SHIFT_RIGHT(byte) (SET_CARRY(byte), (byte) = (unsigned char) ((byte) >> 1), nz = (byte))\n"
+    "#define ROTATE_LEFT(byte) (carry = p & STATUS_CARRY, SET_CARRY((byte) >> 7), \\\n"
+    "                           (byte) = (unsigned char) (((byte) << 1) | carry), nz = (byte))\n"
+    "#define ROTATE_RIGHT(byte) (carry = p & STATUS_CARRY, SET_CARRY(byte), \\\n"
+    "                            (byte) = (unsigned char) (((byte) >> 1) | (carry << 7)), nz = (byte))\n"
+    "\n"
+    "#define ADD_BINARY(byte) do { \\\n"
+    "        unsigned int sum_ = a + (byte) + (p & STATUS_CARRY); \\\n"
+    "        p = (unsigned char) ((p & ~STATUS_OVERFLOW) | (((~(a ^ (byte)) & (a ^ sum_)) & 0x80) >> 1)); \\\n"
+    "        SET_CARRY(sum_ >> 8); \\\n"
+    "        a = (unsigned char) sum_; \\\n"
+    "        nz = a; \\\n"
+    "    } while (0)\n"
+    "#define ADD_WITH_CARRY(byte) do { \\\n"
+    "        if (p & STATUS_DECIMAL_MODE) { \\\n"
+    "            unsigned int carry_ = p & STATUS_CARRY; \\\n"
+    "            unsigned char binary_ = (unsigned char) (a + (byte) + carry_); \\\n"
+    "            unsigned int low_ = (a & 0x0F) + ((byte) & 0x0F) + carry_; \\\n"
+    "            low_ = (low_ >= 0x0A) ? ((low_ + 0x06) & 0x0F) + 0x10 : low_; \\\n"
+    "            unsigned int sum_ = (a & 0xF0) + ((byte) & 0xF0) + low_; \\\n"
+    "            p = (unsigned char) ((p & ~STATUS_OVERFLOW) | (((~(a ^ (byte)) & (a ^ sum_)) & 0x80) >> 1)); \\\n"
+    "            nz = ((sum_ & 0x80) << 1) | ((binary_ != 0) << 1); \\\n"
+    "            sum_ = (sum_ >= 0xA0) ? sum_ + 0x60 : sum_; \\\n"
+    "            SET_CARRY(sum_ > 0xFF); \\\n"
+    "            a = (unsigned char) sum_; \\\n"
+    "        } else { \\\n"
+    "            ADD_BINARY(byte); \\\n"
+    "        } \\\n"
+    "    } while (0)\n"
+    "#define SUBTRACT_WITH_BORROW(byte) do { \\\n"
+    "        unsigned char accumulator_ = a; \\\n"
+    "        int borrow_ = (p & STATUS_CARRY) ^ STATUS_CARRY; \\\n"
+    "        ADD_BINARY((unsigned char) ~(byte)); \\\n"
+    "        if (p & STATUS_DECIMAL_MODE) { \\\n"
+    "            int low_ = (accumulator_ & 0x0F) - ((byte) & 0x0F) - borrow_; \\\n"
+    "            low_ = (low_ < 0) ? ((low_ - 0x06) & 0x0F) - 0x10 : low_; \\\n"
+    "            int difference_ = (accumulator_ & 0xF0) - ((byte) & 0xF0) + low_; \\\n"
+    "            a = (unsigned char) ((difference_ < 0) ? difference_ - 0x60 : difference_); \\\n"
+    "        } \\\n"
+    "    } while (0)\n"
+    "\n"
+    "// A block only runs when the interpreter would run all of it with the budget that is left\n"
+    "#define BLOCK_FITS(count, cycles_before_last) (!budget->stop_requested && instructions + (count) <= instruction_end && \\\n"
+    "                                              cycles + (cycles_before_last) < cycle_end)\n"
+    "\n";
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Follows control flow from the entry points
+static void queue_address(t_recompiler *, unsigned int, int);
+static void find_code(t_recompiler *);
+static int is_recoverable(t_recompiler *, unsigned int);
+static unsigned char image_byte(t_recompiler *, unsigned int);
+static unsigned short instruction_operand(t_recompiler *, unsigned int);
+
+// Splits the code into blocks
+static unsigned int walk_block(t_recompiler *, unsigned int, unsigned int *);
+static int is_block_start(t_recompiler *, unsigned int);
+static void split_blocks(t_recompiler *);
+
+// Writes the module
+static void write_module(t_recompiler *, const char *);
+static void write_block(t_recompiler *, unsigned int);
+static void write_instruction(t_recompiler *, unsigned int);
+static void write_address(t_recompiler *, t_memory_access, unsigned short, int);
+static void write_value(t_recompiler *, t_memory_access, unsigned short);
+static void write_goto(t_recompiler *, unsigned int, const char *);
+
+// Properties of operations
+static int ends_block(t_recompile_operation);
+static int is_branch(t_recompile_operation);
+static int reads_operand(t_recompile_operation);
+static unsigned int most_cycles(const t_recompile_opcode *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Recompile an image to C. The vectors are used as entry points when the image covers them, along with any others given.
+// The module has a single function, run_<name>_mos6502(), taking the same arguments as run_mos6502().
+//   Inputs: Image, Image Size, Load Address, Other Entry Points, Number Of Other Entry Points, Module Name, Output File,
+//           Result (filled in, may be NULL)
+//   Output: 0 on success, -1 if the image or name is not valid or there is no entry point
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int recompile_mos6502(const unsigned char *image, unsigned int size, unsigned short address,
+                             const unsigned short *entries, unsigned int entry_count, const char *name, FILE *output,
+                             t_recompiler_result *result) {
+    static const unsigned short vectors[] = { INTERRUPT_HANDLER_1, RESET_LOCATION_1, INTERRUPT_REQUEST_1 };
+    t_recompiler_result unused_result;
+
+    if (size == 0 || size > MOS_6502_MEM_SIZE - (unsigned int) address) {
+        printf("Error: Image of $%X bytes does not fit at $%04X!!\n", size, address);
+        return -1;
+    }
+    if (name[0] == '\0' || strlen(name) > RECOMPILER_MAX_NAME || isdigit((unsigned char) name[0])) {
+        printf("Error: %s is not a valid module name!!\n", name);
+        return -1;
+    }
+    for (const char *next = name; *next != '\0'; next++) {
+        if (!isalnum((unsigned char) *next) && *next != '_') {
+            printf("Error: %s is not a valid module name!!\n", name);
+            return -1;
+        }
+    }
+
+    t_recompiler *r = calloc(1, sizeof(t_recompiler));
+    if (r == NULL) {
+        printf("Error: Could not allocate the recompiler!!\n");
+        return -1;
+    }
+    r->image = image;
+    r->size = size;
+    r->base = address;
+    r->output = output;
+    r->result = (result != NULL) ? result : &unused_result;
+    memset(r->result, 0, sizeof(t_recompiler_result));
+
+    for (unsigned int i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        if (vectors[i] >= r->base && vectors[i] + 2U <= r->base + r->size) {
+            queue_address(r, (image_byte(r, vectors[i] + 1U) << 8) | image_byte(r, vectors[i]), 1);
+            r->result->entry_points++;
+        }
+    }
+    for (unsigned int i = 0; i < entry_count; i++) {
+        queue_address(r, entries[i], 1);
+        r->result->entry_points++;
+    }
+    if (r->result->entry_points == 0) {
+        printf("Error: Image has no vectors and no entry points were given!!\n");
+        free(r);
+        return -1;
+    }
+
+    find_code(r);
+    split_blocks(r);
+    write_module(r, name);
+    free(r);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Adds an address to the ones to follow
+//   Inputs: Recompiler, Address, Starts A Block
+// -------------------------------------------------------------------------------------------------------------------------------
+static void queue_address(t_recompiler *r, unsigned int address, int block_start) {
+    address &= 0xFFFF;
+    if (block_start) {
+        r->flags[address] |= ADDRESS_BLOCK_START;
+    }
+    if (!(r->flags[address] & ADDRESS_QUEUED)) {
+        r->flags[address] |= ADDRESS_QUEUED;
+        r->queue[r->queue_count++] = (unsigned short) address;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Follows control flow from the queued addresses, marking every instruction reached
+//   Inputs: Recompiler
+// -------------------------------------------------------------------------------------------------------------------------------
+static void find_code(t_recompiler *r) {
+    while (r->queue_count != 0) {
+        unsigned int address = r->queue[--r->queue_count];
+
+        if (!is_recoverable(r, address)) {
+            if (address >= r->base && address < r->base + r->size) {
+                r->result->unrecovered++;
+            }
+            continue;
+        }
+        r->flags[address] |= ADDRESS_INSTRUCTION;
+        r->result->instructions++;
+
+        const t_recompile_opcode *opcode = &recompile_opcodes[image_byte(r, address)];
+        unsigned short operand = instruction_operand(r, address);
+        unsigned int next = address + opcode->length;
+        if (is_branch(opcode->operation)) {
+            queue_address(r, next + (signed char) operand, 1);
+            queue_address(r, next, 1);
+        } else if (opcode->operation == RECOMPILE_JMP && opcode->mode == ABSOLUTE) {
+            queue_address(r, operand, 1);
+        } else if (opcode->operation == RECOMPILE_JSR) {
+            // Calls usually return to the instruction after them, so it gets a block for the return to find
+            queue_address(r, operand, 1);
+            queue_address(r, next, 1);
+        } else if (ends_block(opcode->operation)) {
+            r->result->computed_jumps++;
+        } else {
+            queue_address(r, next, 0);
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether the instruction at an address can be recompiled, it must be a supported opcode other than BRK and lie
+// entirely inside the image
+//   Inputs: Recompiler, Address
+//   Output: 1 if it can, 0 if it is left to the interpreter
+// -------------------------------------------------------------------------------------------------------------------------------
+static int is_recoverable(t_recompiler *r, unsigned int address) {
+    if (address < r->base || address >= r->base + r->size) {
+        return 0;
+    }
+    const t_recompile_opcode *opcode = &recompile_opcodes[image_byte(r, address)];
+    return opcode->mnemonic != NULL && opcode->operation != RECOMPILE_BRK && address + opcode->length <= r->base + r->size;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads a byte of the image, 0 outside it
+//   Inputs: Recompiler, Address
+//   Output: Byte
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned char image_byte(t_recompiler *r, unsigned int address) {
+    if (address < r->base || address >= r->base + r->size) {
+        return 0;
+    }
+    return r->image[address - r->base];
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads the operand bytes after an opcode
+//   Inputs: Recompiler, Address Of The Opcode
+//   Output: Operand, a little endian word for three byte instructions
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned short instruction_operand(t_recompiler *r, unsigned int address) {
+    const t_recompile_opcode *opcode = &recompile_opcodes[image_byte(r, address)];
+    if (opcode->length == 2) {
+        return image_byte(r, address + 1);
+    }
+    return (unsigned short) ((image_byte(r, address + 2) << 8) | image_byte(r, address + 1));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Walks the instructions of a block
+//   Inputs: Recompiler, Address Of The First Instruction, Address After The Last Instruction (filled in)
+//   Output: Number of instructions
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int walk_block(t_recompiler *r, unsigned int address, unsigned int *end) {
+    unsigned int count = 0;
+
+    for (;;) {
+        const t_recompile_opcode *opcode = &recompile_opcodes[image_byte(r, address)];
+        unsigned int next = (address + opcode->length) & 0xFFFF;
+        count++;
+        *end = next;
+        if (ends_block(opcode->operation) || count == RECOMPILER_MAX_BLOCK_INSTRUCTIONS ||
+            !(r->flags[next] & ADDRESS_INSTRUCTION) || (r->flags[next] & ADDRESS_BLOCK_START)) {
+            return count;
+        }
+        address = next;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether a block starts at an address
+//   Inputs: Recompiler, Address
+//   Output: 1 if an instruction there starts a block, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int is_block_start(t_recompiler *r, unsigned int address) {
+    return (r->flags[address] & (ADDRESS_INSTRUCTION | ADDRESS_BLOCK_START)) == (ADDRESS_INSTRUCTION | ADDRESS_BLOCK_START);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Starts a new block after every block cut off at the most instructions, until there are no more
+//   Inputs: Recompiler
+// -------------------------------------------------------------------------------------------------------------------------------
+static void split_blocks(t_recompiler *r) {
+    int changed = 1;
+
+    while (changed) {
+        changed = 0;
+        for (unsigned int address = 0; address < MOS_6502_MEM_SIZE; address++) {
+            unsigned int end;
+            if (!is_block_start(r, address)) {
+                continue;
+            }
+            if (walk_block(r, address, &end) == RECOMPILER_MAX_BLOCK_INSTRUCTIONS && (r->flags[end] & ADDRESS_INSTRUCTION) &&
+                !(r->flags[end] & ADDRESS_BLOCK_START)) {
+                r->flags[end] |= ADDRESS_BLOCK_START;
+                changed = 1;
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes the module, a switch on the program counter that starts each block and then the blocks themselves
+//   Inputs: Recompiler, Module Name
+// -------------------------------------------------------------------------------------------------------------------------------
+static void write_module(t_recompiler *r, const char *name) {
+    FILE *out = r->output;
+
+    fprintf(out, "// Recompiled from a $%04X byte image, do not edit. The image must be mapped write protected at $%04X.\n",
+            r->size, r->base);
+    fprintf(out, "//\n// Declare as: extern t_run_status run_%s_mos6502(t_memory_bus *, t_registers *, t_run_budget *);\n\n",
+            name);
+    fputs(module_preamble, out);
+
+    fprintf(out, "extern t_run_status run_%s_mos6502(t_memory_bus *bus, t_registers *registers, t_run_budget *budget) {\n", name);
+    fputs("    t_run_status status = RUN_BUDGET_EXHAUSTED;\n"
+          "    t_run_budget step = { .instruction_limit = 1 };\n"
+          "    unsigned long long instructions = 0;\n"
+          "    unsigned long long instruction_end = (budget->instruction_limit != 0) ? budget->instruction_limit : ~0ULL;\n"
+          "    unsigned long long cycles, start_cycles, cycle_end;\n"
+          "    unsigned short pc, address, base, difference;\n"
+          "    unsigned char a, x, y, sp, p, value, pointer, carry;\n"
+          "    unsigned int nz;\n"
+          "\n"
+          "    (void) address, (void) base, (void) difference, (void) value, (void) pointer, (void) carry;\n"
+          "    if (budget->trace != NULL || budget->profile != NULL || budget->debugger != NULL || budget->coverage != NULL) {\n"
+          "        return run_mos6502(bus, registers, budget);\n"
+          "    }\n"
+          "    LOAD_REGISTERS();\n"
+          "    start_cycles = cycles;\n"
+          "#if MOS_6502_CYCLE_COUNTING\n"
+          "    cycle_end = (budget->cycle_limit != 0) ? start_cycles + budget->cycle_limit : ~0ULL;\n"
+          "#else\n"
+          "    cycle_end = ~0ULL;\n"
+          "#endif\n"
+          "\n"
+          "    for (;;) {\n"
+          "        switch (pc) {\n", out);
+    for (unsigned int address = 0; address < MOS_6502_MEM_SIZE; address++) {
+        if (is_block_start(r, address)) {
+            fprintf(out, "            case 0x%04X: goto block_%04X;\n", address, address);
+            r->result->blocks++;
+        }
+    }
+    fputs("            default: goto interpret;\n"
+          "        }\n"
+          "\n"
+          "    // Anything without a block is run by the interpreter, one instruction at a time\n"
+          "    interpret:\n"
+          "        if (budget->stop_requested) {\n"
+          "            status = RUN_STOPPED;\n"
+          "            break;\n"
+          "        }\n"
+          "        if (instructions >= instruction_end || cycles >= cycle_end) {\n"
+          "            break;\n"
+          "        }\n"
+          "        STORE_REGISTERS();\n"
+          "        status = run_mos6502(bus, registers, &step);\n"
+          "        LOAD_REGISTERS();\n"
+          "        instructions += step.instructions_executed;\n"
+          "        if (status != RUN_BUDGET_EXHAUSTED) {\n"
+          "            break;\n"
+          "        }\n"
+          "        continue;\n", out);
+
+    for (unsigned int address = 0; address < MOS_6502_MEM_SIZE; address++) {
+        if (is_block_start(r, address)) {
+            write_block(r, address);
+        }
+    }
+
+    fputs("    }\n"
+          "\n"
+          "    STORE_REGISTERS();\n"
+          "    budget->instructions_executed = instructions;\n"
+          "    budget->cycles_executed = cycles - start_cycles;\n"
+          "    return status;\n"
+          "}\n", out);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes a block. Its instruction count and base cycles are added up front, so only page crossings and taken branches add
+// cycles as it runs.
+//   Inputs: Recompiler, Address Of The First Instruction
+// -------------------------------------------------------------------------------------------------------------------------------
+static void write_block(t_recompiler *r, unsigned int start) {
+    FILE *out = r->output;
+    unsigned int end;
+    unsigned int count = walk_block(r, start, &end);
+    unsigned int base_cycles = 0;
+    unsigned int cycles_before_last = 0;
+    unsigned int address = start;
+
+    for (unsigned int i = 0; i < count; i++) {
+        const t_recompile_opcode *opcode = &recompile_opcodes[image_byte(r, address)];
+        base_cycles += opcode->cycles;
+        if (i + 1 < count) {
+            cycles_before_last += most_cycles(opcode);
+        }
+        address = (address + opcode->length) & 0xFFFF;
+    }
+
+    fprintf(out, "\n    block_%04X:\n", start);
+    fprintf(out, "        if (!BLOCK_FITS(%u, %u)) {\n", count, cycles_before_last);
+    fprintf(out, "            pc = 0x%04X;\n", start);
+    fputs("            goto interpret;\n"
+          "        }\n", out);
+    fprintf(out, "        instructions += %u;\n", count);
+    fprintf(out, "        CYCLES(%u);\n", base_cycles);
+
+    const t_recompile_opcode *last = NULL;
+    address = start;
+    for (unsigned int i = 0; i < count; i++) {
+        last = &recompile_opcodes[image_byte(r, address)];
+        write_instruction(r, address);
+        address = (address + last->length) & 0xFFFF;
+    }
+    // Blocks ending in a jump have already left, the rest carry on with the next instruction
+    if (!ends_block(last->operation) || is_branch(last->operation)) {
+        write_goto(r, end, "        ");
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes a single instruction
+//   Inputs: Recompiler, Address
+// -------------------------------------------------------------------------------------------------------------------------------
+static void write_instruction(t_recompiler *r, unsigned int address) {
+    FILE *out = r->output;
+    const t_recompile_opcode *opcode = &recompile_opcodes[image_byte(r, address)];
+    unsigned short operand = instruction_operand(r, address);
+    unsigned int next = (address + opcode->length) & 0xFFFF;
+    const char *branch_condition = NULL;
+
+    fprintf(out, "        // $%04X %s\n", address, opcode->mnemonic);
+    if (reads_operand(opcode->operation)) {
+        write_value(r, opcode->mode, operand);
+    }
+    switch (opcode->operation) {
+        case RECOMPILE_LDA: fputs("        a = value;\n        nz = a;\n", out); break;
+        case RECOMPILE_LDX: fputs("        x = value;\n        nz = x;\n", out); break;
+        case RECOMPILE_LDY: fputs("        y = value;\n        nz = y;\n", out); break;
+        case RECOMPILE_STA: write_address(r, opcode->mode, operand, 0); fputs("        WRITE(address, a);\n", out); break;
+        case RECOMPILE_STX: write_address(r, opcode->mode, operand, 0); fputs("        WRITE(address, x);\n", out); break;
+        case RECOMPILE_STY: write_address(r, opcode->mode, operand, 0); fputs("        WRITE(address, y);\n", out); break;
+        case RECOMPILE_TAX: fputs("        x = a;\n        nz = x;\n", out); break;
+        case RECOMPILE_TAY: fputs("        y = a;\n        nz = y;\n", out); break;
+        case RECOMPILE_TXA: fputs("        a = x;\n        nz = a;\n", out); break;
+        case RECOMPILE_TYA: fputs("        a = y;\n        nz = a;\n", out); break;
+        case RECOMPILE_TSX: fputs("        x = sp;\n        nz = x;\n", out); break;
+        case RECOMPILE_TXS: fputs("        sp = x;\n", out); break;
+        case RECOMPILE_PHA: fputs("        PUSH(a);\n", out); break;
+        case RECOMPILE_PHP: fputs("        PUSH(PACK_STATUS() | STATUS_BREAK_COMMAND | STATUS_UNUSED);\n", out); break;
+        case RECOMPILE_PLA: fputs("        a = PULL();\n        nz = a;\n", out); break;
+        case RECOMPILE_PLP: fputs("        value = PULL();\n        UNPACK_STATUS(value);\n", out); break;
+        case RECOMPILE_AND: fputs("        a &= value;\n        nz = a;\n", out); break;
+        case RECOMPILE_EOR: fputs("        a ^= value;\n        nz = a;\n", out); break;
+        case RECOMPILE_ORA: fputs("        a |= value;\n        nz = a;\n", out); break;
+        case RECOMPILE_BIT:
+            fputs("        p = (unsigned char) ((p & ~STATUS_OVERFLOW) | (value & STATUS_OVERFLOW));\n"
+                  "        nz = (a & value) | ((value & STATUS_NEGATIVE) << 1);\n", out);
+            break;
+        case RECOMPILE_ADC: fputs("        ADD_WITH_CARRY(value);\n", out); break;
+        case RECOMPILE_SBC: fputs("        SUBTRACT_WITH_BORROW(value);\n", out); break;
+        case RECOMPILE_CMP: fputs("        COMPARE(a, value);\n", out); break;
+        case RECOMPILE_CPX: fputs("        COMPARE(x, value);\n", out); break;
+        case RECOMPILE_CPY: fputs("        COMPARE(y, value);\n", out); break;
+        case RECOMPILE_INC:
+            write_address(r, opcode->mode, operand, 0);
+            fputs("        value = (unsigned char) (READ(address) + 1);\n"
+                  "        WRITE(address, value);\n"
+                  "        nz = value;\n", out);
+            break;
+        case RECOMPILE_DEC:
+            write_address(r, opcode->mode, operand, 0);
+            fputs("        value = (unsigned char) (READ(address) - 1);\n"
+                  "        WRITE(address, value);\n"
+                  "        nz = value;\n", out);
+            break;
+        case RECOMPILE_INX: fputs("        x++;\n        nz = x;\n", out); break;
+        case RECOMPILE_INY: fputs("        y++;\n        nz = y;\n", out); break;
+        case RECOMPILE_DEX: fputs("        x--;\n        nz = x;\n", out); break;
+        case RECOMPILE_DEY: fputs("        y--;\n        nz = y;\n", out); break;
+        case RECOMPILE_ASL:
+        case RECOMPILE_LSR:
+        case RECOMPILE_ROL:
+        case RECOMPILE_ROR: {
+            const char *shift = (opcode->operation == RECOMPILE_ASL) ? "SHIFT_LEFT" :
+                                (opcode->operation == RECOMPILE_LSR) ? "SHIFT_RIGHT" :
+                                (opcode->operation == RECOMPILE_ROL) ? "ROTATE_LEFT" : "ROTATE_RIGHT";
+            if (opcode->mode == ACCUMULATOR) {
+                fprintf(out, "        %s(a);\n", shift);
+            } else {
+                write_address(r, opcode->mode, operand, 0);
+                fprintf(out, "        value = READ(address);\n        %s(value);\n        WRITE(address, value);\n", shift);
+            }
+            break;
+        }
+        case RECOMPILE_JMP:
+            if (opcode->mode == ABSOLUTE) {
+                write_goto(r, operand, "        ");
+            } else {
+                // The high byte of the pointer is not carried into the page, just like the real processor
+                fprintf(out, "        pc = (unsigned short) ((READ(0x%04X) << 8) | READ(0x%04X));\n        continue;\n",
+                        (operand & 0xFF00) | ((operand + 1) & 0x00FF), operand);
+            }
+            break;
+        case RECOMPILE_JSR:
+            fprintf(out, "        PUSH(0x%02X);\n        PUSH(0x%02X);\n", ((next - 1) >> 8) & 0xFF, (next - 1) & 0xFF);
+            write_goto(r, operand, "        ");
+            break;
+        case RECOMPILE_RTS:
+            fputs("        value = PULL();\n"
+                  "        pc = (unsigned short) ((value | (PULL() << 8)) + 1);\n"
+                  "        continue;\n", out);
+            break;
+        case RECOMPILE_RTI:
+            fputs("        value = PULL();\n"
+                  "        UNPACK_STATUS(value);\n"
+                  "        value = PULL();\n"
+                  "        pc = (unsigned short) (value | (PULL() << 8));\n"
+                  "        continue;\n", out);
+            break;
+        case RECOMPILE_BCC: branch_condition = "!(p & STATUS_CARRY)"; break;
+        case RECOMPILE_BCS: branch_condition = "p & STATUS_CARRY"; break;
+        case RECOMPILE_BEQ: branch_condition = "(nz & 0xFF) == 0"; break;
+        case RECOMPILE_BNE: branch_condition = "(nz & 0xFF) != 0"; break;
+        case RECOMPILE_BMI: branch_condition = "nz & 0x180"; break;
+        case RECOMPILE_BPL: branch_condition = "!(nz & 0x180)"; break;
+        case RECOMPILE_BVC: branch_condition = "!(p & STATUS_OVERFLOW)"; break;
+        case RECOMPILE_BVS: branch_condition = "p & STATUS_OVERFLOW"; break;
+        case RECOMPILE_CLC: fputs("        p &= ~STATUS_CARRY;\n", out); break;
+        case RECOMPILE_CLD: fputs("        p &= ~STATUS_DECIMAL_MODE;\n", out); break;
+        case RECOMPILE_CLI: fputs("        p &= ~STATUS_INTERRUPT_DISABLE;\n", out); break;
+        case RECOMPILE_CLV: fputs("        p &= ~STATUS_OVERFLOW;\n", out); break;
+        case RECOMPILE_SEC: fputs("        p |= STATUS_CARRY;\n", out); break;
+        case RECOMPILE_SED: fputs("        p |= STATUS_DECIMAL_MODE;\n", out); break;
+        case RECOMPILE_SEI: fputs("        p |= STATUS_INTERRUPT_DISABLE;\n", out); break;
+        case RECOMPILE_NOP:
+        case RECOMPILE_BRK:
+            break;
+    }
+
+    if (branch_condition != NULL) {
+        // The target is known here, so whether the branch crosses a page is too
+        unsigned int target = (next + (signed char) operand) & 0xFFFF;
+        fprintf(out, "        if (%s) {\n", branch_condition);
+        fprintf(out, "            CYCLES(%u);\n", 1 + (((target ^ next) >> 8) & 1));
+        write_goto(r, target, "            ");
+        fputs("        }\n", out);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes the effective address of a memory operand into address, adding a cycle when a read crosses a page
+//   Inputs: Recompiler, Addressing Mode, Operand, Page Crossing Penalty
+// -------------------------------------------------------------------------------------------------------------------------------
+static void write_address(t_recompiler *r, t_memory_access mode, unsigned short operand, int page_penalty) {
+    FILE *out = r->output;
+
+    switch (mode) {
+        case ZERO_PAGE:
+        case ABSOLUTE:
+            fprintf(out, "        address = 0x%04X;\n", operand);
+            break;
+        case ZERO_PAGE_X:
+            fprintf(out, "        address = (unsigned char) (0x%02X + x);\n", operand);
+            break;
+        case ZERO_PAGE_Y:
+            fprintf(out, "        address = (unsigned char) (0x%02X + y);\n", operand);
+            break;
+        case ABSOLUTE_X:
+        case ABSOLUTE_Y: {
+            char index = (mode == ABSOLUTE_X) ? 'x' : 'y';
+            if (page_penalty) {
+                fprintf(out, "        CYCLES((0x%02X + %c) >> 8);\n", operand & 0x00FF, index);
+            }
+            fprintf(out, "        address = (unsigned short) (0x%04X + %c);\n", operand, index);
+            break;
+        }
+        case INDEXED_INDIRECT:
+            fprintf(out, "        pointer = (unsigned char) (0x%02X + x);\n", operand);
+            fputs("        address = (unsigned short) ((READ((unsigned char) (pointer + 1)) << 8) | READ(pointer));\n", out);
+            break;
+        case INDIRECT_INDEXED:
+            fprintf(out, "        base = (unsigned short) ((READ(0x%02X) << 8) | READ(0x%02X));\n",
+                    (operand + 1) & 0x00FF, operand);
+            if (page_penalty) {
+                fputs("        CYCLES(((base & 0x00FF) + y) >> 8);\n", out);
+            }
+            fputs("        address = (unsigned short) (base + y);\n", out);
+            break;
+        default:
+            break;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes the value read by an instruction into value, an immediate operand is the value itself
+//   Inputs: Recompiler, Addressing Mode, Operand
+// -------------------------------------------------------------------------------------------------------------------------------
+static void write_value(t_recompiler *r, t_memory_access mode, unsigned short operand) {
+    if (mode == IMMEDIATE) {
+        fprintf(r->output, "        value = 0x%02X;\n", operand & 0x00FF);
+        return;
+    }
+    write_address(r, mode, operand, 1);
+    fputs("        value = READ(address);\n", r->output);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes a jump to a known address, straight to its block when it has one and to the interpreter when it does not
+//   Inputs: Recompiler, Target, Indent
+// -------------------------------------------------------------------------------------------------------------------------------
+static void write_goto(t_recompiler *r, unsigned int target, const char *indent) {
+    target &= 0xFFFF;
+    if (is_block_start(r, target)) {
+        fprintf(r->output, "%sgoto block_%04X;\n", indent, target);
+    } else {
+        fprintf(r->output, "%spc = 0x%04X;\n%sgoto interpret;\n", indent, target, indent);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether an operation ends a block
+//   Inputs: Operation
+//   Output: 1 for branches, jumps, calls and returns, 0 for anything else
+// -------------------------------------------------------------------------------------------------------------------------------
+static int ends_block(t_recompile_operation operation) {
+    return is_branch(operation) || operation == RECOMPILE_JMP || operation == RECOMPILE_JSR || operation == RECOMPILE_RTS ||
+           operation == RECOMPILE_RTI || operation == RECOMPILE_BRK;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether an operation is a conditional branch
+//   Inputs: Operation
+//   Output: 1 if it is, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int is_branch(t_recompile_operation operation) {
+    return operation == RECOMPILE_BCC || operation == RECOMPILE_BCS || operation == RECOMPILE_BEQ || operation == RECOMPILE_BNE ||
+           operation == RECOMPILE_BMI || operation == RECOMPILE_BPL || operation == RECOMPILE_BVC || operation == RECOMPILE_BVS;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether an operation only reads its operand. Those take a cycle more when an indexed address crosses a page, stores
+// and read-modify-write instructions always take it so it is already part of their base cycles.
+//   Inputs: Operation
+//   Output: 1 if it does, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int reads_operand(t_recompile_operation operation) {
+    switch (operation) {
+        case RECOMPILE_LDA: case RECOMPILE_LDX: case RECOMPILE_LDY: case RECOMPILE_AND: case RECOMPILE_EOR:
+        case RECOMPILE_ORA: case RECOMPILE_BIT: case RECOMPILE_ADC: case RECOMPILE_SBC: case RECOMPILE_CMP:
+        case RECOMPILE_CPX: case RECOMPILE_CPY:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Works out the most cycles an instruction can take
+//   Inputs: Opcode
+//   Output: Base cycles plus a page crossing or a taken branch to another page
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int most_cycles(const t_recompile_opcode *opcode) {
+    if (is_branch(opcode->operation)) {
+        return opcode->cycles + 2;
+    }
+    if (reads_operand(opcode->operation) &&
+        (opcode->mode == ABSOLUTE_X || opcode->mode == ABSOLUTE_Y || opcode->mode == INDIRECT_INDEXED)) {
+        return opcode->cycles + 1;
+    }
+    return opcode->cycles;
+}
@@ -0,0 +1,68 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Static Recompiler Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_recompiler.h
+//
+// Description:
+//   Contains the data types and function prototypes for the static recompiler, which turns a firmware image into C ahead of
+//   time. The code is found by following control flow from the reset, interrupt and non maskable interrupt vectors, and
+//   from any other entry points given, through branches, jumps and subroutine calls. Each basic block found becomes straight
+//   line C that keeps the registers in local variables and reads and writes memory through the bus, like the interpreter.
+//
+//   The generated module has a single function with the same arguments and results as run_mos6502(). It runs a block only
+//   when the whole of it fits in the budget, and anything it has no block for is stepped through run_mos6502() one
+//   instruction at a time: jumps through a pointer and returns to places no call was seen from, code outside the image or
+//   not reached from an entry point, BRK and unsupported opcodes. A run gives exactly the same machine as the interpreter.
+//
+//   The generated code assumes the image never changes, so it must be mapped write protected at the address it was
+//   recompiled for. Runs with a trace, profile, debugger or coverage are handed to run_mos6502() whole.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_RECOMPILER_H
+#define MOS_6502_RECOMPILER_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most instructions in a single block, longer runs are split so a block near the end of a budget still fits
+#define RECOMPILER_MAX_BLOCK_INSTRUCTIONS 64
+
+// Longest name of a generated module
+#define RECOMPILER_MAX_NAME 64
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// What the recompiler found in an image
+typedef struct t_struct_recompiler_result {
+    unsigned int entry_points;
+    unsigned int instructions;
+    unsigned int blocks;
+    // Instructions that end a block and leave the rest to the interpreter: BRK, unsupported opcodes and ones cut off by the
+    // end of the image
+    unsigned int unrecovered;
+    // Jumps through a pointer, returns and returns from interrupts, whose targets are only known when they run
+    unsigned int computed_jumps;
+} t_recompiler_result;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Recompile An Image To C
+extern int recompile_mos6502(const unsigned char *, unsigned int, unsigned short, const unsigned short *, unsigned int,
+                             const char *, FILE *, t_recompiler_result *);
+
+#endif // MOS_6502_RECOMPILER_H
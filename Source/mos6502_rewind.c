@@ -0,0 +1,572 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Rewind
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_rewind.c
+//
+// Description:
+//   Encodes save states and the deltas between them, saves and loads save state files, and keeps the rewind buffer that
+//   lets a machine be put back to any cycle in its recent history
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local
+#include "mos6502_rewind.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Encodes and applies records
+static unsigned int encode_state(t_memory_bus *, t_registers *, unsigned int, t_rewind *, unsigned char *);
+static unsigned int encode_page(const unsigned char *, const unsigned char *, unsigned char *);
+static int apply_state(t_memory_bus *, t_registers *, const unsigned char *, unsigned int);
+static int is_ram_page(t_memory_bus *, unsigned int);
+
+// Keeps the ring
+static t_rewind_record *nth_record(t_rewind *, unsigned int);
+static int find_space(t_rewind *, unsigned int, unsigned long long *);
+static void drop_oldest_keyframe(t_rewind *);
+static int mapping_changed(t_rewind *, t_memory_bus *);
+static void remember_pages(t_rewind *, t_memory_bus *, unsigned int);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Save the registers and every RAM page of a machine to a file
+//   Inputs: Memory Bus, Registers, File Path
+//   Output: 0 on success, -1 if the file could not be written
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int save_state_mos6502(t_memory_bus *bus, t_registers *registers, const char *path) {
+    unsigned char header[SAVE_STATE_FILE_HEADER_SIZE];
+
+    unsigned char *state = malloc(STATE_MAX_RECORD_SIZE);
+    if (state == NULL) {
+        printf("Error: Could not allocate a save state!!\n");
+        return -1;
+    }
+    unsigned int size = encode_state(bus, registers, STATE_KEYFRAME, NULL, state);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Error: Could not create save state file %s!!\n", path);
+        free(state);
+        return -1;
+    }
+
+    // The version and size are stored a byte at a time, low byte first, just like the keyframe
+    memcpy(header, SAVE_STATE_FILE_MAGIC, 8);
+    for (unsigned int i = 0; i < 4; i++) {
+        header[8 + i] = (unsigned char) (SAVE_STATE_FILE_VERSION >> (8 * i));
+        header[12 + i] = (unsigned char) (size >> (8 * i));
+    }
+    int written = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(state, size, 1, file) == 1;
+    free(state);
+    if (fclose(file) != 0 || !written) {
+        printf("Error: Could not write save state file %s!!\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Load a save state written by save_state_mos6502(). Pages are loaded into whatever RAM the bus has mapped at the same
+// addresses now, pages saved from RAM that is not mapped any more are skipped.
+//   Inputs: Memory Bus, Registers, File Path
+//   Output: 0 on success, -1 if the file could not be read or is not a save state
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int load_state_mos6502(t_memory_bus *bus, t_registers *registers, const char *path) {
+    unsigned char header[SAVE_STATE_FILE_HEADER_SIZE];
+    unsigned int version = 0;
+    unsigned int state_size = 0;
+    unsigned char *state = NULL;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: Could not open save state file %s!!\n", path);
+        return -1;
+    }
+
+    int read = fread(header, sizeof(header), 1, file) == 1 && memcmp(header, SAVE_STATE_FILE_MAGIC, 8) == 0;
+    for (unsigned int i = 0; read && i < 4; i++) {
+        version |= (unsigned int) header[8 + i] << (8 * i);
+        state_size |= (unsigned int) header[12 + i] << (8 * i);
+    }
+    read = read && version == SAVE_STATE_FILE_VERSION && state_size >= STATE_HEADER_SIZE &&
+           state_size <= STATE_MAX_RECORD_SIZE && (state = malloc(state_size)) != NULL &&
+           fread(state, state_size, 1, file) == 1 && state[0] == STATE_KEYFRAME;
+    fclose(file);
+
+    // The state is checked before anything is written, so a bad file leaves the machine alone
+    t_registers loaded;
+    if (!read || apply_state(NULL, &loaded, state, state_size) != 0) {
+        printf("Error: %s is not a save state this version can read!!\n", path);
+        free(state);
+        return -1;
+    }
+    apply_state(bus, registers, state, state_size);
+    free(state);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize an empty rewind buffer. The first capture is always a keyframe.
+//   Inputs: Rewind Buffer, Size Of The Ring In Bytes, Cycles Between Captures, Captures From One Keyframe To The Next
+//   Output: 0 on success, -1 if the ring could not be allocated or is too small for a keyframe
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int init_rewind_mos6502(t_rewind *rewind, unsigned long long buffer_size, unsigned long long capture_interval,
+                               unsigned int keyframe_interval) {
+    memset(rewind, 0, sizeof(t_rewind));
+
+    if (buffer_size < STATE_MAX_RECORD_SIZE) {
+        printf("Error: A rewind buffer needs at least %d bytes!!\n", STATE_MAX_RECORD_SIZE);
+        return -1;
+    }
+
+    rewind->buffer_size = buffer_size;
+    rewind->record_capacity = (unsigned int) (buffer_size / REWIND_BYTES_PER_RECORD);
+    rewind->capture_interval = (capture_interval != 0) ? capture_interval : 1;
+    rewind->keyframe_interval = (keyframe_interval != 0) ? keyframe_interval : 1;
+    rewind->buffer = malloc(buffer_size);
+    rewind->records = malloc(rewind->record_capacity * sizeof(t_rewind_record));
+    rewind->scratch = malloc(STATE_MAX_RECORD_SIZE);
+    if (rewind->buffer == NULL || rewind->records == NULL || rewind->scratch == NULL) {
+        printf("Error: Could not allocate a rewind buffer of %llu bytes!!\n", buffer_size);
+        free_rewind_mos6502(rewind);
+        return -1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Free the ring of a rewind buffer
+//   Inputs: Rewind Buffer
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void free_rewind_mos6502(t_rewind *rewind) {
+    free(rewind->buffer);
+    free(rewind->records);
+    free(rewind->scratch);
+    rewind->buffer = NULL;
+    rewind->records = NULL;
+    rewind->scratch = NULL;
+    rewind->record_count = 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Capture the machine now and make the next capture due a capture interval from now. The capture is a keyframe when one is
+// due, when the bus has been tracked by something else or had its RAM mapped differently since the last capture, and when
+// making room for a delta would drop the keyframe it depends on.
+//   Inputs: Rewind Buffer, Memory Bus, Registers
+//   Output: 0 on success, -1 if the rewind buffer has no ring
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int capture_rewind_mos6502(t_rewind *rewind, t_memory_bus *bus, t_registers *registers) {
+    if (rewind->buffer == NULL) {
+        printf("Error: The rewind buffer has not been initialized!!\n");
+        return -1;
+    }
+
+    unsigned int kind = STATE_DELTA;
+    if (rewind->record_count == 0 || rewind->captures_since_keyframe + 1 >= rewind->keyframe_interval ||
+        bus->dirty_tracker != rewind || mapping_changed(rewind, bus)) {
+        kind = STATE_KEYFRAME;
+    }
+    unsigned int size = encode_state(bus, registers, kind, rewind, rewind->scratch);
+
+    unsigned long long offset;
+    while (!find_space(rewind, size, &offset)) {
+        // The newest keyframe is the oldest record, so the delta could not be applied once there is room for it
+        if (kind == STATE_DELTA && rewind->captures_since_keyframe + 1 == rewind->record_count) {
+            kind = STATE_KEYFRAME;
+            size = encode_state(bus, registers, kind, rewind, rewind->scratch);
+        }
+        drop_oldest_keyframe(rewind);
+    }
+
+    memcpy(&rewind->buffer[offset], rewind->scratch, size);
+    t_rewind_record *record = nth_record(rewind, rewind->record_count++);
+    record->offset = offset;
+    record->cycles = registers->cycles;
+    record->size = size;
+    record->kind = kind;
+    rewind->write_offset = offset + size;
+    rewind->bytes_used += size;
+
+    if (kind == STATE_KEYFRAME) {
+        rewind->captures_since_keyframe = 0;
+        rewind->keyframes++;
+    } else {
+        rewind->captures_since_keyframe++;
+        rewind->deltas++;
+    }
+    remember_pages(rewind, bus, kind);
+    rewind->next_capture = registers->cycles + rewind->capture_interval;
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs instructions like run_mos6502(), or run_cached_mos6502() when a block cache is given, capturing the machine each
+// time a capture comes due. The processor is run with a cycle budget ending at the next capture, and the budget's own limits
+// cover the whole call.
+//   Inputs: Rewind Buffer, Block Cache (NULL for the interpreter), Memory Bus, Registers, Budget
+//   Output: Reason for returning
+// -------------------------------------------------------------------------------------------------------------------------------
+extern t_run_status run_rewind_mos6502(t_rewind *rewind, t_block_cache *cache, t_memory_bus *bus, t_registers *registers,
+                                       t_run_budget *budget) {
+    t_run_status status = RUN_BUDGET_EXHAUSTED;
+    unsigned long long instruction_limit = budget->instruction_limit;
+    unsigned long long cycle_limit = budget->cycle_limit;
+    unsigned long long start_cycles = registers->cycles;
+    unsigned long long instructions = 0;
+
+#if !MOS_6502_CYCLE_COUNTING
+    printf("Error: The rewind buffer needs cycle counting!!\n");
+    budget->instructions_executed = 0;
+    budget->cycles_executed = 0;
+    return RUN_STOPPED;
+#endif
+
+    for (;;) {
+        if (rewind->record_count == 0 || registers->cycles >= rewind->next_capture) {
+            if (capture_rewind_mos6502(rewind, bus, registers) != 0) {
+                status = RUN_STOPPED;
+                break;
+            }
+        }
+
+        if (budget->stop_requested) {
+            status = RUN_STOPPED;
+            break;
+        }
+        if ((instruction_limit != 0 && instructions >= instruction_limit) ||
+            (cycle_limit != 0 && registers->cycles - start_cycles >= cycle_limit)) {
+            break;
+        }
+
+        // Run up to the next capture, or the end of the host's budget when that comes first
+        unsigned long long cycles = rewind->next_capture - registers->cycles;
+        if (cycle_limit != 0 && start_cycles + cycle_limit - registers->cycles < cycles) {
+            cycles = start_cycles + cycle_limit - registers->cycles;
+        }
+        budget->instruction_limit = (instruction_limit != 0) ? instruction_limit - instructions : 0;
+        budget->cycle_limit = cycles;
+
+        if (cache != NULL) {
+            status = run_cached_mos6502(cache, bus, registers, budget);
+        } else {
+            status = run_mos6502(bus, registers, budget);
+        }
+        instructions += budget->instructions_executed;
+        budget->instruction_limit = instruction_limit;
+        budget->cycle_limit = cycle_limit;
+        if (status != RUN_BUDGET_EXHAUSTED) {
+            break;
+        }
+    }
+
+    budget->instructions_executed = instructions;
+    budget->cycles_executed = registers->cycles - start_cycles;
+    return status;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Put the machine back to an earlier cycle. The keyframe before it is put back, the captures after the keyframe are applied
+// up to the last one before the cycle, and the rest is replayed with the interpreter, stopping at the first instruction
+// boundary at or after the cycle. Captures after the cycle are dropped, as running on from here makes a new history.
+//   Inputs: Rewind Buffer, Memory Bus, Registers, Cycle Count To Go Back To
+//   Output: 0 on success, -1 if the cycle is not in the history or the replay stopped before reaching it
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int seek_rewind_mos6502(t_rewind *rewind, t_memory_bus *bus, t_registers *registers, unsigned long long cycle) {
+    if (rewind->record_count == 0 || cycle < nth_record(rewind, 0)->cycles || cycle > registers->cycles) {
+        printf("Error: Cycle %llu is not in the rewind history!!\n", cycle);
+        return -1;
+    }
+
+    unsigned int newest = rewind->record_count - 1;
+    while (nth_record(rewind, newest)->cycles > cycle) {
+        newest--;
+    }
+    unsigned int keyframe = newest;
+    while (nth_record(rewind, keyframe)->kind != STATE_KEYFRAME) {
+        keyframe--;
+    }
+
+    for (unsigned int i = keyframe; i <= newest; i++) {
+        t_rewind_record *record = nth_record(rewind, i);
+        if (apply_state(bus, registers, &rewind->buffer[record->offset], record->size) != 0) {
+            printf("Error: Rewind record at cycle %llu is corrupt!!\n", record->cycles);
+            return -1;
+        }
+    }
+
+    for (unsigned int i = newest + 1; i < rewind->record_count; i++) {
+        rewind->bytes_used -= nth_record(rewind, i)->size;
+        rewind->records_dropped++;
+    }
+    t_rewind_record *record = nth_record(rewind, newest);
+    rewind->record_count = newest + 1;
+    rewind->write_offset = record->offset + record->size;
+    rewind->captures_since_keyframe = newest - keyframe;
+    rewind->next_capture = record->cycles + rewind->capture_interval;
+
+    // The pages now hold the newest capture, so the next delta is taken against them
+    remember_pages(rewind, bus, STATE_KEYFRAME);
+
+    t_run_budget budget = { 0 };
+    while (registers->cycles < cycle) {
+        budget.cycle_limit = cycle - registers->cycles;
+        if (run_mos6502(bus, registers, &budget) != RUN_BUDGET_EXHAUSTED) {
+            break;
+        }
+    }
+    if (registers->cycles < cycle) {
+        printf("Error: Replay stopped at cycle %llu before reaching cycle %llu!!\n", registers->cycles, cycle);
+        return -1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Encodes the registers and the RAM pages of a machine. A keyframe holds every RAM page, a delta holds the XOR of each page
+// written since the last capture with its contents then, leaving out pages that are the same.
+//   Inputs: Memory Bus, Registers, Record Kind, Rewind Buffer (only for deltas), Output (STATE_MAX_RECORD_SIZE bytes)
+//   Output: Size of the record
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int encode_state(t_memory_bus *bus, t_registers *registers, unsigned int kind, t_rewind *rewind, unsigned char *output) {
+    unsigned int size = STATE_HEADER_SIZE;
+    unsigned int page_count = 0;
+
+    for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+        if (!is_ram_page(bus, i)) {
+            continue;
+        }
+        const unsigned char *data = bus->pages[i].data;
+        const unsigned char *reference = NULL;
+        if (kind == STATE_DELTA) {
+            reference = &rewind->shadow[i * MEMORY_PAGE_SIZE];
+            if (!page_is_dirty_mos6502(bus, (unsigned char) i) || memcmp(data, reference, MEMORY_PAGE_SIZE) == 0) {
+                continue;
+            }
+        }
+        output[size++] = (unsigned char) i;
+        size += encode_page(data, reference, &output[size]);
+        page_count++;
+    }
+
+    // Every field is stored a byte at a time, low byte first, so files can be moved between hosts
+    output[0] = (unsigned char) kind;
+    output[1] = (unsigned char) registers->program_counter;
+    output[2] = (unsigned char) (registers->program_counter >> 8);
+    output[3] = registers->stack_pointer;
+    output[4] = registers->accumulator;
+    output[5] = registers->register_x;
+    output[6] = registers->register_y;
+    output[7] = registers->processor_status;
+    for (unsigned int i = 0; i < 8; i++) {
+        output[8 + i] = (unsigned char) (registers->cycles >> (8 * i));
+    }
+    output[16] = (unsigned char) page_count;
+    output[17] = (unsigned char) (page_count >> 8);
+    return size;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Run length encodes a page, or its XOR with a reference page. Each run is a count of zero bytes followed by a count of
+// bytes stored as they are and those bytes. A lone zero is cheaper stored than ending the run, so it is kept in the run.
+//   Inputs: Page, Reference Page (NULL for none), Output (at least 2 * MEMORY_PAGE_SIZE bytes)
+//   Output: Number of bytes written
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int encode_page(const unsigned char *data, const unsigned char *reference, unsigned char *output) {
+    unsigned char page[MEMORY_PAGE_SIZE];
+    unsigned int size = 0;
+
+    for (unsigned int i = 0; i < MEMORY_PAGE_SIZE; i++) {
+        page[i] = (reference != NULL) ? data[i] ^ reference[i] : data[i];
+    }
+
+    unsigned int i = 0;
+    while (i < MEMORY_PAGE_SIZE) {
+        unsigned int zeros = 0;
+        while (i < MEMORY_PAGE_SIZE && page[i] == 0 && zeros < 255) {
+            zeros++;
+            i++;
+        }
+        unsigned int start = i;
+        while (i < MEMORY_PAGE_SIZE && i - start < 255 && (page[i] != 0 || (i + 1 < MEMORY_PAGE_SIZE && page[i + 1] != 0))) {
+            i++;
+        }
+        output[size++] = (unsigned char) zeros;
+        output[size++] = (unsigned char) (i - start);
+        memcpy(&output[size], &page[start], i - start);
+        size += i - start;
+    }
+    return size;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Applies a record to a machine. A keyframe sets the registers and RAM pages, a delta sets the registers and XORs its pages
+// into RAM. Pages that are not RAM now are skipped. Without a bus the record is only checked.
+//   Inputs: Memory Bus (NULL to only check the record), Registers, Record, Size Of The Record
+//   Output: 0 on success, -1 if the record is corrupt
+// -------------------------------------------------------------------------------------------------------------------------------
+static int apply_state(t_memory_bus *bus, t_registers *registers, const unsigned char *state, unsigned int size) {
+    unsigned char discard[MEMORY_PAGE_SIZE];
+
+    if (size < STATE_HEADER_SIZE || (state[0] != STATE_KEYFRAME && state[0] != STATE_DELTA)) {
+        return -1;
+    }
+    registers->program_counter = (unsigned short) (state[1] | (state[2] << 8));
+    registers->stack_pointer = state[3];
+    registers->accumulator = state[4];
+    registers->register_x = state[5];
+    registers->register_y = state[6];
+    registers->processor_status = state[7];
+    registers->cycles = 0;
+    for (unsigned int i = 0; i < 8; i++) {
+        registers->cycles |= (unsigned long long) state[8 + i] << (8 * i);
+    }
+    unsigned int page_count = state[16] | (state[17] << 8);
+
+    unsigned int position = STATE_HEADER_SIZE;
+    for (unsigned int page = 0; page < page_count; page++) {
+        if (position >= size) {
+            return -1;
+        }
+        unsigned int page_number = state[position++];
+        unsigned char *data = (bus != NULL && is_ram_page(bus, page_number)) ? bus->pages[page_number].data : discard;
+        if (state[0] == STATE_KEYFRAME) {
+            memset(data, 0, MEMORY_PAGE_SIZE);
+        }
+
+        unsigned int filled = 0;
+        while (filled < MEMORY_PAGE_SIZE) {
+            if (position + 2 > size) {
+                return -1;
+            }
+            unsigned int zeros = state[position];
+            unsigned int literals = state[position + 1];
+            position += 2;
+            if ((zeros == 0 && literals == 0) || filled + zeros + literals > MEMORY_PAGE_SIZE || position + literals > size) {
+                return -1;
+            }
+            filled += zeros;
+            for (unsigned int i = 0; i < literals; i++) {
+                data[filled++] ^= state[position++];
+            }
+        }
+
+        // The copy does not go through the bus, so code decoded from the page has to be thrown away here
+        if (data != discard) {
+            invalidate_code_page_mos6502(bus, (unsigned char) page_number);
+        }
+    }
+    return (position == size) ? 0 : -1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether a page is RAM, the only pages saved
+//   Inputs: Memory Bus, Page Number
+//   Output: 1 if the page is RAM, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int is_ram_page(t_memory_bus *bus, unsigned int page_number) {
+    return bus->pages[page_number].data != NULL && !(bus->pages[page_number].flags & PAGE_WRITE_PROTECT);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Finds a record in the index
+//   Inputs: Rewind Buffer, Position Of The Record, 0 for the oldest
+//   Output: Record
+// -------------------------------------------------------------------------------------------------------------------------------
+static t_rewind_record *nth_record(t_rewind *rewind, unsigned int position) {
+    return &rewind->records[(rewind->first_record + position) % rewind->record_capacity];
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Finds room for a new record after the newest one, starting again at the front of the ring when it does not fit before
+// the end
+//   Inputs: Rewind Buffer, Size Of The Record, Offset (filled in)
+//   Output: 1 if there is room, 0 if older records have to be dropped first
+// -------------------------------------------------------------------------------------------------------------------------------
+static int find_space(t_rewind *rewind, unsigned int size, unsigned long long *offset) {
+    if (rewind->record_count == 0) {
+        *offset = 0;
+        return 1;
+    }
+    if (rewind->record_count == rewind->record_capacity) {
+        return 0;
+    }
+
+    unsigned long long oldest = nth_record(rewind, 0)->offset;
+    if (rewind->write_offset > oldest) {
+        if (rewind->write_offset + size <= rewind->buffer_size) {
+            *offset = rewind->write_offset;
+            return 1;
+        }
+        *offset = 0;
+        return size <= oldest;
+    }
+    *offset = rewind->write_offset;
+    return rewind->write_offset + size <= oldest;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Drops the oldest keyframe and every delta up to the next keyframe
+//   Inputs: Rewind Buffer
+// -------------------------------------------------------------------------------------------------------------------------------
+static void drop_oldest_keyframe(t_rewind *rewind) {
+    do {
+        rewind->bytes_used -= nth_record(rewind, 0)->size;
+        rewind->first_record = (rewind->first_record + 1) % rewind->record_capacity;
+        rewind->record_count--;
+        rewind->records_dropped++;
+    } while (rewind->record_count != 0 && nth_record(rewind, 0)->kind != STATE_KEYFRAME);
+
+    if (rewind->record_count == 0) {
+        rewind->write_offset = 0;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether any page maps different RAM than at the last capture. The bus marks RAM mapped since then dirty, but a delta
+// is the XOR against the shadow of the RAM mapped before, so only a keyframe can capture it. RAM switched out and back in
+// maps the same memory again and is caught as dirty by a delta.
+//   Inputs: Rewind Buffer, Memory Bus
+//   Output: 1 if the RAM mapping changed, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int mapping_changed(t_rewind *rewind, t_memory_bus *bus) {
+    for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+        if (rewind->page_data[i] != (is_ram_page(bus, i) ? bus->pages[i].data : NULL)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Copies the pages just captured into the shadow, and marks them clean so the next capture only holds pages written after
+// this one. After a keyframe every RAM page is copied and the bus starts tracking this rewind buffer again.
+//   Inputs: Rewind Buffer, Memory Bus, Record Kind
+// -------------------------------------------------------------------------------------------------------------------------------
+static void remember_pages(t_rewind *rewind, t_memory_bus *bus, unsigned int kind) {
+    for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+        if (!is_ram_page(bus, i)) {
+            rewind->page_data[i] = NULL;
+        } else if (kind == STATE_KEYFRAME || page_is_dirty_mos6502(bus, (unsigned char) i)) {
+            memcpy(&rewind->shadow[i * MEMORY_PAGE_SIZE], bus->pages[i].data, MEMORY_PAGE_SIZE);
+            rewind->page_data[i] = bus->pages[i].data;
+            if (kind == STATE_DELTA) {
+                clean_page_mos6502(bus, (unsigned char) i);
+            }
+        }
+    }
+
+    if (kind == STATE_KEYFRAME) {
+        track_dirty_pages_mos6502(bus, rewind);
+    }
+}
@@ -0,0 +1,125 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Rewind Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_rewind.h
+//
+// Description:
+//   Contains the data types and function prototypes for save states and the rewind buffer. A save state holds the registers
+//   and every RAM page, each page run length encoded so that empty memory takes almost no space. It can be written to a
+//   file and loaded back into a machine later.
+//
+//   The rewind buffer captures the machine every so many cycles into a ring of a fixed number of bytes. Every few captures
+//   is a keyframe holding a whole save state, the ones in between only hold the pages written since the last capture, as
+//   the XOR of their old and new contents run length encoded. The dirty page tracking of the bus finds those pages, so a
+//   capture costs next to nothing for pages that were not written. When the ring is full the oldest keyframe is dropped
+//   along with the captures that depend on it, so the history always starts at a keyframe.
+//
+//   Seeking to an earlier cycle puts back the keyframe before it, applies the captures up to it and replays the rest with
+//   the interpreter. Devices and bank switching are not captured, so replaying only gives the same machine when the code
+//   run between captures does not depend on device state. The rewind buffer owns the dirty page tracking of its bus, so
+//   the bus cannot have a snapshot taken or be lockstep checked while it is being captured.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_REWIND_H
+#define MOS_6502_REWIND_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+#include "mos6502_block_cache.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Save state file identification, the header is followed straight away by a keyframe
+#define SAVE_STATE_FILE_MAGIC   "M6502SAV"
+#define SAVE_STATE_FILE_VERSION 1
+
+// Magic, version and size of the keyframe at the start of a save state file
+#define SAVE_STATE_FILE_HEADER_SIZE 16
+
+// Kinds of record
+#define STATE_KEYFRAME 0x01
+#define STATE_DELTA    0x02
+
+// Record kind, registers and number of pages, before the pages themselves
+#define STATE_HEADER_SIZE 18
+
+// Most bytes a single encoded page can take, with its page number
+#define STATE_MAX_PAGE_SIZE (1 + 2 * MEMORY_PAGE_SIZE)
+
+// Most bytes a single record can take
+#define STATE_MAX_RECORD_SIZE (STATE_HEADER_SIZE + MEMORY_PAGE_COUNT * STATE_MAX_PAGE_SIZE)
+
+// Ring bytes per record the index is sized for, the oldest records are dropped when either runs out
+#define REWIND_BYTES_PER_RECORD 256
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Where a record is in the ring
+typedef struct t_struct_rewind_record {
+    unsigned long long offset;
+    unsigned long long cycles;
+    unsigned int size;
+    unsigned int kind;
+} t_rewind_record;
+
+// Rewind buffer
+typedef struct t_struct_rewind {
+    // Ring holding the encoded records back to back, a record that does not fit before the end starts again at the front
+    unsigned char *buffer;
+    unsigned long long buffer_size;
+    unsigned long long write_offset;
+    unsigned long long bytes_used;
+    // Index of the records, oldest first
+    t_rewind_record *records;
+    unsigned int record_capacity;
+    unsigned int first_record;
+    unsigned int record_count;
+    // Cycles between captures, and captures from one keyframe to the next
+    unsigned long long capture_interval;
+    unsigned int keyframe_interval;
+    unsigned int captures_since_keyframe;
+    // Cycle count the next capture is due at
+    unsigned long long next_capture;
+    // RAM as of the last capture, and the host memory each page was mapped to
+    unsigned char shadow[MOS_6502_MEM_SIZE];
+    unsigned char *page_data[MEMORY_PAGE_COUNT];
+    // Record being encoded
+    unsigned char *scratch;
+    // Counters
+    unsigned long long keyframes;
+    unsigned long long deltas;
+    unsigned long long records_dropped;
+} t_rewind;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Save And Load A Machine
+extern int save_state_mos6502(t_memory_bus *, t_registers *, const char *);
+extern int load_state_mos6502(t_memory_bus *, t_registers *, const char *);
+
+// Initialize An Empty Rewind Buffer
+extern int init_rewind_mos6502(t_rewind *, unsigned long long, unsigned long long, unsigned int);
+
+// Free The Ring Of A Rewind Buffer
+extern void free_rewind_mos6502(t_rewind *);
+
+// Capture The Machine Now
+extern int capture_rewind_mos6502(t_rewind *, t_memory_bus *, t_registers *);
+
+// Run Instructions, Capturing The Machine As Captures Come Due
+extern t_run_status run_rewind_mos6502(t_rewind *, t_block_cache *, t_memory_bus *, t_registers *, t_run_budget *);
+
+// Put The Machine Back To An Earlier Cycle
+extern int seek_rewind_mos6502(t_rewind *, t_memory_bus *, t_registers *, unsigned long long);
+
+#endif // MOS_6502_REWIND_H
@@ -0,0 +1,253 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Event Scheduler
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_scheduler.c
+//
+// Description:
+//   Fires device events at the emulated cycle they are due and delivers interrupts between runs of the processor
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <string.h>
+
+// Local
+#include "mos6502_scheduler.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Keeps the events in heap order
+static void sift_up(t_scheduler *, unsigned int);
+static void sift_down(t_scheduler *, unsigned int);
+static int fires_before(const t_scheduled_event *, const t_scheduled_event *);
+
+// Fires every event due by now
+static void fire_due_events(t_scheduler *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Clear every event and interrupt
+//   Inputs: Scheduler
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void init_scheduler_mos6502(t_scheduler *scheduler) {
+    memset(scheduler, 0, sizeof(t_scheduler));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Schedule a handler to be called for a device once the cycle count reaches a cycle. A cycle already passed fires at the
+// next instruction boundary.
+//   Inputs: Scheduler, Cycle, Handler, Device
+//   Output: 0 on success, -1 if too many events are waiting
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int schedule_event_mos6502(t_scheduler *scheduler, unsigned long long cycle, t_event_handler handler, void *device) {
+    if (scheduler->event_count == SCHEDULER_MAX_EVENTS) {
+        printf("Error: More than %d events scheduled!!\n", SCHEDULER_MAX_EVENTS);
+        return -1;
+    }
+
+    t_scheduled_event *event = &scheduler->events[scheduler->event_count];
+    event->cycle = cycle;
+    event->sequence = scheduler->next_sequence++;
+    event->handler = handler;
+    event->device = device;
+    sift_up(scheduler, scheduler->event_count++);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Cancel every waiting event of a handler and device
+//   Inputs: Scheduler, Handler, Device
+//   Output: Number of events cancelled
+// -------------------------------------------------------------------------------------------------------------------------------
+extern unsigned int cancel_events_mos6502(t_scheduler *scheduler, t_event_handler handler, void *device) {
+    unsigned int kept = 0;
+
+    for (unsigned int i = 0; i < scheduler->event_count; i++) {
+        if (scheduler->events[i].handler != handler || scheduler->events[i].device != device) {
+            scheduler->events[kept++] = scheduler->events[i];
+        }
+    }
+    unsigned int cancelled = scheduler->event_count - kept;
+
+    // Build the heap again from the events left, which is linear in their number
+    scheduler->event_count = kept;
+    for (unsigned int i = kept / 2; i-- > 0;) {
+        sift_down(scheduler, i);
+    }
+    return cancelled;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Hold the interrupt request line for a source, until it is released
+//   Inputs: Scheduler, Source Number
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void assert_irq_mos6502(t_scheduler *scheduler, unsigned int source) {
+    scheduler->irq_sources |= 1ULL << (source % SCHEDULER_MAX_IRQ_SOURCES);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Let go of the interrupt request line for a source
+//   Inputs: Scheduler, Source Number
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void release_irq_mos6502(t_scheduler *scheduler, unsigned int source) {
+    scheduler->irq_sources &= ~(1ULL << (source % SCHEDULER_MAX_IRQ_SOURCES));
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Signal a non maskable interrupt. It is edge triggered, so signalling again before it is taken gives a single interrupt.
+//   Inputs: Scheduler
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void signal_nmi_mos6502(t_scheduler *scheduler) {
+    scheduler->nmi_pending = 1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs instructions like run_mos6502(), or run_cached_mos6502() when a block cache is given, firing events and taking
+// interrupts as they come due. The processor is run with a cycle budget ending at the next event, and the budget's own
+// limits cover the whole call including the cycles spent entering interrupt handlers.
+//   Inputs: Scheduler, Block Cache (NULL for the interpreter), Memory Bus, Registers, Budget
+//   Output: Reason for returning
+// -------------------------------------------------------------------------------------------------------------------------------
+extern t_run_status run_scheduled_mos6502(t_scheduler *scheduler, t_block_cache *cache, t_memory_bus *bus, t_registers *registers,
+                                          t_run_budget *budget) {
+    t_run_status status = RUN_BUDGET_EXHAUSTED;
+    unsigned long long instruction_limit = budget->instruction_limit;
+    unsigned long long cycle_limit = budget->cycle_limit;
+    unsigned long long start_cycles = registers->cycles;
+    unsigned long long instructions = 0;
+
+#if !MOS_6502_CYCLE_COUNTING
+    printf("Error: The event scheduler needs cycle counting!!\n");
+    budget->instructions_executed = 0;
+    budget->cycles_executed = 0;
+    return RUN_STOPPED;
+#endif
+
+    for (;;) {
+        // Everything due happens between instructions
+        scheduler->now = registers->cycles;
+        fire_due_events(scheduler);
+        if (scheduler->nmi_pending) {
+            scheduler->nmi_pending = 0;
+            interrupt_mos6502(bus, registers, 1);
+            scheduler->nmis_taken++;
+        } else if (scheduler->irq_sources != 0 && interrupt_mos6502(bus, registers, 0)) {
+            scheduler->irqs_taken++;
+        }
+
+        if (budget->stop_requested) {
+            status = RUN_STOPPED;
+            break;
+        }
+        if ((instruction_limit != 0 && instructions >= instruction_limit) ||
+            (cycle_limit != 0 && registers->cycles - start_cycles >= cycle_limit)) {
+            break;
+        }
+
+        // Run up to the next event, or one instruction at a time while a masked interrupt request waits. The host's
+        // budget is used for the run so that its stop flag, trace and profile still apply.
+        unsigned long long deadline = (cycle_limit != 0) ? start_cycles + cycle_limit : ~0ULL;
+        if (scheduler->event_count != 0 && scheduler->events[0].cycle < deadline) {
+            deadline = scheduler->events[0].cycle;
+        }
+        budget->instruction_limit = (instruction_limit != 0) ? instruction_limit - instructions : 0;
+        if (scheduler->irq_sources != 0) {
+            budget->instruction_limit = 1;
+        }
+        budget->cycle_limit = (deadline != ~0ULL && deadline > registers->cycles) ? deadline - registers->cycles : 0;
+        if (deadline <= registers->cycles) {
+            // Interrupt entry ran past an event, fire it before anything else runs
+            budget->instruction_limit = instruction_limit;
+            budget->cycle_limit = cycle_limit;
+            continue;
+        }
+
+        if (cache != NULL) {
+            status = run_cached_mos6502(cache, bus, registers, budget);
+        } else {
+            status = run_mos6502(bus, registers, budget);
+        }
+        instructions += budget->instructions_executed;
+        budget->instruction_limit = instruction_limit;
+        budget->cycle_limit = cycle_limit;
+        if (status != RUN_BUDGET_EXHAUSTED) {
+            break;
+        }
+    }
+
+    budget->instructions_executed = instructions;
+    budget->cycles_executed = registers->cycles - start_cycles;
+    return status;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Fires every event due by now in order. Handlers may schedule more events, which fire in the same pass when already due.
+//   Inputs: Scheduler
+// -------------------------------------------------------------------------------------------------------------------------------
+static void fire_due_events(t_scheduler *scheduler) {
+    while (scheduler->event_count != 0 && scheduler->events[0].cycle <= scheduler->now) {
+        t_scheduled_event event = scheduler->events[0];
+        scheduler->events[0] = scheduler->events[--scheduler->event_count];
+        sift_down(scheduler, 0);
+        scheduler->events_fired++;
+        event.handler(event.device, scheduler, scheduler->now);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Moves an event up the heap until its parent fires first
+//   Inputs: Scheduler, Event Index
+// -------------------------------------------------------------------------------------------------------------------------------
+static void sift_up(t_scheduler *scheduler, unsigned int index) {
+    t_scheduled_event event = scheduler->events[index];
+
+    while (index != 0) {
+        unsigned int parent = (index - 1) / 2;
+        if (!fires_before(&event, &scheduler->events[parent])) {
+            break;
+        }
+        scheduler->events[index] = scheduler->events[parent];
+        index = parent;
+    }
+    scheduler->events[index] = event;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Moves an event down the heap until it fires before both children
+//   Inputs: Scheduler, Event Index
+// -------------------------------------------------------------------------------------------------------------------------------
+static void sift_down(t_scheduler *scheduler, unsigned int index) {
+    t_scheduled_event event = scheduler->events[index];
+
+    for (;;) {
+        unsigned int child = 2 * index + 1;
+        if (child >= scheduler->event_count) {
+            break;
+        }
+        if (child + 1 < scheduler->event_count && fires_before(&scheduler->events[child + 1], &scheduler->events[child])) {
+            child++;
+        }
+        if (!fires_before(&scheduler->events[child], &event)) {
+            break;
+        }
+        scheduler->events[index] = scheduler->events[child];
+        index = child;
+    }
+    scheduler->events[index] = event;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether one event fires before another
+//   Inputs: Events To Compare
+//   Output: 1 if the first fires first, 0 otherwise
+// -------------------------------------------------------------------------------------------------------------------------------
+static int fires_before(const t_scheduled_event *first, const t_scheduled_event *second) {
+    return first->cycle < second->cycle || (first->cycle == second->cycle && first->sequence < second->sequence);
+}
@@ -0,0 +1,94 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Event Scheduler Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_scheduler.h
+//
+// Description:
+//   Contains the data types and function prototypes for the event scheduler. Devices schedule callbacks for the emulated
+//   cycle they are due at, and assert or release the interrupt request line and signal non maskable interrupts from them.
+//   run_scheduled_mos6502() runs the processor with a cycle budget that ends at the next event, so nothing is polled while
+//   instructions run. Events are kept in a min heap ordered by cycle, events due at the same cycle fire in the order they
+//   were scheduled.
+//
+//   Events fire, and interrupts are taken, at the first instruction boundary at or after their cycle. The interrupt request
+//   line is level triggered: while it is held with interrupts disabled the processor is run one instruction at a time so
+//   that the request is taken as soon as they are enabled again. Cycle counting must be compiled in.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_SCHEDULER_H
+#define MOS_6502_SCHEDULER_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+#include "mos6502_block_cache.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most events waiting at once
+#define SCHEDULER_MAX_EVENTS 256
+
+// Most devices sharing the interrupt request line, one bit each
+#define SCHEDULER_MAX_IRQ_SOURCES 64
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+struct t_struct_scheduler;
+
+// Called when an event is due, with the device it was scheduled for and the cycle count it fired at
+typedef void (*t_event_handler)(void *, struct t_struct_scheduler *, unsigned long long);
+
+// Event waiting to fire
+typedef struct t_struct_scheduled_event {
+    unsigned long long cycle;
+    // Order the event was scheduled in, so events due at the same cycle fire first in first out
+    unsigned long long sequence;
+    t_event_handler handler;
+    void *device;
+} t_scheduled_event;
+
+// Events and interrupt lines of one machine
+typedef struct t_struct_scheduler {
+    // Min heap of the waiting events, the next one due first
+    t_scheduled_event events[SCHEDULER_MAX_EVENTS];
+    unsigned int event_count;
+    unsigned long long next_sequence;
+    // Cycle count of the instruction boundary being handled, for scheduling relative to now
+    unsigned long long now;
+    // Devices holding the interrupt request line, bit n is source n
+    unsigned long long irq_sources;
+    // Set by a non maskable interrupt until it is taken
+    int nmi_pending;
+    // Counters
+    unsigned long long events_fired;
+    unsigned long long irqs_taken;
+    unsigned long long nmis_taken;
+} t_scheduler;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Clear Every Event And Interrupt
+extern void init_scheduler_mos6502(t_scheduler *);
+
+// Schedule And Cancel Events
+extern int schedule_event_mos6502(t_scheduler *, unsigned long long, t_event_handler, void *);
+extern unsigned int cancel_events_mos6502(t_scheduler *, t_event_handler, void *);
+
+// Drive The Interrupt Lines
+extern void assert_irq_mos6502(t_scheduler *, unsigned int);
+extern void release_irq_mos6502(t_scheduler *, unsigned int);
+extern void signal_nmi_mos6502(t_scheduler *);
+
+// Run Instructions, Firing Events And Taking Interrupts As They Come Due
+extern t_run_status run_scheduled_mos6502(t_scheduler *, t_block_cache *, t_memory_bus *, t_registers *, t_run_budget *);
+
+#endif // MOS_6502_SCHEDULER_H
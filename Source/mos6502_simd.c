@@ -0,0 +1,1282 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 SIMD Lockstep Engine
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_simd.c
+//
+// Description:
+//   Runs many machines that share a program in lockstep. Every step picks the lowest program counter of the running lanes
+//   and executes the instruction there for every lane that has reached it, so lanes that split at a branch tend to meet up
+//   again further on. The instruction is decoded once, the register and flag work is done across all lanes with vector
+//   instructions and the memory accesses go to the bus of each lane. Lanes that cannot take the vector path, and groups too
+//   small to be worth it, are run one instruction at a time by the scalar core instead. Lanes go fastest when their code is
+//   mapped from the same host memory, otherwise the code of every lane is compared byte by byte before each step.
+//
+//   The lane loops are plain C over fixed size arrays. On x86-64 the run loop is built for AVX-512, AVX2 and the base
+//   instruction set, and the loader picks the best one the host supports.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <string.h>
+
+// Local
+#include "mos6502_opcode.h"
+#include "mos6502_simd.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Builds the run loop once per vector instruction set, the lane helpers are forced inline so every build gets its own copy
+#if defined(__x86_64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_CLONES 1
+#define SIMD_RUN_LOOP __attribute__((target_clones("arch=skylake-avx512", "avx2", "default")))
+#else
+#define SIMD_TARGET_CLONES 0
+#define SIMD_RUN_LOOP
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_LANE_HELPER static inline __attribute__((always_inline))
+#else
+#define SIMD_LANE_HELPER static inline
+#endif
+
+// Adds clock cycles to a lane, compiled out along with the rest of the cycle counting
+#if MOS_6502_CYCLE_COUNTING
+#define ADD_LANE_CYCLES(engine, lane, count) ((engine)->cycles[lane] += (count))
+#else
+#define ADD_LANE_CYCLES(engine, lane, count) ((void) (count))
+#endif
+
+// Picks the new value for lanes whose mask byte is 0xFF and keeps the old value for lanes whose mask byte is 0x00
+#define BLEND(mask, new_value, old_value) (((new_value) & (mask)) | ((old_value) & ~(mask)))
+
+// Negative and zero flags of a result
+#define NZ_FLAGS(value) (((value) & STATUS_NEGATIVE) | (((value) == 0) ? STATUS_ZERO : 0))
+
+// Value larger than any program counter, used for lanes that are not running
+#define NO_PROGRAM_COUNTER 0x10000
+
+// Operation done by each instruction handler on the vector path. Handlers mapped to SIMD_SCALAR always use the scalar core.
+#define SIMD_OPERATION_adc SIMD_ADC
+#define SIMD_OPERATION_and SIMD_AND
+#define SIMD_OPERATION_asl SIMD_ASL
+#define SIMD_OPERATION_bcc SIMD_BRANCH
+#define SIMD_OPERATION_bcs SIMD_BRANCH
+#define SIMD_OPERATION_beq SIMD_BRANCH
+#define SIMD_OPERATION_bit SIMD_BIT
+#define SIMD_OPERATION_bmi SIMD_BRANCH
+#define SIMD_OPERATION_bne SIMD_BRANCH
+#define SIMD_OPERATION_bpl SIMD_BRANCH
+#define SIMD_OPERATION_brk SIMD_SCALAR
+#define SIMD_OPERATION_bvc SIMD_BRANCH
+#define SIMD_OPERATION_bvs SIMD_BRANCH
+#define SIMD_OPERATION_clc SIMD_CLC
+#define SIMD_OPERATION_cld SIMD_CLD
+#define SIMD_OPERATION_cli SIMD_CLI
+#define SIMD_OPERATION_clv SIMD_CLV
+#define SIMD_OPERATION_cmp SIMD_CMP
+#define SIMD_OPERATION_cpx SIMD_CPX
+#define SIMD_OPERATION_cpy SIMD_CPY
+#define SIMD_OPERATION_dec SIMD_DEC
+#define SIMD_OPERATION_dex SIMD_DEX
+#define SIMD_OPERATION_dey SIMD_DEY
+#define SIMD_OPERATION_eor SIMD_EOR
+#define SIMD_OPERATION_inc SIMD_INC
+#define SIMD_OPERATION_inx SIMD_INX
+#define SIMD_OPERATION_iny SIMD_INY
+#define SIMD_OPERATION_jmp SIMD_JMP
+#define SIMD_OPERATION_jsr SIMD_JSR
+#define SIMD_OPERATION_lda SIMD_LDA
+#define SIMD_OPERATION_ldx SIMD_LDX
+#define SIMD_OPERATION_ldy SIMD_LDY
+#define SIMD_OPERATION_lsr SIMD_LSR
+#define SIMD_OPERATION_nop SIMD_NOP
+#define SIMD_OPERATION_ora SIMD_ORA
+#define SIMD_OPERATION_pha SIMD_PHA
+#define SIMD_OPERATION_php SIMD_PHP
+#define SIMD_OPERATION_pla SIMD_PLA
+#define SIMD_OPERATION_plp SIMD_PLP
+#define SIMD_OPERATION_rol SIMD_ROL
+#define SIMD_OPERATION_ror SIMD_ROR
+#define SIMD_OPERATION_rti SIMD_SCALAR
+#define SIMD_OPERATION_rts SIMD_RTS
+#define SIMD_OPERATION_sbc SIMD_SBC
+#define SIMD_OPERATION_sec SIMD_SEC
+#define SIMD_OPERATION_sed SIMD_SED
+#define SIMD_OPERATION_sei SIMD_SEI
+#define SIMD_OPERATION_sta SIMD_STA
+#define SIMD_OPERATION_stx SIMD_STX
+#define SIMD_OPERATION_sty SIMD_STY
+#define SIMD_OPERATION_tax SIMD_TAX
+#define SIMD_OPERATION_tay SIMD_TAY
+#define SIMD_OPERATION_tsx SIMD_TSX
+#define SIMD_OPERATION_txa SIMD_TXA
+#define SIMD_OPERATION_txs SIMD_TXS
+#define SIMD_OPERATION_tya SIMD_TYA
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Operations of the vector path
+typedef enum {
+    SIMD_SCALAR = 0,
+    SIMD_LDA, SIMD_LDX, SIMD_LDY,
+    SIMD_STA, SIMD_STX, SIMD_STY,
+    SIMD_ADC, SIMD_SBC,
+    SIMD_AND, SIMD_ORA, SIMD_EOR, SIMD_BIT,
+    SIMD_CMP, SIMD_CPX, SIMD_CPY,
+    SIMD_INC, SIMD_DEC, SIMD_ASL, SIMD_LSR, SIMD_ROL, SIMD_ROR,
+    SIMD_INX, SIMD_INY, SIMD_DEX, SIMD_DEY,
+    SIMD_TAX, SIMD_TAY, SIMD_TXA, SIMD_TYA, SIMD_TSX, SIMD_TXS,
+    SIMD_CLC, SIMD_SEC, SIMD_CLD, SIMD_SED, SIMD_CLI, SIMD_SEI, SIMD_CLV,
+    SIMD_BRANCH, SIMD_JMP, SIMD_JSR, SIMD_RTS,
+    SIMD_PHA, SIMD_PLA, SIMD_PHP, SIMD_PLP,
+    SIMD_NOP
+} t_simd_operation;
+
+// Set of lanes, as a bit per lane for walking the lanes and a byte per lane for blending vectors
+typedef struct t_struct_simd_group {
+    unsigned int lanes;
+    unsigned int count;
+    _Alignas(64) unsigned char mask[SIMD_MAX_LANES];
+} t_simd_group;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Vector path operation of every opcode
+#define SIMD_OPERATION_ENTRY(code, mnemonic, handler, mode, length, base_cycles) [code] = SIMD_OPERATION_##handler,
+static const unsigned char simd_operations[OPCODE_TABLE_SIZE] = {
+    MOS_6502_OPCODE_TABLE(SIMD_OPERATION_ENTRY)
+};
+#undef SIMD_OPERATION_ENTRY
+
+// Flag tested by each branch, picked by the top two bits of the opcode. Bit 5 of the opcode is the value that takes it.
+static const unsigned char branch_flags[4] = { STATUS_NEGATIVE, STATUS_OVERFLOW, STATUS_CARRY, STATUS_ZERO };
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs lanes that share a program counter for as long as they stay together
+SIMD_LANE_HELPER unsigned long long run_lockstep(t_simd_engine *, t_run_budget *, const unsigned long long *, const t_simd_group *, unsigned short);
+
+// Runs the instruction at a program counter for a group of lanes, on the vector path where it can
+SIMD_LANE_HELPER void step_group(t_simd_engine *, t_run_budget *, const unsigned long long *, const t_simd_group *, unsigned short);
+
+// Picks the lanes of a group that can take the vector path
+static unsigned int select_vector_lanes(t_simd_engine *, unsigned short, const t_simd_group *, t_simd_group *);
+
+// Checks that every lane of a group sees the same host memory for a page
+static int page_is_shared(t_simd_engine *, const t_simd_group *, unsigned int);
+
+// Checks whether any lane of a group is in decimal mode
+SIMD_LANE_HELPER int any_decimal_mode(t_simd_engine *, const t_simd_group *);
+
+// Stops the lanes of a group that have used up their budget
+SIMD_LANE_HELPER void retire_lanes(t_simd_engine *, t_run_budget *, const unsigned long long *, unsigned int);
+
+// Runs a single instruction for one lane with the scalar core
+static t_run_status step_scalar(t_simd_engine *, unsigned int);
+
+// Runs the instruction at a program counter for every lane in a group
+SIMD_LANE_HELPER unsigned int step_vector(t_simd_engine *, unsigned short, const t_simd_group *, unsigned int *);
+
+// Works out the effective address of every lane and reads or writes memory through it
+SIMD_LANE_HELPER void lane_addresses(t_simd_engine *, t_memory_access, unsigned short, const t_simd_group *, unsigned short *, int);
+SIMD_LANE_HELPER void read_lanes(t_simd_engine *, t_memory_access, unsigned short, const t_simd_group *, unsigned char *);
+SIMD_LANE_HELPER void write_lanes(t_simd_engine *, const t_simd_group *, const unsigned short *, const unsigned char *);
+
+// Pushes and pulls a value on the stack of every lane
+SIMD_LANE_HELPER void push_lanes(t_simd_engine *, const t_simd_group *, const unsigned char *);
+SIMD_LANE_HELPER void pull_lanes(t_simd_engine *, const t_simd_group *, unsigned char *);
+
+// Reads and writes the memory of a single lane
+SIMD_LANE_HELPER unsigned char read_lane(t_simd_engine *, unsigned int, unsigned short);
+SIMD_LANE_HELPER void write_lane(t_simd_engine *, unsigned int, unsigned short, unsigned char);
+
+// Program counter every lane of a group ended up at
+SIMD_LANE_HELPER unsigned int same_program_counter(t_simd_engine *, const t_simd_group *);
+
+// Walks the lanes of a set
+SIMD_LANE_HELPER unsigned int first_lane(unsigned int);
+SIMD_LANE_HELPER unsigned int next_lane(unsigned int *);
+
+// Register and flag work across the lanes
+SIMD_LANE_HELPER void load_lanes(t_simd_engine *, unsigned char *, const unsigned char *, const unsigned char *);
+SIMD_LANE_HELPER void add_lanes(t_simd_engine *, const unsigned char *, const unsigned char *, int);
+SIMD_LANE_HELPER void compare_lanes(t_simd_engine *, const unsigned char *, const unsigned char *, const unsigned char *);
+SIMD_LANE_HELPER void modify_lanes(t_simd_engine *, t_simd_operation, unsigned char *, const unsigned char *);
+SIMD_LANE_HELPER void set_lane_flags(t_simd_engine *, const unsigned char *, unsigned char, unsigned char);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize engine with no lanes loaded
+//   Inputs: Engine, Lane Count (8, 16 or 32 fit the vector registers, anything up to SIMD_MAX_LANES works)
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void init_simd_mos6502(t_simd_engine *engine, unsigned int lane_count) {
+    memset(engine, 0, sizeof(t_simd_engine));
+    engine->lane_count = (lane_count > SIMD_MAX_LANES) ? SIMD_MAX_LANES : lane_count;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Copies a machine into a lane. The memory bus stays owned by the caller and must not be shared with another lane.
+//   Inputs: Engine, Lane, Memory Bus, Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void load_lane_simd_mos6502(t_simd_engine *engine, unsigned int lane, t_memory_bus *bus, t_registers *registers) {
+    if (lane >= engine->lane_count) {
+        printf("Error: Lane, %u, is past the end of the engine!!\n", lane);
+        return;
+    }
+
+    engine->buses[lane] = bus;
+    engine->program_counter[lane] = registers->program_counter;
+    engine->stack_pointer[lane] = registers->stack_pointer;
+    engine->accumulator[lane] = registers->accumulator;
+    engine->register_x[lane] = registers->register_x;
+    engine->register_y[lane] = registers->register_y;
+    // Stored the same way the scalar core stores it
+    engine->processor_status[lane] = registers->processor_status & ~STATUS_UNUSED;
+    engine->cycles[lane] = registers->cycles;
+    engine->status[lane] = RUN_BUDGET_EXHAUSTED;
+    engine->instructions_executed[lane] = 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Copies a lane back out into a set of registers
+//   Inputs: Engine, Lane, Registers
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void store_lane_simd_mos6502(t_simd_engine *engine, unsigned int lane, t_registers *registers) {
+    if (lane >= engine->lane_count) {
+        printf("Error: Lane, %u, is past the end of the engine!!\n", lane);
+        return;
+    }
+
+    registers->program_counter = engine->program_counter[lane];
+    registers->stack_pointer = engine->stack_pointer[lane];
+    registers->accumulator = engine->accumulator[lane];
+    registers->register_x = engine->register_x[lane];
+    registers->register_y = engine->register_y[lane];
+    registers->processor_status = engine->processor_status[lane];
+    registers->cycles = engine->cycles[lane];
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs every loaded lane until it uses up the budget, hits a BRK or an unsupported opcode, or a stop is requested. The
+// instruction and cycle limits apply to each lane on its own, and the amount used is written back as the total for all lanes.
+// The reason each lane stopped is left in the engine's status array.
+//   Inputs: Engine, Budget
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_RUN_LOOP
+extern void run_simd_mos6502(t_simd_engine *engine, t_run_budget *budget) {
+    unsigned long long start_cycles[SIMD_MAX_LANES];
+    t_simd_group group;
+
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        engine->active[i] = (i < engine->lane_count && engine->buses[i] != NULL) ? 0xFF : 0x00;
+        engine->status[i] = RUN_BUDGET_EXHAUSTED;
+        engine->instructions_executed[i] = 0;
+        start_cycles[i] = engine->cycles[i];
+    }
+    retire_lanes(engine, budget, start_cycles, 0xFFFFFFFF);
+
+    for (;;) {
+        if (budget->stop_requested) {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                if (engine->active[i]) {
+                    engine->status[i] = RUN_STOPPED;
+                }
+            }
+            break;
+        }
+
+        // The lowest program counter goes next, lanes that are behind catch up with the rest
+        unsigned int program_counter = NO_PROGRAM_COUNTER;
+        unsigned int running = 0;
+        for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+            unsigned int lane_counter = engine->active[i] ? engine->program_counter[i] : NO_PROGRAM_COUNTER;
+            program_counter = (lane_counter < program_counter) ? lane_counter : program_counter;
+            running |= (unsigned int) (engine->active[i] & 1) << i;
+        }
+        if (program_counter == NO_PROGRAM_COUNTER) {
+            break;
+        }
+
+        group.lanes = 0;
+        group.count = 0;
+        for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+            group.mask[i] = (engine->active[i] && engine->program_counter[i] == program_counter) ? 0xFF : 0x00;
+            group.lanes |= (unsigned int) (group.mask[i] & 1) << i;
+            group.count += group.mask[i] & 1;
+        }
+
+        // Every running lane is at the same place, keep them together until they split up
+        if (group.lanes == running && run_lockstep(engine, budget, start_cycles, &group, (unsigned short) program_counter) > 0) {
+            continue;
+        }
+
+        step_group(engine, budget, start_cycles, &group, (unsigned short) program_counter);
+    }
+
+    budget->instructions_executed = 0;
+    budget->cycles_executed = 0;
+    for (unsigned int i = 0; i < engine->lane_count; i++) {
+        budget->instructions_executed += engine->instructions_executed[i];
+        budget->cycles_executed += engine->cycles[i] - start_cycles[i];
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Name of the vector instruction set the run loop uses on this host
+//   Output: "avx512bw", "avx2" or "scalar"
+// -------------------------------------------------------------------------------------------------------------------------------
+extern const char *simd_instruction_set_mos6502(void) {
+#if SIMD_TARGET_CLONES
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        return "avx512bw";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return "avx2";
+    }
+#elif defined(__AVX512BW__)
+    return "avx512bw";
+#elif defined(__AVX2__)
+    return "avx2";
+#endif
+    return "scalar";
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs a group of lanes that share a program counter for as long as they stay together. The program counter, the base
+// cycles and the instruction count are the same for every lane, so they are kept once for the group and only written to
+// the lanes when the group leaves lockstep. It leaves when the lanes split up, an instruction needs the scalar core or a
+// lane reaches the end of its budget.
+//   Inputs: Engine, Budget, Cycle Count Of Each Lane At The Start Of The Run, Lanes, Program Counter
+//   Output: Number of instructions each lane ran, 0 when the first instruction needs the scalar core
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER unsigned long long run_lockstep(t_simd_engine *engine, t_run_budget *budget, const unsigned long long *start_cycles,
+                                                 const t_simd_group *group, unsigned short program_counter) {
+    t_memory_bus *leader_bus = engine->buses[first_lane(group->lanes)];
+    unsigned long long step_limit = ~0ULL;
+    unsigned long long steps = 0;
+    unsigned long long group_cycles = 0;
+    // Page every lane was last seen to share, trusted until a slow path access might have remapped something
+    unsigned int shared_page = MEMORY_PAGE_COUNT;
+    unsigned long long shared_slow_accesses = engine->slow_accesses;
+    int split = 0;
+
+    if (budget->instruction_limit != 0) {
+        for (unsigned int lanes = group->lanes; lanes != 0; ) {
+            unsigned int i = next_lane(&lanes);
+            unsigned long long remaining = budget->instruction_limit - engine->instructions_executed[i];
+            step_limit = (remaining < step_limit) ? remaining : step_limit;
+        }
+    }
+
+    while (steps < step_limit) {
+        // Only look at the stop flag once in a while so it costs nothing in the inner loop
+        if (((steps + 1) & (RUN_SLICE_SIZE - 1)) == 0 && budget->stop_requested) {
+            break;
+        }
+
+        unsigned char *page = leader_bus->read_pages[program_counter >> 8];
+        if (page == NULL) {
+            break;
+        }
+        unsigned char opcode = page[program_counter & 0x00FF];
+        t_simd_operation operation = (t_simd_operation) simd_operations[opcode];
+        if (operation == SIMD_SCALAR) {
+            break;
+        }
+
+        // Make sure every lane holds the same instruction
+        unsigned int first_page = program_counter >> 8;
+        unsigned int last_page = ((program_counter + mos6502_opcode_table[opcode].length - 1) >> 8) & 0xFF;
+        if (engine->slow_accesses != shared_slow_accesses) {
+            shared_page = MEMORY_PAGE_COUNT;
+            shared_slow_accesses = engine->slow_accesses;
+        }
+        if (first_page != shared_page || last_page != shared_page) {
+            if (page_is_shared(engine, group, first_page) && page_is_shared(engine, group, last_page)) {
+                shared_page = (first_page == last_page) ? first_page : MEMORY_PAGE_COUNT;
+            } else {
+                t_simd_group vector;
+                if (select_vector_lanes(engine, program_counter, group, &vector) != group->count) {
+                    break;
+                }
+            }
+        }
+        if ((operation == SIMD_ADC || operation == SIMD_SBC) && any_decimal_mode(engine, group)) {
+            break;
+        }
+
+        unsigned int cycles;
+        unsigned int next_counter = step_vector(engine, program_counter, group, &cycles);
+        group_cycles += cycles;
+        steps++;
+        if (next_counter == NO_PROGRAM_COUNTER) {
+            split = 1;
+            break;
+        }
+        program_counter = (unsigned short) next_counter;
+
+#if MOS_6502_CYCLE_COUNTING
+        if (budget->cycle_limit != 0) {
+            unsigned int spent = 0;
+            for (unsigned int lanes = group->lanes; lanes != 0; ) {
+                unsigned int i = next_lane(&lanes);
+                spent |= (engine->cycles[i] + group_cycles - start_cycles[i] >= budget->cycle_limit);
+            }
+            if (spent) {
+                break;
+            }
+        }
+#endif
+    }
+
+    // Hand the shared state back to the lanes
+    for (unsigned int lanes = group->lanes; lanes != 0; ) {
+        unsigned int i = next_lane(&lanes);
+        if (!split) {
+            engine->program_counter[i] = program_counter;
+        }
+        ADD_LANE_CYCLES(engine, i, group_cycles);
+        engine->instructions_executed[i] += steps;
+    }
+    engine->vector_instructions += steps * group->count;
+
+    retire_lanes(engine, budget, start_cycles, group->lanes);
+    return steps;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs the instruction at a program counter for a group of lanes. The lanes that can take the vector path run together and
+// the rest are run one at a time by the scalar core.
+//   Inputs: Engine, Budget, Cycle Count Of Each Lane At The Start Of The Run, Lanes, Program Counter
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void step_group(t_simd_engine *engine, t_run_budget *budget, const unsigned long long *start_cycles,
+                                 const t_simd_group *group, unsigned short program_counter) {
+    t_simd_group vector;
+
+    if (select_vector_lanes(engine, program_counter, group, &vector) > 0) {
+        unsigned int cycles;
+        unsigned int next_counter = step_vector(engine, program_counter, &vector, &cycles);
+        for (unsigned int lanes = vector.lanes; lanes != 0; ) {
+            unsigned int i = next_lane(&lanes);
+            if (next_counter != NO_PROGRAM_COUNTER) {
+                engine->program_counter[i] = (unsigned short) next_counter;
+            }
+            ADD_LANE_CYCLES(engine, i, cycles);
+            engine->instructions_executed[i]++;
+        }
+        engine->vector_instructions += vector.count;
+    }
+
+    for (unsigned int lanes = group->lanes & ~vector.lanes; lanes != 0; ) {
+        unsigned int i = next_lane(&lanes);
+        t_run_status status = step_scalar(engine, i);
+        if (status != RUN_BUDGET_EXHAUSTED) {
+            engine->status[i] = status;
+            engine->active[i] = 0x00;
+        }
+    }
+
+    retire_lanes(engine, budget, start_cycles, group->lanes);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Picks the lanes of a group that can take the vector path. The instruction is decoded from the first lane of the group, so
+// every other lane must hold the same bytes, which is free to check when the lanes map the same host memory for the code.
+// Lanes running ADC or SBC in decimal mode are left to the scalar core.
+//   Inputs: Engine, Program Counter, Lanes At The Program Counter, Lanes For The Vector Path
+//   Output: Number of lanes for the vector path, 0 when the whole group should use the scalar core
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int select_vector_lanes(t_simd_engine *engine, unsigned short program_counter, const t_simd_group *group, t_simd_group *vector) {
+    memset(vector, 0, sizeof(t_simd_group));
+
+    // The code has to be in RAM or ROM, reading a device here could have side effects
+    t_memory_bus *leader_bus = engine->buses[first_lane(group->lanes)];
+    unsigned char *first_page = leader_bus->read_pages[program_counter >> 8];
+    if (first_page == NULL || group->count < SIMD_MIN_VECTOR_LANES) {
+        return 0;
+    }
+
+    unsigned char opcode = first_page[program_counter & 0x00FF];
+    const t_opcode_descriptor *descriptor = &mos6502_opcode_table[opcode];
+    if (simd_operations[opcode] == SIMD_SCALAR) {
+        return 0;
+    }
+
+    unsigned short last_byte = (unsigned short) (program_counter + descriptor->length - 1);
+    unsigned char *last_page = leader_bus->read_pages[last_byte >> 8];
+    if (last_page == NULL) {
+        return 0;
+    }
+
+    int check_decimal = (simd_operations[opcode] == SIMD_ADC || simd_operations[opcode] == SIMD_SBC);
+
+    for (unsigned int lanes = group->lanes; lanes != 0; ) {
+        unsigned int i = next_lane(&lanes);
+        t_memory_bus *bus = engine->buses[i];
+        unsigned char *lane_first_page = bus->read_pages[program_counter >> 8];
+        unsigned char *lane_last_page = bus->read_pages[last_byte >> 8];
+        int same_code = (lane_first_page == first_page && lane_last_page == last_page);
+        if (!same_code && lane_first_page != NULL && lane_last_page != NULL) {
+            // Lanes with their own copy of the code compare it byte by byte
+            same_code = 1;
+            for (unsigned int j = 0; j < descriptor->length; j++) {
+                unsigned short address = (unsigned short) (program_counter + j);
+                unsigned char *lane_page = ((address >> 8) == (program_counter >> 8)) ? lane_first_page : lane_last_page;
+                unsigned char *leader_page = ((address >> 8) == (program_counter >> 8)) ? first_page : last_page;
+                if (lane_page[address & 0x00FF] != leader_page[address & 0x00FF]) {
+                    same_code = 0;
+                    break;
+                }
+            }
+        }
+        if (!same_code || (check_decimal && (engine->processor_status[i] & STATUS_DECIMAL_MODE))) {
+            continue;
+        }
+
+        vector->lanes |= 1U << i;
+        vector->mask[i] = 0xFF;
+        vector->count++;
+    }
+
+    if (vector->count < SIMD_MIN_VECTOR_LANES) {
+        memset(vector, 0, sizeof(t_simd_group));
+        return 0;
+    }
+    return vector->count;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks that every lane of a group reads a page straight from the same host memory, which means the lanes see the same
+// bytes there no matter what is written to it
+//   Inputs: Engine, Lanes, Page Number
+//   Output: 1 if the page is shared, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int page_is_shared(t_simd_engine *engine, const t_simd_group *group, unsigned int page_number) {
+    unsigned char *page = engine->buses[first_lane(group->lanes)]->read_pages[page_number];
+
+    if (page == NULL) {
+        return 0;
+    }
+    for (unsigned int lanes = group->lanes; lanes != 0; ) {
+        unsigned int i = next_lane(&lanes);
+        if (engine->buses[i]->read_pages[page_number] != page) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks whether any lane of a group is in decimal mode, which only the scalar core handles
+//   Inputs: Engine, Lanes
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER int any_decimal_mode(t_simd_engine *engine, const t_simd_group *group) {
+    unsigned char decimal = 0;
+
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        decimal |= group->mask[i] & engine->processor_status[i];
+    }
+    return (decimal & STATUS_DECIMAL_MODE) != 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Stops the lanes that have used up their instruction or cycle budget
+//   Inputs: Engine, Budget, Cycle Count Of Each Lane At The Start Of The Run, Lanes To Check
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void retire_lanes(t_simd_engine *engine, t_run_budget *budget, const unsigned long long *start_cycles, unsigned int lanes) {
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        if (!((lanes >> i) & 1) || !engine->active[i]) {
+            continue;
+        }
+        if (budget->instruction_limit != 0 && engine->instructions_executed[i] >= budget->instruction_limit) {
+            engine->active[i] = 0x00;
+        }
+#if MOS_6502_CYCLE_COUNTING
+        if (budget->cycle_limit != 0 && engine->cycles[i] - start_cycles[i] >= budget->cycle_limit) {
+            engine->active[i] = 0x00;
+        }
+#else
+        (void) start_cycles;
+#endif
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs a single instruction for one lane with the scalar core, the same path execute_mos6502() takes
+//   Inputs: Engine, Lane
+//   Output: RUN_BUDGET_EXHAUSTED if the lane can keep going, otherwise why it stopped
+// -------------------------------------------------------------------------------------------------------------------------------
+static t_run_status step_scalar(t_simd_engine *engine, unsigned int lane) {
+    t_registers registers;
+    t_run_budget budget;
+
+    memset(&budget, 0, sizeof(budget));
+    budget.instruction_limit = 1;
+
+    store_lane_simd_mos6502(engine, lane, &registers);
+    t_run_status status = run_mos6502(engine->buses[lane], &registers, &budget);
+
+    engine->program_counter[lane] = registers.program_counter;
+    engine->stack_pointer[lane] = registers.stack_pointer;
+    engine->accumulator[lane] = registers.accumulator;
+    engine->register_x[lane] = registers.register_x;
+    engine->register_y[lane] = registers.register_y;
+    engine->processor_status[lane] = registers.processor_status;
+    engine->cycles[lane] = registers.cycles;
+    engine->instructions_executed[lane] += budget.instructions_executed;
+    engine->scalar_instructions += budget.instructions_executed;
+    return status;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs the instruction at a program counter for every lane in a group. The lanes are known to hold the same instruction.
+// The base cycles, and any extra cycles that are the same for every lane, are handed back for the caller to add.
+//   Inputs: Engine, Program Counter, Lanes To Run, Cycles Used By Every Lane
+//   Output: Program counter every lane goes to next, NO_PROGRAM_COUNTER when the lanes split up and each lane's program
+//           counter has been written to the engine
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER unsigned int step_vector(t_simd_engine *engine, unsigned short program_counter, const t_simd_group *group, unsigned int *cycles) {
+    _Alignas(64) unsigned char value[SIMD_MAX_LANES];
+    _Alignas(64) unsigned short address[SIMD_MAX_LANES];
+    const unsigned char *mask = group->mask;
+    unsigned int leader = first_lane(group->lanes);
+
+    // Decode once for every lane
+    t_memory_bus *leader_bus = engine->buses[leader];
+    unsigned char opcode = read_bus_mos6502(leader_bus, program_counter);
+    const t_opcode_descriptor *descriptor = &mos6502_opcode_table[opcode];
+    t_memory_access mode = descriptor->addressing_mode;
+    unsigned short operand = 0;
+    if (descriptor->length > 1) {
+        operand = read_bus_mos6502(leader_bus, (unsigned short) (program_counter + 1));
+    }
+    if (descriptor->length > 2) {
+        operand |= read_bus_mos6502(leader_bus, (unsigned short) (program_counter + 2)) << 8;
+    }
+    unsigned short next_counter = (unsigned short) (program_counter + descriptor->length);
+
+    *cycles = descriptor->cycles;
+
+    switch ((t_simd_operation) simd_operations[opcode]) {
+
+        // Loads and stores
+        case SIMD_LDA: {
+            read_lanes(engine, mode, operand, group, value);
+            load_lanes(engine, engine->accumulator, value, mask);
+            break;
+        }
+        case SIMD_LDX: {
+            read_lanes(engine, mode, operand, group, value);
+            load_lanes(engine, engine->register_x, value, mask);
+            break;
+        }
+        case SIMD_LDY: {
+            read_lanes(engine, mode, operand, group, value);
+            load_lanes(engine, engine->register_y, value, mask);
+            break;
+        }
+        case SIMD_STA: {
+            lane_addresses(engine, mode, operand, group, address, 0);
+            write_lanes(engine, group, address, engine->accumulator);
+            break;
+        }
+        case SIMD_STX: {
+            lane_addresses(engine, mode, operand, group, address, 0);
+            write_lanes(engine, group, address, engine->register_x);
+            break;
+        }
+        case SIMD_STY: {
+            lane_addresses(engine, mode, operand, group, address, 0);
+            write_lanes(engine, group, address, engine->register_y);
+            break;
+        }
+
+        // Arithmetic and logic
+        case SIMD_ADC: {
+            read_lanes(engine, mode, operand, group, value);
+            add_lanes(engine, value, mask, 0);
+            break;
+        }
+        case SIMD_SBC: {
+            read_lanes(engine, mode, operand, group, value);
+            add_lanes(engine, value, mask, 1);
+            break;
+        }
+        case SIMD_AND: {
+            read_lanes(engine, mode, operand, group, value);
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] &= engine->accumulator[i];
+            }
+            load_lanes(engine, engine->accumulator, value, mask);
+            break;
+        }
+        case SIMD_ORA: {
+            read_lanes(engine, mode, operand, group, value);
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] |= engine->accumulator[i];
+            }
+            load_lanes(engine, engine->accumulator, value, mask);
+            break;
+        }
+        case SIMD_EOR: {
+            read_lanes(engine, mode, operand, group, value);
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] ^= engine->accumulator[i];
+            }
+            load_lanes(engine, engine->accumulator, value, mask);
+            break;
+        }
+        case SIMD_BIT: {
+            read_lanes(engine, mode, operand, group, value);
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                unsigned char status = engine->processor_status[i];
+                unsigned char result = (status & ~(STATUS_NEGATIVE | STATUS_OVERFLOW | STATUS_ZERO)) |
+                                       (value[i] & (STATUS_NEGATIVE | STATUS_OVERFLOW)) |
+                                       (((engine->accumulator[i] & value[i]) == 0) ? STATUS_ZERO : 0);
+                engine->processor_status[i] = BLEND(mask[i], result, status);
+            }
+            break;
+        }
+        case SIMD_CMP: {
+            read_lanes(engine, mode, operand, group, value);
+            compare_lanes(engine, engine->accumulator, value, mask);
+            break;
+        }
+        case SIMD_CPX: {
+            read_lanes(engine, mode, operand, group, value);
+            compare_lanes(engine, engine->register_x, value, mask);
+            break;
+        }
+        case SIMD_CPY: {
+            read_lanes(engine, mode, operand, group, value);
+            compare_lanes(engine, engine->register_y, value, mask);
+            break;
+        }
+
+        // Read modify write, on the accumulator or on memory
+        case SIMD_INC:
+        case SIMD_DEC:
+        case SIMD_ASL:
+        case SIMD_LSR:
+        case SIMD_ROL:
+        case SIMD_ROR: {
+            t_simd_operation operation = (t_simd_operation) simd_operations[opcode];
+            if (mode == ACCUMULATOR) {
+                modify_lanes(engine, operation, engine->accumulator, mask);
+            } else {
+                lane_addresses(engine, mode, operand, group, address, 0);
+                for (unsigned int lanes = group->lanes; lanes != 0; ) {
+                    unsigned int i = next_lane(&lanes);
+                    value[i] = read_lane(engine, i, address[i]);
+                }
+                modify_lanes(engine, operation, value, mask);
+                write_lanes(engine, group, address, value);
+            }
+            break;
+        }
+
+        // Register increments, decrements and transfers
+        case SIMD_INX: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] = engine->register_x[i] + 1;
+            }
+            load_lanes(engine, engine->register_x, value, mask);
+            break;
+        }
+        case SIMD_INY: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] = engine->register_y[i] + 1;
+            }
+            load_lanes(engine, engine->register_y, value, mask);
+            break;
+        }
+        case SIMD_DEX: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] = engine->register_x[i] - 1;
+            }
+            load_lanes(engine, engine->register_x, value, mask);
+            break;
+        }
+        case SIMD_DEY: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] = engine->register_y[i] - 1;
+            }
+            load_lanes(engine, engine->register_y, value, mask);
+            break;
+        }
+        case SIMD_TAX: {
+            load_lanes(engine, engine->register_x, engine->accumulator, mask);
+            break;
+        }
+        case SIMD_TAY: {
+            load_lanes(engine, engine->register_y, engine->accumulator, mask);
+            break;
+        }
+        case SIMD_TXA: {
+            load_lanes(engine, engine->accumulator, engine->register_x, mask);
+            break;
+        }
+        case SIMD_TYA: {
+            load_lanes(engine, engine->accumulator, engine->register_y, mask);
+            break;
+        }
+        case SIMD_TSX: {
+            load_lanes(engine, engine->register_x, engine->stack_pointer, mask);
+            break;
+        }
+        case SIMD_TXS: {
+            // The only transfer that leaves the flags alone
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                engine->stack_pointer[i] = BLEND(mask[i], engine->register_x[i], engine->stack_pointer[i]);
+            }
+            break;
+        }
+
+        // Status flag changes
+        case SIMD_CLC: {
+            set_lane_flags(engine, mask, STATUS_CARRY, 0);
+            break;
+        }
+        case SIMD_SEC: {
+            set_lane_flags(engine, mask, 0, STATUS_CARRY);
+            break;
+        }
+        case SIMD_CLD: {
+            set_lane_flags(engine, mask, STATUS_DECIMAL_MODE, 0);
+            break;
+        }
+        case SIMD_SED: {
+            set_lane_flags(engine, mask, 0, STATUS_DECIMAL_MODE);
+            break;
+        }
+        case SIMD_CLI: {
+            set_lane_flags(engine, mask, STATUS_INTERRUPT_DISABLE, 0);
+            break;
+        }
+        case SIMD_SEI: {
+            set_lane_flags(engine, mask, 0, STATUS_INTERRUPT_DISABLE);
+            break;
+        }
+        case SIMD_CLV: {
+            set_lane_flags(engine, mask, STATUS_OVERFLOW, 0);
+            break;
+        }
+
+        // Jumps and branches, lanes that branch differently split up here
+        case SIMD_BRANCH: {
+            unsigned char flag = branch_flags[opcode >> 6];
+            unsigned char taken_when = (opcode & 0x20) ? flag : 0;
+            unsigned short target = (unsigned short) (next_counter + (signed char) operand);
+            unsigned int taken_cycles = 1 + (((target ^ next_counter) >> 8) & 1);
+            unsigned int taken_count = 0;
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] = mask[i] & (((engine->processor_status[i] & flag) == taken_when) ? 0xFF : 0x00);
+                taken_count += value[i] & 1;
+            }
+            if (taken_count == 0) {
+                return next_counter;
+            }
+            if (taken_count == group->count) {
+                *cycles += taken_cycles;
+                return target;
+            }
+            for (unsigned int lanes = group->lanes; lanes != 0; ) {
+                unsigned int i = next_lane(&lanes);
+                engine->program_counter[i] = value[i] ? target : next_counter;
+                ADD_LANE_CYCLES(engine, i, value[i] ? taken_cycles : 0);
+            }
+            return NO_PROGRAM_COUNTER;
+        }
+        case SIMD_JMP: {
+            if (mode != INDIRECT) {
+                return operand;
+            }
+            // The high byte of the pointer is not carried into the page, just like the real processor
+            unsigned short operand_next = (operand & 0xFF00) | ((operand + 1) & 0x00FF);
+            for (unsigned int lanes = group->lanes; lanes != 0; ) {
+                unsigned int i = next_lane(&lanes);
+                engine->program_counter[i] = (read_lane(engine, i, operand_next) << 8) | read_lane(engine, i, operand);
+            }
+            return same_program_counter(engine, group);
+        }
+        case SIMD_JSR: {
+            unsigned short return_address = (unsigned short) (next_counter - 1);
+            memset(value, return_address >> 8, SIMD_MAX_LANES);
+            push_lanes(engine, group, value);
+            memset(value, return_address & 0xFF, SIMD_MAX_LANES);
+            push_lanes(engine, group, value);
+            return operand;
+        }
+        case SIMD_RTS: {
+            _Alignas(64) unsigned char address_msb[SIMD_MAX_LANES];
+            pull_lanes(engine, group, value);
+            pull_lanes(engine, group, address_msb);
+            for (unsigned int lanes = group->lanes; lanes != 0; ) {
+                unsigned int i = next_lane(&lanes);
+                engine->program_counter[i] = (unsigned short) (((address_msb[i] << 8) | value[i]) + 1);
+            }
+            return same_program_counter(engine, group);
+        }
+
+        // Stack instructions
+        case SIMD_PHA: {
+            push_lanes(engine, group, engine->accumulator);
+            break;
+        }
+        case SIMD_PHP: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                value[i] = engine->processor_status[i] | STATUS_BREAK_COMMAND | STATUS_UNUSED;
+            }
+            push_lanes(engine, group, value);
+            break;
+        }
+        case SIMD_PLA: {
+            pull_lanes(engine, group, value);
+            load_lanes(engine, engine->accumulator, value, mask);
+            break;
+        }
+        case SIMD_PLP: {
+            pull_lanes(engine, group, value);
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                engine->processor_status[i] = BLEND(mask[i], value[i] & ~STATUS_UNUSED, engine->processor_status[i]);
+            }
+            break;
+        }
+
+        case SIMD_NOP:
+        case SIMD_SCALAR: {
+            break;
+        }
+    }
+
+    return next_counter;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Works out the effective address of every lane, following the same rules as operand_address() in the scalar core
+//   Inputs: Engine, Addressing Mode, Operand, Lanes, Addresses, Page Penalty (1 to add a cycle when indexing crosses a page)
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void lane_addresses(t_simd_engine *engine, t_memory_access mode, unsigned short operand, const t_simd_group *group,
+                                     unsigned short *address, int page_penalty) {
+    switch (mode) {
+
+        case ZERO_PAGE_X: {
+            // Wrap around so that we stay in the zero page
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                address[i] = (unsigned char) (operand + engine->register_x[i]);
+            }
+            break;
+        }
+
+        case ZERO_PAGE_Y: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                address[i] = (unsigned char) (operand + engine->register_y[i]);
+            }
+            break;
+        }
+
+        case ABSOLUTE_X:
+        case ABSOLUTE_Y: {
+            const unsigned char *index = (mode == ABSOLUTE_X) ? engine->register_x : engine->register_y;
+            // Carry out of the low byte means the page was crossed
+            unsigned char last_index = 0xFF - (operand & 0x00FF);
+            unsigned char crossed = 0;
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                address[i] = (unsigned short) (operand + index[i]);
+                crossed |= group->mask[i] & ((index[i] > last_index) ? 0xFF : 0x00);
+            }
+            if (page_penalty && crossed) {
+                for (unsigned int lanes = group->lanes; lanes != 0; ) {
+                    unsigned int i = next_lane(&lanes);
+                    ADD_LANE_CYCLES(engine, i, index[i] > last_index);
+                }
+            }
+            break;
+        }
+
+        case INDEXED_INDIRECT: {
+            for (unsigned int lanes = group->lanes; lanes != 0; ) {
+                unsigned int i = next_lane(&lanes);
+                unsigned char pointer = (unsigned char) (operand + engine->register_x[i]);
+                address[i] = (read_lane(engine, i, (unsigned char) (pointer + 1)) << 8) | read_lane(engine, i, pointer);
+            }
+            break;
+        }
+
+        case INDIRECT_INDEXED: {
+            for (unsigned int lanes = group->lanes; lanes != 0; ) {
+                unsigned int i = next_lane(&lanes);
+                unsigned short base = (read_lane(engine, i, (unsigned char) (operand + 1)) << 8) | read_lane(engine, i, (unsigned char) operand);
+                address[i] = (unsigned short) (base + engine->register_y[i]);
+                ADD_LANE_CYCLES(engine, i, page_penalty ? ((base & 0x00FF) + engine->register_y[i]) >> 8 : 0);
+            }
+            break;
+        }
+
+        default: {
+            // Zero page and absolute addresses are the operand itself
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                address[i] = operand;
+            }
+            break;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads the operand of every lane, immediate operands come straight from the instruction
+//   Inputs: Engine, Addressing Mode, Operand, Lanes, Values
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void read_lanes(t_simd_engine *engine, t_memory_access mode, unsigned short operand, const t_simd_group *group, unsigned char *value) {
+    _Alignas(64) unsigned short address[SIMD_MAX_LANES];
+
+    if (mode == IMMEDIATE) {
+        memset(value, operand & 0xFF, SIMD_MAX_LANES);
+        return;
+    }
+
+    lane_addresses(engine, mode, operand, group, address, 1);
+    for (unsigned int lanes = group->lanes; lanes != 0; ) {
+        unsigned int i = next_lane(&lanes);
+        value[i] = read_lane(engine, i, address[i]);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes a value to memory for every lane
+//   Inputs: Engine, Lanes, Addresses, Values
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void write_lanes(t_simd_engine *engine, const t_simd_group *group, const unsigned short *address, const unsigned char *value) {
+    for (unsigned int lanes = group->lanes; lanes != 0; ) {
+        unsigned int i = next_lane(&lanes);
+        write_lane(engine, i, address[i], value[i]);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Pushes a value onto the stack of every lane
+//   Inputs: Engine, Lanes, Values
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void push_lanes(t_simd_engine *engine, const t_simd_group *group, const unsigned char *value) {
+    for (unsigned int lanes = group->lanes; lanes != 0; ) {
+        unsigned int i = next_lane(&lanes);
+        write_lane(engine, i, STACK_BASE_ADDR + engine->stack_pointer[i], value[i]);
+        engine->stack_pointer[i]--;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Pulls a value from the stack of every lane
+//   Inputs: Engine, Lanes, Values
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void pull_lanes(t_simd_engine *engine, const t_simd_group *group, unsigned char *value) {
+    for (unsigned int lanes = group->lanes; lanes != 0; ) {
+        unsigned int i = next_lane(&lanes);
+        engine->stack_pointer[i]++;
+        value[i] = read_lane(engine, i, STACK_BASE_ADDR + engine->stack_pointer[i]);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads a byte from the bus of one lane. Slow path accesses are counted because a device callback may remap memory.
+//   Inputs: Engine, Lane, Address
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER unsigned char read_lane(t_simd_engine *engine, unsigned int lane, unsigned short address) {
+    unsigned char *page = engine->buses[lane]->read_pages[address >> 8];
+    if (page != NULL) {
+        return page[address & 0x00FF];
+    }
+    engine->slow_accesses++;
+    return read_bus_slow_mos6502(engine->buses[lane], address);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes a byte to the bus of one lane
+//   Inputs: Engine, Lane, Address, Value
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void write_lane(t_simd_engine *engine, unsigned int lane, unsigned short address, unsigned char value) {
+    unsigned char *page = engine->buses[lane]->write_pages[address >> 8];
+    if (page != NULL) {
+        page[address & 0x00FF] = value;
+        return;
+    }
+    engine->slow_accesses++;
+    write_bus_slow_mos6502(engine->buses[lane], address, value);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Program counter shared by every lane of a group after a jump that each lane worked out for itself
+//   Inputs: Engine, Lanes
+//   Output: The shared program counter, NO_PROGRAM_COUNTER if the lanes went to different places
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER unsigned int same_program_counter(t_simd_engine *engine, const t_simd_group *group) {
+    unsigned short program_counter = engine->program_counter[first_lane(group->lanes)];
+    unsigned int differ = 0;
+
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        differ |= group->mask[i] & (engine->program_counter[i] != program_counter);
+    }
+    return differ ? NO_PROGRAM_COUNTER : program_counter;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Lowest lane in a set of lanes, which must not be empty
+//   Inputs: Lanes
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER unsigned int first_lane(unsigned int lanes) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int) __builtin_ctz(lanes);
+#else
+    unsigned int lane = 0;
+    while (!((lanes >> lane) & 1)) {
+        lane++;
+    }
+    return lane;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Takes the lowest lane out of a set of lanes, which must not be empty
+//   Inputs: Lanes
+//   Output: The lane taken out
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER unsigned int next_lane(unsigned int *lanes) {
+    unsigned int lane = first_lane(*lanes);
+    *lanes &= *lanes - 1;
+    return lane;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Loads a register of every lane and sets the negative and zero flags from it
+//   Inputs: Engine, Register, Values, Lanes
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void load_lanes(t_simd_engine *engine, unsigned char *target, const unsigned char *value, const unsigned char *mask) {
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        unsigned char status = engine->processor_status[i];
+        unsigned char result = value[i];
+        target[i] = BLEND(mask[i], result, target[i]);
+        engine->processor_status[i] = BLEND(mask[i], (status & ~(STATUS_NEGATIVE | STATUS_ZERO)) | NZ_FLAGS(result), status);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Adds a value and the carry to the accumulator of every lane, subtraction adds the complement. Lanes in decimal mode never
+// get here.
+//   Inputs: Engine, Values, Lanes, Subtract (1 for SBC)
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void add_lanes(t_simd_engine *engine, const unsigned char *value, const unsigned char *mask, int subtract) {
+    unsigned char complement = subtract ? 0xFF : 0x00;
+
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        unsigned char accumulator = engine->accumulator[i];
+        unsigned char operand = value[i] ^ complement;
+        unsigned char status = engine->processor_status[i];
+        unsigned short sum = accumulator + operand + (status & STATUS_CARRY);
+        unsigned char result = (unsigned char) sum;
+        // Overflow when both inputs have the same sign and the result has a different one
+        unsigned char overflow = (~(accumulator ^ operand) & (accumulator ^ result) & 0x80) >> 1;
+        unsigned char flags = (status & ~(STATUS_NEGATIVE | STATUS_OVERFLOW | STATUS_ZERO | STATUS_CARRY)) |
+                              NZ_FLAGS(result) | overflow | (sum >> 8);
+        engine->accumulator[i] = BLEND(mask[i], result, accumulator);
+        engine->processor_status[i] = BLEND(mask[i], flags, status);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Compares a register of every lane with a value
+//   Inputs: Engine, Register, Values, Lanes
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void compare_lanes(t_simd_engine *engine, const unsigned char *source, const unsigned char *value, const unsigned char *mask) {
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        unsigned char status = engine->processor_status[i];
+        unsigned char difference = source[i] - value[i];
+        unsigned char flags = (status & ~(STATUS_NEGATIVE | STATUS_ZERO | STATUS_CARRY)) | NZ_FLAGS(difference) |
+                              ((source[i] >= value[i]) ? STATUS_CARRY : 0);
+        engine->processor_status[i] = BLEND(mask[i], flags, status);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Increments, decrements, shifts or rotates a value for every lane and sets the flags from the result
+//   Inputs: Engine, Operation, Values (replaced by the results), Lanes
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void modify_lanes(t_simd_engine *engine, t_simd_operation operation, unsigned char *value, const unsigned char *mask) {
+    _Alignas(64) unsigned char result[SIMD_MAX_LANES];
+    _Alignas(64) unsigned char carry[SIMD_MAX_LANES];
+
+    switch (operation) {
+        case SIMD_INC: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                result[i] = value[i] + 1;
+                carry[i] = engine->processor_status[i] & STATUS_CARRY;
+            }
+            break;
+        }
+        case SIMD_DEC: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                result[i] = value[i] - 1;
+                carry[i] = engine->processor_status[i] & STATUS_CARRY;
+            }
+            break;
+        }
+        case SIMD_ASL: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                result[i] = value[i] << 1;
+                carry[i] = value[i] >> 7;
+            }
+            break;
+        }
+        case SIMD_LSR: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                result[i] = value[i] >> 1;
+                carry[i] = value[i] & STATUS_CARRY;
+            }
+            break;
+        }
+        case SIMD_ROL: {
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                result[i] = (value[i] << 1) | (engine->processor_status[i] & STATUS_CARRY);
+                carry[i] = value[i] >> 7;
+            }
+            break;
+        }
+        default: {
+            // Rotate right
+            for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+                result[i] = (value[i] >> 1) | ((engine->processor_status[i] & STATUS_CARRY) << 7);
+                carry[i] = value[i] & STATUS_CARRY;
+            }
+            break;
+        }
+    }
+
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        unsigned char status = engine->processor_status[i];
+        unsigned char flags = (status & ~(STATUS_NEGATIVE | STATUS_ZERO | STATUS_CARRY)) | NZ_FLAGS(result[i]) | carry[i];
+        value[i] = BLEND(mask[i], result[i], value[i]);
+        engine->processor_status[i] = BLEND(mask[i], flags, status);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Clears and sets status flags for every lane
+//   Inputs: Engine, Lanes, Flags To Clear, Flags To Set
+// -------------------------------------------------------------------------------------------------------------------------------
+SIMD_LANE_HELPER void set_lane_flags(t_simd_engine *engine, const unsigned char *mask, unsigned char clear, unsigned char set) {
+    for (unsigned int i = 0; i < SIMD_MAX_LANES; i++) {
+        unsigned char status = engine->processor_status[i];
+        engine->processor_status[i] = BLEND(mask[i], (status & ~clear) | set, status);
+    }
+}
@@ -0,0 +1,80 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 SIMD Lockstep Engine Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_simd.h
+//
+// Description:
+//   Contains the data types and function prototypes for the lockstep engine, which runs up to 32 machines that share the
+//   same program side by side. The registers of every machine (lane) are kept as structure of arrays so one vector
+//   instruction updates the same register of every lane.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_SIMD_H
+#define MOS_6502_SIMD_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most lanes an engine can hold, one AVX2 register of bytes
+#define SIMD_MAX_LANES 32
+
+// Fewest lanes at the same program counter that are worth a vector step, smaller groups take the scalar path
+#define SIMD_MIN_VECTOR_LANES 2
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Lockstep Engine
+typedef struct t_struct_simd_engine {
+    unsigned int lane_count;
+    // Registers of every lane
+    _Alignas(64) unsigned char accumulator[SIMD_MAX_LANES];
+    _Alignas(64) unsigned char register_x[SIMD_MAX_LANES];
+    _Alignas(64) unsigned char register_y[SIMD_MAX_LANES];
+    _Alignas(64) unsigned char stack_pointer[SIMD_MAX_LANES];
+    _Alignas(64) unsigned char processor_status[SIMD_MAX_LANES];
+    _Alignas(64) unsigned short program_counter[SIMD_MAX_LANES];
+    _Alignas(64) unsigned long long cycles[SIMD_MAX_LANES];
+    // 0xFF for lanes that are still running, 0x00 for lanes that have stopped or are not in use. Every loaded lane is made
+    // active again at the start of run_simd_mos6502().
+    _Alignas(64) unsigned char active[SIMD_MAX_LANES];
+    // Memory of every lane
+    t_memory_bus *buses[SIMD_MAX_LANES];
+    // Why each lane stopped and how many instructions it ran during the last call to run_simd_mos6502()
+    t_run_status status[SIMD_MAX_LANES];
+    unsigned long long instructions_executed[SIMD_MAX_LANES];
+    // Lane instructions run by the vector path and by the scalar core, kept across calls
+    unsigned long long vector_instructions;
+    unsigned long long scalar_instructions;
+    // Lane accesses that went through the slow path of the bus. A device callback may remap memory, so the check that the
+    // lanes share their code is redone after one.
+    unsigned long long slow_accesses;
+} t_simd_engine;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize Engine With No Lanes Loaded
+extern void init_simd_mos6502(t_simd_engine *, unsigned int);
+
+// Copy A Machine In And Out Of A Lane
+extern void load_lane_simd_mos6502(t_simd_engine *, unsigned int, t_memory_bus *, t_registers *);
+extern void store_lane_simd_mos6502(t_simd_engine *, unsigned int, t_registers *);
+
+// Run Every Lane Until Its Budget Is Used Up
+extern void run_simd_mos6502(t_simd_engine *, t_run_budget *);
+
+// Name Of The Vector Instruction Set In Use
+extern const char *simd_instruction_set_mos6502(void);
+
+#endif // MOS_6502_SIMD_H
@@ -0,0 +1,101 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Snapshot
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_snapshot.c
+//
+// Description:
+//   Takes snapshots of a machine and puts them back. Taking a snapshot copies every RAM page once and turns on dirty page
+//   tracking in the memory bus. Restoring copies back only the pages written since, and marks them clean again so the same
+//   snapshot can be restored over and over, as fuzzing and regression loops do.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <string.h>
+
+// Local
+#include "mos6502_snapshot.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Copies a saved page back into the machine
+static void restore_page(t_memory_bus *, t_snapshot *, unsigned int);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Take a snapshot of the registers and every RAM page, and start tracking which pages are written from here on. Only the
+// most recent snapshot of a bus is tracked. Restoring an older one copies back all of its pages.
+//   Inputs: Memory Bus, Registers, Snapshot
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void snapshot_mos6502(t_memory_bus *bus, t_registers *registers, t_snapshot *snapshot) {
+    snapshot->registers = *registers;
+    snapshot->bytes_restored = 0;
+
+    for (unsigned int i = 0; i < PAGE_BITMAP_WORDS; i++) {
+        snapshot->saved_pages[i] = 0;
+    }
+
+    for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+        t_memory_page *page = &bus->pages[i];
+        if (page->data != NULL && !(page->flags & PAGE_WRITE_PROTECT)) {
+            memcpy(&snapshot->memory[i * MEMORY_PAGE_SIZE], page->data, MEMORY_PAGE_SIZE);
+            snapshot->saved_pages[i / 64] |= 1ULL << (i % 64);
+            snapshot->page_data[i] = page->data;
+        } else {
+            snapshot->page_data[i] = NULL;
+        }
+    }
+
+    track_dirty_pages_mos6502(bus, snapshot);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Put the registers and RAM back to a snapshot. When the snapshot is the one the bus is tracking only the dirty pages are
+// copied, otherwise every saved page is copied and the bus starts tracking this snapshot instead.
+//   Inputs: Memory Bus, Registers, Snapshot
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void restore_mos6502(t_memory_bus *bus, t_registers *registers, t_snapshot *snapshot) {
+    *registers = snapshot->registers;
+    snapshot->bytes_restored = 0;
+
+    if (bus->dirty_tracker != snapshot) {
+        for (unsigned int i = 0; i < MEMORY_PAGE_COUNT; i++) {
+            if ((snapshot->saved_pages[i / 64] >> (i % 64)) & 1) {
+                restore_page(bus, snapshot, i);
+            }
+        }
+        track_dirty_pages_mos6502(bus, snapshot);
+        return;
+    }
+
+    // Most words of the bitmap are empty after a short run, so whole words are skipped
+    for (unsigned int word = 0; word < PAGE_BITMAP_WORDS; word++) {
+        unsigned long long dirty = bus->dirty_pages[word] & snapshot->saved_pages[word];
+        for (unsigned int bit = 0; dirty != 0; bit++, dirty >>= 1) {
+            if (dirty & 1) {
+                restore_page(bus, snapshot, word * 64 + bit);
+                clean_page_mos6502(bus, (unsigned char) (word * 64 + bit));
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Copies a saved page back into the machine, as long as the page still maps the memory it was saved from
+//   Inputs: Memory Bus, Snapshot, Page Number
+// -------------------------------------------------------------------------------------------------------------------------------
+static void restore_page(t_memory_bus *bus, t_snapshot *snapshot, unsigned int page_number) {
+    if (bus->pages[page_number].data != snapshot->page_data[page_number]) {
+        return;
+    }
+    memcpy(snapshot->page_data[page_number], &snapshot->memory[page_number * MEMORY_PAGE_SIZE], MEMORY_PAGE_SIZE);
+    snapshot->bytes_restored += MEMORY_PAGE_SIZE;
+    // The copy does not go through the bus, so code decoded from the page has to be thrown away here
+    invalidate_code_page_mos6502(bus, (unsigned char) page_number);
+}
@@ -0,0 +1,49 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Snapshot Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_snapshot.h
+//
+// Description:
+//   Contains the data types and function prototypes for taking a snapshot of a machine and putting it back. Only the RAM
+//   pages written since the snapshot are copied back, so returning to a known state after a short run is cheap.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_SNAPSHOT_H
+#define MOS_6502_SNAPSHOT_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Saved state of a machine. ROM and device pages are not saved, devices keep their own state.
+typedef struct t_struct_snapshot {
+    t_registers registers;
+    // Contents of every RAM page when the snapshot was taken
+    unsigned char memory[MOS_6502_MEM_SIZE];
+    // Pages that were RAM when the snapshot was taken, bit n of word n / 64 is page n
+    unsigned long long saved_pages[PAGE_BITMAP_WORDS];
+    // Host memory of each saved page, a page mapped to different memory since is not written back
+    unsigned char *page_data[MEMORY_PAGE_COUNT];
+    // Bytes copied back by the last restore, for seeing how much the dirty page tracking saves
+    unsigned int bytes_restored;
+} t_snapshot;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Take A Snapshot And Start Tracking Dirty Pages
+extern void snapshot_mos6502(t_memory_bus *, t_registers *, t_snapshot *);
+
+// Put A Machine Back To A Snapshot
+extern void restore_mos6502(t_memory_bus *, t_registers *, t_snapshot *);
+
+#endif // MOS_6502_SNAPSHOT_H
@@ -0,0 +1,304 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Multiple Processor System
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_system.c
+//
+// Description:
+//   Runs the processors of a system a quantum at a time on a pool of threads. Each quantum has two phases separated by a
+//   barrier: the processors run, then the write logs of all of them are applied to each view. Every log only has one writer
+//   and is only read once its writer has reached the barrier, so no locks are needed anywhere.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local
+#include "mos6502_system.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Longest quantum, which bounds the size of the write logs
+#define SYSTEM_MAX_QUANTUM_CYCLES 0x1000000
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Shared memory callbacks
+static unsigned char read_shared(void *, unsigned short);
+static void write_shared(void *, unsigned short, unsigned char);
+
+// Entry point of a worker thread
+static void *worker_main(void *);
+
+// Runs the quanta of a run for the processors of one thread
+static void run_participant(t_system *, unsigned int);
+
+// Runs a processor up to the end of a quantum
+static void run_quantum(t_system_cpu *, unsigned long long);
+
+// Applies the write logs of every processor to a copy of shared memory
+static void apply_writes(t_system *, unsigned char *);
+
+// Waits for every thread of the run
+static void wait_barrier(t_system *, unsigned int);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize a system with no processors. The shared memory must hold page count * MEMORY_PAGE_SIZE bytes and stay valid
+// for the life of the system, between runs it holds what the processors wrote.
+//   Inputs: System, Shared Memory, First Shared Page, Shared Page Count, Cycles In A Quantum
+//   Output: 0 on success, -1 if the pages or quantum are out of range
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int init_system_mos6502(t_system *system, unsigned char *shared, unsigned char first_page, unsigned int page_count,
+                               unsigned long long quantum_cycles) {
+#if !MOS_6502_CYCLE_COUNTING
+    printf("Error: A multiple processor system needs cycle counting!!\n");
+    return -1;
+#endif
+
+    memset(system, 0, sizeof(t_system));
+    if (page_count == 0 || first_page + page_count > MEMORY_PAGE_COUNT) {
+        printf("Error: %u shared pages do not fit from page $%02X!!\n", page_count, first_page);
+        return -1;
+    }
+    if (quantum_cycles == 0 || quantum_cycles > SYSTEM_MAX_QUANTUM_CYCLES) {
+        printf("Error: A quantum must be from 1 to %d cycles!!\n", SYSTEM_MAX_QUANTUM_CYCLES);
+        return -1;
+    }
+    system->shared = shared;
+    system->first_shared_page = first_page;
+    system->shared_page_count = page_count;
+    system->quantum_cycles = quantum_cycles;
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Add a processor to a system and map the shared memory into its bus. The processor runs from the cycle count its registers
+// have now, and the host must not change the count while it is part of the system.
+//   Inputs: System, Memory Bus, Registers, Block Cache (NULL to run the interpreter)
+//   Output: Processor number on success, -1 if the system is full or the memory could not be allocated
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int add_system_cpu_mos6502(t_system *system, t_memory_bus *bus, t_registers *registers, t_block_cache *cache) {
+    if (system->cpu_count == SYSTEM_MAX_CPUS) {
+        printf("Error: A system holds at most %d processors!!\n", SYSTEM_MAX_CPUS);
+        return -1;
+    }
+
+    t_system_cpu *cpu = &system->cpus[system->cpu_count];
+    memset(cpu, 0, sizeof(t_system_cpu));
+    cpu->system = system;
+    cpu->bus = bus;
+    cpu->registers = registers;
+    cpu->cache = cache;
+    cpu->write_capacity = (unsigned int) system->quantum_cycles + SYSTEM_WRITE_SLACK;
+    cpu->view = malloc(system->shared_page_count * MEMORY_PAGE_SIZE);
+    cpu->writes = malloc(cpu->write_capacity * sizeof(t_shared_write));
+    if (cpu->view == NULL || cpu->writes == NULL) {
+        printf("Error: Could not allocate processor %u of the system!!\n", system->cpu_count);
+        free(cpu->view);
+        free(cpu->writes);
+        return -1;
+    }
+    memcpy(cpu->view, system->shared, system->shared_page_count * MEMORY_PAGE_SIZE);
+    cpu->deadline = registers->cycles;
+    cpu->status = RUN_BUDGET_EXHAUSTED;
+
+    map_device_mos6502(bus, system->first_shared_page, system->shared_page_count, read_shared, write_shared, cpu);
+    return (int) system->cpu_count++;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Free the views and logs of a system. The shared pages stay mapped in the buses of its processors.
+//   Inputs: System
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void free_system_mos6502(t_system *system) {
+    for (unsigned int i = 0; i < system->cpu_count; i++) {
+        free(system->cpus[i].view);
+        free(system->cpus[i].writes);
+        system->cpus[i].view = NULL;
+        system->cpus[i].writes = NULL;
+    }
+    system->cpu_count = 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Run every processor that has not halted for a number of cycles, the last quantum cut short if the cycles are not a whole
+// number of quanta. With threads, each processor runs on its own thread, or the threads that could be started share them.
+// The machines are the same either way.
+//   Inputs: System, Cycles, Use Threads
+//   Output: 0 on success, -1 if the system has no processors
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int run_system_mos6502(t_system *system, unsigned long long cycles, int threaded) {
+    unsigned int started = 0;
+
+    if (system->cpu_count == 0) {
+        printf("Error: System has no processors to run!!\n");
+        return -1;
+    }
+
+    system->run_cycles = cycles;
+    atomic_store_explicit(&system->participants, 0, memory_order_relaxed);
+    atomic_store_explicit(&system->barrier_arrived, 0, memory_order_relaxed);
+
+    // Workers are numbered by the order they started in, so a thread that fails to start leaves no gap
+    for (unsigned int i = 1; threaded && i < system->cpu_count; i++) {
+        t_system_worker *worker = &system->workers[started + 1];
+        worker->system = system;
+        worker->index = started + 1;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) == 0) {
+            started++;
+        }
+    }
+    atomic_store_explicit(&system->participants, started + 1, memory_order_release);
+
+    run_participant(system, 0);
+    for (unsigned int i = 1; i <= started; i++) {
+        pthread_join(system->workers[i].thread, NULL);
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads shared memory as the processor sees it
+//   Inputs: Processor, Address
+//   Output: Value
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned char read_shared(void *device, unsigned short address) {
+    t_system_cpu *cpu = (t_system_cpu *) device;
+    return cpu->view[address - (cpu->system->first_shared_page << 8)];
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writes shared memory, which the processor sees straight away and the others once the quantum is over
+//   Inputs: Processor, Address, Value
+// -------------------------------------------------------------------------------------------------------------------------------
+static void write_shared(void *device, unsigned short address, unsigned char value) {
+    t_system_cpu *cpu = (t_system_cpu *) device;
+
+    cpu->view[address - (cpu->system->first_shared_page << 8)] = value;
+    if (cpu->write_count == cpu->write_capacity) {
+        // Can not happen with fewer writes than cycles, but a lost write must not run off the end of the log
+        cpu->write_overflows++;
+        return;
+    }
+    cpu->writes[cpu->write_count].address = address;
+    cpu->writes[cpu->write_count].value = value;
+    cpu->write_count++;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Entry point of a worker thread, which waits for every worker to have started
+//   Inputs: Worker
+//   Output: NULL
+// -------------------------------------------------------------------------------------------------------------------------------
+static void *worker_main(void *argument) {
+    t_system_worker *worker = (t_system_worker *) argument;
+
+    while (atomic_load_explicit(&worker->system->participants, memory_order_acquire) == 0) {
+        sched_yield();
+    }
+    run_participant(worker->system, worker->index);
+    return NULL;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs the quanta of a run for the processors of one thread, which are every one whose number is the thread's number plus a
+// multiple of the number of threads. The first thread also brings the host's copy of shared memory up to date.
+//   Inputs: System, Thread Number
+// -------------------------------------------------------------------------------------------------------------------------------
+static void run_participant(t_system *system, unsigned int participant) {
+    unsigned int participants = atomic_load_explicit(&system->participants, memory_order_acquire);
+    unsigned long long remaining = system->run_cycles;
+
+    while (remaining != 0) {
+        unsigned long long quantum = (remaining < system->quantum_cycles) ? remaining : system->quantum_cycles;
+        remaining -= quantum;
+
+        for (unsigned int i = participant; i < system->cpu_count; i += participants) {
+            run_quantum(&system->cpus[i], quantum);
+        }
+        wait_barrier(system, participants);
+
+        for (unsigned int i = participant; i < system->cpu_count; i += participants) {
+            apply_writes(system, system->cpus[i].view);
+        }
+        if (participant == 0) {
+            apply_writes(system, system->shared);
+            system->quanta++;
+        }
+        wait_barrier(system, participants);
+
+        // Nobody reads the logs again until every thread has passed the next barrier
+        for (unsigned int i = participant; i < system->cpu_count; i += participants) {
+            system->cpus[i].write_count = 0;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Runs a processor up to the end of a quantum. The last instruction can run past the end, and the next quantum is that much
+// shorter.
+//   Inputs: Processor, Cycles In The Quantum
+// -------------------------------------------------------------------------------------------------------------------------------
+static void run_quantum(t_system_cpu *cpu, unsigned long long quantum) {
+    t_run_status status;
+
+    cpu->deadline += quantum;
+    if (cpu->halted || cpu->registers->cycles >= cpu->deadline) {
+        return;
+    }
+
+    t_run_budget budget = { .cycle_limit = cpu->deadline - cpu->registers->cycles };
+    if (cpu->cache != NULL) {
+        status = run_cached_mos6502(cpu->cache, cpu->bus, cpu->registers, &budget);
+    } else {
+        status = run_mos6502(cpu->bus, cpu->registers, &budget);
+    }
+    cpu->instructions_executed += budget.instructions_executed;
+    if (status != RUN_BUDGET_EXHAUSTED) {
+        cpu->halted = 1;
+        cpu->status = status;
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Applies the write logs of every processor to a copy of shared memory, in processor order, so every copy ends up the same
+//   Inputs: System, Shared Memory Copy
+// -------------------------------------------------------------------------------------------------------------------------------
+static void apply_writes(t_system *system, unsigned char *memory) {
+    unsigned int base = system->first_shared_page << 8;
+
+    for (unsigned int i = 0; i < system->cpu_count; i++) {
+        const t_system_cpu *cpu = &system->cpus[i];
+        for (unsigned int j = 0; j < cpu->write_count; j++) {
+            memory[cpu->writes[j].address - base] = cpu->writes[j].value;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Waits for every thread of the run. The last one to arrive starts a new generation, which lets the others go.
+//   Inputs: System, Number Of Threads
+// -------------------------------------------------------------------------------------------------------------------------------
+static void wait_barrier(t_system *system, unsigned int participants) {
+    unsigned int generation = atomic_load_explicit(&system->barrier_generation, memory_order_acquire);
+
+    if (atomic_fetch_add_explicit(&system->barrier_arrived, 1, memory_order_acq_rel) == participants - 1) {
+        atomic_store_explicit(&system->barrier_arrived, 0, memory_order_relaxed);
+        atomic_fetch_add_explicit(&system->barrier_generation, 1, memory_order_release);
+        return;
+    }
+    while (atomic_load_explicit(&system->barrier_generation, memory_order_acquire) == generation) {
+        sched_yield();
+    }
+}
@@ -0,0 +1,127 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Multiple Processor System Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_system.h
+//
+// Description:
+//   Contains the data types and function prototypes for running several processors that share a range of memory pages, such
+//   as a main processor and a disk or sound processor talking through a mailbox. Each processor keeps its own bus for its
+//   private RAM, ROM and devices, and has the shared pages mapped into it.
+//
+//   Processors run in quanta of a fixed number of cycles, each on its own thread. During a quantum a processor sees the
+//   shared memory as it was at the start of the quantum plus its own writes, and its writes to it are also logged. At the
+//   end of the quantum every thread waits at a barrier, then every processor has the logs of all of them applied to its view
+//   in processor order, so a location written by several processors ends up with the value of the last one. What each
+//   processor sees only depends on the quantum, never on how the threads were scheduled, so a run on several threads gives
+//   exactly the same machines as a run on one. A smaller quantum lets processors see each other's writes sooner at the cost
+//   of more barriers.
+//
+//   Reads and writes of the shared pages take the slow path of the bus, and code running from them is not cached. Cycle
+//   counting must be compiled in.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_SYSTEM_H
+#define MOS_6502_SYSTEM_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Local
+#include "mos6502_emulator.h"
+#include "mos6502_block_cache.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most processors in a system
+#define SYSTEM_MAX_CPUS 16
+
+// Writes a log holds beyond the quantum, as the last instruction of a quantum can run past its end
+#define SYSTEM_WRITE_SLACK 16
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+struct t_struct_system;
+
+// Write to shared memory waiting for the end of the quantum
+typedef struct t_struct_shared_write {
+    unsigned short address;
+    unsigned char value;
+} t_shared_write;
+
+// Single processor of a system
+typedef struct t_struct_system_cpu {
+    struct t_struct_system *system;
+    t_memory_bus *bus;
+    t_registers *registers;
+    // Block cache to run with, NULL for the interpreter
+    t_block_cache *cache;
+    // Shared memory as this processor sees it
+    unsigned char *view;
+    // Writes to shared memory during this quantum, in the order they were made
+    t_shared_write *writes;
+    unsigned int write_count;
+    unsigned int write_capacity;
+    // Cycle count this processor runs up to in the current quantum
+    unsigned long long deadline;
+    // Set when a run of the processor ends for any reason but its budget, it is not run again until the host clears it
+    int halted;
+    t_run_status status;
+    // Counters
+    unsigned long long instructions_executed;
+    unsigned long long write_overflows;
+} t_system_cpu;
+
+// Thread running some of the processors of a system
+typedef struct t_struct_system_worker {
+    struct t_struct_system *system;
+    unsigned int index;
+    pthread_t thread;
+} t_system_worker;
+
+// Multiple processor system
+typedef struct t_struct_system {
+    t_system_cpu cpus[SYSTEM_MAX_CPUS];
+    unsigned int cpu_count;
+    // Shared memory as of the end of the last quantum, and where it is mapped in every processor
+    unsigned char *shared;
+    unsigned char first_shared_page;
+    unsigned int shared_page_count;
+    // Cycles in a quantum
+    unsigned long long quantum_cycles;
+    // Workers of the run in progress, and the number taking part once every thread has started
+    t_system_worker workers[SYSTEM_MAX_CPUS];
+    atomic_uint participants;
+    unsigned long long run_cycles;
+    // Barrier at the end of each phase of a quantum, threads arrive and wait for the generation to change
+    atomic_uint barrier_arrived;
+    atomic_uint barrier_generation;
+    // Counters
+    unsigned long long quanta;
+} t_system;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize A System With No Processors Around Shared Memory
+extern int init_system_mos6502(t_system *, unsigned char *, unsigned char, unsigned int, unsigned long long);
+
+// Add A Processor, Mapping The Shared Memory Into Its Bus
+extern int add_system_cpu_mos6502(t_system *, t_memory_bus *, t_registers *, t_block_cache *);
+
+// Free The Views And Logs Of A System
+extern void free_system_mos6502(t_system *);
+
+// Run Every Processor For A Number Of Cycles
+extern int run_system_mos6502(t_system *, unsigned long long, int);
+
+#endif // MOS_6502_SYSTEM_H
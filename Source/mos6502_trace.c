@@ -0,0 +1,353 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Trace
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_trace.c
+//
+// Description:
+//   Trace ring set up, the writer thread that streams a ring into a memory mapped trace file and the decoder that prints
+//   trace records as text
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Local
+#include "mos6502_trace.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Time the writer sleeps when the ring is empty
+#define TRACE_WRITER_SLEEP_NS 100000
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writer thread
+static void *writer_main(void *);
+static unsigned long long write_records(t_trace_writer *);
+static int grow_trace_file(t_trace_writer *, unsigned long long);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize an empty ring with no writer
+//   Inputs: Trace Ring, Log2 Of The Number Of Records
+//   Output: 0 on success, -1 if the records could not be allocated
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int init_trace_ring_mos6502(t_trace_ring *ring, unsigned int capacity_log2) {
+    ring->capacity = 1ULL << capacity_log2;
+    ring->mask = ring->capacity - 1;
+    ring->records = calloc(ring->capacity, sizeof(t_trace_record));
+    if (ring->records == NULL) {
+        printf("Error: Could not allocate %llu trace records!!\n", ring->capacity);
+        return -1;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->writer_attached, 0);
+    ring->cached_tail = 0;
+    ring->dropped = 0;
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Free the records of a ring, its writer must have been stopped
+//   Inputs: Trace Ring
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void free_trace_ring_mos6502(t_trace_ring *ring) {
+    free(ring->records);
+    ring->records = NULL;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Start a thread streaming a ring into a new trace file. Records already in the ring are skipped. The ring must not be
+// filled while the writer is being started.
+//   Inputs: Trace Writer, Trace Ring, File Path
+//   Output: 0 on success, -1 if the file could not be created or the thread started
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int start_trace_writer_mos6502(t_trace_writer *writer, t_trace_ring *ring, const char *path) {
+    writer->ring = ring;
+    writer->map = NULL;
+    writer->mapped_size = 0;
+    writer->record_count = 0;
+    writer->dropped = 0;
+    atomic_init(&writer->stop_requested, 0);
+
+    writer->file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (writer->file < 0) {
+        printf("Error: Could not create trace file %s!!\n", path);
+        return -1;
+    }
+    if (grow_trace_file(writer, TRACE_FILE_GROWTH) != 0) {
+        close(writer->file);
+        return -1;
+    }
+
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    atomic_store_explicit(&ring->tail, head, memory_order_relaxed);
+    ring->cached_tail = head;
+    atomic_store_explicit(&ring->writer_attached, 1, memory_order_release);
+
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        printf("Error: Could not start the trace writer!!\n");
+        atomic_store_explicit(&ring->writer_attached, 0, memory_order_release);
+        munmap(writer->map, writer->mapped_size);
+        close(writer->file);
+        return -1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Stop a writer once it has written every record in the ring, then cut the trace file down to the records written and fill
+// in its header. The ring goes back to overwriting its oldest records.
+//   Inputs: Trace Writer
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void stop_trace_writer_mos6502(t_trace_writer *writer) {
+    t_trace_file_header header;
+
+    atomic_store_explicit(&writer->stop_requested, 1, memory_order_release);
+    pthread_join(writer->thread, NULL);
+    atomic_store_explicit(&writer->ring->writer_attached, 0, memory_order_release);
+
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.record_size = sizeof(t_trace_record);
+    header.record_count = writer->record_count;
+    header.dropped = writer->ring->dropped + writer->dropped;
+    memcpy(writer->map, &header, sizeof(header));
+
+    munmap(writer->map, writer->mapped_size);
+    if (ftruncate(writer->file, sizeof(header) + writer->record_count * sizeof(t_trace_record)) != 0) {
+        printf("Error: Could not truncate the trace file!!\n");
+    }
+    close(writer->file);
+    writer->map = NULL;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Print the last records of a ring, oldest first. The ring must not be filled while it is printed.
+//   Inputs: Trace Ring, Output File, Most Records To Print
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void print_trace_ring_mos6502(t_trace_ring *ring, FILE *output, unsigned long long count) {
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned long long available = (head < ring->capacity) ? head : ring->capacity;
+    unsigned long long cycles = 0;
+
+    if (count > available) {
+        count = available;
+    }
+    for (unsigned long long position = head - count; position != head; position++) {
+        const t_trace_record *record = &ring->records[position & ring->mask];
+        // Only the low bits of the cycle counter are in the ring, so the count printed starts from the first record shown
+        unsigned long long next = (cycles & ~0xFFFFFFFFULL) | record->cycles;
+        if (next < cycles) {
+            next += 1ULL << 32;
+        }
+        cycles = next;
+        print_trace_record_mos6502(output, record, cycles);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Print a single record as one line of text: address, instruction bytes, disassembly, registers and cycles
+//   Inputs: Output File, Trace Record, Full Cycle Count
+// -------------------------------------------------------------------------------------------------------------------------------
+extern void print_trace_record_mos6502(FILE *output, const t_trace_record *record, unsigned long long cycles) {
+    const t_opcode_descriptor *descriptor = &mos6502_opcode_table[record->opcode];
+    unsigned char low = record->operand & 0xFF;
+    unsigned char high = record->operand >> 8;
+    char bytes[16];
+    char operand[16];
+
+    if (descriptor->mnemonic == NULL) {
+        fprintf(output, "%04X  %02X        ???            A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu\n", record->program_counter,
+                record->opcode, record->accumulator, record->register_x, record->register_y, record->processor_status,
+                record->stack_pointer, cycles);
+        return;
+    }
+
+    if (descriptor->length == 3) {
+        snprintf(bytes, sizeof(bytes), "%02X %02X %02X", record->opcode, low, high);
+    } else if (descriptor->length == 2) {
+        snprintf(bytes, sizeof(bytes), "%02X %02X", record->opcode, low);
+    } else {
+        snprintf(bytes, sizeof(bytes), "%02X", record->opcode);
+    }
+
+    switch (descriptor->addressing_mode) {
+        case ZERO_PAGE:        snprintf(operand, sizeof(operand), "$%02X", low); break;
+        case ZERO_PAGE_X:      snprintf(operand, sizeof(operand), "$%02X,X", low); break;
+        case ZERO_PAGE_Y:      snprintf(operand, sizeof(operand), "$%02X,Y", low); break;
+        case ABSOLUTE:         snprintf(operand, sizeof(operand), "$%04X", record->operand); break;
+        case ABSOLUTE_X:       snprintf(operand, sizeof(operand), "$%04X,X", record->operand); break;
+        case ABSOLUTE_Y:       snprintf(operand, sizeof(operand), "$%04X,Y", record->operand); break;
+        case INDIRECT:         snprintf(operand, sizeof(operand), "($%04X)", record->operand); break;
+        case INDEXED_INDIRECT: snprintf(operand, sizeof(operand), "($%02X,X)", low); break;
+        case INDIRECT_INDEXED: snprintf(operand, sizeof(operand), "($%02X),Y", low); break;
+        case ACCUMULATOR:      snprintf(operand, sizeof(operand), "A"); break;
+        case IMMEDIATE:        snprintf(operand, sizeof(operand), "#$%02X", low); break;
+        // Branches show their target rather than the offset
+        case RELATIVE:         snprintf(operand, sizeof(operand), "$%04X", (unsigned short) (record->program_counter + 2 + (signed char) low)); break;
+        case IMPLIED:
+        default:               operand[0] = '\0'; break;
+    }
+
+    fprintf(output, "%04X  %-8s  %s %-10s A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu\n", record->program_counter, bytes,
+            descriptor->mnemonic, operand, record->accumulator, record->register_x, record->register_y,
+            record->processor_status, record->stack_pointer, cycles);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Print every record of a trace file. The cycle counter is rebuilt from the low 32 bits kept in each record, which only
+// goes wrong if more than 2^32 cycles pass between two records.
+//   Inputs: File Path, Output File
+//   Output: 0 on success, -1 if the file could not be read or is not a trace file
+// -------------------------------------------------------------------------------------------------------------------------------
+extern int decode_trace_file_mos6502(const char *path, FILE *output) {
+    t_trace_file_header header;
+    struct stat file_status;
+    unsigned long long cycles = 0;
+
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        printf("Error: Could not open trace file %s!!\n", path);
+        return -1;
+    }
+    if (fstat(file, &file_status) != 0 || (unsigned long long) file_status.st_size < sizeof(header)) {
+        printf("Error: %s is not a trace file!!\n", path);
+        close(file);
+        return -1;
+    }
+
+    unsigned char *map = mmap(NULL, file_status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED) {
+        printf("Error: Could not map trace file %s!!\n", path);
+        return -1;
+    }
+
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != TRACE_FILE_VERSION ||
+        header.record_size != sizeof(t_trace_record) ||
+        sizeof(header) + header.record_count * sizeof(t_trace_record) > (unsigned long long) file_status.st_size) {
+        printf("Error: %s is not a trace file this version can read!!\n", path);
+        munmap(map, file_status.st_size);
+        return -1;
+    }
+
+    const t_trace_record *records = (const t_trace_record *) (map + sizeof(header));
+    for (unsigned long long i = 0; i < header.record_count; i++) {
+        unsigned long long next = (cycles & ~0xFFFFFFFFULL) | records[i].cycles;
+        if (next < cycles) {
+            next += 1ULL << 32;
+        }
+        cycles = next;
+        print_trace_record_mos6502(output, &records[i], cycles);
+    }
+    if (header.dropped != 0) {
+        fprintf(output, "%llu records were dropped because the writer fell behind\n", header.dropped);
+    }
+
+    munmap(map, file_status.st_size);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Writer thread, copies records out of the ring until asked to stop and the ring is empty
+//   Inputs: Trace Writer
+// -------------------------------------------------------------------------------------------------------------------------------
+static void *writer_main(void *argument) {
+    t_trace_writer *writer = argument;
+    struct timespec sleep_time = { 0, TRACE_WRITER_SLEEP_NS };
+
+    for (;;) {
+        // Read the stop flag first so records stored before it was set are still written
+        int stopping = atomic_load_explicit(&writer->stop_requested, memory_order_acquire);
+        if (write_records(writer) == 0) {
+            if (stopping) {
+                break;
+            }
+            nanosleep(&sleep_time, NULL);
+        }
+    }
+    return NULL;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Copies every record the producer has finished into the trace file and hands the slots back
+//   Inputs: Trace Writer
+//   Output: Number of records written
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned long long write_records(t_trace_writer *writer) {
+    t_trace_ring *ring = writer->ring;
+    unsigned long long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned long long written = 0;
+
+    while (tail != head) {
+        // Copy up to the end of the ring at most, the rest goes on the next pass
+        unsigned long long slot = tail & ring->mask;
+        unsigned long long count = head - tail;
+        if (count > ring->capacity - slot) {
+            count = ring->capacity - slot;
+        }
+
+        unsigned long long offset = sizeof(t_trace_file_header) + writer->record_count * sizeof(t_trace_record);
+        unsigned long long size = count * sizeof(t_trace_record);
+        if (offset + size > writer->mapped_size) {
+            unsigned long long growth = (size > TRACE_FILE_GROWTH) ? size : TRACE_FILE_GROWTH;
+            if (grow_trace_file(writer, writer->mapped_size + growth) != 0) {
+                // Nowhere to put them, count them as dropped rather than stall the producer
+                writer->dropped += count;
+                tail += count;
+                atomic_store_explicit(&ring->tail, tail, memory_order_release);
+                continue;
+            }
+        }
+
+        memcpy(writer->map + offset, &ring->records[slot], size);
+        writer->record_count += count;
+        written += count;
+        tail += count;
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+    return written;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Grows the trace file and maps all of it again
+//   Inputs: Trace Writer, New Size
+//   Output: 0 on success, -1 if the file could not be grown or mapped
+// -------------------------------------------------------------------------------------------------------------------------------
+static int grow_trace_file(t_trace_writer *writer, unsigned long long size) {
+    if (ftruncate(writer->file, size) != 0) {
+        printf("Error: Could not grow the trace file!!\n");
+        return -1;
+    }
+
+    unsigned char *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, writer->file, 0);
+    if (map == MAP_FAILED) {
+        printf("Error: Could not map the trace file!!\n");
+        return -1;
+    }
+
+    if (writer->map != NULL) {
+        munmap(writer->map, writer->mapped_size);
+    }
+    writer->map = map;
+    writer->mapped_size = size;
+    return 0;
+}
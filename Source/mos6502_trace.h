@@ -0,0 +1,163 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Trace Header File
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_trace.h
+//
+// Description:
+//   Contains the data types and function prototypes for execution tracing. While tracing is compiled in (MOS_6502_TRACE)
+//   run_mos6502() and run_cached_mos6502() store a 16 byte record for every instruction into the trace ring of their budget,
+//   holding the processor state just before the instruction runs. A ring has a single producer, the thread running the
+//   machine, and at most a single consumer, a writer thread streaming the records into a memory mapped trace file. Without a
+//   writer the ring keeps overwriting its oldest records, so the last instructions before a crash can still be printed.
+//
+//   Trace files are turned back into text with decode_trace_file_mos6502(), or the trace decoder in Tools.
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+#ifndef MOS_6502_TRACE_H
+#define MOS_6502_TRACE_H
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+// Local
+#include "mos6502_emulator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Size of a cache line, the producer and consumer positions each get their own
+#define TRACE_CACHE_LINE_SIZE 64
+
+// Trace file identification, the header is followed straight away by the records
+#define TRACE_FILE_MAGIC   "M6502TRC"
+#define TRACE_FILE_VERSION 1
+
+// Amount a trace file grows by each time the writer runs out of mapped space
+#define TRACE_FILE_GROWTH (16 * 1024 * 1024)
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Processor state just before an instruction runs. Only the low 32 bits of the cycle counter are kept, the decoder puts the
+// rest back from the order of the records.
+typedef struct t_struct_trace_record {
+    unsigned int cycles;
+    unsigned short program_counter;
+    unsigned short operand;
+    unsigned char opcode;
+    unsigned char accumulator;
+    unsigned char register_x;
+    unsigned char register_y;
+    unsigned char stack_pointer;
+    t_processor_status processor_status;
+    unsigned char reserved[2];
+} t_trace_record;
+
+// Trace ring. Positions count records from the start and only ever go up, the slot of a record is its position masked by the
+// capacity.
+typedef struct t_struct_trace_ring {
+    t_trace_record *records;
+    unsigned long long capacity;
+    unsigned long long mask;
+    // Next position written, only changed by the producer
+    _Alignas(TRACE_CACHE_LINE_SIZE) atomic_ullong head;
+    // Producer's copy of the tail and the records it had to drop because the writer fell behind
+    unsigned long long cached_tail;
+    unsigned long long dropped;
+    // Set while a writer is streaming the ring, the producer never overwrites records it has not taken yet
+    atomic_int writer_attached;
+    // Next position read, only changed by the writer
+    _Alignas(TRACE_CACHE_LINE_SIZE) atomic_ullong tail;
+} t_trace_ring;
+
+// Header at the start of a trace file, rewritten with the final counts when the writer stops
+typedef struct t_struct_trace_file_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int record_size;
+    unsigned long long record_count;
+    unsigned long long dropped;
+} t_trace_file_header;
+
+// Writer thread streaming a ring into a trace file
+typedef struct t_struct_trace_writer {
+    t_trace_ring *ring;
+    int file;
+    unsigned char *map;
+    unsigned long long mapped_size;
+    unsigned long long record_count;
+    // Records the writer could not fit in the file
+    unsigned long long dropped;
+    atomic_int stop_requested;
+    pthread_t thread;
+} t_trace_writer;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Initialize Empty Ring Holding 2^n Records
+extern int init_trace_ring_mos6502(t_trace_ring *, unsigned int);
+
+// Free The Records Of A Ring
+extern void free_trace_ring_mos6502(t_trace_ring *);
+
+// Start Streaming A Ring Into A Trace File
+extern int start_trace_writer_mos6502(t_trace_writer *, t_trace_ring *, const char *);
+
+// Stop Streaming, Once Every Record Has Been Written
+extern void stop_trace_writer_mos6502(t_trace_writer *);
+
+// Print The Last Records Of A Ring
+extern void print_trace_ring_mos6502(t_trace_ring *, FILE *, unsigned long long);
+
+// Print A Single Record
+extern void print_trace_record_mos6502(FILE *, const t_trace_record *, unsigned long long);
+
+// Print A Whole Trace File
+extern int decode_trace_file_mos6502(const char *, FILE *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Inline Functions
+// -------------------------------------------------------------------------------------------------------------------------------
+// -------------------------------------------------------------------------------------------------------------------------------
+// Stores a record into a ring. Only the thread running the machine may call this. While a writer is attached and has fallen
+// a whole ring behind the record is dropped instead.
+//   Inputs: Trace Ring, Program Counter, Opcode, Operand, Accumulator, X Register, Y Register, Stack Pointer, Processor Status,
+//           Cycles
+// -------------------------------------------------------------------------------------------------------------------------------
+static inline void record_trace_mos6502(t_trace_ring *ring, unsigned short program_counter, unsigned char opcode, unsigned short operand,
+                                        unsigned char accumulator, unsigned char register_x, unsigned char register_y,
+                                        unsigned char stack_pointer, t_processor_status processor_status, unsigned long long cycles) {
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (head - ring->cached_tail >= ring->capacity && atomic_load_explicit(&ring->writer_attached, memory_order_relaxed)) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - ring->cached_tail >= ring->capacity) {
+            ring->dropped++;
+            return;
+        }
+    }
+
+    t_trace_record *record = &ring->records[head & ring->mask];
+    record->cycles = (unsigned int) cycles;
+    record->program_counter = program_counter;
+    record->operand = operand;
+    record->opcode = opcode;
+    record->accumulator = accumulator;
+    record->register_x = register_x;
+    record->register_y = register_y;
+    record->stack_pointer = stack_pointer;
+    record->processor_status = processor_status;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+#endif // MOS_6502_TRACE_H
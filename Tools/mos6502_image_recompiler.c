@@ -0,0 +1,112 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Image Recompiler
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_image_recompiler.c
+//
+// Description:
+//   Recompiles a raw firmware image to a C module, following code from its vectors when the image covers them and from any
+//   other entry points given. The module is built along with the emulator, and its run_<name>_mos6502() is called in place
+//   of run_mos6502() with the image mapped write protected at the same address. Addresses are in hex.
+//
+//   Build: cc -O2 -I../Source mos6502_image_recompiler.c ../Source/mos6502_recompiler.c ../Source/mos6502_loader.c
+//          ../Source/mos6502_memory_bus.c -o mos6502_image_recompiler
+//   Usage: mos6502_image_recompiler image_file load_address output_file [name] [entry ...]
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+
+// Local
+#include "mos6502_loader.h"
+#include "mos6502_recompiler.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Name of the module when none is given
+#define DEFAULT_NAME "firmware"
+
+// Most entry points on the command line
+#define MAX_ENTRIES 256
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+static int parse_address(const char *, unsigned short *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    unsigned short entries[MAX_ENTRIES];
+    unsigned int entry_count = 0;
+    unsigned short address;
+    t_rom_image image;
+    t_recompiler_result result;
+
+    if (argc < 4 || argc > 5 + MAX_ENTRIES) {
+        printf("Usage: %s image_file load_address output_file [name] [entry ...]\n", argv[0]);
+        return 1;
+    }
+    if (parse_address(argv[2], &address) != 0) {
+        return 1;
+    }
+    for (int i = 5; i < argc; i++) {
+        if (parse_address(argv[i], &entries[entry_count++]) != 0) {
+            return 1;
+        }
+    }
+    if (open_rom_image_mos6502(&image, argv[1]) != 0) {
+        return 1;
+    }
+
+    FILE *output = fopen(argv[3], "w");
+    if (output == NULL) {
+        printf("Error: Could not create %s!!\n", argv[3]);
+        close_rom_image_mos6502(&image);
+        return 1;
+    }
+    int status = recompile_mos6502(image.data, image.size, address, entries, entry_count, (argc > 4) ? argv[4] : DEFAULT_NAME,
+                                   output, &result);
+    fclose(output);
+    close_rom_image_mos6502(&image);
+    if (status != 0) {
+        remove(argv[3]);
+        return 1;
+    }
+
+    printf("Entry points:      %u\n", result.entry_points);
+    printf("Instructions:      %u\n", result.instructions);
+    printf("Blocks:            %u\n", result.blocks);
+    printf("Computed jumps:    %u\n", result.computed_jumps);
+    printf("Left to interpret: %u\n", result.unrecovered);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Parses an address in hex, with or without a leading $ or 0x
+//   Inputs: Text, Address (filled in)
+//   Output: 0 on success, -1 if it is not an address
+// -------------------------------------------------------------------------------------------------------------------------------
+static int parse_address(const char *text, unsigned short *address) {
+    char *end;
+
+    if (text[0] == '$') {
+        text++;
+    }
+    unsigned long value = strtoul(text, &end, 16);
+    if (text[0] == '\0' || *end != '\0' || value >= MOS_6502_MEM_SIZE) {
+        printf("Error: %s is not an address!!\n", text);
+        return -1;
+    }
+    *address = (unsigned short) value;
+    return 0;
+}
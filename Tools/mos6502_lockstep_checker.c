@@ -0,0 +1,204 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Lockstep Checker
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_lockstep_checker.c
+//
+// Description:
+//   Checks the block cache, or the block cache with the JIT, against the interpreter on random programs. Memory is filled
+//   with every supported opcode in equal measure, mixed with random bytes for operands, and the registers are random. Each
+//   program is run in lockstep until it has run its share of instructions or hits an unsupported opcode, and the first
+//   difference is printed with the state of both machines.
+//
+//   The JIT only runs whole blocks, so it is only checked with an interval longer than its blocks, 64 is plenty.
+//
+//   Build: cc -O2 -pthread -I../Source mos6502_lockstep_checker.c ../Source/mos6502_lockstep.c ../Source/mos6502_trace.c
+//          ../Source/mos6502_emulator.c ../Source/mos6502_block_cache.c ../Source/mos6502_jit.c ../Source/mos6502_memory_bus.c
+//          ../Source/mos6502_debugger.c -o mos6502_lockstep_checker
+//   Usage: mos6502_lockstep_checker [instructions] [check interval] [cache|jit] [seed]
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Local
+#include "mos6502_lockstep.h"
+#include "mos6502_block_cache.h"
+#include "mos6502_jit.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defaults for the command line arguments
+#define DEFAULT_INSTRUCTIONS 100000000
+#define DEFAULT_CHECK_INTERVAL 1
+
+// Most instructions run from one random program before the next one is made
+#define PROGRAM_INSTRUCTIONS 100000
+
+// One byte in this many is random rather than an opcode
+#define RANDOM_BYTE_RATE 8
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Everything owned by a single machine
+typedef struct t_struct_machine {
+    unsigned char memory[MOS_6502_MEM_SIZE];
+    t_memory_bus bus;
+    t_registers registers;
+} t_machine;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+// Machines run by the interpreter and by the candidate
+static t_machine reference_machine;
+static t_machine candidate_machine;
+
+// Candidate engine
+static t_block_cache cache;
+static t_jit jit;
+
+static t_lockstep lockstep;
+
+// Every supported opcode
+static unsigned char opcodes[OPCODE_TABLE_SIZE];
+static unsigned int opcode_count;
+
+// State of the random number generator
+static unsigned long long random_state;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Makes the next random program in both machines
+static void make_program(void);
+
+// Random numbers that are the same on every host for the same seed
+static unsigned int next_random(void);
+
+// Seconds since an arbitrary point
+static double now_seconds(void);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    unsigned long long instruction_count = (argc > 1) ? strtoull(argv[1], NULL, 0) : DEFAULT_INSTRUCTIONS;
+    unsigned long long check_interval = (argc > 2) ? strtoull(argv[2], NULL, 0) : DEFAULT_CHECK_INTERVAL;
+    int use_jit = (argc > 3) && strcmp(argv[3], "jit") == 0;
+    unsigned long long checked = 0;
+    unsigned long long programs = 0;
+
+    random_state = (argc > 4) ? strtoull(argv[4], NULL, 0) : 1;
+
+    for (unsigned int opcode = 0; opcode < OPCODE_TABLE_SIZE; opcode++) {
+        if (mos6502_opcode_table[opcode].mnemonic != NULL) {
+            opcodes[opcode_count++] = (unsigned char) opcode;
+        }
+    }
+
+    init_block_cache_mos6502(&cache);
+    if (use_jit) {
+        if (init_jit_mos6502(&jit) != 0) {
+            printf("Error: The JIT is not available on this host!!\n");
+            return 1;
+        }
+        // Compile blocks straight away so that most of the run is native
+        jit.hot_threshold = 1;
+        cache.jit = &jit;
+    }
+
+    printf("Checking the %s against the interpreter, %llu instructions between checks\n", use_jit ? "JIT" : "block cache",
+           check_interval);
+
+    double start_time = now_seconds();
+    while (checked < instruction_count) {
+        make_program();
+        init_lockstep_mos6502(&lockstep, &reference_machine.bus, &reference_machine.registers, &candidate_machine.bus,
+                              &candidate_machine.registers, run_cached_lockstep_mos6502, &cache);
+        lockstep.check_interval = check_interval;
+
+        unsigned long long share = instruction_count - checked;
+        if (share > PROGRAM_INSTRUCTIONS) {
+            share = PROGRAM_INSTRUCTIONS;
+        }
+        if (run_lockstep_mos6502(&lockstep, share) != 0) {
+            printf("Program %llu (seed %llu):\n", programs, (argc > 4) ? strtoull(argv[4], NULL, 0) : 1);
+            print_divergence_mos6502(&lockstep, stdout);
+            return 1;
+        }
+        // A program stuck on an unsupported opcode straight away still counts as one instruction, so the run always ends
+        checked += (lockstep.instructions_checked != 0) ? lockstep.instructions_checked : 1;
+        programs++;
+    }
+    double seconds = now_seconds() - start_time;
+
+    printf("%llu instructions from %llu programs match, %.2f million instructions per second\n", checked, programs,
+           (seconds > 0) ? checked / seconds / 1e6 : 0);
+    if (use_jit) {
+        printf("JIT: %llu blocks compiled, %llu native runs, %llu left early\n", jit.blocks_compiled, jit.native_runs,
+               jit.side_exits);
+        free_jit_mos6502(&jit);
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Fills both machines with the same random program and registers, and throws away every block decoded from the last one
+// -------------------------------------------------------------------------------------------------------------------------------
+static void make_program(void) {
+    for (unsigned int address = 0; address < MOS_6502_MEM_SIZE; address++) {
+        if (next_random() % RANDOM_BYTE_RATE == 0) {
+            reference_machine.memory[address] = (unsigned char) next_random();
+        } else {
+            reference_machine.memory[address] = opcodes[next_random() % opcode_count];
+        }
+    }
+    memcpy(candidate_machine.memory, reference_machine.memory, MOS_6502_MEM_SIZE);
+
+    init_memory_bus_mos6502(&reference_machine.bus);
+    init_memory_bus_mos6502(&candidate_machine.bus);
+    map_memory_mos6502(&reference_machine.bus, 0, MEMORY_PAGE_COUNT, reference_machine.memory, 0);
+    map_memory_mos6502(&candidate_machine.bus, 0, MEMORY_PAGE_COUNT, candidate_machine.memory, 0);
+    flush_block_cache_mos6502(&cache);
+
+    memset(&reference_machine.registers, 0, sizeof(t_registers));
+    reference_machine.registers.program_counter = (unsigned short) next_random();
+    reference_machine.registers.accumulator = (unsigned char) next_random();
+    reference_machine.registers.register_x = (unsigned char) next_random();
+    reference_machine.registers.register_y = (unsigned char) next_random();
+    reference_machine.registers.stack_pointer = (unsigned char) next_random();
+    reference_machine.registers.processor_status = (unsigned char) next_random();
+    candidate_machine.registers = reference_machine.registers;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Random numbers from a xorshift generator
+//   Output: Next random number
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (unsigned int) (random_state >> 32);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Seconds since an arbitrary point
+// -------------------------------------------------------------------------------------------------------------------------------
+static double now_seconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
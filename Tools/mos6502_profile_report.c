@@ -0,0 +1,196 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Profile Report
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_profile_report.c
+//
+// Description:
+//   Prints a profile saved by save_profile_mos6502() and lists the routines that ran the most instructions. Routines come
+//   from a ranges file when one is given, one "START END NAME" line per routine with hexadecimal addresses, otherwise every
+//   run of executed addresses with no more than ROUTINE_GAP bytes between them is taken as one routine.
+//
+//   Build: cc -O2 -pthread -I../Source mos6502_profile_report.c ../Source/mos6502_profile.c ../Source/mos6502_emulator.c
+//          ../Source/mos6502_trace.c ../Source/mos6502_block_cache.c ../Source/mos6502_jit.c ../Source/mos6502_memory_bus.c
+//          ../Source/mos6502_debugger.c -o mos6502_profile_report
+//   Usage: mos6502_profile_report profile_file [top_count] [ranges_file]
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local
+#include "mos6502_profile.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Most unexecuted bytes allowed inside a routine found without a ranges file
+#define ROUTINE_GAP 16
+
+// Most routines read from a ranges file
+#define MAX_ROUTINES 4096
+
+// Routines listed when no count is given
+#define DEFAULT_TOP_COUNT 20
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Data Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Address range and the instructions run inside it
+typedef struct t_struct_routine {
+    unsigned int start;
+    unsigned int end;
+    char name[64];
+    unsigned long long hits;
+} t_routine;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Finds the routines
+static unsigned int read_routines(const char *, t_routine *);
+static unsigned int find_routines(t_profile *, t_routine *);
+
+// Orders routines by hits, highest first
+static int compare_routines(const void *, const void *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    unsigned int top_count = DEFAULT_TOP_COUNT;
+    unsigned int routine_count;
+
+    if (argc < 2 || argc > 4) {
+        printf("Usage: %s profile_file [top_count] [ranges_file]\n", argv[0]);
+        return 1;
+    }
+    if (argc >= 3) {
+        top_count = (unsigned int) strtoul(argv[2], NULL, 10);
+    }
+
+    t_profile *profile = malloc(sizeof(t_profile));
+    t_routine *routines = malloc(MAX_ROUTINES * sizeof(t_routine));
+    if (profile == NULL || routines == NULL) {
+        printf("Error: Could not allocate memory for the profile!!\n");
+        free(profile);
+        free(routines);
+        return 1;
+    }
+    if (load_profile_mos6502(profile, argv[1]) != 0) {
+        free(profile);
+        free(routines);
+        return 1;
+    }
+
+    print_profile_mos6502(profile, stdout, top_count);
+
+    // Sum the hits of each routine
+    routine_count = (argc == 4) ? read_routines(argv[3], routines) : find_routines(profile, routines);
+    unsigned long long instructions = 0;
+    for (unsigned int address = 0; address < MOS_6502_MEM_SIZE; address++) {
+        instructions += profile->address_hits[address];
+    }
+    for (unsigned int i = 0; i < routine_count; i++) {
+        routines[i].hits = 0;
+        for (unsigned int address = routines[i].start; address <= routines[i].end; address++) {
+            routines[i].hits += profile->address_hits[address];
+        }
+    }
+    qsort(routines, routine_count, sizeof(t_routine), compare_routines);
+
+    printf("\n%-11s %-24s %14s %7s\n", "Range", "Routine", "Hits", "%");
+    for (unsigned int i = 0; i < routine_count && i < top_count && routines[i].hits != 0; i++) {
+        printf("$%04X-$%04X %-24s %14llu %6.2f%%\n", routines[i].start, routines[i].end, routines[i].name, routines[i].hits,
+               (instructions != 0) ? 100.0 * routines[i].hits / instructions : 0.0);
+    }
+
+    free(profile);
+    free(routines);
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Reads routines from a ranges file, one "START END NAME" line each with hexadecimal addresses. Other lines are skipped.
+//   Inputs: Ranges File Path, Routines (MAX_ROUTINES entries, filled in)
+//   Output: Number of routines read
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int read_routines(const char *path, t_routine *routines) {
+    unsigned int count = 0;
+    char line[256];
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Error: Could not open ranges file %s!!\n", path);
+        return 0;
+    }
+
+    while (count < MAX_ROUTINES && fgets(line, sizeof(line), file) != NULL) {
+        t_routine *routine = &routines[count];
+        routine->name[0] = '\0';
+        if (sscanf(line, "%x %x %63s", &routine->start, &routine->end, routine->name) < 2 || routine->start > routine->end ||
+            routine->end >= MOS_6502_MEM_SIZE) {
+            continue;
+        }
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Takes every run of executed addresses as a routine, allowing up to ROUTINE_GAP unexecuted bytes for the operands and short
+// skipped paths inside it
+//   Inputs: Profile, Routines (MAX_ROUTINES entries, filled in)
+//   Output: Number of routines found
+// -------------------------------------------------------------------------------------------------------------------------------
+static unsigned int find_routines(t_profile *profile, t_routine *routines) {
+    unsigned int count = 0;
+    unsigned int address = 0;
+
+    while (count < MAX_ROUTINES) {
+        // Skip to the next executed address
+        while (address < MOS_6502_MEM_SIZE && profile->address_hits[address] == 0) {
+            address++;
+        }
+        if (address == MOS_6502_MEM_SIZE) {
+            break;
+        }
+
+        // Extend the routine while the next executed address is close enough
+        t_routine *routine = &routines[count++];
+        routine->start = routine->end = address;
+        for (address++; address < MOS_6502_MEM_SIZE && address - routine->end <= ROUTINE_GAP + 1; address++) {
+            if (profile->address_hits[address] != 0) {
+                routine->end = address;
+            }
+        }
+        address = routine->end + 1;
+        snprintf(routine->name, sizeof(routine->name), "sub_%04X", routine->start);
+    }
+    return count;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Orders routines by hits, highest first, ties by start address
+//   Inputs: Routines To Compare
+//   Output: Negative, zero or positive like qsort() wants
+// -------------------------------------------------------------------------------------------------------------------------------
+static int compare_routines(const void *left, const void *right) {
+    const t_routine *a = left;
+    const t_routine *b = right;
+
+    if (a->hits != b->hits) {
+        return (a->hits > b->hits) ? -1 : 1;
+    }
+    return (a->start > b->start) - (a->start < b->start);
+}
@@ -0,0 +1,252 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Snapshot Checker
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_snapshot_checker.c
+//
+// Description:
+//   Checks that restoring a snapshot and seeking the rewind buffer put RAM back, including RAM that was switched out to
+//   another bank and back in or written by the loader after the snapshot or capture was taken. Each check prints whether it
+//   passed, and the checker fails if any of them did not.
+//
+//   Build: cc -O2 -pthread -I../Source mos6502_snapshot_checker.c ../Source/mos6502_snapshot.c ../Source/mos6502_rewind.c
+//          ../Source/mos6502_loader.c ../Source/mos6502_emulator.c ../Source/mos6502_block_cache.c ../Source/mos6502_jit.c
+//          ../Source/mos6502_memory_bus.c ../Source/mos6502_debugger.c -o mos6502_snapshot_checker
+//   Usage: mos6502_snapshot_checker
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+#include <string.h>
+
+// Local
+#include "mos6502_snapshot.h"
+#include "mos6502_rewind.h"
+#include "mos6502_loader.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Defines
+// -------------------------------------------------------------------------------------------------------------------------------
+// Page switched between the two banks, and the address in it the checks write to
+#define BANKED_PAGE    0x40
+#define CHECK_ADDRESS  0x4000
+
+// Ring of the rewind buffer, and cycles between its captures
+#define REWIND_BUFFER_SIZE (1024 * 1024)
+#define CAPTURE_INTERVAL   1000
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Types
+// -------------------------------------------------------------------------------------------------------------------------------
+// Machine with a second bank of RAM that can be switched in over page $40
+typedef struct t_struct_machine {
+    unsigned char memory[MOS_6502_MEM_SIZE];
+    unsigned char other_bank[MEMORY_PAGE_SIZE];
+    t_memory_bus bus;
+    t_registers registers;
+} t_machine;
+
+// Single check, returning 1 when it passed
+typedef struct t_struct_check {
+    const char *name;
+    int (*run)(void);
+} t_check;
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Function Prototypes
+// -------------------------------------------------------------------------------------------------------------------------------
+// Checks
+static int check_write_restored(void);
+static int check_bank_switched_back(void);
+static int check_bank_left_switched(void);
+static int check_poke_restored(void);
+static int check_poke_refuses_rom(void);
+static int check_rewind_bank_switched_back(void);
+static int check_rewind_bank_switched(void);
+
+// Puts a machine back to all RAM with nothing written
+static void reset_machine(t_machine *);
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Global Variables
+// -------------------------------------------------------------------------------------------------------------------------------
+static t_machine machine;
+static t_snapshot snapshot;
+static t_rewind buffer;
+
+static const t_check checks[] = {
+    { "Write restored", check_write_restored },
+    { "Bank switched out and back before a write", check_bank_switched_back },
+    { "Bank left switched out", check_bank_left_switched },
+    { "Loader write restored", check_poke_restored },
+    { "Loader write to ROM refused", check_poke_refuses_rom },
+    { "Rewind with a bank switched out and back", check_rewind_bank_switched_back },
+    { "Rewind with a bank switched out", check_rewind_bank_switched }
+};
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(void) {
+    unsigned int failures = 0;
+
+    for (unsigned int i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        int passed = checks[i].run();
+        printf("%-48s %s\n", checks[i].name, passed ? "pass" : "FAIL");
+        if (!passed) {
+            failures++;
+        }
+    }
+    return (failures == 0) ? 0 : 1;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// A write after the snapshot is undone by the restore
+//   Output: 1 if it passed, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int check_write_restored(void) {
+    reset_machine(&machine);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x11);
+    snapshot_mos6502(&machine.bus, &machine.registers, &snapshot);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x99);
+    restore_mos6502(&machine.bus, &machine.registers, &snapshot);
+    return read_bus_mos6502(&machine.bus, CHECK_ADDRESS) == 0x11;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// A page switched to the other bank and back after the snapshot is still tracked, so a write to it is undone
+//   Output: 1 if it passed, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int check_bank_switched_back(void) {
+    reset_machine(&machine);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x11);
+    snapshot_mos6502(&machine.bus, &machine.registers, &snapshot);
+    map_memory_mos6502(&machine.bus, BANKED_PAGE, 1, machine.other_bank, 0);
+    map_memory_mos6502(&machine.bus, BANKED_PAGE, 1, &machine.memory[BANKED_PAGE * MEMORY_PAGE_SIZE], 0);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x99);
+    restore_mos6502(&machine.bus, &machine.registers, &snapshot);
+    if (read_bus_mos6502(&machine.bus, CHECK_ADDRESS) != 0x11) {
+        return 0;
+    }
+
+    // The page is clean again after the restore, and the next write to it is still caught
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x99);
+    restore_mos6502(&machine.bus, &machine.registers, &snapshot);
+    return read_bus_mos6502(&machine.bus, CHECK_ADDRESS) == 0x11;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// A page still switched to the other bank is left alone by the restore, the bank it was saved from gets its contents back
+// once it is switched in again
+//   Output: 1 if it passed, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int check_bank_left_switched(void) {
+    reset_machine(&machine);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x11);
+    snapshot_mos6502(&machine.bus, &machine.registers, &snapshot);
+    map_memory_mos6502(&machine.bus, BANKED_PAGE, 1, machine.other_bank, 0);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x77);
+    restore_mos6502(&machine.bus, &machine.registers, &snapshot);
+    if (read_bus_mos6502(&machine.bus, CHECK_ADDRESS) != 0x77) {
+        return 0;
+    }
+
+    map_memory_mos6502(&machine.bus, BANKED_PAGE, 1, &machine.memory[BANKED_PAGE * MEMORY_PAGE_SIZE], 0);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x99);
+    restore_mos6502(&machine.bus, &machine.registers, &snapshot);
+    return read_bus_mos6502(&machine.bus, CHECK_ADDRESS) == 0x11;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Bytes the loader writes after the snapshot mark their page dirty, so they are undone by the restore
+//   Output: 1 if it passed, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int check_poke_restored(void) {
+    static const unsigned char bytes[] = { 0x01, 0x02, 0x03 };
+
+    reset_machine(&machine);
+    snapshot_mos6502(&machine.bus, &machine.registers, &snapshot);
+    if (poke_memory_mos6502(&machine.bus, CHECK_ADDRESS, bytes, sizeof(bytes)) != 0) {
+        return 0;
+    }
+    restore_mos6502(&machine.bus, &machine.registers, &snapshot);
+    return read_bus_mos6502(&machine.bus, CHECK_ADDRESS) == 0x00 && snapshot.bytes_restored != 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// The loader refuses a range running into ROM and writes none of it, as the ROM may be shared with other machines
+//   Output: 1 if it passed, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int check_poke_refuses_rom(void) {
+    static const unsigned char bytes[] = { 0x01, 0x02, 0x03 };
+
+    reset_machine(&machine);
+    map_memory_mos6502(&machine.bus, BANKED_PAGE, 1, machine.other_bank, PAGE_WRITE_PROTECT);
+    return poke_memory_mos6502(&machine.bus, CHECK_ADDRESS - 1, bytes, sizeof(bytes)) != 0 &&
+           machine.memory[CHECK_ADDRESS - 1] == 0x00 && machine.other_bank[0] == 0x00;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// A page switched to the other bank and back between two captures is still tracked, so the delta holds the write to it
+//   Output: 1 if it passed, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int check_rewind_bank_switched_back(void) {
+    reset_machine(&machine);
+    if (init_rewind_mos6502(&buffer, REWIND_BUFFER_SIZE, CAPTURE_INTERVAL, 8) != 0) {
+        return 0;
+    }
+    capture_rewind_mos6502(&buffer, &machine.bus, &machine.registers);
+    map_memory_mos6502(&machine.bus, BANKED_PAGE, 1, machine.other_bank, 0);
+    map_memory_mos6502(&machine.bus, BANKED_PAGE, 1, &machine.memory[BANKED_PAGE * MEMORY_PAGE_SIZE], 0);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x77);
+    machine.registers.cycles = CAPTURE_INTERVAL;
+    capture_rewind_mos6502(&buffer, &machine.bus, &machine.registers);
+
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x55);
+    machine.registers.cycles = 2 * CAPTURE_INTERVAL;
+    int passed = seek_rewind_mos6502(&buffer, &machine.bus, &machine.registers, CAPTURE_INTERVAL) == 0 &&
+                 read_bus_mos6502(&machine.bus, CHECK_ADDRESS) == 0x77 && buffer.deltas == 1;
+    free_rewind_mos6502(&buffer);
+    return passed;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// A page still switched to the other bank at a capture makes it a keyframe, which holds the write to the other bank
+//   Output: 1 if it passed, 0 if not
+// -------------------------------------------------------------------------------------------------------------------------------
+static int check_rewind_bank_switched(void) {
+    reset_machine(&machine);
+    if (init_rewind_mos6502(&buffer, REWIND_BUFFER_SIZE, CAPTURE_INTERVAL, 8) != 0) {
+        return 0;
+    }
+    capture_rewind_mos6502(&buffer, &machine.bus, &machine.registers);
+    map_memory_mos6502(&machine.bus, BANKED_PAGE, 1, machine.other_bank, 0);
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x77);
+    machine.registers.cycles = CAPTURE_INTERVAL;
+    capture_rewind_mos6502(&buffer, &machine.bus, &machine.registers);
+
+    write_bus_mos6502(&machine.bus, CHECK_ADDRESS, 0x55);
+    machine.registers.cycles = 2 * CAPTURE_INTERVAL;
+    int passed = seek_rewind_mos6502(&buffer, &machine.bus, &machine.registers, CAPTURE_INTERVAL) == 0 &&
+                 read_bus_mos6502(&machine.bus, CHECK_ADDRESS) == 0x77 && buffer.keyframes == 2;
+    free_rewind_mos6502(&buffer);
+    return passed;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Puts a machine back to all RAM with nothing written
+//   Inputs: Machine
+// -------------------------------------------------------------------------------------------------------------------------------
+static void reset_machine(t_machine *target) {
+    memset(target->memory, 0, MOS_6502_MEM_SIZE);
+    memset(target->other_bank, 0, MEMORY_PAGE_SIZE);
+    memset(&target->registers, 0, sizeof(t_registers));
+    init_memory_bus_mos6502(&target->bus);
+    map_memory_mos6502(&target->bus, 0, MEMORY_PAGE_COUNT, target->memory, 0);
+}
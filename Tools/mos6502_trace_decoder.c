@@ -0,0 +1,54 @@
+// -------------------------------------------------------------------------------------------------------------------------------
+//
+// Title: MOS 6502 Trace Decoder
+//
+// Author: Nicholas Juk
+//
+// File: mos6502_trace_decoder.c
+//
+// Description:
+//   Prints a trace file written by the trace writer as text, one instruction per line with its address, bytes, disassembly,
+//   the registers before it ran and the cycle count.
+//
+//   Build: cc -O2 -pthread -I../Source mos6502_trace_decoder.c ../Source/mos6502_trace.c ../Source/mos6502_emulator.c
+//          ../Source/mos6502_block_cache.c ../Source/mos6502_jit.c ../Source/mos6502_memory_bus.c ../Source/mos6502_debugger.c
+//          -o mos6502_trace_decoder
+//   Usage: mos6502_trace_decoder trace_file [output_file]
+//
+// -------------------------------------------------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Libraries
+// -------------------------------------------------------------------------------------------------------------------------------
+// Standard
+#include <stdio.h>
+
+// Local
+#include "mos6502_trace.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+    FILE *output = stdout;
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s trace_file [output_file]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc == 3) {
+        output = fopen(argv[2], "w");
+        if (output == NULL) {
+            printf("Error: Could not create %s!!\n", argv[2]);
+            return 1;
+        }
+    }
+
+    int result = decode_trace_file_mos6502(argv[1], output);
+
+    if (output != stdout) {
+        fclose(output);
+    }
+    return (result == 0) ? 0 : 1;
+}